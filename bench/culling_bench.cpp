@@ -0,0 +1,186 @@
+// CPU视锥剔除的吞吐量：每种可用的kernel分别在单线程与多线程下测试，另外测一次Scene::cull(含索引压缩)
+// 对象均匀分布在立方体内，相机位于中心，约有十分之一可见
+// 用法：culling_bench [--objects=1000000] [--iterations=200] [--threads=<n>] [--seed=1]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frustum_culling.h"
+#include "scene.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        uint32_t objects = 1000000;
+        uint32_t iterations = 200;
+        uint32_t threads = 0;
+        uint32_t seed = 1;
+    };
+
+    Options parseOptions(int argc, char **argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; i++)
+        {
+            const char *arg = argv[i];
+            if (sscanf(arg, "--objects=%u", &options.objects) == 1)
+                continue;
+            if (sscanf(arg, "--iterations=%u", &options.iterations) == 1)
+                continue;
+            if (sscanf(arg, "--threads=%u", &options.threads) == 1)
+                continue;
+            if (sscanf(arg, "--seed=%u", &options.seed) == 1)
+                continue;
+            throw std::runtime_error(std::string("=====Unknown argument: ") + arg + "=====");
+        }
+        options.iterations = std::max(options.iterations, 1u);
+        return options;
+    }
+
+    // 列主序的perspective * lookAt(原点，看向-z)，Vulkan深度[0, 1]，y轴向下
+    void viewProjection(float fovY, float aspect, float nearPlane, float farPlane, float *m)
+    {
+        float f = 1.0f / std::tan(fovY * 0.5f);
+        std::fill(m, m + 16, 0.0f);
+        m[0] = f / aspect;
+        m[5] = -f;
+        m[10] = farPlane / (nearPlane - farPlane);
+        m[11] = -1.0f;
+        m[14] = nearPlane * farPlane / (nearPlane - farPlane);
+    }
+
+    struct Timing
+    {
+        double averageMs = 0.0;
+        double minMs = 0.0;
+        size_t visible = 0;
+    };
+
+    template <typename Function>
+    Timing measure(uint32_t iterations, Function &&function)
+    {
+        Timing timing;
+        timing.minMs = 1e30;
+        double total = 0.0;
+        //第一次运行预热缓存与工作线程，不计入
+        timing.visible = function();
+        for (uint32_t i = 0; i < iterations; i++)
+        {
+            auto start = Clock::now();
+            timing.visible = function();
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            total += ms;
+            timing.minMs = std::min(timing.minMs, ms);
+        }
+        timing.averageMs = total / iterations;
+        return timing;
+    }
+
+    void printTiming(const char *name, uint32_t threads, const Timing &timing, size_t objects)
+    {
+        //每个对象读取4个float
+        double gigabytes = objects * 16.0 / 1e9;
+        printf("%-8s %2u threads  avg %7.3f ms  min %7.3f ms  %7.1f M objects/s  %6.1f GB/s  visible %zu\n", name, threads,
+            timing.averageMs, timing.minMs, objects / timing.averageMs / 1e3, gigabytes / (timing.minMs / 1e3), timing.visible);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+        uint32_t threads = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+
+        Scene scene;
+        scene.reserve(options.objects);
+        std::mt19937 random(options.seed);
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+        std::uniform_real_distribution<float> size(0.5f, 4.0f);
+        std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+        for (uint32_t i = 0; i < options.objects; i++)
+        {
+            Scene::ObjectDesc object;
+            object.position[0] = position(random);
+            object.position[1] = position(random);
+            object.position[2] = position(random);
+            float half = angle(random) * 0.5f;
+            object.rotation[1] = std::sin(half);
+            object.rotation[3] = std::cos(half);
+            object.scale = size(random);
+            scene.add(object);
+        }
+        auto updateStart = Clock::now();
+        scene.updateBounds();
+        printf("%u objects, bounds update %.2f ms, best kernel %s\n", options.objects,
+            std::chrono::duration<double, std::milli>(Clock::now() - updateStart).count(), cullingKernelName(bestCullingKernel()));
+
+        float matrix[16];
+        viewProjection(1.0471976f, 16.0f / 9.0f, 0.1f, 500.0f, matrix);
+        Frustum frustum = frustumFromMatrix(matrix);
+        SphereArrays spheres = scene.spheres();
+
+        //标量结果作为参考，SIMD kernel的结果只可能在恰好贴着平面的对象上因FMA舍入而不同
+        std::vector<uint64_t> reference((options.objects + 63) / 64);
+        cullSpheres(CullingKernel::Scalar, frustum, spheres, 0, options.objects, reference.data());
+
+        FrustumCuller culler;
+        std::vector<uint64_t> bits;
+        for (CullingKernel kernel : {CullingKernel::Scalar, CullingKernel::Sse, CullingKernel::Avx2, CullingKernel::Neon})
+        {
+            if (!cullingKernelSupported(kernel))
+            {
+                continue;
+            }
+            culler.setKernel(kernel);
+            for (uint32_t threadCount : {1u, threads})
+            {
+                culler.setThreadCount(threadCount);
+                Timing timing = measure(options.iterations, [&] { return culler.cull(frustum, spheres, options.objects, bits); });
+                printTiming(cullingKernelName(kernel), threadCount, timing, options.objects);
+                if (threadCount == threads)
+                {
+                    break;
+                }
+            }
+
+            size_t mismatches = 0;
+            for (size_t word = 0; word < bits.size(); word++)
+            {
+                uint64_t difference = bits[word] ^ reference[word];
+                while (difference != 0)
+                {
+                    mismatches++;
+                    difference &= difference - 1;
+                }
+            }
+            if (mismatches > 0)
+            {
+                printf("         %zu objects differ from the scalar kernel\n", mismatches);
+            }
+        }
+
+        culler.setKernel(bestCullingKernel());
+        culler.setThreadCount(threads);
+        std::vector<uint32_t> visibleObjects;
+        Timing timing = measure(options.iterations, [&] { return scene.cull(culler, frustum, visibleObjects); });
+        printTiming("scene", threads, timing, options.objects);
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
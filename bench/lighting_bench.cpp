@@ -0,0 +1,728 @@
+// Clustered forward shading(ClusteredLighting)在大量点光源下的开销：
+//   clustered：compute把光源分桶到froxel，fragment只遍历所在cluster的列表
+//   brute    ：fragment遍历所有光源，作为对照，只在光源数不超过--brute-max时运行
+// 场景为地面上的建筑网格，光源随机分布在街道高度，半径固定，光源数从1k每次翻倍到--max-lights
+// 输出每个光源数下分桶与着色的GPU时间、cluster的平均/最大光源数与被截断的cluster数
+// 用法：lighting_bench [--grid=32] [--frames=100] [--size=1920x1080] [--max-lights=65536] [--brute-max=4096] [--radius=4]
+//                      [--gpu=<index>] [--seed=1] [--shader-dir=shader]
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "clustered_lighting.h"
+
+namespace
+{
+    struct Options
+    {
+        uint32_t grid = 32;
+        uint32_t frames = 100;
+        uint32_t width = 1920;
+        uint32_t height = 1080;
+        uint32_t maxLights = 65536;
+        uint32_t bruteMax = 4096;
+        float radius = 4.0f;
+        uint32_t gpu = 0;
+        uint32_t seed = 1;
+        std::string shaderDirectory = "shader";
+    };
+
+    Options parseOptions(int argc, char **argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; i++)
+        {
+            const char *arg = argv[i];
+            if (sscanf(arg, "--grid=%u", &options.grid) == 1)
+                continue;
+            if (sscanf(arg, "--frames=%u", &options.frames) == 1)
+                continue;
+            if (sscanf(arg, "--size=%ux%u", &options.width, &options.height) == 2)
+                continue;
+            if (sscanf(arg, "--max-lights=%u", &options.maxLights) == 1)
+                continue;
+            if (sscanf(arg, "--brute-max=%u", &options.bruteMax) == 1)
+                continue;
+            if (sscanf(arg, "--radius=%f", &options.radius) == 1)
+                continue;
+            if (sscanf(arg, "--gpu=%u", &options.gpu) == 1)
+                continue;
+            if (sscanf(arg, "--seed=%u", &options.seed) == 1)
+                continue;
+            if (strncmp(arg, "--shader-dir=", 13) == 0)
+                options.shaderDirectory = arg + 13;
+            else
+                throw std::runtime_error(std::string("=====Unknown argument: ") + arg + "=====");
+        }
+        options.grid = std::max(options.grid, 2u);
+        options.frames = std::max(options.frames, 8u);
+        options.maxLights = std::max(options.maxLights, 1024u);
+        options.radius = std::max(options.radius, 0.1f);
+        return options;
+    }
+
+    void check(VkResult result, const char *what)
+    {
+        if (result != VK_SUCCESS)
+        {
+            throw std::runtime_error(std::string("=====") + what + " failed: " + std::to_string(result) + "=====");
+        }
+    }
+
+    // 列主序4x4矩阵
+    struct Matrix
+    {
+        float m[16] = {};
+    };
+
+    Matrix multiply(const Matrix &a, const Matrix &b)
+    {
+        Matrix result;
+        for (int c = 0; c < 4; c++)
+        {
+            for (int r = 0; r < 4; r++)
+            {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; k++)
+                {
+                    sum += a.m[k * 4 + r] * b.m[c * 4 + k];
+                }
+                result.m[c * 4 + r] = sum;
+            }
+        }
+        return result;
+    }
+
+    // reverse-Z：近平面深度为1，远平面为0；Vulkan的clip空间y向下
+    Matrix perspective(float fovY, float aspect, float nearPlane, float farPlane)
+    {
+        float f = 1.0f / std::tan(fovY * 0.5f);
+        Matrix result;
+        result.m[0] = f / aspect;
+        result.m[5] = -f;
+        result.m[10] = nearPlane / (farPlane - nearPlane);
+        result.m[11] = -1.0f;
+        result.m[14] = nearPlane * farPlane / (farPlane - nearPlane);
+        return result;
+    }
+
+    Matrix lookAt(const float eye[3], const float target[3])
+    {
+        float forward[3] = {target[0] - eye[0], target[1] - eye[1], target[2] - eye[2]};
+        float length = std::sqrt(forward[0] * forward[0] + forward[1] * forward[1] + forward[2] * forward[2]);
+        for (float &value : forward)
+        {
+            value /= length;
+        }
+        //up为+y
+        float side[3] = {-forward[2], 0.0f, forward[0]};
+        length = std::sqrt(side[0] * side[0] + side[2] * side[2]);
+        side[0] /= length;
+        side[2] /= length;
+        float up[3] = {side[1] * forward[2] - side[2] * forward[1], side[2] * forward[0] - side[0] * forward[2], side[0] * forward[1] - side[1] * forward[0]};
+
+        Matrix result;
+        for (int i = 0; i < 3; i++)
+        {
+            result.m[i * 4 + 0] = side[i];
+            result.m[i * 4 + 1] = up[i];
+            result.m[i * 4 + 2] = -forward[i];
+        }
+        result.m[12] = -(side[0] * eye[0] + side[1] * eye[1] + side[2] * eye[2]);
+        result.m[13] = -(up[0] * eye[0] + up[1] * eye[1] + up[2] * eye[2]);
+        result.m[14] = forward[0] * eye[0] + forward[1] * eye[1] + forward[2] * eye[2];
+        result.m[15] = 1.0f;
+        return result;
+    }
+
+    uint32_t findMemoryType(const VkPhysicalDeviceMemoryProperties &memoryProperties, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+    {
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+        {
+            if ((typeFilter & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+            {
+                return i;
+            }
+        }
+        throw std::runtime_error("=====Failed to find memory type!=====");
+    }
+
+    // HOST_VISIBLE的buffer，创建时写入data
+    void createBuffer(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties, const void *data, VkDeviceSize size,
+        VkBufferUsageFlags usage, VkBuffer &buffer, VkDeviceMemory &memory)
+    {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        check(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer), "vkCreateBuffer");
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memoryProperties, memRequirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        check(vkAllocateMemory(device, &allocInfo, nullptr, &memory), "vkAllocateMemory");
+        vkBindBufferMemory(device, buffer, memory, 0);
+        void *mapped = nullptr;
+        vkMapMemory(device, memory, 0, size, 0, &mapped);
+        memcpy(mapped, data, static_cast<size_t>(size));
+        vkUnmapMemory(device, memory);
+    }
+
+    void createImage(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties, VkFormat format, VkExtent2D extent,
+        VkImageUsageFlags usage, VkImageAspectFlags aspect, VkImage &image, VkDeviceMemory &memory, VkImageView &view)
+    {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent = {extent.width, extent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = usage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        check(vkCreateImage(device, &imageInfo, nullptr, &image), "vkCreateImage");
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, image, &memRequirements);
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memoryProperties, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        check(vkAllocateMemory(device, &allocInfo, nullptr, &memory), "vkAllocateMemory");
+        vkBindImageMemory(device, image, memory, 0);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange = {aspect, 0, 1, 0, 1};
+        check(vkCreateImageView(device, &viewInfo, nullptr, &view), "vkCreateImageView");
+    }
+
+    VkShaderModule loadShader(VkDevice device, const std::string &path)
+    {
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("=====Failed to open shader file: " + path + "=====");
+        }
+        std::vector<char> code(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(code.data(), code.size());
+        VkShaderModuleCreateInfo moduleInfo{};
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.codeSize = code.size();
+        moduleInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+        VkShaderModule module;
+        check(vkCreateShaderModule(device, &moduleInfo, nullptr, &module), "vkCreateShaderModule");
+        return module;
+    }
+
+    VkRenderPass createRenderPass(VkDevice device)
+    {
+        VkAttachmentDescription attachments[2]{};
+        attachments[0].format = VK_FORMAT_R8G8B8A8_UNORM;
+        attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attachments[1] = attachments[0];
+        attachments[1].format = VK_FORMAT_D32_SFLOAT;
+        attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference colorReference{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        VkAttachmentReference depthReference{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorReference;
+        subpass.pDepthStencilAttachment = &depthReference;
+
+        //上一帧的颜色与深度写入完成后再写；cluster数据的barrier由ClusteredLighting负责
+        VkSubpassDependency dependency{};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = 0;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 2;
+        renderPassInfo.pAttachments = attachments;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 1;
+        renderPassInfo.pDependencies = &dependency;
+        VkRenderPass renderPass;
+        check(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass), "vkCreateRenderPass");
+        return renderPass;
+    }
+
+    struct ModeResult
+    {
+        std::vector<double> buildMs;
+        std::vector<double> shadeMs;
+        double indices = 0.0;
+        double maxLightsInCluster = 0.0;
+        double truncatedClusters = 0.0;
+        uint32_t clusters = 0;
+        uint32_t frames = 0;
+    };
+
+    double median(std::vector<double> &samples)
+    {
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+
+        VkApplicationInfo appInfo{};
+        appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        appInfo.pApplicationName = "lighting_bench";
+        appInfo.apiVersion = VK_API_VERSION_1_1;
+        VkInstanceCreateInfo instanceInfo{};
+        instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        instanceInfo.pApplicationInfo = &appInfo;
+        VkInstance instance;
+        check(vkCreateInstance(&instanceInfo, nullptr, &instance), "vkCreateInstance");
+
+        uint32_t deviceCount = 0;
+        vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+        std::vector<VkPhysicalDevice> physicalDevices(deviceCount);
+        vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data());
+        if (options.gpu >= deviceCount)
+        {
+            throw std::runtime_error("=====No GPU with index " + std::to_string(options.gpu) + "=====");
+        }
+        VkPhysicalDevice physicalDevice = physicalDevices[options.gpu];
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+        uint32_t queueFamily = UINT32_MAX;
+        for (uint32_t i = 0; i < familyCount; i++)
+        {
+            //graphics队列一定支持compute
+            if ((families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && families[i].timestampValidBits > 0)
+            {
+                queueFamily = i;
+                break;
+            }
+        }
+        if (queueFamily == UINT32_MAX)
+        {
+            throw std::runtime_error("=====No graphics queue with timestamp support!=====");
+        }
+
+        float priority = 1.0f;
+        VkDeviceQueueCreateInfo queueInfo{};
+        queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo.queueFamilyIndex = queueFamily;
+        queueInfo.queueCount = 1;
+        queueInfo.pQueuePriorities = &priority;
+        VkDeviceCreateInfo deviceInfo{};
+        deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        deviceInfo.queueCreateInfoCount = 1;
+        deviceInfo.pQueueCreateInfos = &queueInfo;
+        VkDevice device;
+        check(vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device), "vkCreateDevice");
+        VkQueue queue;
+        vkGetDeviceQueue(device, queueFamily, 0, &queue);
+
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+        //建筑：网格上每格一栋，最后一个对象是地面
+        const float spacing = 12.0f;
+        std::mt19937 random(options.seed);
+        std::uniform_real_distribution<float> footprint(3.0f, 4.5f);
+        std::uniform_real_distribution<float> height(4.0f, 40.0f);
+        float worldSize = options.grid * spacing;
+        std::vector<float> boxes;
+        for (uint32_t z = 0; z < options.grid; z++)
+        {
+            for (uint32_t x = 0; x < options.grid; x++)
+            {
+                float halfY = height(random) * 0.5f;
+                boxes.insert(boxes.end(), {x * spacing, halfY, z * spacing, 0.0f, footprint(random), halfY, footprint(random), 0.0f});
+            }
+        }
+        float groundCenter = (options.grid - 1) * spacing * 0.5f;
+        boxes.insert(boxes.end(), {groundCenter, -0.5f, groundCenter, 0.0f, worldSize * 0.5f, 0.5f, worldSize * 0.5f, 0.0f});
+        uint32_t objectCount = static_cast<uint32_t>(boxes.size() / 8);
+        //盒子的12个三角形，角的编号为x | y << 1 | z << 2
+        const uint16_t indices[36] = {
+            0, 2, 6, 0, 6, 4, 1, 3, 7, 1, 7, 5,
+            0, 1, 5, 0, 5, 4, 2, 3, 7, 2, 7, 6,
+            0, 1, 3, 0, 3, 2, 4, 5, 7, 4, 7, 6,
+        };
+
+        //光源在整个城市的街道高度随机分布；光源数较少时取前面的一部分，密度随光源数增长
+        std::uniform_real_distribution<float> position(-0.5f * spacing, worldSize - 0.5f * spacing);
+        std::uniform_real_distribution<float> lightHeight(0.5f, 8.0f);
+        std::uniform_real_distribution<float> channel(0.2f, 1.0f);
+        std::vector<PointLight> lights(options.maxLights);
+        for (PointLight &light : lights)
+        {
+            light.position[0] = position(random);
+            light.position[1] = lightHeight(random);
+            light.position[2] = position(random);
+            light.radius = options.radius;
+            light.color[0] = channel(random);
+            light.color[1] = channel(random);
+            light.color[2] = channel(random);
+            light.intensity = 4.0f;
+        }
+
+        VkBuffer boxBuffer, indexBuffer;
+        VkDeviceMemory boxMemory, indexMemory;
+        createBuffer(device, memoryProperties, boxes.data(), boxes.size() * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, boxBuffer, boxMemory);
+        createBuffer(device, memoryProperties, indices, sizeof(indices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer, indexMemory);
+
+        VkExtent2D extent{options.width, options.height};
+        VkImage colorImage, depthImage;
+        VkDeviceMemory colorMemory, depthMemory;
+        VkImageView colorView, depthView;
+        createImage(device, memoryProperties, VK_FORMAT_R8G8B8A8_UNORM, extent, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT, colorImage, colorMemory, colorView);
+        createImage(device, memoryProperties, VK_FORMAT_D32_SFLOAT, extent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+            VK_IMAGE_ASPECT_DEPTH_BIT, depthImage, depthMemory, depthView);
+
+        VkRenderPass renderPass = createRenderPass(device);
+        VkImageView attachments[2] = {colorView, depthView};
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = 2;
+        framebufferInfo.pAttachments = attachments;
+        framebufferInfo.width = extent.width;
+        framebufferInfo.height = extent.height;
+        framebufferInfo.layers = 1;
+        VkFramebuffer framebuffer;
+        check(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer), "vkCreateFramebuffer");
+
+        //近/远平面与投影矩阵一致；光源很密时把index buffer放大，截断的cluster数会在结果中体现
+        const float nearPlane = 0.1f;
+        const float farPlane = 2000.0f;
+        //基准以Vulkan 1.1创建设备，不启用synchronization2，barrier由Synchronization2转换为旧接口
+        Synchronization2 synchronization2;
+        synchronization2.load(device, false, false);
+        ClusteredLighting lighting;
+        lighting.create(device, synchronization2, memoryProperties, options.shaderDirectory, options.maxLights, 1);
+        ClusteredLighting::Config lightingConfig;
+        lightingConfig.nearPlane = nearPlane;
+        lightingConfig.farPlane = farPlane;
+        lightingConfig.averageLightsPerCluster = 64;
+        lighting.setConfig(lightingConfig);
+        lighting.setExtent(extent);
+
+        //set 0为建筑，set 1为ClusteredLighting
+        VkDescriptorSetLayoutBinding binding{};
+        binding.binding = 0;
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        binding.descriptorCount = 1;
+        binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+        setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        setLayoutInfo.bindingCount = 1;
+        setLayoutInfo.pBindings = &binding;
+        VkDescriptorSetLayout setLayout;
+        check(vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &setLayout), "vkCreateDescriptorSetLayout");
+        VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1};
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        VkDescriptorPool descriptorPool;
+        check(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool), "vkCreateDescriptorPool");
+        VkDescriptorSetAllocateInfo setInfo{};
+        setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool = descriptorPool;
+        setInfo.descriptorSetCount = 1;
+        setInfo.pSetLayouts = &setLayout;
+        VkDescriptorSet descriptorSet;
+        check(vkAllocateDescriptorSets(device, &setInfo, &descriptorSet), "vkAllocateDescriptorSets");
+        VkDescriptorBufferInfo boxInfo{boxBuffer, 0, VK_WHOLE_SIZE};
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = descriptorSet;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = &boxInfo;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+        VkDescriptorSetLayout setLayouts[2] = {setLayout, lighting.descriptorSetLayout()};
+        VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Matrix)};
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 2;
+        pipelineLayoutInfo.pSetLayouts = setLayouts;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        VkPipelineLayout pipelineLayout;
+        check(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout), "vkCreatePipelineLayout");
+
+        VkShaderModule vertexShader = loadShader(device, options.shaderDirectory + "/occlusion_bench_vert.spv");
+        VkShaderModule fragmentShader = loadShader(device, options.shaderDirectory + "/clustered_bench_frag.spv");
+        VkPipelineShaderStageCreateInfo stages[2]{};
+        stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        stages[0].module = vertexShader;
+        stages[0].pName = "main";
+        stages[1] = stages[0];
+        stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        stages[1].module = fragmentShader;
+
+        VkPipelineVertexInputStateCreateInfo vertexInput{};
+        vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        VkViewport viewport{0.0f, 0.0f, float(extent.width), float(extent.height), 0.0f, 1.0f};
+        VkRect2D scissor{{0, 0}, extent};
+        VkPipelineViewportStateCreateInfo viewportState{};
+        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.viewportCount = 1;
+        viewportState.pViewports = &viewport;
+        viewportState.scissorCount = 1;
+        viewportState.pScissors = &scissor;
+        VkPipelineRasterizationStateCreateInfo rasterizer{};
+        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterizer.cullMode = VK_CULL_MODE_NONE;
+        rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        rasterizer.lineWidth = 1.0f;
+        VkPipelineMultisampleStateCreateInfo multisampling{};
+        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        VkPipelineDepthStencilStateCreateInfo depthStencil{};
+        depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depthStencil.depthTestEnable = VK_TRUE;
+        depthStencil.depthWriteEnable = VK_TRUE;
+        depthStencil.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+        VkPipelineColorBlendAttachmentState blendAttachment{};
+        blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        VkPipelineColorBlendStateCreateInfo colorBlending{};
+        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlending.attachmentCount = 1;
+        colorBlending.pAttachments = &blendAttachment;
+        VkGraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = 2;
+        pipelineInfo.pStages = stages;
+        pipelineInfo.pVertexInputState = &vertexInput;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pDepthStencilState = &depthStencil;
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.layout = pipelineLayout;
+        pipelineInfo.renderPass = renderPass;
+
+        //两种模式只是fragment shader的specialization constant CLUSTERED不同
+        VkPipeline pipelines[2];
+        for (int mode = 0; mode < 2; mode++)
+        {
+            VkBool32 clustered = mode == 0 ? VK_TRUE : VK_FALSE;
+            VkSpecializationMapEntry entry{0, 0, sizeof(VkBool32)};
+            VkSpecializationInfo specialization{1, &entry, sizeof(clustered), &clustered};
+            stages[1].pSpecializationInfo = &specialization;
+            check(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipelines[mode]), "vkCreateGraphicsPipelines");
+        }
+        vkDestroyShaderModule(device, vertexShader, nullptr);
+        vkDestroyShaderModule(device, fragmentShader, nullptr);
+
+        VkCommandPoolCreateInfo commandPoolInfo{};
+        commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        commandPoolInfo.queueFamilyIndex = queueFamily;
+        VkCommandPool commandPool;
+        check(vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool), "vkCreateCommandPool");
+        VkCommandBufferAllocateInfo commandBufferInfo{};
+        commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferInfo.commandPool = commandPool;
+        commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        check(vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer), "vkAllocateCommandBuffers");
+
+        //开始、分桶结束、着色结束
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = 3;
+        VkQueryPool timestampPool;
+        check(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestampPool), "vkCreateQueryPool");
+
+        Matrix projection = perspective(1.0f, float(extent.width) / float(extent.height), nearPlane, farPlane);
+        const float projectionScale[2] = {projection.m[0], projection.m[5]};
+        float streetZ = (options.grid / 2 + 0.5f) * spacing;
+        float streetLength = (options.grid - 1) * spacing;
+        double period = properties.limits.timestampPeriod / 1e6;
+        const uint32_t warmupFrames = 4;
+
+        std::vector<uint32_t> lightCounts;
+        for (uint32_t count = 1024; count <= options.maxLights; count *= 2)
+        {
+            lightCounts.push_back(count);
+        }
+
+        printf("%s, %ux%u, %u objects, %u frames, light radius %.1f, %ux%ux%u clusters\n", properties.deviceName, extent.width, extent.height,
+            objectCount, options.frames, options.radius, (extent.width + lightingConfig.tileSize - 1) / lightingConfig.tileSize,
+            (extent.height + lightingConfig.tileSize - 1) / lightingConfig.tileSize, lightingConfig.slices);
+        printf("%-7s %-9s %10s %10s %10s %9s %9s %9s\n", "lights", "mode", "build ms", "shade ms", "total ms", "avg/clu", "max/clu", "truncated");
+
+        const char *modeNames[2] = {"clustered", "brute"};
+        for (uint32_t lightCount : lightCounts)
+        {
+            for (int mode = 0; mode < 2; mode++)
+            {
+                bool clustered = mode == 0;
+                if (!clustered && lightCount > options.bruteMax)
+                {
+                    continue;
+                }
+
+                ModeResult result;
+                for (uint32_t frame = 0; frame < options.frames + warmupFrames; frame++)
+                {
+                    //沿街道前进，视线在街道方向左右摆动
+                    float t = float(frame) / float(options.frames + warmupFrames);
+                    float eye[3] = {t * streetLength, 3.0f, streetZ};
+                    float yaw = 0.5f * std::sin(t * 12.0f);
+                    float target[3] = {eye[0] + std::cos(yaw), 2.5f, eye[2] + std::sin(yaw)};
+                    Matrix view = lookAt(eye, target);
+                    Matrix viewProjection = multiply(projection, view);
+                    //brute模式也分桶：uniform与光源由分桶写入，只是fragment shader不使用cluster列表
+                    lighting.setLights(0, lights.data(), lightCount);
+
+                    VkCommandBufferBeginInfo beginInfo{};
+                    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                    check(vkResetCommandBuffer(commandBuffer, 0), "vkResetCommandBuffer");
+                    check(vkBeginCommandBuffer(commandBuffer, &beginInfo), "vkBeginCommandBuffer");
+                    vkCmdResetQueryPool(commandBuffer, timestampPool, 0, 3);
+                    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, 0);
+                    lighting.recordBuild(commandBuffer, 0, view.m, projectionScale);
+                    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, timestampPool, 1);
+
+                    VkClearValue clearValues[2]{};
+                    clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+                    clearValues[1].depthStencil = {0.0f, 0};
+                    VkRenderPassBeginInfo passInfo{};
+                    passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                    passInfo.renderPass = renderPass;
+                    passInfo.framebuffer = framebuffer;
+                    passInfo.renderArea = {{0, 0}, extent};
+                    passInfo.clearValueCount = 2;
+                    passInfo.pClearValues = clearValues;
+                    vkCmdBeginRenderPass(commandBuffer, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[mode]);
+                    VkDescriptorSet sets[2] = {descriptorSet, lighting.descriptorSet(0)};
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, sets, 0, nullptr);
+                    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Matrix), viewProjection.m);
+                    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+                    vkCmdDrawIndexed(commandBuffer, 36, objectCount, 0, 0, 0);
+                    vkCmdEndRenderPass(commandBuffer);
+                    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, 2);
+                    check(vkEndCommandBuffer(commandBuffer), "vkEndCommandBuffer");
+
+                    VkSubmitInfo submitInfo{};
+                    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                    submitInfo.commandBufferCount = 1;
+                    submitInfo.pCommandBuffers = &commandBuffer;
+                    check(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE), "vkQueueSubmit");
+                    check(vkQueueWaitIdle(queue), "vkQueueWaitIdle");
+                    if (frame < warmupFrames)
+                    {
+                        continue;
+                    }
+
+                    uint64_t timestamps[3];
+                    check(vkGetQueryPoolResults(device, timestampPool, 0, 3, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT),
+                        "vkGetQueryPoolResults");
+                    result.buildMs.push_back((timestamps[1] - timestamps[0]) * period);
+                    result.shadeMs.push_back((timestamps[2] - timestamps[1]) * period);
+                    ClusteredLighting::Stats stats = lighting.stats(0);
+                    result.clusters = stats.clusters;
+                    result.indices += stats.indices;
+                    result.maxLightsInCluster = std::max(result.maxLightsInCluster, double(stats.maxLightsInCluster));
+                    result.truncatedClusters += stats.truncatedClusters;
+                    result.frames++;
+                }
+
+                double frames = result.frames;
+                double buildMs = clustered ? median(result.buildMs) : 0.0;
+                double shadeMs = median(result.shadeMs);
+                printf("%-7u %-9s %10.3f %10.3f %10.3f %9.2f %9.0f %9.1f\n", lightCount, modeNames[mode], buildMs, shadeMs, buildMs + shadeMs,
+                    result.indices / frames / result.clusters, result.maxLightsInCluster, result.truncatedClusters / frames);
+            }
+        }
+        printf("(brute shades every light per fragment; its build time is not counted)\n");
+
+        lighting.destroy();
+        vkDestroyQueryPool(device, timestampPool, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        vkDestroyPipeline(device, pipelines[0], nullptr);
+        vkDestroyPipeline(device, pipelines[1], nullptr);
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+        vkDestroyRenderPass(device, renderPass, nullptr);
+        vkDestroyImageView(device, colorView, nullptr);
+        vkDestroyImageView(device, depthView, nullptr);
+        vkDestroyImage(device, colorImage, nullptr);
+        vkDestroyImage(device, depthImage, nullptr);
+        vkFreeMemory(device, colorMemory, nullptr);
+        vkFreeMemory(device, depthMemory, nullptr);
+        vkDestroyBuffer(device, boxBuffer, nullptr);
+        vkDestroyBuffer(device, indexBuffer, nullptr);
+        vkFreeMemory(device, boxMemory, nullptr);
+        vkFreeMemory(device, indexMemory, nullptr);
+        vkDestroyDevice(device, nullptr);
+        vkDestroyInstance(instance, nullptr);
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
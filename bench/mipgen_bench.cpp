@@ -0,0 +1,414 @@
+// 对比两种生成mip链的方式在GPU上的耗时：
+//   blit：逐级vkCmdBlitImage，每级之间一个barrier
+//   spd ：MipGenerator的单pass compute
+// 用法：mipgen_bench [--size=3840x2160] [--format=rgba8|srgb|rgba16f|r32f] [--iterations=100] [--gpu=<index>] [--lds] [--shader-dir=shader]
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "mip_generator.h"
+
+namespace
+{
+    struct Options
+    {
+        uint32_t width = 3840;
+        uint32_t height = 2160;
+        VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+        uint32_t iterations = 100;
+        uint32_t gpu = 0;
+        bool forceLds = false;
+        std::string shaderDirectory = "shader";
+    };
+
+    Options parseOptions(int argc, char **argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; i++)
+        {
+            const char *arg = argv[i];
+            if (sscanf(arg, "--size=%ux%u", &options.width, &options.height) == 2)
+                continue;
+            if (sscanf(arg, "--iterations=%u", &options.iterations) == 1)
+                continue;
+            if (sscanf(arg, "--gpu=%u", &options.gpu) == 1)
+                continue;
+            if (strcmp(arg, "--lds") == 0)
+                options.forceLds = true;
+            else if (strncmp(arg, "--shader-dir=", 13) == 0)
+                options.shaderDirectory = arg + 13;
+            else if (strcmp(arg, "--format=rgba8") == 0)
+                options.format = VK_FORMAT_R8G8B8A8_UNORM;
+            else if (strcmp(arg, "--format=srgb") == 0)
+                options.format = VK_FORMAT_R8G8B8A8_SRGB;
+            else if (strcmp(arg, "--format=rgba16f") == 0)
+                options.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+            else if (strcmp(arg, "--format=r32f") == 0)
+                options.format = VK_FORMAT_R32_SFLOAT;
+            else
+                throw std::runtime_error(std::string("=====Unknown argument: ") + arg + "=====");
+        }
+        options.iterations = std::max(options.iterations, 1u);
+        return options;
+    }
+
+    void check(VkResult result, const char *what)
+    {
+        if (result != VK_SUCCESS)
+        {
+            throw std::runtime_error(std::string("=====") + what + " failed: " + std::to_string(result) + "=====");
+        }
+    }
+
+    VkImageMemoryBarrier imageBarrier(VkImage image, uint32_t baseLevel, uint32_t levelCount,
+        VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+    {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = baseLevel;
+        barrier.subresourceRange.levelCount = levelCount;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        return barrier;
+    }
+
+    // 与常见的generateMipmaps写法相同：每级先把上一级转为TRANSFER_SRC，blit后再转为SHADER_READ_ONLY
+    void recordBlitChain(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels)
+    {
+        VkImageMemoryBarrier start[2] = {
+            imageBarrier(image, 0, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                0, VK_ACCESS_TRANSFER_READ_BIT),
+            imageBarrier(image, 1, mipLevels - 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                0, VK_ACCESS_TRANSFER_WRITE_BIT),
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, start);
+
+        int32_t mipWidth = static_cast<int32_t>(width);
+        int32_t mipHeight = static_cast<int32_t>(height);
+        for (uint32_t level = 1; level < mipLevels; level++)
+        {
+            if (level > 1)
+            {
+                VkImageMemoryBarrier toSource = imageBarrier(image, level - 1, 1,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    0, 0, nullptr, 0, nullptr, 1, &toSource);
+            }
+
+            VkImageBlit blit{};
+            blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+            blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+            mipWidth = std::max(mipWidth / 2, 1);
+            mipHeight = std::max(mipHeight / 2, 1);
+            blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+            blit.dstOffsets[1] = {mipWidth, mipHeight, 1};
+            vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+            VkImageMemoryBarrier toRead = imageBarrier(image, level - 1, 1,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT);
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &toRead);
+        }
+
+        VkImageMemoryBarrier last = imageBarrier(image, mipLevels - 1, 1,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &last);
+    }
+
+    struct Result
+    {
+        double average = 0.0;
+        double median = 0.0;
+        double minimum = 0.0;
+    };
+
+    Result summarize(std::vector<double> samples)
+    {
+        Result result;
+        std::sort(samples.begin(), samples.end());
+        for (double sample : samples)
+        {
+            result.average += sample;
+        }
+        result.average /= samples.size();
+        result.median = samples[samples.size() / 2];
+        result.minimum = samples.front();
+        return result;
+    }
+
+    const char *formatName(VkFormat format)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            return "RGBA8 sRGB";
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            return "RGBA16F";
+        case VK_FORMAT_R32_SFLOAT:
+            return "R32F";
+        default:
+            return "RGBA8";
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+
+        VkApplicationInfo appInfo{};
+        appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        appInfo.pApplicationName = "mipgen_bench";
+        appInfo.apiVersion = VK_API_VERSION_1_1;
+        VkInstanceCreateInfo instanceInfo{};
+        instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        instanceInfo.pApplicationInfo = &appInfo;
+        VkInstance instance;
+        check(vkCreateInstance(&instanceInfo, nullptr, &instance), "vkCreateInstance");
+
+        uint32_t deviceCount = 0;
+        vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+        std::vector<VkPhysicalDevice> physicalDevices(deviceCount);
+        vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data());
+        if (options.gpu >= deviceCount)
+        {
+            throw std::runtime_error("=====No GPU with index " + std::to_string(options.gpu) + "=====");
+        }
+        VkPhysicalDevice physicalDevice = physicalDevices[options.gpu];
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        //blit需要graphics队列，同一个队列也用于compute
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+        uint32_t queueFamily = UINT32_MAX;
+        for (uint32_t i = 0; i < familyCount; i++)
+        {
+            if ((families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && families[i].timestampValidBits > 0)
+            {
+                queueFamily = i;
+                break;
+            }
+        }
+        if (queueFamily == UINT32_MAX)
+        {
+            throw std::runtime_error("=====No graphics queue with timestamp support!=====");
+        }
+
+        float priority = 1.0f;
+        VkDeviceQueueCreateInfo queueInfo{};
+        queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo.queueFamilyIndex = queueFamily;
+        queueInfo.queueCount = 1;
+        queueInfo.pQueuePriorities = &priority;
+        VkDeviceCreateInfo deviceInfo{};
+        deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        deviceInfo.queueCreateInfoCount = 1;
+        deviceInfo.pQueueCreateInfos = &queueInfo;
+        VkDevice device;
+        check(vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device), "vkCreateDevice");
+        VkQueue queue;
+        vkGetDeviceQueue(device, queueFamily, 0, &queue);
+
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+        //两种方式都依赖线性过滤求2x2平均
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, options.format, &formatProperties);
+        VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        if ((formatProperties.optimalTilingFeatures & required) != required)
+        {
+            throw std::runtime_error(std::string("=====") + formatName(options.format) + " cannot be blitted or filtered on this GPU=====");
+        }
+
+        bool subgroupQuad = !options.forceLds && MipGenerator::supportsSubgroupQuad(physicalDevice);
+        MipGenerator mipGenerator;
+        mipGenerator.create(device, memoryProperties, options.shaderDirectory, subgroupQuad, 1);
+
+        //同一张image交替用两种方式生成
+        uint32_t mipLevels = 1;
+        while ((std::max(options.width, options.height) >> mipLevels) > 0)
+        {
+            mipLevels++;
+        }
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.flags = options.format == VK_FORMAT_R8G8B8A8_SRGB ? VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT : 0;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = options.format;
+        imageInfo.extent = {options.width, options.height, 1};
+        imageInfo.mipLevels = mipLevels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                          VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkImage image;
+        check(vkCreateImage(device, &imageInfo, nullptr, &image), "vkCreateImage");
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, image, &memRequirements);
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = UINT32_MAX;
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+        {
+            if ((memRequirements.memoryTypeBits & (1u << i)) &&
+                (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+            {
+                allocInfo.memoryTypeIndex = i;
+                break;
+            }
+        }
+        VkDeviceMemory imageMemory;
+        check(vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory), "vkAllocateMemory");
+        vkBindImageMemory(device, image, imageMemory, 0);
+        uint32_t target = mipGenerator.addTarget(image, options.format, options.width, options.height, mipLevels);
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = queueFamily;
+        VkCommandPool commandPool;
+        check(vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool), "vkCreateCommandPool");
+        VkCommandBufferAllocateInfo commandBufferInfo{};
+        commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferInfo.commandPool = commandPool;
+        commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        check(vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer), "vkAllocateCommandBuffers");
+
+        //每次迭代两个timestamp：blit的开始/结束与spd的开始/结束
+        uint32_t queryCount = options.iterations * 4;
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = queryCount;
+        VkQueryPool queryPool;
+        check(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool), "vkCreateQueryPool");
+
+        auto submitAndWait = [&]()
+        {
+            VkSubmitInfo submitInfo{};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &commandBuffer;
+            check(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE), "vkQueueSubmit");
+            check(vkQueueWaitIdle(queue), "vkQueueWaitIdle");
+        };
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        //填充mip0并把所有级别转为SHADER_READ_ONLY，作为每次迭代的起始状态
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        VkImageMemoryBarrier toClear = imageBarrier(image, 0, mipLevels, VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &toClear);
+        VkClearColorValue clearColor = {{0.25f, 0.5f, 0.75f, 1.0f}};
+        VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1};
+        vkCmdClearColorImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &range);
+        VkImageMemoryBarrier toRead = imageBarrier(image, 0, mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &toRead);
+        vkEndCommandBuffer(commandBuffer);
+        submitAndWait();
+
+        //先各跑几次预热，再在一个command buffer中交替录制，两种方式受到的时钟变化影响相同
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            recordBlitChain(commandBuffer, image, options.width, options.height, mipLevels);
+            mipGenerator.record(commandBuffer, target, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        }
+        vkEndCommandBuffer(commandBuffer);
+        submitAndWait();
+
+        vkResetCommandBuffer(commandBuffer, 0);
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        vkCmdResetQueryPool(commandBuffer, queryPool, 0, queryCount);
+        for (uint32_t i = 0; i < options.iterations; i++)
+        {
+            //BOTTOM_OF_PIPE：等之前的命令全部完成才写入，测到的是完整的执行时间
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, i * 4);
+            recordBlitChain(commandBuffer, image, options.width, options.height, mipLevels);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, i * 4 + 1);
+
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, i * 4 + 2);
+            mipGenerator.record(commandBuffer, target, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, i * 4 + 3);
+        }
+        vkEndCommandBuffer(commandBuffer);
+        submitAndWait();
+
+        std::vector<uint64_t> timestamps(queryCount);
+        check(vkGetQueryPoolResults(device, queryPool, 0, queryCount, timestamps.size() * sizeof(uint64_t), timestamps.data(),
+                  sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT),
+            "vkGetQueryPoolResults");
+        std::vector<double> blitSamples;
+        std::vector<double> spdSamples;
+        double period = properties.limits.timestampPeriod / 1e6;
+        for (uint32_t i = 0; i < options.iterations; i++)
+        {
+            blitSamples.push_back((timestamps[i * 4 + 1] - timestamps[i * 4]) * period);
+            spdSamples.push_back((timestamps[i * 4 + 3] - timestamps[i * 4 + 2]) * period);
+        }
+        Result blit = summarize(blitSamples);
+        Result spd = summarize(spdSamples);
+
+        printf("%s, %ux%u %s, %u mips, %u iterations, spd %s\n", properties.deviceName, options.width, options.height,
+            formatName(options.format), mipLevels, options.iterations, subgroupQuad ? "subgroup quad" : "shared memory");
+        printf("%-6s %10s %10s %10s\n", "", "avg ms", "median ms", "min ms");
+        printf("%-6s %10.3f %10.3f %10.3f\n", "blit", blit.average, blit.median, blit.minimum);
+        printf("%-6s %10.3f %10.3f %10.3f\n", "spd", spd.average, spd.median, spd.minimum);
+        printf("speedup (median) %.2fx\n", blit.median / spd.median);
+
+        vkDestroyQueryPool(device, queryPool, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        mipGenerator.destroy();
+        vkDestroyImage(device, image, nullptr);
+        vkFreeMemory(device, imageMemory, nullptr);
+        vkDestroyDevice(device, nullptr);
+        vkDestroyInstance(instance, nullptr);
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+#version 450
+
+// lighting_bench的着色：顶点由occlusion_bench.vert生成，光源与cluster数据来自ClusteredLighting(set 1)
+// CLUSTERED为true时只遍历fragment所在cluster的光源列表，否则遍历所有光源作为对照
+
+layout(location = 0) in vec3 worldPosition;
+layout(location = 1) flat in uint objectIndex;
+
+layout(location = 0) out vec4 outColor;
+
+// 与light_cluster.comp一致
+layout(set = 1, binding = 0) uniform ClusterUniforms
+{
+    mat4 view;
+    vec4 projection;
+    uvec4 grid;
+    vec4 screen;
+    uint lightCount;
+    uint maxLightsPerCluster;
+    uint indexCapacity;
+} cluster;
+layout(std430, set = 1, binding = 1) readonly buffer Lights { vec4 lights[]; };
+layout(std430, set = 1, binding = 2) readonly buffer Clusters { uvec2 clusters[]; };
+layout(std430, set = 1, binding = 4) readonly buffer LightIndices { uint lightIndices[]; };
+
+layout(constant_id = 0) const bool CLUSTERED = true;
+
+// 与light_cluster.comp一致
+uint depthSlice(float depth)
+{
+    float slice = floor(log(max(depth, 1e-6)) * cluster.screen.z + cluster.screen.w);
+    return uint(clamp(slice, 0.0, float(cluster.grid.z - 1)));
+}
+
+vec3 shade(uint lightIndex, vec3 normal)
+{
+    vec4 positionRadius = lights[lightIndex * 2];
+    vec4 colorIntensity = lights[lightIndex * 2 + 1];
+    vec3 toLight = positionRadius.xyz - worldPosition;
+    float distanceSquared = dot(toLight, toLight);
+    float radiusSquared = positionRadius.w * positionRadius.w;
+    if (distanceSquared >= radiusSquared)
+    {
+        return vec3(0.0);
+    }
+    // 在半径处平滑衰减到0
+    float window = 1.0 - distanceSquared / radiusSquared;
+    float attenuation = window * window / (1.0 + distanceSquared);
+    float lambert = max(dot(normal, toLight * inversesqrt(max(distanceSquared, 1e-8))), 0.0);
+    return colorIntensity.rgb * colorIntensity.a * attenuation * lambert;
+}
+
+void main()
+{
+    // 由屏幕空间导数求面法线，不需要顶点法线
+    vec3 normal = normalize(cross(dFdx(worldPosition), dFdy(worldPosition)));
+    // 朝向相机的一侧
+    vec3 cameraPosition = -transpose(mat3(cluster.view)) * cluster.view[3].xyz;
+    if (dot(normal, cameraPosition - worldPosition) < 0.0)
+    {
+        normal = -normal;
+    }
+    uint hash = objectIndex * 2654435761u;
+    vec3 albedo = vec3((hash >> 8) & 255u, (hash >> 16) & 255u, (hash >> 24) & 255u) / 255.0 * 0.5 + 0.4;
+
+    vec3 light = vec3(0.02);
+    if (CLUSTERED)
+    {
+        float depth = -(cluster.view * vec4(worldPosition, 1.0)).z;
+        uvec2 tile = min(uvec2(gl_FragCoord.xy) / cluster.grid.w, cluster.grid.xy - 1);
+        uint index = (depthSlice(depth) * cluster.grid.y + tile.y) * cluster.grid.x + tile.x;
+        uvec2 list = clusters[index];
+        for (uint i = 0; i < list.y; i++)
+        {
+            light += shade(lightIndices[list.x + i], normal);
+        }
+    }
+    else
+    {
+        for (uint i = 0; i < cluster.lightCount; i++)
+        {
+            light += shade(i, normal);
+        }
+    }
+    outColor = vec4(albedo * light, 1.0);
+}
@@ -1,3 +0,0 @@
-C:/VulkanSDK/1.3.275.0/Bin/glslc.exe triangle.vert -o vert.spv
-C:/VulkanSDK/1.3.275.0/Bin/glslc.exe triangle.frag -o frag.spv
-pause
\ No newline at end of file
@@ -0,0 +1,16 @@
+#version 450
+
+layout(location = 0) in vec3 worldPosition;
+layout(location = 1) flat in uint objectIndex;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    // 由屏幕空间导数求面法线，不需要顶点法线
+    vec3 normal = normalize(cross(dFdx(worldPosition), dFdy(worldPosition)));
+    float light = 0.3 + 0.7 * abs(dot(normal, normalize(vec3(0.4, 0.8, 0.3))));
+    uint hash = objectIndex * 2654435761u;
+    vec3 albedo = vec3((hash >> 8) & 255u, (hash >> 16) & 255u, (hash >> 24) & 255u) / 255.0 * 0.5 + 0.4;
+    outColor = vec4(albedo * light, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#version 450
+
+// occlusion_bench的建筑：每个对象一个盒子，8个角由gl_VertexIndex的3位生成，index buffer给出12个三角形
+// gl_InstanceIndex即indirect命令中的firstInstance，也就是对象编号
+
+// 每个对象两个vec4：中心与半尺寸
+layout(std430, binding = 0) readonly buffer Boxes { vec4 boxes[]; };
+
+layout(push_constant) uniform PushConstants
+{
+    mat4 viewProjection;
+} pc;
+
+layout(location = 0) out vec3 worldPosition;
+layout(location = 1) flat out uint objectIndex;
+
+void main()
+{
+    uint object = uint(gl_InstanceIndex);
+    vec3 center = boxes[object * 2].xyz;
+    vec3 halfSize = boxes[object * 2 + 1].xyz;
+    vec3 corner = vec3((gl_VertexIndex & 1) != 0 ? 1.0 : -1.0, (gl_VertexIndex & 2) != 0 ? 1.0 : -1.0, (gl_VertexIndex & 4) != 0 ? 1.0 : -1.0);
+    worldPosition = center + corner * halfSize;
+    objectIndex = object;
+    gl_Position = pc.viewProjection * vec4(worldPosition, 1.0);
+}
\ No newline at end of file
@@ -2,8 +2,33 @@
 
 layout(location = 0) out vec4 outColor;
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
 
+layout(binding = 0) uniform sampler2D texSampler;
+
+// 创建pipeline时由VkSpecializationInfo代入，驱动把它们当作常量折叠掉不用的分支和循环
+// 关闭时只输出顶点颜色，depth prepass用它得到最简单的fragment shader
+layout(constant_id = 0) const bool TEXTURED = true;
+// 每个像素内的纹理采样次数，大于1时在像素覆盖的纹理范围内按圆周均匀采样后取平均
+layout(constant_id = 1) const int TEXTURE_TAPS = 1;
 
 void main() {
-    outColor = vec4(fragColor, 1.);
+    vec3 color = fragColor;
+    if (TEXTURED) {
+        vec3 texel = vec3(0.0);
+        if (TEXTURE_TAPS <= 1) {
+            texel = texture(texSampler, fragTexCoord).rgb;
+        } else {
+            vec2 dx = dFdx(fragTexCoord);
+            vec2 dy = dFdy(fragTexCoord);
+            for (int i = 0; i < TEXTURE_TAPS; i++) {
+                float angle = (float(i) + 0.5) * 6.2831853 / float(TEXTURE_TAPS);
+                vec2 offset = 0.35 * vec2(cos(angle), sin(angle));
+                texel += texture(texSampler, fragTexCoord + offset.x * dx + offset.y * dy).rgb;
+            }
+            texel /= float(TEXTURE_TAPS);
+        }
+        color *= texel;
+    }
+    outColor = vec4(color, 1.);
 }
\ No newline at end of file
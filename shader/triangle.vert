@@ -1,6 +1,7 @@
 #version 450
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
 
 vec2 positions[3] = vec2[](
     vec2(0.0, -0.5),
@@ -17,4 +18,6 @@ vec3 colors[3] = vec3[](
 void main() {
     gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
     fragColor = colors[gl_VertexIndex];
+    // [-0.5, 0.5] -> [0, 1]
+    fragTexCoord = positions[gl_VertexIndex] + 0.5;
 }
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "allocation_counter.h"
+
+#ifndef KUTORY_COUNT_ALLOCATIONS
+#define KUTORY_COUNT_ALLOCATIONS 0
+#endif
+
+#if KUTORY_COUNT_ALLOCATIONS
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace
+{
+    // 平凡类型的thread_local不需要动态初始化，可以在operator new中安全使用
+    thread_local uint64_t allocationCount = 0;
+    thread_local uint64_t allocationBytes = 0;
+
+    void *countedAllocate(size_t size)
+    {
+        allocationCount++;
+        allocationBytes += size;
+        return malloc(size == 0 ? 1 : size);
+    }
+
+    // 对齐分配：多申请alignment + 一个指针，原始指针保存在返回地址之前
+    void *countedAllocateAligned(size_t size, size_t alignment)
+    {
+        allocationCount++;
+        allocationBytes += size;
+        void *raw = malloc(size + alignment + sizeof(void *));
+        if (raw == nullptr)
+        {
+            return nullptr;
+        }
+        uintptr_t address = reinterpret_cast<uintptr_t>(raw) + sizeof(void *);
+        uintptr_t aligned = (address + alignment - 1) & ~uintptr_t(alignment - 1);
+        memcpy(reinterpret_cast<void *>(aligned - sizeof(void *)), &raw, sizeof(void *));
+        return reinterpret_cast<void *>(aligned);
+    }
+
+    void freeAligned(void *pointer)
+    {
+        if (pointer == nullptr)
+        {
+            return;
+        }
+        void *raw;
+        memcpy(&raw, static_cast<uint8_t *>(pointer) - sizeof(void *), sizeof(void *));
+        free(raw);
+    }
+}
+
+void *operator new(size_t size)
+{
+    if (void *pointer = countedAllocate(size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    if (void *pointer = countedAllocate(size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAllocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAllocate(size);
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    if (void *pointer = countedAllocateAligned(size, static_cast<size_t>(alignment)))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+    if (void *pointer = countedAllocateAligned(size, static_cast<size_t>(alignment)))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return countedAllocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return countedAllocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *pointer) noexcept { free(pointer); }
+void operator delete[](void *pointer) noexcept { free(pointer); }
+void operator delete(void *pointer, size_t) noexcept { free(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { free(pointer); }
+void operator delete(void *pointer, const std::nothrow_t &) noexcept { free(pointer); }
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept { free(pointer); }
+void operator delete(void *pointer, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete[](void *pointer, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete[](void *pointer, size_t, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete(void *pointer, std::align_val_t, const std::nothrow_t &) noexcept { freeAligned(pointer); }
+void operator delete[](void *pointer, std::align_val_t, const std::nothrow_t &) noexcept { freeAligned(pointer); }
+
+bool allocationCountingEnabled()
+{
+    return true;
+}
+
+uint64_t threadAllocationCount()
+{
+    return allocationCount;
+}
+
+uint64_t threadAllocationBytes()
+{
+    return allocationBytes;
+}
+#else
+bool allocationCountingEnabled()
+{
+    return false;
+}
+
+uint64_t threadAllocationCount()
+{
+    return 0;
+}
+
+uint64_t threadAllocationBytes()
+{
+    return 0;
+}
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+// 统计当前线程通过operator new进行的堆分配，用于确认稳定运行时每帧不分配内存
+// 需要以KUTORY_COUNT_ALLOCATIONS=1编译(CMake选项同名)，此时替换全局的operator new/delete；
+// 否则不做任何替换，计数恒为0
+bool allocationCountingEnabled();
+// 当前线程累计的分配次数与字节数
+uint64_t threadAllocationCount();
+uint64_t threadAllocationBytes();
+
+// 构造到调用allocations()之间当前线程的分配次数
+class AllocationScope
+{
+public:
+    AllocationScope() : startCount(threadAllocationCount()), startBytes(threadAllocationBytes()) {}
+
+    uint64_t allocations() const { return threadAllocationCount() - startCount; }
+    uint64_t bytes() const { return threadAllocationBytes() - startBytes; }
+
+private:
+    uint64_t startCount;
+    uint64_t startBytes;
+};
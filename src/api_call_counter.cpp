@@ -0,0 +1,44 @@
+#include "api_call_counter.h"
+
+namespace
+{
+#if KUTORY_PROFILING
+    // 常量初始化，不需要动态初始化
+    thread_local ApiCallCounts threadCounts;
+#endif
+
+    const char *const callNames[apiCallCount] = {
+        "draw",
+        "dispatch",
+        "bind_pipeline",
+        "bind_descriptor_sets",
+        "bind_vertex_buffers",
+        "bind_index_buffer",
+        "push_constants",
+        "pipeline_barrier",
+        "barrier",
+        "begin_render_pass",
+        "execute_commands",
+        "copy",
+        "submit",
+        "present",
+    };
+}
+
+const char *apiCallName(ApiCall call)
+{
+    uint32_t index = static_cast<uint32_t>(call);
+    return index < apiCallCount ? callNames[index] : "unknown";
+}
+
+#if KUTORY_PROFILING
+void countApiCall(ApiCall call, uint64_t count)
+{
+    threadCounts.calls[static_cast<uint32_t>(call)] += count;
+}
+
+const ApiCallCounts &threadApiCallCounts()
+{
+    return threadCounts;
+}
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+
+#include "renderer_config.h"
+
+// 统计当前线程录制与提交的Vulkan命令，用于观察每帧的CPU端工作量
+// 计数点放在命令最终调用驱动的地方(DrawList、Synchronization2、QueueSubmitter等)，调用方不需要改动
+// 缓存的secondary command buffer只在重新录制时计数，之后每帧只计一次ExecuteCommands
+enum class ApiCall : uint32_t
+{
+    Draw,
+    Dispatch,
+    BindPipeline,
+    BindDescriptorSets,
+    BindVertexBuffers,
+    BindIndexBuffer,
+    PushConstants,
+    // vkCmdPipelineBarrier(2)的调用次数
+    PipelineBarrier,
+    // 其中memory/buffer/image barrier结构的总数
+    Barrier,
+    BeginRenderPass,
+    ExecuteCommands,
+    Copy,
+    Submit,
+    Present,
+    Count,
+};
+
+const uint32_t apiCallCount = static_cast<uint32_t>(ApiCall::Count);
+
+// 小写下划线形式，用作CSV列名与Prometheus的标签
+const char *apiCallName(ApiCall call);
+
+struct ApiCallCounts
+{
+    uint64_t calls[apiCallCount] = {};
+
+    uint64_t operator[](ApiCall call) const { return calls[static_cast<uint32_t>(call)]; }
+};
+
+#if KUTORY_PROFILING
+void countApiCall(ApiCall call, uint64_t count = 1);
+// 当前线程累计的调用次数
+const ApiCallCounts &threadApiCallCounts();
+
+// 构造到调用counts()之间当前线程的调用次数
+class ApiCallScope
+{
+public:
+    ApiCallScope() : start(threadApiCallCounts()) {}
+
+    ApiCallCounts counts() const
+    {
+        const ApiCallCounts &current = threadApiCallCounts();
+        ApiCallCounts result;
+        for (uint32_t i = 0; i < apiCallCount; i++)
+        {
+            result.calls[i] = current.calls[i] - start.calls[i];
+        }
+        return result;
+    }
+
+private:
+    ApiCallCounts start;
+};
+#else
+// 关闭profiling时计数点编译为空，各模块的调用处不需要条件编译
+inline void countApiCall(ApiCall, uint64_t = 1) {}
+
+class ApiCallScope
+{
+public:
+    ApiCallCounts counts() const { return {}; }
+};
+#endif
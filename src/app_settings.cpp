@@ -0,0 +1,227 @@
+#include "app_settings.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    // 读取 --name=value 形式的参数，匹配时返回value
+    const char *matchOption(const char *arg, const char *name)
+    {
+        size_t length = strlen(name);
+        if (strncmp(arg, name, length) == 0 && arg[length] == '=')
+        {
+            return arg + length + 1;
+        }
+        return nullptr;
+    }
+
+    [[noreturn]] void throwInvalidValue(const char *value, const char *what)
+    {
+        throw std::runtime_error(std::string("=====Invalid value for ") + what + ": " + value + "=====");
+    }
+
+    //strtoull会跳过空白并接受负号(-1变成ULLONG_MAX)，所以要求第一个字符就是数字
+    uint64_t parseUnsigned64(const char *value, const char *what, uint64_t maxValue = UINT64_MAX)
+    {
+        if (!isdigit(static_cast<unsigned char>(value[0])))
+        {
+            throwInvalidValue(value, what);
+        }
+        char *end = nullptr;
+        errno = 0;
+        unsigned long long result = strtoull(value, &end, 10);
+        if (*end != '\0' || errno == ERANGE || result > maxValue)
+        {
+            throwInvalidValue(value, what);
+        }
+        return result;
+    }
+
+    uint32_t parseUnsigned(const char *value, const char *what)
+    {
+        return static_cast<uint32_t>(parseUnsigned64(value, what, UINT32_MAX));
+    }
+
+    //nan与inf在后面的比较中都不会被当作非法值，这里直接拒绝
+    double parseDouble(const char *value, const char *what)
+    {
+        char *end = nullptr;
+        double result = strtod(value, &end);
+        if (end == value || *end != '\0' || !std::isfinite(result) || result < 0.0)
+        {
+            throwInvalidValue(value, what);
+        }
+        return result;
+    }
+
+    bool parseBool(const char *value)
+    {
+        return strcmp(value, "0") != 0 && strcmp(value, "false") != 0 && strcmp(value, "off") != 0;
+    }
+}
+
+VkPresentModeKHR parsePresentMode(const char *name)
+{
+    if (strcmp(name, "immediate") == 0)
+        return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    if (strcmp(name, "mailbox") == 0)
+        return VK_PRESENT_MODE_MAILBOX_KHR;
+    if (strcmp(name, "fifo") == 0)
+        return VK_PRESENT_MODE_FIFO_KHR;
+    if (strcmp(name, "fifo_relaxed") == 0)
+        return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    throw std::runtime_error(std::string("=====Unknown present mode: ") + name + "=====");
+}
+
+const char *presentModeName(VkPresentModeKHR presentMode)
+{
+    switch (presentMode)
+    {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR:
+        return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "fifo_relaxed";
+    default:
+        return "unknown";
+    }
+}
+
+ShaderQuality parseShaderQuality(const char *name)
+{
+    if (strcmp(name, "low") == 0)
+        return ShaderQuality::Low;
+    if (strcmp(name, "medium") == 0)
+        return ShaderQuality::Medium;
+    if (strcmp(name, "high") == 0)
+        return ShaderQuality::High;
+    throw std::runtime_error(std::string("=====Unknown shader quality: ") + name + "=====");
+}
+
+const char *shaderQualityName(ShaderQuality quality)
+{
+    switch (quality)
+    {
+    case ShaderQuality::Low:
+        return "low";
+    case ShaderQuality::Medium:
+        return "medium";
+    case ShaderQuality::High:
+        return "high";
+    default:
+        return "unknown";
+    }
+}
+
+AppSettings parseAppSettings(int argc, char **argv)
+{
+    AppSettings settings;
+
+    // 先读环境变量，命令行参数随后覆盖
+    if (const char *env = getenv("KUTORY_PRESENT_MODE"))
+        settings.presentMode = parsePresentMode(env);
+    if (const char *env = getenv("KUTORY_SWAPCHAIN_IMAGES"))
+        settings.swapChainImageCount = parseUnsigned(env, "KUTORY_SWAPCHAIN_IMAGES");
+    if (const char *env = getenv("KUTORY_FPS_LIMIT"))
+        settings.fpsLimit = parseDouble(env, "KUTORY_FPS_LIMIT");
+    if (const char *env = getenv("KUTORY_LOW_LATENCY"))
+        settings.lowLatency = parseBool(env);
+    if (const char *env = getenv("KUTORY_GPU"))
+        settings.gpuSelector = env;
+    if (const char *env = getenv("KUTORY_LOG_LEVEL"))
+        settings.logLevel = parseLogLevel(env);
+    if (const char *env = getenv("KUTORY_STARTUP_TRACE"))
+        settings.startupTracePath = env;
+    if (const char *env = getenv("KUTORY_STARTUP_BUDGET_MS"))
+        settings.startupBudgetMs = parseDouble(env, "KUTORY_STARTUP_BUDGET_MS");
+    if (const char *env = getenv("KUTORY_TEXTURE_BUDGET_MB"))
+        settings.textureBudgetMb = parseDouble(env, "KUTORY_TEXTURE_BUDGET_MB");
+    if (const char *env = getenv("KUTORY_TEXTURE"))
+        settings.texturePath = env;
+    if (const char *env = getenv("KUTORY_CAPTURE"))
+        settings.captureTarget = env;
+    if (const char *env = getenv("KUTORY_HEADLESS"))
+        settings.headless = parseBool(env);
+    if (const char *env = getenv("KUTORY_GOLDEN"))
+        settings.goldenImagePath = env;
+    if (const char *env = getenv("KUTORY_CACHE_COMMANDS"))
+        settings.cacheCommands = parseBool(env);
+    if (const char *env = getenv("KUTORY_SHADER_QUALITY"))
+        settings.shaderQuality = parseShaderQuality(env);
+    if (const char *env = getenv("KUTORY_CHECK_FRAME_ALLOCATIONS"))
+        settings.checkFrameAllocations = parseBool(env);
+    if (const char *env = getenv("KUTORY_DYNAMIC_RESOLUTION"))
+        settings.dynamicResolutionMs = parseDouble(env, "KUTORY_DYNAMIC_RESOLUTION");
+    if (const char *env = getenv("KUTORY_UPSCALE_SHARPNESS"))
+        settings.upscaleSharpness = parseDouble(env, "KUTORY_UPSCALE_SHARPNESS");
+    if (const char *env = getenv("KUTORY_METRICS"))
+        settings.metricsTargets = env;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = nullptr;
+        if ((value = matchOption(arg, "--present-mode")))
+            settings.presentMode = parsePresentMode(value);
+        else if ((value = matchOption(arg, "--swapchain-images")))
+            settings.swapChainImageCount = parseUnsigned(value, "--swapchain-images");
+        else if ((value = matchOption(arg, "--fps-limit")))
+            settings.fpsLimit = parseDouble(value, "--fps-limit");
+        else if (strcmp(arg, "--low-latency") == 0)
+            settings.lowLatency = true;
+        else if (strcmp(arg, "--frame-stats") == 0)
+            settings.printFrameStats = true;
+        else if ((value = matchOption(arg, "--gpu")))
+            settings.gpuSelector = value;
+        else if ((value = matchOption(arg, "--log-level")))
+            settings.logLevel = parseLogLevel(value);
+        else if ((value = matchOption(arg, "--startup-trace")))
+            settings.startupTracePath = value;
+        else if ((value = matchOption(arg, "--startup-budget-ms")))
+            settings.startupBudgetMs = parseDouble(value, "--startup-budget-ms");
+        else if ((value = matchOption(arg, "--texture-budget-mb")))
+            settings.textureBudgetMb = parseDouble(value, "--texture-budget-mb");
+        else if ((value = matchOption(arg, "--texture")))
+            settings.texturePath = value;
+        else if ((value = matchOption(arg, "--capture")))
+            settings.captureTarget = value;
+        else if ((value = matchOption(arg, "--capture-start")))
+            settings.captureStart = parseUnsigned64(value, "--capture-start");
+        else if ((value = matchOption(arg, "--capture-frames")))
+            settings.captureFrames = parseUnsigned(value, "--capture-frames");
+        else if ((value = matchOption(arg, "--exit-after")))
+            settings.exitAfterFrames = parseUnsigned64(value, "--exit-after");
+        else if (strcmp(arg, "--headless") == 0)
+            settings.headless = true;
+        else if ((value = matchOption(arg, "--golden")))
+            settings.goldenImagePath = value;
+        else if ((value = matchOption(arg, "--golden-tolerance")))
+            settings.goldenTolerance = parseUnsigned(value, "--golden-tolerance");
+        else if (strcmp(arg, "--cache-commands") == 0)
+            settings.cacheCommands = true;
+        else if ((value = matchOption(arg, "--shader-quality")))
+            settings.shaderQuality = parseShaderQuality(value);
+        else if (strcmp(arg, "--check-frame-allocations") == 0)
+            settings.checkFrameAllocations = true;
+        else if ((value = matchOption(arg, "--dynamic-resolution")))
+            settings.dynamicResolutionMs = parseDouble(value, "--dynamic-resolution");
+        else if ((value = matchOption(arg, "--upscale-sharpness")))
+            settings.upscaleSharpness = parseDouble(value, "--upscale-sharpness");
+        else if ((value = matchOption(arg, "--metrics")))
+            settings.metricsTargets = value;
+        else
+            throw std::runtime_error(std::string("=====Unknown argument: ") + arg + "=====");
+    }
+
+    return settings;
+}
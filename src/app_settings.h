@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "log.h"
+
+// fragment shader的质量档位，通过specialization constant代入同一份SPIR-V
+enum class ShaderQuality
+{
+    // 只输出顶点颜色，不采样纹理
+    Low,
+    // 每个像素采样一次纹理
+    Medium,
+    // 每个像素采样4次纹理后取平均，减少放大时的走样
+    High,
+};
+
+// 运行时可调的设置，来源优先级：命令行 > 环境变量 > 默认值
+struct AppSettings
+{
+    // 为空时按MAILBOX -> FIFO的顺序自动选择
+    std::optional<VkPresentModeKHR> presentMode;
+    // 0表示自动(minImageCount + 1)，否则会被限制在surface支持的范围内
+    uint32_t swapChainImageCount = 0;
+    // 帧率上限，0表示不限制
+    double fpsLimit = 0.0;
+    // 按预测的GPU开始时间推迟CPU的帧开始，减少输入到显示的延迟
+    bool lowLatency = false;
+    // 每秒在stdout输出一次帧时间与延迟统计
+    bool printFrameStats = false;
+    // 按枚举索引或名称子串强制选择GPU，为空时按分数自动选择
+    std::string gpuSelector;
+    // 控制台输出级别，verbose时列出所有layer与扩展
+    LogLevel logLevel = LogLevel::Info;
+    // 非空时把启动阶段耗时写成Chrome trace JSON
+    std::string startupTracePath;
+    // 启动(到第一帧提交)的耗时预算，超出时给出警告，0表示不检查
+    double startupBudgetMs = 0.0;
+    // 纹理常驻显存上限(MiB)，0表示按VK_EXT_memory_budget报告的可用显存自动决定
+    double textureBudgetMb = 0.0;
+    // 非空时加载该KTX2文件代替程序生成的棋盘格纹理
+    std::string texturePath;
+    // 非空时异步捕获帧：png:<path>、raw:<path>或pipe:<command>，见FrameCapture::Config
+    std::string captureTarget;
+    // 从第几帧开始捕获
+    uint64_t captureStart = 0;
+    // 捕获的帧数，0表示一直捕获
+    uint32_t captureFrames = 0;
+    // 渲染指定帧数后退出，0表示不限制
+    uint64_t exitAfterFrames = 0;
+    // 不创建窗口，使用VK_EXT_headless_surface渲染
+    bool headless = false;
+    // 非空时退出前把最后捕获的一帧与该PNG比较，超出容差时以失败退出
+    std::string goldenImagePath;
+    // 每个通道允许的差值
+    uint32_t goldenTolerance = 2;
+    // 静态的draw录制在secondary command buffer中，只在swap chain、pipeline、descriptor或draw list变化时重新录制
+    bool cacheCommands = false;
+    ShaderQuality shaderQuality = ShaderQuality::Medium;
+    // 预热之后的帧在主线程上有堆分配时抛出异常，需要以KUTORY_COUNT_ALLOCATIONS编译
+    bool checkFrameAllocations = false;
+    // GPU帧时间的目标(ms)，非0时按GPU时间调整渲染分辨率再放大到窗口尺寸，0表示关闭
+    double dynamicResolutionMs = 0.0;
+    // 放大后的锐化强度，0到1
+    double upscaleSharpness = 0.5;
+    // 非空时输出每帧的pipeline statistics与命令数：逗号分隔的stdout、csv:<path>、prometheus:<port>，见createMetricsSink
+    std::string metricsTargets;
+};
+
+// 解析--present-mode=、--swapchain-images=、--fps-limit=、--low-latency、--frame-stats、--gpu=、
+// --log-level=、--startup-trace=、--startup-budget-ms=、--texture-budget-mb=、--texture=、
+// --capture=、--capture-start=、--capture-frames=、--exit-after=、--headless、--golden=、--golden-tolerance=、--cache-commands、
+// --shader-quality=、--check-frame-allocations、--dynamic-resolution=、--upscale-sharpness=、--metrics=
+// 以及对应的KUTORY_*环境变量，格式错误时抛出std::runtime_error
+AppSettings parseAppSettings(int argc, char **argv);
+
+VkPresentModeKHR parsePresentMode(const char *name);
+const char *presentModeName(VkPresentModeKHR presentMode);
+ShaderQuality parseShaderQuality(const char *name);
+const char *shaderQualityName(ShaderQuality quality);
@@ -0,0 +1,1020 @@
+#include "batch_renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+#include "device_selection.h"
+#include "png_image.h"
+
+namespace
+{
+    const VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    const VkFormat depthFormat = VK_FORMAT_D32_SFLOAT;
+    // 建筑之间的距离，与occlusion_bench相同
+    const float citySpacing = 12.0f;
+
+    void check(VkResult result, const char *what)
+    {
+        if (result != VK_SUCCESS)
+        {
+            throw std::runtime_error(std::string("=====") + what + " failed: " + std::to_string(result) + "=====");
+        }
+    }
+
+    // 列主序4x4矩阵
+    struct Matrix
+    {
+        float m[16] = {};
+    };
+
+    Matrix multiply(const Matrix &a, const Matrix &b)
+    {
+        Matrix result;
+        for (int c = 0; c < 4; c++)
+        {
+            for (int r = 0; r < 4; r++)
+            {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; k++)
+                {
+                    sum += a.m[k * 4 + r] * b.m[c * 4 + k];
+                }
+                result.m[c * 4 + r] = sum;
+            }
+        }
+        return result;
+    }
+
+    // reverse-Z：近平面深度为1，远平面为0；Vulkan的clip空间y向下
+    Matrix perspective(float fovY, float aspect, float nearPlane, float farPlane)
+    {
+        float f = 1.0f / std::tan(fovY * 0.5f);
+        Matrix result;
+        result.m[0] = f / aspect;
+        result.m[5] = -f;
+        result.m[10] = nearPlane / (farPlane - nearPlane);
+        result.m[11] = -1.0f;
+        result.m[14] = nearPlane * farPlane / (farPlane - nearPlane);
+        return result;
+    }
+
+    Matrix lookAt(const float eye[3], const float target[3])
+    {
+        float forward[3] = {target[0] - eye[0], target[1] - eye[1], target[2] - eye[2]};
+        float length = std::sqrt(forward[0] * forward[0] + forward[1] * forward[1] + forward[2] * forward[2]);
+        for (float &value : forward)
+        {
+            value /= length;
+        }
+        //up为+y
+        float side[3] = {-forward[2], 0.0f, forward[0]};
+        length = std::sqrt(side[0] * side[0] + side[2] * side[2]);
+        side[0] /= length;
+        side[2] /= length;
+        float up[3] = {side[1] * forward[2] - side[2] * forward[1], side[2] * forward[0] - side[0] * forward[2], side[0] * forward[1] - side[1] * forward[0]};
+
+        Matrix result;
+        for (int i = 0; i < 3; i++)
+        {
+            result.m[i * 4 + 0] = side[i];
+            result.m[i * 4 + 1] = up[i];
+            result.m[i * 4 + 2] = -forward[i];
+        }
+        result.m[12] = -(side[0] * eye[0] + side[1] * eye[1] + side[2] * eye[2]);
+        result.m[13] = -(up[0] * eye[0] + up[1] * eye[1] + up[2] * eye[2]);
+        result.m[14] = forward[0] * eye[0] + forward[1] * eye[1] + forward[2] * eye[2];
+        result.m[15] = 1.0f;
+        return result;
+    }
+
+    // 按顺序尝试每组属性，返回第一个匹配的内存类型
+    uint32_t findMemoryType(const VkPhysicalDeviceMemoryProperties &memoryProperties, uint32_t typeFilter,
+        std::initializer_list<VkMemoryPropertyFlags> candidates, VkMemoryPropertyFlags &chosen)
+    {
+        for (VkMemoryPropertyFlags properties : candidates)
+        {
+            for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+            {
+                if ((typeFilter & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+                {
+                    chosen = memoryProperties.memoryTypes[i].propertyFlags;
+                    return i;
+                }
+            }
+        }
+        throw std::runtime_error("=====Failed to find memory type!=====");
+    }
+
+    VkMemoryPropertyFlags createBuffer(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties, VkDeviceSize size,
+        VkBufferUsageFlags usage, std::initializer_list<VkMemoryPropertyFlags> candidates, VkBuffer &buffer, VkDeviceMemory &memory)
+    {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        check(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer), "vkCreateBuffer");
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+        VkMemoryPropertyFlags chosen = 0;
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memoryProperties, memRequirements.memoryTypeBits, candidates, chosen);
+        check(vkAllocateMemory(device, &allocInfo, nullptr, &memory), "vkAllocateMemory");
+        vkBindBufferMemory(device, buffer, memory, 0);
+        return chosen;
+    }
+
+    // 只在创建时写入一次的buffer；有ReBAR/统一内存时直接放在显存中
+    void createUploadBuffer(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties, const void *data, VkDeviceSize size,
+        VkBufferUsageFlags usage, VkBuffer &buffer, VkDeviceMemory &memory)
+    {
+        createBuffer(device, memoryProperties, size, usage,
+            {VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT},
+            buffer, memory);
+        void *mapped = nullptr;
+        check(vkMapMemory(device, memory, 0, size, 0, &mapped), "vkMapMemory");
+        memcpy(mapped, data, static_cast<size_t>(size));
+        vkUnmapMemory(device, memory);
+    }
+
+    void createImage(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties, VkFormat format, VkExtent2D extent,
+        VkImageUsageFlags usage, VkImageAspectFlags aspect, VkImage &image, VkDeviceMemory &memory, VkImageView &view)
+    {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent = {extent.width, extent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = usage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        check(vkCreateImage(device, &imageInfo, nullptr, &image), "vkCreateImage");
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, image, &memRequirements);
+        VkMemoryPropertyFlags chosen = 0;
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memoryProperties, memRequirements.memoryTypeBits, {VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT}, chosen);
+        check(vkAllocateMemory(device, &allocInfo, nullptr, &memory), "vkAllocateMemory");
+        vkBindImageMemory(device, image, memory, 0);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange = {aspect, 0, 1, 0, 1};
+        check(vkCreateImageView(device, &viewInfo, nullptr, &view), "vkCreateImageView");
+    }
+
+    VkShaderModule loadShader(VkDevice device, const std::string &path)
+    {
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("=====Failed to open shader file: " + path + "=====");
+        }
+        std::vector<char> code(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(code.data(), code.size());
+        VkShaderModuleCreateInfo moduleInfo{};
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.codeSize = code.size();
+        moduleInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+        VkShaderModule module;
+        check(vkCreateShaderModule(device, &moduleInfo, nullptr, &module), "vkCreateShaderModule");
+        return module;
+    }
+
+    // 依次把%d/%0Nd替换为values中的值，不把用户输入直接当作printf格式
+    std::string formatOutputPath(const std::string &pattern, std::initializer_list<uint32_t> values)
+    {
+        std::string result;
+        auto value = values.begin();
+        size_t position = 0;
+        while (position < pattern.size())
+        {
+            size_t percent = pattern.find('%', position);
+            if (percent == std::string::npos || value == values.end())
+            {
+                break;
+            }
+            size_t end = percent + 1;
+            size_t width = 0;
+            while (end < pattern.size() && pattern[end] >= '0' && pattern[end] <= '9')
+            {
+                width = width * 10 + (pattern[end] - '0');
+                end++;
+            }
+            if (end >= pattern.size() || pattern[end] != 'd')
+            {
+                result.append(pattern, position, end - position);
+                position = end;
+                continue;
+            }
+            std::string number = std::to_string(*value++);
+            if (number.size() < width)
+            {
+                number.insert(0, width - number.size(), '0');
+            }
+            result.append(pattern, position, percent - position);
+            result += number;
+            position = end + 1;
+        }
+        result.append(pattern, std::min(position, pattern.size()), std::string::npos);
+        return result;
+    }
+
+    // 与occlusion_bench相同的城市：网格上每格一栋建筑，每个对象两个vec4(中心与半尺寸)
+    std::vector<float> buildCity(const BatchJob &job)
+    {
+        std::mt19937 random(job.seed);
+        std::uniform_real_distribution<float> footprint(4.0f, 5.5f);
+        std::uniform_real_distribution<float> height(6.0f, 60.0f);
+        std::vector<float> boxes;
+        boxes.reserve(size_t(job.grid) * job.grid * 8);
+        for (uint32_t z = 0; z < job.grid; z++)
+        {
+            for (uint32_t x = 0; x < job.grid; x++)
+            {
+                float halfX = footprint(random);
+                float halfZ = footprint(random);
+                float halfY = height(random) * 0.5f;
+                boxes.insert(boxes.end(), {x * citySpacing, halfY, z * citySpacing, 0.0f, halfX, halfY, halfZ, 0.0f});
+            }
+        }
+        return boxes;
+    }
+
+    // 相机在seed决定的街道上从城市一端走到另一端，同时左右张望
+    Matrix cameraMatrix(const BatchJob &job, uint32_t frame, float aspect)
+    {
+        float t = job.frames > 1 ? float(frame) / float(job.frames - 1) : 0.0f;
+        uint32_t street = job.grid > 1 ? job.seed % (job.grid - 1) : 0;
+        float eye[3] = {(t * (job.grid + 1) - 1.0f) * citySpacing, 2.0f, (street + 0.5f) * citySpacing};
+        float angle = std::sin(t * 6.2831853f) * 0.6f;
+        float target[3] = {eye[0] + 10.0f * std::cos(angle), 3.0f, eye[2] + 10.0f * std::sin(angle)};
+        return multiply(perspective(1.0f, aspect, 0.5f, 2000.0f), lookAt(eye, target));
+    }
+}
+
+void BatchScheduler::setConfig(const Config &config)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->config = config;
+    this->config.minChunk = std::max(this->config.minChunk, 1u);
+    this->config.maxChunk = std::max(this->config.maxChunk, this->config.minChunk);
+}
+
+void BatchScheduler::reset(const std::vector<BatchJob> &jobs, uint32_t workerCount)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    jobFrames.clear();
+    nextFrame.assign(jobs.size(), 0);
+    remainingFrames = 0;
+    for (const BatchJob &job : jobs)
+    {
+        jobFrames.push_back(job.frames);
+        remainingFrames += job.frames;
+    }
+    workers.assign(workerCount, WorkerState{});
+    cancelled = false;
+}
+
+uint32_t BatchScheduler::chunkSize(uint32_t worker) const
+{
+    const WorkerState &state = workers[worker];
+    if (state.framesPerSecond <= 0.0)
+    {
+        return std::clamp(config.initialChunk, config.minChunk, config.maxChunk);
+    }
+
+    //还没有测量结果的worker按已测量的平均值计算
+    double totalRate = 0.0;
+    uint32_t measured = 0;
+    for (const WorkerState &other : workers)
+    {
+        if (other.framesPerSecond > 0.0)
+        {
+            totalRate += other.framesPerSecond;
+            measured++;
+        }
+    }
+    totalRate += (workers.size() - measured) * totalRate / measured;
+
+    //按吞吐量平分剩余帧时该worker的份额，只先拿一半，剩下的留给最后的调整
+    double size = state.framesPerSecond * config.chunkSeconds;
+    double share = remainingFrames * state.framesPerSecond / totalRate;
+    size = std::min(size, share * 0.5);
+    uint32_t frames = static_cast<uint32_t>(std::min(size + 0.5, double(config.maxChunk)));
+    return std::clamp(frames, config.minChunk, config.maxChunk);
+}
+
+bool BatchScheduler::next(uint32_t worker, BatchWorkItem &item)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (cancelled || remainingFrames == 0)
+    {
+        return false;
+    }
+
+    WorkerState &state = workers[worker];
+    uint32_t job = state.currentJob;
+    if (job >= jobFrames.size() || nextFrame[job] >= jobFrames[job])
+    {
+        job = 0;
+        for (uint32_t i = 1; i < jobFrames.size(); i++)
+        {
+            if (jobFrames[i] - nextFrame[i] > jobFrames[job] - nextFrame[job])
+            {
+                job = i;
+            }
+        }
+    }
+
+    item.job = job;
+    item.firstFrame = nextFrame[job];
+    item.frameCount = std::min(chunkSize(worker), jobFrames[job] - nextFrame[job]);
+    nextFrame[job] += item.frameCount;
+    remainingFrames -= item.frameCount;
+    state.currentJob = job;
+    state.chunks++;
+    return true;
+}
+
+void BatchScheduler::completed(uint32_t worker, uint32_t frames, double seconds)
+{
+    if (frames == 0 || seconds <= 0.0)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    WorkerState &state = workers[worker];
+    double sample = frames / seconds;
+    state.framesPerSecond = state.framesPerSecond > 0.0 ? state.framesPerSecond + (sample - state.framesPerSecond) * config.smoothing : sample;
+}
+
+void BatchScheduler::cancel()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    cancelled = true;
+}
+
+double BatchScheduler::throughput(uint32_t worker) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return workers[worker].framesPerSecond;
+}
+
+uint32_t BatchScheduler::chunks(uint32_t worker) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return workers[worker].chunks;
+}
+
+BatchRenderer::~BatchRenderer()
+{
+    destroy();
+}
+
+void BatchRenderer::setConfig(const Config &config)
+{
+    this->config = config;
+    this->config.queuesPerDevice = std::max(this->config.queuesPerDevice, 1u);
+    this->config.framesInFlight = std::max(this->config.framesInFlight, 1u);
+    scheduler.setConfig(config.scheduler);
+}
+
+void BatchRenderer::create()
+{
+    VkApplicationInfo appInfo{};
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = "batch_render";
+    appInfo.apiVersion = VK_API_VERSION_1_1;
+    VkInstanceCreateInfo instanceInfo{};
+    instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceInfo.pApplicationInfo = &appInfo;
+    check(vkCreateInstance(&instanceInfo, nullptr, &instance), "vkCreateInstance");
+
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+    std::vector<VkPhysicalDevice> physicalDevices(deviceCount);
+    vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data());
+
+    //findDeviceBySelector只需要名称
+    std::vector<DeviceCandidate> candidates(deviceCount);
+    std::vector<uint32_t> graphicsFamilies(deviceCount, UINT32_MAX);
+    std::vector<uint32_t> familyQueueCounts(deviceCount, 0);
+    bool anyGpu = false;
+    for (uint32_t i = 0; i < deviceCount; i++)
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevices[i], &properties);
+        candidates[i].name = properties.deviceName;
+        candidates[i].deviceType = properties.deviceType;
+
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevices[i], &familyCount, nullptr);
+        candidates[i].queueFamilies.resize(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevices[i], &familyCount, candidates[i].queueFamilies.data());
+        //图形queue最多的family，通常就是第一个
+        for (uint32_t family = 0; family < familyCount; family++)
+        {
+            const VkQueueFamilyProperties &familyProperties = candidates[i].queueFamilies[family];
+            if ((familyProperties.queueFlags & VK_QUEUE_GRAPHICS_BIT) && familyProperties.queueCount > familyQueueCounts[i])
+            {
+                graphicsFamilies[i] = family;
+                familyQueueCounts[i] = familyProperties.queueCount;
+            }
+        }
+        if (graphicsFamilies[i] != UINT32_MAX && properties.deviceType != VK_PHYSICAL_DEVICE_TYPE_CPU)
+        {
+            anyGpu = true;
+        }
+    }
+
+    std::vector<uint32_t> selected;
+    if (config.devices.empty())
+    {
+        for (uint32_t i = 0; i < deviceCount; i++)
+        {
+            if (graphicsFamilies[i] != UINT32_MAX && !(anyGpu && candidates[i].deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU))
+            {
+                selected.push_back(i);
+            }
+        }
+    }
+    else
+    {
+        size_t start = 0;
+        while (start <= config.devices.size())
+        {
+            size_t comma = config.devices.find(',', start);
+            std::string selector = config.devices.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+            start = comma == std::string::npos ? config.devices.size() + 1 : comma + 1;
+            if (selector.empty())
+            {
+                continue;
+            }
+            size_t index = findDeviceBySelector(candidates, selector);
+            if (index == candidates.size())
+            {
+                throw std::runtime_error("=====No GPU matches \"" + selector + "\"!=====");
+            }
+            if (graphicsFamilies[index] == UINT32_MAX)
+            {
+                throw std::runtime_error("=====" + candidates[index].name + " has no graphics queue!=====");
+            }
+            if (std::find(selected.begin(), selected.end(), uint32_t(index)) == selected.end())
+            {
+                selected.push_back(static_cast<uint32_t>(index));
+            }
+        }
+    }
+    if (selected.empty())
+    {
+        throw std::runtime_error("=====No device with a graphics queue for batch rendering!=====");
+    }
+
+    for (uint32_t index : selected)
+    {
+        uint32_t queueCount = std::min(config.queuesPerDevice, familyQueueCounts[index]);
+        createDevice(physicalDevices[index], index, graphicsFamilies[index], queueCount, candidates[index].name);
+    }
+    for (uint32_t device = 0; device < devices.size(); device++)
+    {
+        for (uint32_t queue = 0; queue < devices[device].queueCount; queue++)
+        {
+            createWorker(device, queue);
+        }
+    }
+}
+
+void BatchRenderer::createDevice(VkPhysicalDevice physicalDevice, uint32_t index, uint32_t queueFamily, uint32_t queueCount, const std::string &name)
+{
+    devices.emplace_back();
+    Device &device = devices.back();
+    device.name = name;
+    device.index = index;
+    device.physicalDevice = physicalDevice;
+    device.queueFamily = queueFamily;
+    device.queueCount = queueCount;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &device.memoryProperties);
+
+    //同一family中的多个queue，每个worker一个，提交时不需要互相加锁
+    std::vector<float> priorities(queueCount, 1.0f);
+    VkDeviceQueueCreateInfo queueInfo{};
+    queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo.queueFamilyIndex = queueFamily;
+    queueInfo.queueCount = queueCount;
+    queueInfo.pQueuePriorities = priorities.data();
+    VkPhysicalDeviceFeatures enabled{};
+    VkDeviceCreateInfo deviceInfo{};
+    deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+    deviceInfo.pEnabledFeatures = &enabled;
+    check(vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device.device), "vkCreateDevice");
+
+    createPipeline(device);
+
+    //盒子的12个三角形，角的编号为x | y << 1 | z << 2
+    const uint16_t indices[36] = {
+        0, 2, 6, 0, 6, 4, 1, 3, 7, 1, 7, 5,
+        0, 1, 5, 0, 5, 4, 2, 3, 7, 2, 7, 6,
+        0, 1, 3, 0, 3, 2, 4, 5, 7, 4, 7, 6,
+    };
+    createUploadBuffer(device.device, device.memoryProperties, indices, sizeof(indices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        device.indexBuffer, device.indexMemory);
+}
+
+void BatchRenderer::createPipeline(Device &device)
+{
+    VkAttachmentDescription attachments[2]{};
+    attachments[0].format = colorFormat;
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    //render pass结束时直接转换为复制所需的layout
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    attachments[1] = attachments[0];
+    attachments[1].format = depthFormat;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference colorReference{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference depthReference{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorReference;
+    subpass.pDepthStencilAttachment = &depthReference;
+
+    //进入：同一worker上一帧的深度写入完成后再清除；退出：颜色写入完成后再复制到读回buffer
+    VkSubpassDependency dependencies[2]{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 2;
+    renderPassInfo.pAttachments = attachments;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.pDependencies = dependencies;
+    check(vkCreateRenderPass(device.device, &renderPassInfo, nullptr, &device.renderPass), "vkCreateRenderPass");
+
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount = 1;
+    setLayoutInfo.pBindings = &binding;
+    check(vkCreateDescriptorSetLayout(device.device, &setLayoutInfo, nullptr, &device.setLayout), "vkCreateDescriptorSetLayout");
+
+    VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Matrix)};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &device.setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    check(vkCreatePipelineLayout(device.device, &pipelineLayoutInfo, nullptr, &device.pipelineLayout), "vkCreatePipelineLayout");
+
+    //与occlusion_bench共用shader：建筑由gl_VertexIndex与gl_InstanceIndex生成，不需要顶点buffer
+    VkShaderModule vertexShader = loadShader(device.device, config.shaderDirectory + "/occlusion_bench_vert.spv");
+    VkShaderModule fragmentShader = loadShader(device.device, config.shaderDirectory + "/occlusion_bench_frag.spv");
+    VkPipelineShaderStageCreateInfo stages[2]{};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vertexShader;
+    stages[0].pName = "main";
+    stages[1] = stages[0];
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = fragmentShader;
+
+    VkExtent2D extent{config.width, config.height};
+    VkPipelineVertexInputStateCreateInfo vertexInput{};
+    vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkViewport viewport{0.0f, 0.0f, float(extent.width), float(extent.height), 0.0f, 1.0f};
+    VkRect2D scissor{{0, 0}, extent};
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = &viewport;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = &scissor;
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.lineWidth = 1.0f;
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+    VkPipelineColorBlendAttachmentState blendAttachment{};
+    blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &blendAttachment;
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = stages;
+    pipelineInfo.pVertexInputState = &vertexInput;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.layout = device.pipelineLayout;
+    pipelineInfo.renderPass = device.renderPass;
+    VkResult result = vkCreateGraphicsPipelines(device.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &device.pipeline);
+    vkDestroyShaderModule(device.device, vertexShader, nullptr);
+    vkDestroyShaderModule(device.device, fragmentShader, nullptr);
+    check(result, "vkCreateGraphicsPipelines");
+}
+
+void BatchRenderer::createWorker(uint32_t deviceIndex, uint32_t queueIndex)
+{
+    const Device &device = devices[deviceIndex];
+    workers.emplace_back();
+    Worker &worker = workers.back();
+    worker.device = deviceIndex;
+    worker.queueIndex = queueIndex;
+    vkGetDeviceQueue(device.device, device.queueFamily, queueIndex, &worker.queue);
+
+    VkCommandPoolCreateInfo commandPoolInfo{};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolInfo.queueFamilyIndex = device.queueFamily;
+    check(vkCreateCommandPool(device.device, &commandPoolInfo, nullptr, &worker.commandPool), "vkCreateCommandPool");
+
+    VkExtent2D extent{config.width, config.height};
+    createImage(device.device, device.memoryProperties, depthFormat, extent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+        VK_IMAGE_ASPECT_DEPTH_BIT, worker.depthImage, worker.depthMemory, worker.depthView);
+
+    VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1};
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    check(vkCreateDescriptorPool(device.device, &poolInfo, nullptr, &worker.descriptorPool), "vkCreateDescriptorPool");
+    VkDescriptorSetAllocateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = worker.descriptorPool;
+    setInfo.descriptorSetCount = 1;
+    setInfo.pSetLayouts = &device.setLayout;
+    check(vkAllocateDescriptorSets(device.device, &setInfo, &worker.descriptorSet), "vkAllocateDescriptorSets");
+
+    VkDeviceSize readbackSize = VkDeviceSize(config.width) * config.height * 4;
+    worker.frames.resize(config.framesInFlight);
+    for (Frame &frame : worker.frames)
+    {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = worker.commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        check(vkAllocateCommandBuffers(device.device, &allocInfo, &frame.commandBuffer), "vkAllocateCommandBuffers");
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        check(vkCreateFence(device.device, &fenceInfo, nullptr, &frame.fence), "vkCreateFence");
+
+        //每帧单独的颜色目标，上一帧等待读回时下一帧可以直接开始渲染
+        createImage(device.device, device.memoryProperties, colorFormat, extent,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+            frame.colorImage, frame.colorMemory, frame.colorView);
+        VkImageView attachments[2] = {frame.colorView, worker.depthView};
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = device.renderPass;
+        framebufferInfo.attachmentCount = 2;
+        framebufferInfo.pAttachments = attachments;
+        framebufferInfo.width = extent.width;
+        framebufferInfo.height = extent.height;
+        framebufferInfo.layers = 1;
+        check(vkCreateFramebuffer(device.device, &framebufferInfo, nullptr, &frame.framebuffer), "vkCreateFramebuffer");
+
+        //CPU要读取整帧，优先HOST_CACHED，未缓存的内存读取非常慢
+        VkMemoryPropertyFlags chosen = createBuffer(device.device, device.memoryProperties, readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            {VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT},
+            frame.readbackBuffer, frame.readbackMemory);
+        frame.readbackCoherent = (chosen & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+        check(vkMapMemory(device.device, frame.readbackMemory, 0, VK_WHOLE_SIZE, 0, &frame.mapped), "vkMapMemory");
+    }
+}
+
+void BatchRenderer::destroyWorker(Worker &worker)
+{
+    VkDevice device = devices[worker.device].device;
+    for (Frame &frame : worker.frames)
+    {
+        vkDestroyFramebuffer(device, frame.framebuffer, nullptr);
+        vkDestroyImageView(device, frame.colorView, nullptr);
+        vkDestroyImage(device, frame.colorImage, nullptr);
+        vkFreeMemory(device, frame.colorMemory, nullptr);
+        vkDestroyBuffer(device, frame.readbackBuffer, nullptr);
+        vkFreeMemory(device, frame.readbackMemory, nullptr);
+        vkDestroyFence(device, frame.fence, nullptr);
+    }
+    worker.frames.clear();
+    vkDestroyBuffer(device, worker.sceneBuffer, nullptr);
+    vkFreeMemory(device, worker.sceneMemory, nullptr);
+    vkDestroyDescriptorPool(device, worker.descriptorPool, nullptr);
+    vkDestroyImageView(device, worker.depthView, nullptr);
+    vkDestroyImage(device, worker.depthImage, nullptr);
+    vkFreeMemory(device, worker.depthMemory, nullptr);
+    vkDestroyCommandPool(device, worker.commandPool, nullptr);
+}
+
+void BatchRenderer::destroy()
+{
+    for (Device &device : devices)
+    {
+        if (device.device != VK_NULL_HANDLE)
+        {
+            vkDeviceWaitIdle(device.device);
+        }
+    }
+    for (Worker &worker : workers)
+    {
+        destroyWorker(worker);
+    }
+    workers.clear();
+    for (Device &device : devices)
+    {
+        if (device.device == VK_NULL_HANDLE)
+        {
+            continue;
+        }
+        vkDestroyBuffer(device.device, device.indexBuffer, nullptr);
+        vkFreeMemory(device.device, device.indexMemory, nullptr);
+        vkDestroyPipeline(device.device, device.pipeline, nullptr);
+        vkDestroyPipelineLayout(device.device, device.pipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device.device, device.setLayout, nullptr);
+        vkDestroyRenderPass(device.device, device.renderPass, nullptr);
+        vkDestroyDevice(device.device, nullptr);
+    }
+    devices.clear();
+    if (instance != VK_NULL_HANDLE)
+    {
+        vkDestroyInstance(instance, nullptr);
+        instance = VK_NULL_HANDLE;
+    }
+}
+
+BatchResult BatchRenderer::run(const std::vector<BatchJob> &jobs)
+{
+    scheduler.reset(jobs, workerCount());
+    for (Worker &worker : workers)
+    {
+        worker.framesRendered = 0;
+        worker.error.clear();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(workers.size());
+    for (uint32_t i = 0; i < workers.size(); i++)
+    {
+        threads.emplace_back([this, i, &jobs] { runWorker(i, jobs); });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    BatchResult result;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (uint32_t i = 0; i < workers.size(); i++)
+    {
+        const Worker &worker = workers[i];
+        if (!worker.error.empty())
+        {
+            throw std::runtime_error(worker.error);
+        }
+        BatchWorkerResult workerResult;
+        workerResult.deviceName = devices[worker.device].name;
+        workerResult.deviceIndex = devices[worker.device].index;
+        workerResult.queueIndex = worker.queueIndex;
+        workerResult.frames = worker.framesRendered;
+        workerResult.chunks = scheduler.chunks(i);
+        workerResult.framesPerSecond = scheduler.throughput(i);
+        result.frames += worker.framesRendered;
+        result.workers.push_back(workerResult);
+    }
+    return result;
+}
+
+void BatchRenderer::runWorker(uint32_t workerIndex, const std::vector<BatchJob> &jobs)
+{
+    Worker &worker = workers[workerIndex];
+    try
+    {
+        BatchWorkItem item;
+        while (scheduler.next(workerIndex, item))
+        {
+            //吞吐量包括等待之前提交的帧与写文件的时间，也就是这个worker实际能持续的速度
+            auto start = std::chrono::steady_clock::now();
+            if (item.job != worker.sceneJob)
+            {
+                drain(worker);
+                uploadScene(worker, jobs[item.job], item.job);
+            }
+            for (uint32_t i = 0; i < item.frameCount; i++)
+            {
+                Frame &frame = worker.frames[worker.nextSlot];
+                worker.nextSlot = (worker.nextSlot + 1) % worker.frames.size();
+                if (frame.pending)
+                {
+                    finishFrame(worker, frame);
+                }
+                frame.job = item.job;
+                frame.frame = item.firstFrame + i;
+                recordFrame(worker, frame, jobs[item.job]);
+
+                VkSubmitInfo submitInfo{};
+                submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount = 1;
+                submitInfo.pCommandBuffers = &frame.commandBuffer;
+                check(vkQueueSubmit(worker.queue, 1, &submitInfo, frame.fence), "vkQueueSubmit");
+                frame.pending = true;
+            }
+            scheduler.completed(workerIndex, item.frameCount,
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        drain(worker);
+    }
+    catch (const std::exception &e)
+    {
+        worker.error = e.what();
+        scheduler.cancel();
+        //等待已提交的帧，destroy时不会销毁仍在使用的对象
+        vkQueueWaitIdle(worker.queue);
+        for (Frame &frame : worker.frames)
+        {
+            frame.pending = false;
+            vkResetFences(devices[worker.device].device, 1, &frame.fence);
+        }
+    }
+}
+
+void BatchRenderer::uploadScene(Worker &worker, const BatchJob &job, uint32_t jobIndex)
+{
+    const Device &device = devices[worker.device];
+    vkDestroyBuffer(device.device, worker.sceneBuffer, nullptr);
+    vkFreeMemory(device.device, worker.sceneMemory, nullptr);
+    worker.sceneBuffer = VK_NULL_HANDLE;
+    worker.sceneMemory = VK_NULL_HANDLE;
+    worker.sceneJob = UINT32_MAX;
+
+    std::vector<float> boxes = buildCity(job);
+    createUploadBuffer(device.device, device.memoryProperties, boxes.data(), boxes.size() * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        worker.sceneBuffer, worker.sceneMemory);
+    worker.objectCount = job.grid * job.grid;
+    worker.sceneJob = jobIndex;
+
+    //之前的帧都已完成，可以直接更新descriptor set
+    VkDescriptorBufferInfo boxInfo{worker.sceneBuffer, 0, VK_WHOLE_SIZE};
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = worker.descriptorSet;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &boxInfo;
+    vkUpdateDescriptorSets(device.device, 1, &write, 0, nullptr);
+}
+
+void BatchRenderer::recordFrame(Worker &worker, Frame &frame, const BatchJob &job)
+{
+    const Device &device = devices[worker.device];
+    VkCommandBuffer commandBuffer = frame.commandBuffer;
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    check(vkBeginCommandBuffer(commandBuffer, &beginInfo), "vkBeginCommandBuffer");
+
+    VkClearValue clearValues[2]{};
+    clearValues[0].color = {{0.55f, 0.7f, 0.9f, 1.0f}};
+    //reverse-Z，远处为0
+    clearValues[1].depthStencil = {0.0f, 0};
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = device.renderPass;
+    renderPassInfo.framebuffer = frame.framebuffer;
+    renderPassInfo.renderArea = {{0, 0}, {config.width, config.height}};
+    renderPassInfo.clearValueCount = 2;
+    renderPassInfo.pClearValues = clearValues;
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    Matrix viewProjection = cameraMatrix(job, frame.frame, float(config.width) / float(config.height));
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, device.pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, device.pipelineLayout, 0, 1, &worker.descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, device.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Matrix), viewProjection.m);
+    vkCmdBindIndexBuffer(commandBuffer, device.indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+    //每栋建筑一个instance，gl_InstanceIndex即对象编号
+    vkCmdDrawIndexed(commandBuffer, 36, worker.objectCount, 0, 0, 0);
+    vkCmdEndRenderPass(commandBuffer);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {config.width, config.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, frame.colorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frame.readbackBuffer, 1, &region);
+
+    //fence只保证执行完成，host读取还需要这个barrier
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = frame.readbackBuffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    check(vkEndCommandBuffer(commandBuffer), "vkEndCommandBuffer");
+}
+
+void BatchRenderer::finishFrame(Worker &worker, Frame &frame)
+{
+    VkDevice device = devices[worker.device].device;
+    check(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX), "vkWaitForFences");
+    vkResetFences(device, 1, &frame.fence);
+    frame.pending = false;
+
+    if (!frame.readbackCoherent)
+    {
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = frame.readbackMemory;
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(device, 1, &range);
+    }
+    if (!config.outputPattern.empty())
+    {
+        writePng(formatOutputPath(config.outputPattern, {frame.job, frame.frame}), static_cast<const uint8_t *>(frame.mapped),
+            config.width, config.height);
+    }
+    worker.framesRendered++;
+}
+
+void BatchRenderer::drain(Worker &worker)
+{
+    //按提交顺序完成，输出文件的顺序与帧号一致
+    for (uint32_t i = 0; i < worker.frames.size(); i++)
+    {
+        Frame &frame = worker.frames[(worker.nextSlot + i) % worker.frames.size()];
+        if (frame.pending)
+        {
+            finishFrame(worker, frame);
+        }
+    }
+}
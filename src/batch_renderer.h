@@ -0,0 +1,209 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 离线批量渲染的一个任务：一个由seed生成的城市场景，相机沿一条街道移动frames帧
+// 任务之间互不依赖，同一任务的不同帧也可以分给不同的设备
+struct BatchJob
+{
+    std::string name;
+    uint32_t seed = 1;
+    // 建筑网格的边长
+    uint32_t grid = 32;
+    uint32_t frames = 60;
+};
+
+// 分给一个worker的一段连续帧
+struct BatchWorkItem
+{
+    uint32_t job = 0;
+    uint32_t firstFrame = 0;
+    uint32_t frameCount = 0;
+};
+
+// 按每个worker测得的吞吐量(帧/秒)决定分给它的帧数，线程安全
+// 快的设备一次拿到更多帧，减少调度次数；剩余的帧变少时块也随之变小，
+// 让所有worker大致同时结束，不会出现最慢的设备最后还拿着一大块
+class BatchScheduler
+{
+public:
+    struct Config
+    {
+        // 每次分配的目标耗时，块大小 = 吞吐量 * chunkSeconds
+        double chunkSeconds = 0.25;
+        // 还没有测量结果时的块大小
+        uint32_t initialChunk = 2;
+        uint32_t minChunk = 1;
+        uint32_t maxChunk = 256;
+        // 吞吐量指数平均的新样本权重
+        double smoothing = 0.3;
+    };
+
+    void setConfig(const Config &config);
+    void reset(const std::vector<BatchJob> &jobs, uint32_t workerCount);
+
+    // 优先继续worker当前的任务(场景已经上传)，否则选剩余帧最多的任务；所有帧都已分配或已取消时返回false
+    bool next(uint32_t worker, BatchWorkItem &item);
+    // 一块完成之后报告耗时，更新该worker的吞吐量
+    void completed(uint32_t worker, uint32_t frames, double seconds);
+    // 某个worker出错时让其他worker尽快停止
+    void cancel();
+
+    double throughput(uint32_t worker) const;
+    uint32_t chunks(uint32_t worker) const;
+
+private:
+    struct WorkerState
+    {
+        double framesPerSecond = 0.0;
+        uint32_t currentJob = UINT32_MAX;
+        uint32_t chunks = 0;
+    };
+
+    uint32_t chunkSize(uint32_t worker) const;
+
+    Config config;
+    mutable std::mutex mutex;
+    std::vector<uint32_t> jobFrames;
+    // 每个任务下一个未分配的帧
+    std::vector<uint32_t> nextFrame;
+    uint64_t remainingFrames = 0;
+    std::vector<WorkerState> workers;
+    bool cancelled = false;
+};
+
+struct BatchWorkerResult
+{
+    std::string deviceName;
+    uint32_t deviceIndex = 0;
+    uint32_t queueIndex = 0;
+    uint64_t frames = 0;
+    uint32_t chunks = 0;
+    // 调度器最后测得的吞吐量
+    double framesPerSecond = 0.0;
+};
+
+struct BatchResult
+{
+    uint64_t frames = 0;
+    double seconds = 0.0;
+    std::vector<BatchWorkerResult> workers;
+};
+
+// 多设备、多queue的离屏批量渲染：每个合适的VkPhysicalDevice一个VkDevice，每个queue一个worker线程
+// worker有自己的command pool、渲染目标与读回buffer，不与其他线程共享任何需要外部同步的对象
+// 每帧渲染到RGBA8图像后复制到HOST_VISIBLE buffer，fence signal之后在worker线程上写PNG，
+// 同时GPU渲染该worker的下一帧
+class BatchRenderer
+{
+public:
+    struct Config
+    {
+        uint32_t width = 1280;
+        uint32_t height = 720;
+        // 每个设备使用的图形queue数，受queue family的queueCount限制
+        uint32_t queuesPerDevice = 2;
+        // 每个worker同时提交的帧数
+        uint32_t framesInFlight = 2;
+        // 逗号分隔的设备编号或名称子串(见findDeviceBySelector)，为空时使用所有有图形queue的设备，
+        // 同时有GPU时跳过CPU实现(软件光栅化会和PNG编码抢CPU)
+        std::string devices;
+        std::string shaderDirectory = "shader";
+        // 第一个%d/%0Nd为任务编号，第二个为帧号，例如out/job%02d_%05d.png；为空时只读回不写文件
+        std::string outputPattern;
+        BatchScheduler::Config scheduler;
+    };
+
+    ~BatchRenderer();
+
+    void setConfig(const Config &config);
+    // 创建instance、设备与worker，没有可用设备时抛出std::runtime_error
+    void create();
+    void destroy();
+
+    // 渲染所有任务的所有帧后返回；任一worker出错时停止其他worker并抛出该错误
+    BatchResult run(const std::vector<BatchJob> &jobs);
+
+    uint32_t workerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+private:
+    struct Device
+    {
+        std::string name;
+        uint32_t index = 0;
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+        VkPhysicalDeviceMemoryProperties memoryProperties{};
+        VkDevice device = VK_NULL_HANDLE;
+        uint32_t queueFamily = 0;
+        uint32_t queueCount = 0;
+        // 以下对象只在create/destroy中修改，worker线程只读
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory indexMemory = VK_NULL_HANDLE;
+    };
+
+    struct Frame
+    {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        VkImage colorImage = VK_NULL_HANDLE;
+        VkDeviceMemory colorMemory = VK_NULL_HANDLE;
+        VkImageView colorView = VK_NULL_HANDLE;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+        VkBuffer readbackBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory readbackMemory = VK_NULL_HANDLE;
+        bool readbackCoherent = true;
+        void *mapped = nullptr;
+        bool pending = false;
+        uint32_t job = 0;
+        uint32_t frame = 0;
+    };
+
+    struct Worker
+    {
+        uint32_t device = 0;
+        uint32_t queueIndex = 0;
+        VkQueue queue = VK_NULL_HANDLE;
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        // 深度只在一次提交内使用，render pass的external dependency保证前后两帧的顺序
+        VkImage depthImage = VK_NULL_HANDLE;
+        VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+        VkImageView depthView = VK_NULL_HANDLE;
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        // 当前任务的建筑，换任务时等待所有帧完成后重新上传
+        uint32_t sceneJob = UINT32_MAX;
+        uint32_t objectCount = 0;
+        VkBuffer sceneBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory sceneMemory = VK_NULL_HANDLE;
+        std::vector<Frame> frames;
+        uint32_t nextSlot = 0;
+        uint64_t framesRendered = 0;
+        std::string error;
+    };
+
+    void createDevice(VkPhysicalDevice physicalDevice, uint32_t index, uint32_t queueFamily, uint32_t queueCount, const std::string &name);
+    void createPipeline(Device &device);
+    void createWorker(uint32_t deviceIndex, uint32_t queueIndex);
+    void destroyWorker(Worker &worker);
+
+    void runWorker(uint32_t workerIndex, const std::vector<BatchJob> &jobs);
+    void uploadScene(Worker &worker, const BatchJob &job, uint32_t jobIndex);
+    void recordFrame(Worker &worker, Frame &frame, const BatchJob &job);
+    // 等待该帧的fence并写出读回的图像
+    void finishFrame(Worker &worker, Frame &frame);
+    void drain(Worker &worker);
+
+    Config config;
+    VkInstance instance = VK_NULL_HANDLE;
+    std::vector<Device> devices;
+    std::vector<Worker> workers;
+    BatchScheduler scheduler;
+};
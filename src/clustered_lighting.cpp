@@ -0,0 +1,371 @@
+#include "clustered_lighting.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    // 每帧数据中uniform、计数器与光源的位置，不小于任何设备的min*BufferOffsetAlignment
+    const VkDeviceSize countersOffset = 256;
+    const VkDeviceSize lightsOffset = 512;
+    const uint32_t bindingCount = 6;
+
+    enum Phase : uint32_t
+    {
+        PhaseCount,
+        PhaseAllocate,
+        PhaseScatter,
+    };
+
+    void memoryBarrier(const Synchronization2 &synchronization, VkCommandBuffer commandBuffer, VkPipelineStageFlags2 srcStage,
+        VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+    {
+        VkMemoryBarrier2 barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+        barrier.srcStageMask = srcStage;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstStageMask = dstStage;
+        barrier.dstAccessMask = dstAccess;
+        VkDependencyInfo dependency{};
+        dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependency.memoryBarrierCount = 1;
+        dependency.pMemoryBarriers = &barrier;
+        synchronization.pipelineBarrier(commandBuffer, dependency);
+    }
+
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    VkShaderModule loadShader(VkDevice device, const std::string &path)
+    {
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("=====Failed to open shader file: " + path + "=====");
+        }
+        std::vector<char> code(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(code.data(), code.size());
+
+        VkShaderModuleCreateInfo moduleInfo{};
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.codeSize = code.size();
+        moduleInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+        VkShaderModule module;
+        if (vkCreateShaderModule(device, &moduleInfo, nullptr, &module) != VK_SUCCESS)
+        {
+            throw std::runtime_error("=====Failed to create shader module: " + path + "=====");
+        }
+        return module;
+    }
+}
+
+void ClusteredLighting::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &memory)
+{
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create clustered lighting buffer!=====");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = UINT32_MAX;
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    {
+        if ((memRequirements.memoryTypeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            allocInfo.memoryTypeIndex = i;
+            break;
+        }
+    }
+    if (allocInfo.memoryTypeIndex == UINT32_MAX)
+    {
+        throw std::runtime_error("=====Failed to find clustered lighting memory type!=====");
+    }
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to allocate clustered lighting memory!=====");
+    }
+    vkBindBufferMemory(device, buffer, memory, 0);
+}
+
+void ClusteredLighting::create(VkDevice device, const Synchronization2 &synchronization, const VkPhysicalDeviceMemoryProperties &memoryProperties,
+    const std::string &shaderDirectory, uint32_t maxLights, uint32_t framesInFlight)
+{
+    this->device = device;
+    this->synchronization = &synchronization;
+    this->memoryProperties = memoryProperties;
+    this->maxLights = std::max(maxLights, 1u);
+    this->framesInFlight = framesInFlight;
+    lightCounts.assign(framesInFlight, 0);
+
+    //uniform、光源、cluster区间、计数、光源编号、计数器；fragment shader只读其中一部分
+    VkDescriptorSetLayoutBinding bindings[bindingCount]{};
+    for (uint32_t i = 0; i < bindingCount; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = bindingCount;
+    layoutInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create clustered lighting descriptor set layout!=====");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(uint32_t);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create clustered lighting pipeline layout!=====");
+    }
+
+    //文件名与CMakeLists.txt中的add_shader一致
+    VkShaderModule module = loadShader(device, shaderDirectory + "/light_cluster.spv");
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = module;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+    VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(device, module, nullptr);
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create clustered lighting pipeline!=====");
+    }
+
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount = framesInFlight;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = framesInFlight * (bindingCount - 1);
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = framesInFlight;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create clustered lighting descriptor pool!=====");
+    }
+    std::vector<VkDescriptorSetLayout> layouts(framesInFlight, setLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = framesInFlight;
+    allocInfo.pSetLayouts = layouts.data();
+    sets.resize(framesInFlight);
+    if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to allocate clustered lighting descriptor sets!=====");
+    }
+
+    //光源每帧由CPU更新，GPU直接读HOST_VISIBLE内存，省去上传的拷贝；64k个光源也只有2 MiB
+    frameStride = alignUp(lightsOffset + VkDeviceSize(this->maxLights) * sizeof(PointLight), 256);
+    createBuffer(frameStride * framesInFlight, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frameBuffer, frameMemory);
+    void *mapped = nullptr;
+    vkMapMemory(device, frameMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    frameMapped = static_cast<uint8_t *>(mapped);
+    memset(frameMapped, 0, static_cast<size_t>(frameStride * framesInFlight));
+}
+
+void ClusteredLighting::destroy()
+{
+    if (device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    destroyClusters();
+    vkDestroyBuffer(device, frameBuffer, nullptr);
+    vkFreeMemory(device, frameMemory, nullptr);
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+    sets.clear();
+    device = VK_NULL_HANDLE;
+}
+
+void ClusteredLighting::setConfig(const Config &config)
+{
+    this->config = config;
+    this->config.tileSize = std::max(config.tileSize, 1u);
+    this->config.slices = std::max(config.slices, 1u);
+    this->config.maxLightsPerCluster = std::max(config.maxLightsPerCluster, 1u);
+    if (device != VK_NULL_HANDLE && extent.width > 0)
+    {
+        setExtent(extent);
+    }
+}
+
+void ClusteredLighting::destroyClusters()
+{
+    if (clusterBuffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(device, clusterBuffer, nullptr);
+        vkFreeMemory(device, clusterMemory, nullptr);
+        clusterBuffer = VK_NULL_HANDLE;
+        clusterMemory = VK_NULL_HANDLE;
+    }
+    clusterCount = 0;
+}
+
+void ClusteredLighting::setExtent(VkExtent2D extent)
+{
+    destroyClusters();
+    this->extent = extent;
+    tilesX = (std::max(extent.width, 1u) + config.tileSize - 1) / config.tileSize;
+    tilesY = (std::max(extent.height, 1u) + config.tileSize - 1) / config.tileSize;
+    clusterCount = tilesX * tilesY * config.slices;
+    indexCapacity = clusterCount * std::max(config.averageLightsPerCluster, 1u);
+
+    //区间、计数与编号放在同一个buffer中
+    countsOffset = alignUp(VkDeviceSize(clusterCount) * sizeof(uint32_t) * 2, 256);
+    indicesOffset = countsOffset + alignUp(VkDeviceSize(clusterCount) * sizeof(uint32_t), 256);
+    createBuffer(indicesOffset + VkDeviceSize(indexCapacity) * sizeof(uint32_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, clusterBuffer, clusterMemory);
+    writeDescriptors();
+}
+
+void ClusteredLighting::writeDescriptors()
+{
+    for (uint32_t frame = 0; frame < framesInFlight; frame++)
+    {
+        VkDescriptorBufferInfo bufferInfos[bindingCount] = {
+            {frameBuffer, frameStride * frame, sizeof(Uniforms)},
+            {frameBuffer, frameStride * frame + lightsOffset, VkDeviceSize(maxLights) * sizeof(PointLight)},
+            {clusterBuffer, 0, VkDeviceSize(clusterCount) * sizeof(uint32_t) * 2},
+            {clusterBuffer, countsOffset, VkDeviceSize(clusterCount) * sizeof(uint32_t)},
+            {clusterBuffer, indicesOffset, VkDeviceSize(indexCapacity) * sizeof(uint32_t)},
+            {frameBuffer, frameStride * frame + countersOffset, sizeof(Counters)},
+        };
+        VkWriteDescriptorSet writes[bindingCount]{};
+        for (uint32_t i = 0; i < bindingCount; i++)
+        {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = sets[frame];
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pBufferInfo = &bufferInfos[i];
+        }
+        vkUpdateDescriptorSets(device, bindingCount, writes, 0, nullptr);
+    }
+}
+
+void ClusteredLighting::setLights(uint32_t frame, const PointLight *lights, uint32_t count)
+{
+    if (count > maxLights)
+    {
+        throw std::runtime_error("=====Too many lights for clustered lighting!=====");
+    }
+    lightCounts[frame] = count;
+    memcpy(frameMapped + frameStride * frame + lightsOffset, lights, count * sizeof(PointLight));
+}
+
+void ClusteredLighting::recordBuild(VkCommandBuffer commandBuffer, uint32_t frame, const float *view, const float projectionScale[2])
+{
+    if (clusterBuffer == VK_NULL_HANDLE)
+    {
+        throw std::runtime_error("=====Clustered lighting needs an extent!=====");
+    }
+
+    float sliceScale = config.slices / std::log(config.farPlane / config.nearPlane);
+    Uniforms uniforms{};
+    memcpy(uniforms.view, view, sizeof(uniforms.view));
+    uniforms.projection[0] = projectionScale[0];
+    uniforms.projection[1] = projectionScale[1];
+    uniforms.projection[2] = config.nearPlane;
+    uniforms.projection[3] = config.farPlane;
+    uniforms.grid[0] = tilesX;
+    uniforms.grid[1] = tilesY;
+    uniforms.grid[2] = config.slices;
+    uniforms.grid[3] = config.tileSize;
+    uniforms.screen[0] = static_cast<float>(extent.width);
+    uniforms.screen[1] = static_cast<float>(extent.height);
+    uniforms.screen[2] = sliceScale;
+    uniforms.screen[3] = -std::log(config.nearPlane) * sliceScale;
+    uniforms.lightCount = lightCounts[frame];
+    uniforms.maxLightsPerCluster = config.maxLightsPerCluster;
+    uniforms.indexCapacity = indexCapacity;
+    //该帧上一次的提交已经完成(调用方等待过fence)，直接由CPU写入，提交时对GPU可见
+    uint8_t *frameData = frameMapped + frameStride * frame;
+    memcpy(frameData, &uniforms, sizeof(uniforms));
+    memset(frameData + countersOffset, 0, sizeof(Counters));
+
+    //上一帧的fragment shader读完cluster数据之后才能清零与覆盖
+    memoryBarrier(*synchronization, commandBuffer,
+        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+    vkCmdFillBuffer(commandBuffer, clusterBuffer, countsOffset, VkDeviceSize(clusterCount) * sizeof(uint32_t), 0);
+
+    memoryBarrier(*synchronization, commandBuffer, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &sets[frame], 0, nullptr);
+    uint32_t lightGroups = (lightCounts[frame] + 63) / 64;
+    const Phase phases[3] = {PhaseCount, PhaseAllocate, PhaseScatter};
+    for (Phase phase : phases)
+    {
+        uint32_t phaseIndex = phase;
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(phaseIndex), &phaseIndex);
+        uint32_t groups = phase == PhaseAllocate ? (clusterCount + 63) / 64 : lightGroups;
+        if (groups > 0)
+        {
+            vkCmdDispatch(commandBuffer, groups, 1, 1);
+        }
+        if (phase != PhaseScatter)
+        {
+            memoryBarrier(*synchronization, commandBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+        }
+    }
+
+    //cluster数据供fragment shader读取，计数器由CPU读回
+    memoryBarrier(*synchronization, commandBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_HOST_READ_BIT);
+}
+
+ClusteredLighting::Stats ClusteredLighting::stats(uint32_t frame) const
+{
+    Counters counters;
+    memcpy(&counters, frameMapped + frameStride * frame + countersOffset, sizeof(counters));
+    Stats stats;
+    stats.clusters = clusterCount;
+    stats.indices = std::min(counters.indices, indexCapacity);
+    stats.maxLightsInCluster = counters.maxLights;
+    stats.truncatedClusters = counters.truncated;
+    return stats;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "synchronization2.h"
+
+// 点光源，与shader中的两个vec4一致
+struct PointLight
+{
+    float position[3] = {};
+    // 超出半径后贡献为0
+    float radius = 1.0f;
+    float color[3] = {1.0f, 1.0f, 1.0f};
+    float intensity = 1.0f;
+};
+
+// Clustered forward shading的光源分桶(shader/light_cluster.comp)
+// 视锥按屏幕tile与对数分布的深度slice划分为froxel，每帧在GPU上把光源写入与它相交的cluster：
+//   count：每个光源遍历包围球覆盖的cluster，与cluster的包围盒精确测试后计数
+//   allocate：每个cluster在紧凑的index buffer中分配自己的区间
+//   scatter：重复count的遍历，把光源编号写入区间
+// 开销与光源覆盖的cluster数成正比而不是cluster数乘以光源数；fragment shader只遍历所在cluster的列表
+// 同一个descriptor set既给compute也给fragment shader使用，binding见shader/light_cluster.comp
+class ClusteredLighting
+{
+public:
+    struct Config
+    {
+        // tile的像素边长
+        uint32_t tileSize = 64;
+        // 深度方向的slice数，在[nearPlane, farPlane]之间按对数分布
+        uint32_t slices = 24;
+        // 与相机的近/远平面一致；farPlane之外的光源不参与分桶，fragment归入最后一个slice
+        float nearPlane = 0.1f;
+        float farPlane = 1000.0f;
+        // 单个cluster最多的光源数，超出的被丢弃并计入Stats::truncatedClusters
+        uint32_t maxLightsPerCluster = 256;
+        // index buffer按cluster数乘以该值分配
+        uint32_t averageLightsPerCluster = 32;
+    };
+
+    struct Stats
+    {
+        uint32_t clusters = 0;
+        // 所有cluster列表的总长度
+        uint32_t indices = 0;
+        uint32_t maxLightsInCluster = 0;
+        // 超过maxLightsPerCluster或index buffer容量而被截断的cluster
+        uint32_t truncatedClusters = 0;
+
+        double averageLightsPerCluster() const { return clusters > 0 ? static_cast<double>(indices) / clusters : 0.0; }
+    };
+
+    // shaderDirectory中需要有light_cluster.spv；synchronization在destroy之前必须有效
+    void create(VkDevice device, const Synchronization2 &synchronization, const VkPhysicalDeviceMemoryProperties &memoryProperties,
+        const std::string &shaderDirectory, uint32_t maxLights, uint32_t framesInFlight);
+    void destroy();
+    // 改变cluster的划分，之后需要重新setExtent；调用方保证GPU没有在使用cluster数据
+    void setConfig(const Config &config);
+    // 渲染尺寸改变时调用，重新分配cluster数据；调用方保证GPU没有在使用
+    void setExtent(VkExtent2D extent);
+
+    // 该帧的fence signal之后写入本帧的光源(世界空间)
+    void setLights(uint32_t frame, const PointLight *lights, uint32_t count);
+    // render pass之外调用；view为世界到相机空间的列主序矩阵(相机看向-z)，projectionScale为投影矩阵的m[0]与m[5]
+    // 结束后cluster数据可被fragment shader读取，上一帧fragment shader的读取在覆盖之前完成
+    void recordBuild(VkCommandBuffer commandBuffer, uint32_t frame, const float *view, const float projectionScale[2]);
+
+    // fragment shader在set setIndex绑定descriptorSet(frame)，pipeline layout需要包含descriptorSetLayout()
+    VkDescriptorSetLayout descriptorSetLayout() const { return setLayout; }
+    VkDescriptorSet descriptorSet(uint32_t frame) const { return sets[frame]; }
+
+    // 在该帧的fence signal之后读取
+    Stats stats(uint32_t frame) const;
+
+private:
+    struct Uniforms
+    {
+        float view[16];
+        // P00、P11、near、far
+        float projection[4];
+        // tilesX、tilesY、slices、tileSize
+        uint32_t grid[4];
+        // 宽、高、slice = log(depth) * scale + bias
+        float screen[4];
+        uint32_t lightCount;
+        uint32_t maxLightsPerCluster;
+        uint32_t indexCapacity;
+        uint32_t padding;
+    };
+
+    struct Counters
+    {
+        uint32_t indices;
+        uint32_t maxLights;
+        uint32_t truncated;
+    };
+
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &memory);
+    void destroyClusters();
+    void writeDescriptors();
+
+    VkDevice device = VK_NULL_HANDLE;
+    const Synchronization2 *synchronization = nullptr;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    Config config;
+    uint32_t maxLights = 0;
+    uint32_t framesInFlight = 0;
+    std::vector<uint32_t> lightCounts;
+
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> sets;
+
+    // 每帧一份uniform、计数器与光源，HOST_VISIBLE，由CPU直接写入与读回
+    VkBuffer frameBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory frameMemory = VK_NULL_HANDLE;
+    uint8_t *frameMapped = nullptr;
+    VkDeviceSize frameStride = 0;
+
+    // 每个cluster的(offset, count)、count阶段的计数与紧凑的光源编号，只在GPU上使用，所有帧共用
+    VkExtent2D extent{};
+    uint32_t tilesX = 0;
+    uint32_t tilesY = 0;
+    uint32_t clusterCount = 0;
+    uint32_t indexCapacity = 0;
+    VkBuffer clusterBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory clusterMemory = VK_NULL_HANDLE;
+    VkDeviceSize countsOffset = 0;
+    VkDeviceSize indicesOffset = 0;
+};
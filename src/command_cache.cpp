@@ -0,0 +1,81 @@
+#include "command_cache.h"
+
+#include <stdexcept>
+
+void CommandCache::create(VkDevice device, VkCommandPool commandPool, uint32_t slots)
+{
+    this->device = device;
+    this->commandPool = commandPool;
+
+    std::vector<VkCommandBuffer> commandBuffers(slots);
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocInfo.commandBufferCount = slots;
+    if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to allocate secondary command buffers!=====");
+    }
+
+    entries.resize(slots);
+    for (uint32_t i = 0; i < slots; i++)
+    {
+        entries[i].commandBuffer = commandBuffers[i];
+        entries[i].valid = false;
+    }
+}
+
+void CommandCache::destroy()
+{
+    if (device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    for (auto &entry : entries)
+    {
+        vkFreeCommandBuffers(device, commandPool, 1, &entry.commandBuffer);
+    }
+    entries.clear();
+    device = VK_NULL_HANDLE;
+}
+
+void CommandCache::invalidate()
+{
+    for (auto &entry : entries)
+    {
+        entry.valid = false;
+    }
+}
+
+VkCommandBuffer CommandCache::get(uint32_t slot, const Dependencies &dependencies, const VkCommandBufferInheritanceInfo &inheritance,
+    const std::function<void(VkCommandBuffer)> &record)
+{
+    Entry &entry = entries[slot];
+    if (entry.valid && entry.dependencies == dependencies)
+    {
+        counters.reused++;
+        return entry.commandBuffer;
+    }
+
+    vkResetCommandBuffer(entry.commandBuffer, 0);
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    //只在render pass/dynamic rendering内部执行
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritance;
+    if (vkBeginCommandBuffer(entry.commandBuffer, &beginInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to begin recording secondary command buffer!=====");
+    }
+    record(entry.commandBuffer);
+    if (vkEndCommandBuffer(entry.commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to record secondary command buffer!=====");
+    }
+
+    entry.dependencies = dependencies;
+    entry.valid = true;
+    counters.recorded++;
+    return entry.commandBuffer;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// 每个slot一个secondary command buffer，依赖的版本都没有变化时直接复用上次的录制结果
+// 版本由产生这些对象的地方递增(创建swap chain、pipeline，写descriptor，draw list内容变化)，
+// 使用方只需把当前版本传进来，不需要手动标记失效
+class CommandCache
+{
+public:
+    struct Dependencies
+    {
+        uint64_t swapChain = 0;
+        uint64_t pipelines = 0;
+        uint64_t descriptors = 0;
+        uint64_t content = 0;
+        // viewport/scissor录制在secondary中，动态分辨率下每帧可能不同
+        uint64_t viewport = 0;
+
+        bool operator==(const Dependencies &other) const
+        {
+            return swapChain == other.swapChain && pipelines == other.pipelines && descriptors == other.descriptors && content == other.content &&
+                viewport == other.viewport;
+        }
+    };
+
+    struct Stats
+    {
+        uint64_t recorded = 0;
+        uint64_t reused = 0;
+    };
+
+    void create(VkDevice device, VkCommandPool commandPool, uint32_t slots);
+    void destroy();
+    // 使所有录制结果失效，例如inheritance信息之外的状态发生变化时
+    void invalidate();
+
+    // slot上次录制时的依赖与dependencies相同时直接返回，否则reset后以RENDER_PASS_CONTINUE开始录制，
+    // 调用record，再结束录制；调用前slot上使用该buffer的提交必须已经完成
+    VkCommandBuffer get(uint32_t slot, const Dependencies &dependencies, const VkCommandBufferInheritanceInfo &inheritance,
+        const std::function<void(VkCommandBuffer)> &record);
+
+    const Stats &stats() const { return counters; }
+
+private:
+    struct Entry
+    {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        Dependencies dependencies;
+        bool valid = false;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    std::vector<Entry> entries;
+    Stats counters;
+};
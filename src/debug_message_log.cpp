@@ -0,0 +1,222 @@
+#include "debug_message_log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string_view>
+
+namespace
+{
+    const char *severityName(VkDebugUtilsMessageSeverityFlagBitsEXT severity)
+    {
+        if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)
+            return "ERROR";
+        if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT)
+            return "WARNING";
+        if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT)
+            return "INFO";
+        return "VERBOSE";
+    }
+
+    const char *typeName(VkDebugUtilsMessageTypeFlagsEXT type)
+    {
+        if (type & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT)
+            return "performance";
+        if (type & VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT)
+            return "validation";
+        return "general";
+    }
+}
+
+DebugMessageLog::Options DebugMessageLog::optionsForLogLevel(LogLevel level)
+{
+    Options options;
+    switch (level)
+    {
+    case LogLevel::Error:
+        options.minSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+        break;
+    case LogLevel::Warning:
+    case LogLevel::Info:
+        options.minSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+        break;
+    case LogLevel::Verbose:
+        // verbose时不去重也不限速，方便排查
+        options.minSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+        options.repeatLimit = UINT32_MAX;
+        options.maxMessagesPerSecond = 0;
+        break;
+    }
+    return options;
+}
+
+DebugMessageLog::~DebugMessageLog()
+{
+    stop();
+}
+
+void DebugMessageLog::start(const Options &startOptions)
+{
+    if (running)
+    {
+        return;
+    }
+    options = startOptions;
+    tokens = options.maxMessagesPerSecond;
+    lastRefill = Clock::now();
+    stopRequested.store(false);
+    running = true;
+    worker = std::thread(&DebugMessageLog::drainLoop, this);
+}
+
+void DebugMessageLog::stop()
+{
+    if (!running)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopRequested.store(true);
+    }
+    wakeCondition.notify_one();
+    worker.join();
+    running = false;
+}
+
+VkDebugUtilsMessageSeverityFlagsEXT DebugMessageLog::severityMask() const
+{
+    // PERFORMANCE消息一般是WARNING级别，即使只输出ERROR也需要订阅WARNING来计数
+    VkDebugUtilsMessageSeverityFlagsEXT mask = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    if (options.minSeverity <= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT)
+    {
+        mask |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+    }
+    if (options.minSeverity <= VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT)
+    {
+        mask |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+    }
+    return mask;
+}
+
+void DebugMessageLog::submit(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type,
+    const VkDebugUtilsMessengerCallbackDataEXT *callbackData)
+{
+    if (type & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT)
+    {
+        performanceWarnings.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (severity < options.minSeverity)
+    {
+        return;
+    }
+
+    bool pushed = queue.tryPush([&](Message &message) {
+        message.severity = severity;
+        message.type = type;
+        message.messageId = callbackData->messageIdNumber;
+        const char *text = callbackData->pMessage != nullptr ? callbackData->pMessage : "";
+        size_t length = std::min(strlen(text), sizeof(message.text) - 1);
+        memcpy(message.text, text, length);
+        message.text[length] = '\0';
+    });
+    if (!pushed)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // ERROR尽快输出，其余消息等后台线程下一次轮询
+    if (severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)
+    {
+        wakeCondition.notify_one();
+    }
+}
+
+void DebugMessageLog::drainLoop()
+{
+    for (;;)
+    {
+        if (drain())
+        {
+            std::cerr.flush();
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        if (stopRequested.load())
+        {
+            break;
+        }
+        wakeCondition.wait_for(lock, std::chrono::milliseconds(10));
+    }
+
+    // 停止前把剩下的消息全部输出
+    drain();
+    printSummary();
+    std::cerr.flush();
+}
+
+bool DebugMessageLog::drain()
+{
+    bool printed = false;
+    Message message;
+    while (queue.tryPop(message))
+    {
+        // 部分layer的messageIdNumber为0，这时按消息内容去重
+        int32_t key = message.messageId != 0 ? message.messageId
+                                             : static_cast<int32_t>(std::hash<std::string_view>{}(std::string_view(message.text)));
+        uint32_t &count = occurrences[key];
+        count++;
+        if (count > options.repeatLimit)
+        {
+            suppressedRepeats++;
+            continue;
+        }
+
+        if (options.maxMessagesPerSecond > 0 && message.severity < VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)
+        {
+            Clock::time_point now = Clock::now();
+            double elapsed = std::chrono::duration<double>(now - lastRefill).count();
+            lastRefill = now;
+            tokens = std::min<double>(options.maxMessagesPerSecond, tokens + elapsed * options.maxMessagesPerSecond);
+            if (tokens < 1.0)
+            {
+                rateLimited++;
+                continue;
+            }
+            tokens -= 1.0;
+        }
+
+        print(message);
+        if (count == options.repeatLimit)
+        {
+            // 最后一次输出时提示之后的重复会被省略
+            std::cerr << "validation layer: (further repeats of this message are suppressed)\n";
+        }
+        printed = true;
+    }
+    return printed;
+}
+
+void DebugMessageLog::print(const Message &message)
+{
+    std::cerr << "validation layer [" << severityName(message.severity) << ", " << typeName(message.type) << "]: "
+              << message.text << '\n';
+}
+
+void DebugMessageLog::printSummary()
+{
+    if (suppressedRepeats > 0)
+    {
+        std::cerr << "validation layer: " << suppressedRepeats << " repeated messages suppressed\n";
+    }
+    if (rateLimited > 0)
+    {
+        std::cerr << "validation layer: " << rateLimited << " messages dropped by the rate limit\n";
+    }
+    if (dropped.load() > 0)
+    {
+        std::cerr << "validation layer: " << dropped.load() << " messages dropped because the queue was full\n";
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "log.h"
+#include "mpsc_queue.h"
+
+// Validation layer消息的异步输出管线
+// debug callback只把消息拷进无锁队列就返回，由后台线程做过滤、按message ID去重、限速并写到stderr，
+// 避免每条消息都同步flush一次stderr而干扰帧时间的测量
+class DebugMessageLog
+{
+public:
+    struct Message
+    {
+        VkDebugUtilsMessageSeverityFlagBitsEXT severity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+        VkDebugUtilsMessageTypeFlagsEXT type = 0;
+        int32_t messageId = 0;
+        // 固定大小，callback中不做堆分配，过长的消息被截断
+        char text[1024] = {};
+    };
+
+    struct Options
+    {
+        // 低于该级别的消息在callback中直接丢弃(PERFORMANCE消息仍会被计数)
+        VkDebugUtilsMessageSeverityFlagBitsEXT minSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+        // 同一个message ID最多输出的次数，之后只计数，停止时汇总
+        uint32_t repeatLimit = 3;
+        // 每秒最多输出的条数，ERROR不受限
+        uint32_t maxMessagesPerSecond = 20;
+    };
+
+    static Options optionsForLogLevel(LogLevel level);
+
+    DebugMessageLog() = default;
+    ~DebugMessageLog();
+
+    void start(const Options &options);
+    // 输出队列中剩余的消息以及被去重/限速/丢弃的汇总，然后结束后台线程
+    void stop();
+
+    // 需要订阅的severity，低于minSeverity的只在需要统计PERFORMANCE时订阅
+    VkDebugUtilsMessageSeverityFlagsEXT severityMask() const;
+
+    // 由debug callback调用，可能来自任意线程
+    void submit(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type,
+        const VkDebugUtilsMessengerCallbackDataEXT *callbackData);
+
+    // 返回上次调用以来的PERFORMANCE消息数，每帧调用一次即得到每帧的数量
+    uint32_t takePerformanceWarnings() { return performanceWarnings.exchange(0, std::memory_order_relaxed); }
+    // 队列满而被丢弃的消息总数
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void drainLoop();
+    // 返回本轮是否输出了内容
+    bool drain();
+    void print(const Message &message);
+    void printSummary();
+
+    Options options;
+    MpscQueue<Message, 256> queue;
+    std::atomic<uint32_t> performanceWarnings{0};
+    std::atomic<uint64_t> dropped{0};
+
+    std::thread worker;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    std::atomic<bool> stopRequested{false};
+    bool running = false;
+
+    // 以下只在消费者线程中访问
+    std::unordered_map<int32_t, uint32_t> occurrences;
+    uint64_t suppressedRepeats = 0;
+    uint64_t rateLimited = 0;
+    double tokens = 0.0;
+    Clock::time_point lastRefill;
+};
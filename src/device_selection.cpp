@@ -0,0 +1,206 @@
+#include "device_selection.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace
+{
+    // 相邻设备类型的权重差必须大于其他各项之和的上限(约5600)，保证独显总是优先于核显
+    const int64_t discreteScore = 40000;
+    const int64_t integratedScore = 30000;
+    const int64_t virtualScore = 20000;
+    const int64_t cpuScore = 10000;
+    // 每64MiB显存加1分，最多4000分
+    const VkDeviceSize heapUnit = 64ull * 1024 * 1024;
+    const int64_t maxHeapScore = 4000;
+    const int64_t dedicatedTransferScore = 500;
+    const int64_t dedicatedComputeScore = 500;
+    const int64_t vulkan13Score = 300;
+
+    struct OptionalExtension
+    {
+        const char *name;
+        int64_t score;
+    };
+
+    // 本项目会使用、但不是必需的扩展
+    const OptionalExtension optionalExtensions[] = {
+        {"VK_KHR_present_wait", 100},
+        {"VK_KHR_present_id", 50},
+        {"VK_EXT_memory_budget", 100},
+    };
+
+    std::string toLower(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return text;
+    }
+
+    bool hasQueueFamily(const std::vector<VkQueueFamilyProperties> &queueFamilies, VkQueueFlags required, VkQueueFlags excluded)
+    {
+        for (const auto &queueFamily : queueFamilies)
+        {
+            if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & required) == required && (queueFamily.queueFlags & excluded) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+const char *deviceTypeName(VkPhysicalDeviceType deviceType)
+{
+    switch (deviceType)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return "discrete GPU";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return "integrated GPU";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return "virtual GPU";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return "CPU";
+    default:
+        return "other";
+    }
+}
+
+DeviceScore scoreDevice(const DeviceCandidate &candidate)
+{
+    DeviceScore result;
+    if (!candidate.meetsRequirements)
+    {
+        result.reasons.push_back("missing required queues, extensions or swap chain support");
+        return result;
+    }
+    result.suitable = true;
+
+    auto add = [&result](int64_t points, const std::string &reason) {
+        result.score += points;
+        result.reasons.push_back(reason + " (+" + std::to_string(points) + ")");
+    };
+
+    switch (candidate.deviceType)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        add(discreteScore, "discrete GPU");
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        add(integratedScore, "integrated GPU");
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        add(virtualScore, "virtual GPU");
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        add(cpuScore, "CPU implementation");
+        break;
+    default:
+        break;
+    }
+
+    int64_t heapScore = std::min<int64_t>(static_cast<int64_t>(candidate.deviceLocalHeapSize / heapUnit), maxHeapScore);
+    if (heapScore > 0)
+    {
+        add(heapScore, std::to_string(candidate.deviceLocalHeapSize / (1024 * 1024)) + " MiB device-local heap");
+    }
+
+    //没有graphics/compute位的队列通常对应独立的DMA引擎，上传可以与渲染并行
+    if (hasQueueFamily(candidate.queueFamilies, VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+    {
+        add(dedicatedTransferScore, "dedicated transfer queue");
+    }
+    if (hasQueueFamily(candidate.queueFamilies, VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT))
+    {
+        add(dedicatedComputeScore, "async compute queue");
+    }
+
+    if (candidate.apiVersion >= VK_API_VERSION_1_3)
+    {
+        add(vulkan13Score, "Vulkan 1.3");
+    }
+
+    for (const auto &extension : optionalExtensions)
+    {
+        if (std::find(candidate.extensions.begin(), candidate.extensions.end(), extension.name) != candidate.extensions.end())
+        {
+            add(extension.score, extension.name);
+        }
+    }
+
+    //最后用最大纹理尺寸区分同档次的设备
+    add(candidate.maxImageDimension2D / 1024, "max 2D image " + std::to_string(candidate.maxImageDimension2D));
+
+    return result;
+}
+
+size_t findDeviceBySelector(const std::vector<DeviceCandidate> &candidates, const std::string &selector)
+{
+    bool numeric = !selector.empty() && std::all_of(selector.begin(), selector.end(), [](unsigned char c) { return std::isdigit(c); });
+    if (numeric)
+    {
+        //超出范围时strtoull返回ULLONG_MAX并设置ERANGE，不能当作一个很大的索引静默接受
+        errno = 0;
+        unsigned long long index = strtoull(selector.c_str(), nullptr, 10);
+        if (errno == ERANGE)
+        {
+            throw std::runtime_error("=====Invalid value for --gpu: " + selector + "=====");
+        }
+        return index < candidates.size() ? static_cast<size_t>(index) : candidates.size();
+    }
+
+    std::string needle = toLower(selector);
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        if (toLower(candidates[i].name).find(needle) != std::string::npos)
+        {
+            return i;
+        }
+    }
+    return candidates.size();
+}
+
+DeviceSelection selectDevice(const std::vector<DeviceCandidate> &candidates, const std::string &selector)
+{
+    DeviceSelection selection;
+
+    if (!selector.empty())
+    {
+        size_t index = findDeviceBySelector(candidates, selector);
+        if (index == candidates.size())
+        {
+            throw std::runtime_error("=====No GPU matches \"" + selector + "\"!=====");
+        }
+        DeviceScore score = scoreDevice(candidates[index]);
+        if (!score.suitable)
+        {
+            throw std::runtime_error("=====Requested GPU \"" + candidates[index].name + "\" is not suitable!=====");
+        }
+        selection.index = index;
+        selection.score = score;
+        selection.overridden = true;
+        return selection;
+    }
+
+    bool found = false;
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        DeviceScore score = scoreDevice(candidates[i]);
+        //分数相同时保留枚举顺序靠前的设备
+        if (score.suitable && (!found || score.score > selection.score.score))
+        {
+            selection.index = i;
+            selection.score = score;
+            found = true;
+        }
+    }
+
+    if (!found)
+    {
+        throw std::runtime_error("=====No suitable GPU!=====");
+    }
+    return selection;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 打分所需的设备信息，全部是普通数据，可以由VkPhysicalDevice查询填充，
+// 也可以在测试中直接伪造属性表
+struct DeviceCandidate
+{
+    std::string name;
+    VkPhysicalDeviceType deviceType = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+    uint32_t apiVersion = 0;
+    uint32_t maxImageDimension2D = 0;
+    // 最大的DEVICE_LOCAL heap
+    VkDeviceSize deviceLocalHeapSize = 0;
+    std::vector<VkQueueFamilyProperties> queueFamilies;
+    std::vector<std::string> extensions;
+    // 由调用方根据surface判断：graphics/present队列、必需扩展与swap chain是否满足
+    bool meetsRequirements = false;
+};
+
+struct DeviceScore
+{
+    bool suitable = false;
+    int64_t score = 0;
+    // 每一项加分(或被拒绝)的原因，用于打印选择结果
+    std::vector<std::string> reasons;
+};
+
+struct DeviceSelection
+{
+    size_t index = 0;
+    DeviceScore score;
+    // 是否由--gpu/KUTORY_GPU显式指定
+    bool overridden = false;
+};
+
+DeviceScore scoreDevice(const DeviceCandidate &candidate);
+
+// selector为纯数字时按枚举顺序的索引匹配，否则按名称做不区分大小写的子串匹配
+// 返回candidates.size()表示没有匹配，数字超出unsigned long long范围时抛出std::runtime_error
+size_t findDeviceBySelector(const std::vector<DeviceCandidate> &candidates, const std::string &selector);
+
+// selector为空时选分数最高的合格设备；指定了selector但找不到或不合格时抛出std::runtime_error
+DeviceSelection selectDevice(const std::vector<DeviceCandidate> &candidates, const std::string &selector);
+
+const char *deviceTypeName(VkPhysicalDeviceType deviceType);
@@ -0,0 +1,232 @@
+#include "draw_list.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "api_call_counter.h"
+
+uint64_t packDrawKey(const DrawKeyFields &fields)
+{
+    if (fields.pass > 0xF || fields.pipeline > 0x3FF || fields.descriptorSet > 0x3FF || fields.material > 0xFFF || fields.mesh > 0xFFF)
+    {
+        throw std::runtime_error("=====Draw key field out of range!=====");
+    }
+    float depth = std::min(std::max(fields.depth, 0.0f), 1.0f);
+    uint64_t quantized = static_cast<uint64_t>(depth * 65535.0f + 0.5f);
+    if (fields.backToFront)
+    {
+        quantized = 0xFFFF - quantized;
+    }
+    return (uint64_t(fields.pass) << 60) | (uint64_t(fields.pipeline) << 50) | (uint64_t(fields.descriptorSet) << 40) |
+           (uint64_t(fields.material) << 28) | (uint64_t(fields.mesh) << 16) | quantized;
+}
+
+void DrawList::reserve(size_t count)
+{
+    items.reserve(count);
+    scratch.reserve(count);
+}
+
+void DrawList::clear()
+{
+    items.clear();
+}
+
+void DrawList::add(uint64_t key, uint32_t instance)
+{
+    items.push_back({key, instance});
+}
+
+void DrawList::sort()
+{
+    sortItems();
+    // FNV-1a
+    hash = 14695981039346656037ull;
+    for (const Item &item : items)
+    {
+        hash = (hash ^ item.key) * 1099511628211ull;
+        hash = (hash ^ item.instance) * 1099511628211ull;
+    }
+}
+
+void DrawList::sortItems()
+{
+    size_t count = items.size();
+    if (count < 2)
+    {
+        return;
+    }
+    //少量元素时插入排序更快，同样是稳定的
+    if (count <= 64)
+    {
+        for (size_t i = 1; i < count; i++)
+        {
+            Item item = items[i];
+            size_t j = i;
+            for (; j > 0 && items[j - 1].key > item.key; j--)
+            {
+                items[j] = items[j - 1];
+            }
+            items[j] = item;
+        }
+        return;
+    }
+
+    //一次遍历统计全部8个字节的直方图
+    uint32_t histograms[8][256] = {};
+    for (const Item &item : items)
+    {
+        for (int digit = 0; digit < 8; digit++)
+        {
+            histograms[digit][(item.key >> (digit * 8)) & 0xFF]++;
+        }
+    }
+
+    scratch.resize(count);
+    Item *source = items.data();
+    Item *destination = scratch.data();
+    for (int digit = 0; digit < 8; digit++)
+    {
+        uint32_t *histogram = histograms[digit];
+        int shift = digit * 8;
+        //这一字节全部相同(例如未使用的pass位或material位)时跳过
+        if (histogram[(source[0].key >> shift) & 0xFF] == count)
+        {
+            continue;
+        }
+        uint32_t offsets[256];
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < 256; bucket++)
+        {
+            offsets[bucket] = offset;
+            offset += histogram[bucket];
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            destination[offsets[(source[i].key >> shift) & 0xFF]++] = source[i];
+        }
+        std::swap(source, destination);
+    }
+    if (source != items.data())
+    {
+        items.swap(scratch);
+    }
+}
+
+const DrawList::Stats &DrawList::record(VkCommandBuffer commandBuffer, const DrawResources &resources)
+{
+    Stats stats;
+    stats.draws = static_cast<uint32_t>(items.size());
+
+    const uint32_t none = UINT32_MAX;
+    uint32_t boundPipeline = none;
+    uint32_t boundDescriptorSet = none;
+    uint32_t boundMaterial = none;
+    uint32_t boundMesh = none;
+    uint32_t naiveBinds = 0;
+
+    size_t i = 0;
+    while (i < items.size())
+    {
+        uint64_t key = items[i].key;
+        //除depth外的状态相同且instance连续时合并
+        size_t end = i + 1;
+        while (end < items.size() && (items[end].key >> 16) == (key >> 16) && items[end].instance == items[end - 1].instance + 1)
+        {
+            end++;
+        }
+        uint32_t instanceCount = static_cast<uint32_t>(end - i);
+        uint32_t bindsPerDraw = 0;
+
+        uint32_t pipeline = drawKeyPipeline(key);
+        if (pipeline >= resources.pipelines.size())
+        {
+            throw std::runtime_error("=====Draw key references unknown pipeline " + std::to_string(pipeline) + "=====");
+        }
+        bindsPerDraw++;
+        if (pipeline != boundPipeline)
+        {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, resources.pipelines[pipeline]);
+            boundPipeline = pipeline;
+            stats.pipelineBinds++;
+            countApiCall(ApiCall::BindPipeline);
+        }
+
+        if (!resources.descriptorSets.empty())
+        {
+            uint32_t descriptorSet = drawKeyDescriptorSet(key);
+            if (descriptorSet >= resources.descriptorSets.size())
+            {
+                throw std::runtime_error("=====Draw key references unknown descriptor set " + std::to_string(descriptorSet) + "=====");
+            }
+            bindsPerDraw++;
+            if (descriptorSet != boundDescriptorSet)
+            {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, resources.layout, 0, 1,
+                    &resources.descriptorSets[descriptorSet], 0, nullptr);
+                boundDescriptorSet = descriptorSet;
+                stats.descriptorBinds++;
+                countApiCall(ApiCall::BindDescriptorSets);
+            }
+        }
+
+        uint32_t material = drawKeyMaterial(key);
+        if (material < resources.materialSets.size() && resources.materialSets[material] != VK_NULL_HANDLE)
+        {
+            bindsPerDraw++;
+            if (material != boundMaterial)
+            {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, resources.layout, 1, 1,
+                    &resources.materialSets[material], 0, nullptr);
+                boundMaterial = material;
+                stats.materialBinds++;
+                countApiCall(ApiCall::BindDescriptorSets);
+            }
+        }
+
+        uint32_t meshIndex = drawKeyMesh(key);
+        if (meshIndex >= resources.meshes.size())
+        {
+            throw std::runtime_error("=====Draw key references unknown mesh " + std::to_string(meshIndex) + "=====");
+        }
+        const DrawResources::Mesh &mesh = resources.meshes[meshIndex];
+        bool hasBuffers = mesh.vertexBuffer != VK_NULL_HANDLE || mesh.indexBuffer != VK_NULL_HANDLE;
+        if (hasBuffers)
+        {
+            bindsPerDraw++;
+            if (meshIndex != boundMesh)
+            {
+                if (mesh.vertexBuffer != VK_NULL_HANDLE)
+                {
+                    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh.vertexBuffer, &mesh.vertexOffset);
+                    countApiCall(ApiCall::BindVertexBuffers);
+                }
+                if (mesh.indexBuffer != VK_NULL_HANDLE)
+                {
+                    vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, mesh.indexOffset, mesh.indexType);
+                    countApiCall(ApiCall::BindIndexBuffer);
+                }
+                boundMesh = meshIndex;
+                stats.meshBinds++;
+            }
+        }
+
+        if (mesh.indexBuffer != VK_NULL_HANDLE)
+        {
+            vkCmdDrawIndexed(commandBuffer, mesh.indexCount, instanceCount, 0, 0, items[i].instance);
+        }
+        else
+        {
+            vkCmdDraw(commandBuffer, mesh.vertexCount, instanceCount, 0, items[i].instance);
+        }
+        stats.drawCalls++;
+        countApiCall(ApiCall::Draw);
+        naiveBinds += bindsPerDraw * instanceCount;
+        i = end;
+    }
+
+    stats.redundantBindsAvoided = naiveBinds - stats.binds();
+    lastStats = stats;
+    return lastStats;
+}
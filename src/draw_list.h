@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+// 64位排序键，从高位到低位：
+//   pass 4位 | pipeline 10位 | descriptor set 10位 | material 12位 | mesh 12位 | depth 16位
+// 按键排序后同一pipeline/descriptor/material/mesh的draw连续出现，录制时只在值变化时bind
+struct DrawKeyFields
+{
+    // 先于pipeline比较，保证depth prepass、opaque、transparent等的先后顺序
+    uint32_t pass = 0;
+    uint32_t pipeline = 0;
+    uint32_t descriptorSet = 0;
+    uint32_t material = 0;
+    uint32_t mesh = 0;
+    // 归一化到[0, 1]的视空间深度
+    float depth = 0.0f;
+    // 半透明物体需要从远到近
+    bool backToFront = false;
+};
+
+// 字段超出位宽时抛出std::runtime_error
+uint64_t packDrawKey(const DrawKeyFields &fields);
+
+inline uint32_t drawKeyPass(uint64_t key) { return static_cast<uint32_t>(key >> 60); }
+inline uint32_t drawKeyPipeline(uint64_t key) { return static_cast<uint32_t>(key >> 50) & 0x3FF; }
+inline uint32_t drawKeyDescriptorSet(uint64_t key) { return static_cast<uint32_t>(key >> 40) & 0x3FF; }
+inline uint32_t drawKeyMaterial(uint64_t key) { return static_cast<uint32_t>(key >> 28) & 0xFFF; }
+inline uint32_t drawKeyMesh(uint64_t key) { return static_cast<uint32_t>(key >> 16) & 0xFFF; }
+
+// 排序键中的id到Vulkan对象的映射，所有pipeline共用同一个layout
+struct DrawResources
+{
+    struct Mesh
+    {
+        // vertexBuffer为VK_NULL_HANDLE时顶点由shader生成，不绑定vertex buffer
+        VkBuffer vertexBuffer = VK_NULL_HANDLE;
+        VkDeviceSize vertexOffset = 0;
+        // indexBuffer为VK_NULL_HANDLE时使用vkCmdDraw
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        VkDeviceSize indexOffset = 0;
+        VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+        uint32_t indexCount = 0;
+        uint32_t vertexCount = 0;
+    };
+
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    std::vector<VkPipeline> pipelines;
+    // set 0
+    std::vector<VkDescriptorSet> descriptorSets;
+    // set 1，为空或为VK_NULL_HANDLE时不绑定
+    std::vector<VkDescriptorSet> materialSets;
+    std::vector<Mesh> meshes;
+};
+
+// 每帧收集draw，基数排序后录制，只发出变化了的bind
+// 每个draw的instance作为firstInstance传给shader(gl_InstanceIndex)，用于索引对象数据；
+// 排序后除depth外键相同且instance连续的draw合并为一次instanced draw
+class DrawList
+{
+public:
+    struct Stats
+    {
+        uint32_t draws = 0;
+        uint32_t drawCalls = 0;
+        uint32_t pipelineBinds = 0;
+        uint32_t descriptorBinds = 0;
+        uint32_t materialBinds = 0;
+        uint32_t meshBinds = 0;
+        // 每个draw都重新bind自己用到的所有状态时多出的bind数
+        uint32_t redundantBindsAvoided = 0;
+
+        uint32_t binds() const { return pipelineBinds + descriptorBinds + materialBinds + meshBinds; }
+    };
+
+    void reserve(size_t count);
+    void clear();
+    void add(uint64_t key, uint32_t instance);
+    size_t size() const { return items.size(); }
+
+    // 稳定的LSD基数排序，每次处理8位，所有元素该位相同的pass直接跳过
+    void sort();
+    // 按当前顺序录制，调用方负责viewport、scissor等动态状态；返回本次的统计
+    const Stats &record(VkCommandBuffer commandBuffer, const DrawResources &resources);
+    const Stats &stats() const { return lastStats; }
+    // sort时计算的内容(键与instance)哈希，用于判断缓存的录制结果是否仍然有效
+    uint64_t contentHash() const { return hash; }
+
+    uint64_t keyAt(size_t index) const { return items[index].key; }
+    uint32_t instanceAt(size_t index) const { return items[index].instance; }
+
+private:
+    struct Item
+    {
+        uint64_t key;
+        uint32_t instance;
+    };
+
+    void sortItems();
+
+    std::vector<Item> items;
+    std::vector<Item> scratch;
+    Stats lastStats;
+    uint64_t hash = 0;
+};
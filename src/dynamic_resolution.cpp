@@ -0,0 +1,396 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include "api_call_counter.h"
+
+namespace
+{
+    // 输出image的格式，所有设备都支持作为storage image与blit源
+    const VkFormat outputFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+    const uint32_t groupSize = 8;
+}
+
+void ResolutionController::setConfig(const Config &config)
+{
+    this->config = config;
+    current = quantize(std::min(current, config.maxScale));
+    smoothedCost = 0.0;
+}
+
+float ResolutionController::quantize(float scale) const
+{
+    //加一点余量，避免浮点误差把正好落在步长上的比例取整到下一级
+    float steps = std::floor(scale / config.step + 1e-4f);
+    return std::clamp(steps * config.step, config.minScale, config.maxScale);
+}
+
+void ResolutionController::update(double gpuMs, float renderedScale)
+{
+    if (gpuMs <= 0.0 || renderedScale <= 0.0f)
+    {
+        return;
+    }
+
+    double cost = gpuMs / (static_cast<double>(renderedScale) * renderedScale);
+    double budget = config.targetMs * config.headroom;
+
+    //按这一帧的测量，当前比例已经超出预算：立即降下来，平滑值也跟上，之后不会马上回升
+    if (cost * current * current > budget)
+    {
+        smoothedCost = std::max(smoothedCost, cost);
+        current = quantize(static_cast<float>(std::sqrt(budget / cost)));
+        return;
+    }
+
+    smoothedCost = smoothedCost == 0.0 ? cost : smoothedCost + (cost - smoothedCost) * config.smoothing;
+    float desired = static_cast<float>(std::sqrt(budget / smoothedCost));
+    if (desired >= current + config.step)
+    {
+        current = quantize(std::min(desired, current + std::max(config.maxIncrease, config.step)));
+    }
+}
+
+void DynamicResolution::create(VkDevice device, const Synchronization2 &synchronization, const VkPhysicalDeviceMemoryProperties &memoryProperties,
+    const std::string &shaderDirectory)
+{
+    this->device = device;
+    this->synchronization = &synchronization;
+    this->memoryProperties = memoryProperties;
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.0f;
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create upscale sampler!=====");
+    }
+
+    VkDescriptorSetLayoutBinding bindings[2]{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create upscale descriptor set layout!=====");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create upscale pipeline layout!=====");
+    }
+
+    std::string path = shaderDirectory + "/upscale.spv";
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("=====Failed to open shader file: " + path + "=====");
+    }
+    std::vector<char> code(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(code.data(), code.size());
+
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = code.size();
+    moduleInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+    VkShaderModule module;
+    if (vkCreateShaderModule(device, &moduleInfo, nullptr, &module) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create shader module: " + path + "=====");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = module;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+    VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(device, module, nullptr);
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create upscale pipeline!=====");
+    }
+
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = 1;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = 1;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create upscale descriptor pool!=====");
+    }
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+    if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to allocate upscale descriptor set!=====");
+    }
+}
+
+void DynamicResolution::destroy()
+{
+    if (device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    releaseTargets();
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    vkDestroySampler(device, sampler, nullptr);
+    device = VK_NULL_HANDLE;
+}
+
+bool DynamicResolution::isSupported(VkPhysicalDevice physicalDevice, VkFormat colorFormat)
+{
+    VkFormatProperties sceneProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, colorFormat, &sceneProperties);
+    VkFormatFeatureFlags sceneFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+
+    VkFormatProperties outputProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, outputFormat, &outputProperties);
+    VkFormatFeatureFlags outputFeatures = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT;
+
+    return (sceneProperties.optimalTilingFeatures & sceneFeatures) == sceneFeatures &&
+        (outputProperties.optimalTilingFeatures & outputFeatures) == outputFeatures;
+}
+
+DynamicResolution::Image DynamicResolution::createImage(VkFormat format, VkImageUsageFlags usage)
+{
+    Image result;
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = {extent.width, extent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateImage(device, &imageInfo, nullptr, &result.image) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create dynamic resolution image!=====");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, result.image, &memRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = UINT32_MAX;
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    {
+        if ((memRequirements.memoryTypeBits & (1u << i)) &&
+            (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0)
+        {
+            allocInfo.memoryTypeIndex = i;
+            break;
+        }
+    }
+    if (allocInfo.memoryTypeIndex == UINT32_MAX)
+    {
+        throw std::runtime_error("=====Failed to find dynamic resolution memory type!=====");
+    }
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &result.memory) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to allocate dynamic resolution memory!=====");
+    }
+    vkBindImageMemory(device, result.image, result.memory, 0);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = result.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    if (vkCreateImageView(device, &viewInfo, nullptr, &result.view) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create dynamic resolution image view!=====");
+    }
+    return result;
+}
+
+void DynamicResolution::destroyImage(Image &image)
+{
+    if (image.image == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    vkDestroyImageView(device, image.view, nullptr);
+    vkDestroyImage(device, image.image, nullptr);
+    vkFreeMemory(device, image.memory, nullptr);
+    image = {};
+}
+
+void DynamicResolution::resize(VkExtent2D extent, VkFormat colorFormat)
+{
+    releaseTargets();
+    this->extent = extent;
+    scene = createImage(colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    output = createImage(outputFormat, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+    VkDescriptorImageInfo sceneInfo{};
+    sceneInfo.sampler = sampler;
+    sceneInfo.imageView = scene.view;
+    sceneInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    VkDescriptorImageInfo outputInfo{};
+    outputInfo.imageView = output.view;
+    outputInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    VkWriteDescriptorSet writes[2]{};
+    writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[0].dstSet = descriptorSet;
+    writes[0].dstBinding = 0;
+    writes[0].descriptorCount = 1;
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[0].pImageInfo = &sceneInfo;
+    writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[1].dstSet = descriptorSet;
+    writes[1].dstBinding = 1;
+    writes[1].descriptorCount = 1;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[1].pImageInfo = &outputInfo;
+    vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+}
+
+void DynamicResolution::releaseTargets()
+{
+    destroyImage(scene);
+    destroyImage(output);
+    extent = {};
+}
+
+VkExtent2D DynamicResolution::renderExtent(float scale) const
+{
+    uint32_t width = static_cast<uint32_t>(std::lround(extent.width * scale));
+    uint32_t height = static_cast<uint32_t>(std::lround(extent.height * scale));
+    return {std::clamp(width, 1u, extent.width), std::clamp(height, 1u, extent.height)};
+}
+
+void DynamicResolution::recordBeginScene(VkCommandBuffer commandBuffer, bool transitionLayout) const
+{
+    //上一帧的upscale读完之后才能写入(WAR只需要执行依赖)
+    if (transitionLayout)
+    {
+        synchronization->imageBarrier(commandBuffer, makeImageBarrier(scene.image,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_NONE,
+            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT));
+        return;
+    }
+
+    //render pass的外部依赖从COLOR_ATTACHMENT_OUTPUT开始，与这里的目标阶段相接
+    VkMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VkDependencyInfo dependency{};
+    dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency.memoryBarrierCount = 1;
+    dependency.pMemoryBarriers = &barrier;
+    synchronization->pipelineBarrier(commandBuffer, dependency);
+}
+
+void DynamicResolution::recordUpscale(VkCommandBuffer commandBuffer, VkExtent2D renderExtent, VkImage target, float sharpness) const
+{
+    //场景可供采样；输出的旧内容在上一帧blit读完后丢弃
+    VkImageMemoryBarrier2 beforeDispatch[2] = {
+        makeImageBarrier(scene.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT),
+        makeImageBarrier(output.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+            VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_NONE,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT),
+    };
+    VkDependencyInfo dependency{};
+    dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency.imageMemoryBarrierCount = 2;
+    dependency.pImageMemoryBarriers = beforeDispatch;
+    synchronization->pipelineBarrier(commandBuffer, dependency);
+
+    PushConstants constants{};
+    constants.inputScale[0] = static_cast<float>(renderExtent.width) / extent.width;
+    constants.inputScale[1] = static_cast<float>(renderExtent.height) / extent.height;
+    constants.inputTexel[0] = 1.0f / extent.width;
+    constants.inputTexel[1] = 1.0f / extent.height;
+    constants.outputTexel[0] = 1.0f / extent.width;
+    constants.outputTexel[1] = 1.0f / extent.height;
+    constants.outputSize[0] = static_cast<int32_t>(extent.width);
+    constants.outputSize[1] = static_cast<int32_t>(extent.height);
+    constants.sharpness = std::clamp(sharpness, 0.0f, 1.0f);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(commandBuffer, (extent.width + groupSize - 1) / groupSize, (extent.height + groupSize - 1) / groupSize, 1);
+    countApiCall(ApiCall::BindPipeline);
+    countApiCall(ApiCall::BindDescriptorSets);
+    countApiCall(ApiCall::PushConstants);
+    countApiCall(ApiCall::Dispatch);
+
+    //target的srcStage与acquire semaphore的等待阶段一致
+    VkImageMemoryBarrier2 beforeBlit[2] = {
+        makeImageBarrier(output.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT),
+        makeImageBarrier(target, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_NONE,
+            VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT),
+    };
+    dependency.pImageMemoryBarriers = beforeBlit;
+    synchronization->pipelineBarrier(commandBuffer, dependency);
+
+    //尺寸相同，blit只做格式转换(线性的RGBA16F -> swap chain格式，SRGB时在这里编码)
+    VkImageBlit blit{};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.srcOffsets[1] = {static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.dstOffsets[1] = blit.srcOffsets[1];
+    vkCmdBlitImage(commandBuffer, output.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1, &blit, VK_FILTER_NEAREST);
+    countApiCall(ApiCall::Copy);
+}
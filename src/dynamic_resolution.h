@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+
+#include "synchronization2.h"
+
+// 根据GPU时间决定每帧的渲染比例(每个轴)
+// 假设GPU时间与像素数成正比：测得的时间按渲染比例换算成全分辨率下的耗时，再反推达到目标所需的比例
+// 超出目标时立即按本帧的测量降到所需比例，回升时用平滑后的耗时并限制每帧的升幅，避免负载波动时来回跳变
+class ResolutionController
+{
+public:
+    struct Config
+    {
+        // GPU时间的目标，通常取刷新间隔
+        double targetMs = 16.0;
+        // 只用目标的这一部分，给测量之外的波动留出余量
+        double headroom = 0.9;
+        float minScale = 0.5f;
+        float maxScale = 1.0f;
+        // 比例按此步长向下取整，小于一个步长的变化不会改变渲染尺寸
+        float step = 1.0f / 40.0f;
+        // 每帧最多上调的比例
+        float maxIncrease = 0.02f;
+        // 平滑全分辨率耗时的系数
+        double smoothing = 0.1;
+    };
+
+    void setConfig(const Config &config);
+
+    // 每个完成的帧调用一次；renderedScale为该帧渲染时使用的比例(帧在飞行中时可能已经与scale()不同)
+    void update(double gpuMs, float renderedScale);
+    float scale() const { return current; }
+
+private:
+    float quantize(float scale) const;
+
+    Config config;
+    float current = 1.0f;
+    // 换算到全分辨率的GPU耗时(ms)，0表示还没有测量
+    double smoothedCost = 0.0;
+};
+
+// 场景渲染到与swap chain同尺寸的color target的左上角区域(区域大小每帧可变，不需要重新分配)，
+// 然后用shader/upscale.comp放大并锐化到RGBA16F的输出image，再blit到swap chain image
+// 输出经过blit而不是直接写入swap chain，因为swap chain的SRGB格式通常不支持storage
+class DynamicResolution
+{
+public:
+    // shaderDirectory中需要有upscale.spv；synchronization在destroy之前必须有效
+    void create(VkDevice device, const Synchronization2 &synchronization, const VkPhysicalDeviceMemoryProperties &memoryProperties,
+        const std::string &shaderDirectory);
+    void destroy();
+
+    // 设备能否以colorFormat作为场景target并blit到swap chain(swap chain需要TRANSFER_DST usage)
+    static bool isSupported(VkPhysicalDevice physicalDevice, VkFormat colorFormat);
+
+    // swap chain(重新)创建之后调用，设备必须空闲
+    void resize(VkExtent2D extent, VkFormat colorFormat);
+    void releaseTargets();
+
+    VkImage sceneImage() const { return scene.image; }
+    VkImageView sceneView() const { return scene.view; }
+    // 按比例缩放后的渲染区域，至少1x1
+    VkExtent2D renderExtent(float scale) const;
+
+    // 场景写入之前录制：等待上一次upscale对场景target的读取完成
+    // transitionLayout为true时同时把场景target转为COLOR_ATTACHMENT_OPTIMAL(dynamic rendering)，
+    // 否则由render pass负责layout转换
+    void recordBeginScene(VkCommandBuffer commandBuffer, bool transitionLayout) const;
+    // 场景target的renderExtent区域已由color attachment写完，处于COLOR_ATTACHMENT_OPTIMAL；
+    // 放大、锐化后blit到target，target的旧内容被丢弃，结束时处于TRANSFER_DST_OPTIMAL
+    // target的写入在TRANSFER阶段，acquire semaphore需要在该阶段等待
+    void recordUpscale(VkCommandBuffer commandBuffer, VkExtent2D renderExtent, VkImage target, float sharpness) const;
+
+private:
+    struct Image
+    {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+    };
+
+    struct PushConstants
+    {
+        float inputScale[2];
+        float inputTexel[2];
+        float outputTexel[2];
+        int32_t outputSize[2];
+        float sharpness;
+    };
+
+    Image createImage(VkFormat format, VkImageUsageFlags usage);
+    void destroyImage(Image &image);
+
+    VkDevice device = VK_NULL_HANDLE;
+    const Synchronization2 *synchronization = nullptr;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+
+    VkExtent2D extent{};
+    Image scene;
+    Image output;
+};
@@ -0,0 +1,85 @@
+#include "frame_arena.h"
+
+#include <algorithm>
+
+namespace
+{
+    // 追加块的最小大小
+    const size_t minimumOverflowBlock = 4096;
+
+    size_t alignOffset(const uint8_t *base, size_t offset, size_t alignment)
+    {
+        uintptr_t address = reinterpret_cast<uintptr_t>(base) + offset;
+        uintptr_t aligned = (address + alignment - 1) & ~uintptr_t(alignment - 1);
+        return offset + static_cast<size_t>(aligned - address);
+    }
+}
+
+LinearArena::LinearArena(size_t capacity) : block(new uint8_t[capacity]), capacity(capacity)
+{
+    counters.capacity = capacity;
+}
+
+void *LinearArena::allocate(size_t size, size_t alignment)
+{
+    size = std::max<size_t>(size, 1);
+    if (block != nullptr)
+    {
+        size_t offset = alignOffset(block.get(), usedBytes, alignment);
+        if (offset + size <= capacity)
+        {
+            usedBytes = offset + size;
+            return block.get() + offset;
+        }
+    }
+
+    //放不下时追加一块；之后的分配先用追加的块，直到reset
+    size_t offset = overflowBlocks.empty() ? 0 : alignOffset(overflowBlocks.back().get(), overflowUsed, alignment);
+    if (overflowBlocks.empty() || offset + size > overflowCapacity)
+    {
+        overflowCapacity = std::max({size + alignment, capacity, minimumOverflowBlock});
+        overflowBlocks.emplace_back(new uint8_t[overflowCapacity]);
+        overflowUsed = 0;
+        offset = alignOffset(overflowBlocks.back().get(), 0, alignment);
+        counters.overflows++;
+    }
+    overflowBytes += offset + size - overflowUsed;
+    overflowUsed = offset + size;
+    return overflowBlocks.back().get() + offset;
+}
+
+void LinearArena::reset()
+{
+    size_t total = used();
+    counters.lastUsed = total;
+    counters.peakUsed = std::max(counters.peakUsed, total);
+
+    //这一轮溢出过：换成一块能容纳峰值的内存，稳定后不再分配
+    if (!overflowBlocks.empty())
+    {
+        capacity = std::max(capacity * 2, counters.peakUsed + counters.peakUsed / 4);
+        block.reset(new uint8_t[capacity]);
+        counters.capacity = capacity;
+        overflowBlocks.clear();
+    }
+    usedBytes = 0;
+    overflowCapacity = 0;
+    overflowUsed = 0;
+    overflowBytes = 0;
+}
+
+void FrameArena::create(uint32_t framesInFlight, size_t bytesPerFrame)
+{
+    arenas.clear();
+    for (uint32_t i = 0; i < framesInFlight; i++)
+    {
+        arenas.emplace_back(bytesPerFrame);
+    }
+    currentFrame = 0;
+}
+
+void FrameArena::beginFrame(uint32_t frame)
+{
+    currentFrame = frame;
+    arenas[frame].reset();
+}
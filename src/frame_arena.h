@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// 线性分配器：分配只移动偏移，不能单独释放，reset后整体复用
+// 容量不够时从堆上追加一块，reset时合并成一块足够大的，之后同样的用量不再分配堆内存
+class LinearArena
+{
+public:
+    struct Stats
+    {
+        size_t capacity = 0;
+        // 上一次reset之前的用量(包括追加的块)
+        size_t lastUsed = 0;
+        size_t peakUsed = 0;
+        // 因为容量不够而追加块的次数
+        uint64_t overflows = 0;
+    };
+
+    LinearArena() = default;
+    explicit LinearArena(size_t capacity);
+    LinearArena(const LinearArena &) = delete;
+    LinearArena &operator=(const LinearArena &) = delete;
+    LinearArena(LinearArena &&) = default;
+    LinearArena &operator=(LinearArena &&) = default;
+
+    // alignment必须是2的幂；size为0时返回非空的有效指针
+    void *allocate(size_t size, size_t alignment);
+    template <typename T>
+    T *allocateArray(size_t count)
+    {
+        return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+    }
+    // 之前分配的内存全部失效
+    void reset();
+
+    size_t used() const { return usedBytes + overflowBytes; }
+    const Stats &stats() const { return counters; }
+
+private:
+    std::unique_ptr<uint8_t[]> block;
+    size_t capacity = 0;
+    size_t usedBytes = 0;
+    // 追加的块与其中已用的字节，reset时释放
+    std::vector<std::unique_ptr<uint8_t[]>> overflowBlocks;
+    size_t overflowCapacity = 0;
+    size_t overflowUsed = 0;
+    size_t overflowBytes = 0;
+    Stats counters;
+};
+
+// 每个frame in flight一个LinearArena：beginFrame在该帧的fence signal之后调用，
+// 上一轮同一slot的内存此时不再被使用(包括已经提交、尚未执行完的数据)
+class FrameArena
+{
+public:
+    void create(uint32_t framesInFlight, size_t bytesPerFrame);
+    void beginFrame(uint32_t frame);
+    LinearArena &current() { return arenas[currentFrame]; }
+    const LinearArena &arena(uint32_t frame) const { return arenas[frame]; }
+
+private:
+    std::vector<LinearArena> arenas;
+    uint32_t currentFrame = 0;
+};
+
+// STL分配器，deallocate不做任何事，内存在arena reset时统一回收
+// 容器的生命周期不能超过分配它的那一帧
+template <typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(LinearArena &arena) : arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena)
+    {
+    }
+
+    T *allocate(size_t count) { return arena->allocateArray<T>(count); }
+    void deallocate(T *, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const
+    {
+        return arena == other.arena;
+    }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const
+    {
+        return arena != other.arena;
+    }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+
+    LinearArena *arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,527 @@
+#include "frame_capture.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "api_call_counter.h"
+#include "log.h"
+#include "png_image.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace
+{
+    bool startsWith(const std::string &text, const char *prefix)
+    {
+        return text.compare(0, strlen(prefix), prefix) == 0;
+    }
+
+    // 把路径中第一个%d/%0Nd替换为帧号，不把用户输入直接当作printf格式
+    std::string formatFramePath(const std::string &pattern, uint64_t frame)
+    {
+        size_t percent = pattern.find('%');
+        if (percent == std::string::npos)
+        {
+            return pattern;
+        }
+        size_t position = percent + 1;
+        size_t width = 0;
+        while (position < pattern.size() && pattern[position] >= '0' && pattern[position] <= '9')
+        {
+            width = width * 10 + (pattern[position] - '0');
+            position++;
+        }
+        if (position >= pattern.size() || pattern[position] != 'd')
+        {
+            return pattern;
+        }
+        std::string number = std::to_string(frame);
+        if (number.size() < width)
+        {
+            number.insert(0, width - number.size(), '0');
+        }
+        return pattern.substr(0, percent) + number + pattern.substr(position + 1);
+    }
+}
+
+FrameCapture::~FrameCapture()
+{
+    if (writer.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopWriter = true;
+        }
+        jobAvailable.notify_one();
+        writer.join();
+    }
+    closeStream();
+}
+
+void FrameCapture::setConfig(const Config &config)
+{
+    this->config = config;
+    const std::string &target = config.target;
+    if (target.empty())
+    {
+        sink = Sink::None;
+    }
+    else if (startsWith(target, "png:"))
+    {
+        sink = Sink::Png;
+        path = target.substr(4);
+    }
+    else if (startsWith(target, "raw:"))
+    {
+        sink = Sink::Raw;
+        path = target.substr(4);
+    }
+    else if (startsWith(target, "pipe:"))
+    {
+        sink = Sink::Pipe;
+        path = target.substr(5);
+    }
+    else
+    {
+        throw std::runtime_error("=====Capture target must start with png:, raw: or pipe:, got " + target + "=====");
+    }
+    if (sink != Sink::None && path.empty())
+    {
+        throw std::runtime_error("=====Capture target has no path: " + target + "=====");
+    }
+    //每个frame in flight至少要有一个buffer
+    this->config.bufferCount = std::max(this->config.bufferCount, 2u);
+}
+
+void FrameCapture::start(VkDevice device, const Synchronization2 &synchronization, const VkPhysicalDeviceMemoryProperties &memoryProperties, uint32_t frameSlots)
+{
+    if (!enabled())
+    {
+        return;
+    }
+    this->device = device;
+    this->synchronization = &synchronization;
+    this->memoryProperties = memoryProperties;
+    config.bufferCount = std::max(config.bufferCount, frameSlots);
+    slotBuffers.assign(frameSlots, UINT32_MAX);
+    openStream();
+    stopWriter = false;
+    writer = std::thread(&FrameCapture::writerLoop, this);
+}
+
+bool FrameCapture::resize(VkExtent2D newExtent, VkFormat newFormat)
+{
+    if (device == VK_NULL_HANDLE)
+    {
+        return false;
+    }
+    drain();
+
+    switch (newFormat)
+    {
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        swizzle = true;
+        formatSupported = true;
+        break;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        swizzle = false;
+        formatSupported = true;
+        break;
+    default:
+        formatSupported = false;
+        if (newFormat == VK_FORMAT_UNDEFINED)
+        {
+            return false;
+        }
+        logStream(LogLevel::Warning) << "Frame capture: swap chain format " << newFormat << " is not supported, capture disabled\n";
+        return false;
+    }
+
+    if (newExtent.width == extent.width && newExtent.height == extent.height && !buffers.empty())
+    {
+        format = newFormat;
+        return true;
+    }
+    if (sink != Sink::Png && counters.written > 0)
+    {
+        //连续的原始帧中途改变尺寸，读取端需要知道新的尺寸
+        logStream(LogLevel::Warning) << "Frame capture: frame size changed to " << newExtent.width << "x" << newExtent.height
+                                     << " in the middle of a raw stream\n";
+    }
+    destroyBuffers();
+    extent = newExtent;
+    format = newFormat;
+    createBuffers();
+    return true;
+}
+
+void FrameCapture::stop()
+{
+    if (device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    drain();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopWriter = true;
+    }
+    jobAvailable.notify_one();
+    writer.join();
+    closeStream();
+    destroyBuffers();
+    device = VK_NULL_HANDLE;
+
+    Stats result = stats();
+    logStream(LogLevel::Info) << "Frame capture: " << result.written << " frames written, " << result.dropped
+                              << " dropped, " << result.averageWriteMs << " ms per frame on the writer thread\n";
+}
+
+bool FrameCapture::wantsFrame(uint64_t frame) const
+{
+    if (device == VK_NULL_HANDLE || !formatSupported || frame < config.firstFrame)
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    return config.frameCount == 0 || counters.recorded < config.frameCount;
+}
+
+bool FrameCapture::finished() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return config.frameCount > 0 && counters.written >= config.frameCount;
+}
+
+bool FrameCapture::recordCopy(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint64_t frame, VkImage image,
+    VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+    uint32_t index = UINT32_MAX;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (uint32_t i = 0; i < buffers.size(); i++)
+        {
+            if (buffers[i].state == BufferState::Free)
+            {
+                index = i;
+                break;
+            }
+        }
+        if (index == UINT32_MAX)
+        {
+            //写入线程跟不上，丢弃这一帧而不是等待
+            counters.dropped++;
+            return false;
+        }
+        buffers[index].state = BufferState::InFlight;
+        buffers[index].frame = frame;
+        counters.recorded++;
+    }
+    slotBuffers[frameSlot] = index;
+
+    //最后一次写入可能是color attachment，也可能是动态分辨率upscale的blit
+    VkImageMemoryBarrier2 toSource = makeImageBarrier(image, oldLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+    toSource.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    synchronization->imageBarrier(commandBuffer, toSource);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {extent.width, extent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffers[index].buffer, 1, &region);
+    countApiCall(ApiCall::Copy);
+
+    //image交还给present，buffer对host可见
+    VkImageMemoryBarrier2 toPresent = toSource;
+    toPresent.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    toPresent.srcAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+    toPresent.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+    toPresent.dstAccessMask = VK_ACCESS_2_NONE;
+    toPresent.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    toPresent.newLayout = newLayout;
+    VkBufferMemoryBarrier2 toHost{};
+    toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+    toHost.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    toHost.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    toHost.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+    toHost.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+    toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.buffer = buffers[index].buffer;
+    toHost.offset = 0;
+    toHost.size = VK_WHOLE_SIZE;
+    VkDependencyInfo dependency{};
+    dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency.bufferMemoryBarrierCount = 1;
+    dependency.pBufferMemoryBarriers = &toHost;
+    dependency.imageMemoryBarrierCount = 1;
+    dependency.pImageMemoryBarriers = &toPresent;
+    synchronization->pipelineBarrier(commandBuffer, dependency);
+    return true;
+}
+
+void FrameCapture::frameCompleted(uint32_t frameSlot)
+{
+    if (slotBuffers.empty() || slotBuffers[frameSlot] == UINT32_MAX)
+    {
+        return;
+    }
+    uint32_t index = slotBuffers[frameSlot];
+    slotBuffers[frameSlot] = UINT32_MAX;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers[index].state = BufferState::Writing;
+        jobs.push_back({index, buffers[index].frame});
+    }
+    jobAvailable.notify_one();
+}
+
+FrameCapture::Stats FrameCapture::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result = counters;
+    result.averageWriteMs = counters.written > 0 ? totalWriteMs / counters.written : 0.0;
+    return result;
+}
+
+std::vector<uint8_t> FrameCapture::lastFrame(uint32_t &width, uint32_t &height) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    width = keptExtent.width;
+    height = keptExtent.height;
+    return keptFrame;
+}
+
+void FrameCapture::createBuffers()
+{
+    VkDeviceSize size = VkDeviceSize(extent.width) * extent.height * 4;
+    buffers.resize(config.bufferCount);
+    for (auto &readback : buffers)
+    {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (vkCreateBuffer(device, &bufferInfo, nullptr, &readback.buffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("=====Failed to create readback buffer!=====");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device, readback.buffer, &memRequirements);
+        //CPU要读取整帧，优先HOST_CACHED，未缓存的内存读取非常慢
+        const VkMemoryPropertyFlags preferred[] = {
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        };
+        uint32_t memoryType = UINT32_MAX;
+        for (VkMemoryPropertyFlags properties : preferred)
+        {
+            for (uint32_t i = 0; i < memoryProperties.memoryTypeCount && memoryType == UINT32_MAX; i++)
+            {
+                if ((memRequirements.memoryTypeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+                {
+                    memoryType = i;
+                }
+            }
+            if (memoryType != UINT32_MAX)
+            {
+                break;
+            }
+        }
+        if (memoryType == UINT32_MAX)
+        {
+            throw std::runtime_error("=====Failed to find readback memory type!=====");
+        }
+        readback.coherent = (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = memoryType;
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &readback.memory) != VK_SUCCESS)
+        {
+            throw std::runtime_error("=====Failed to allocate readback memory!=====");
+        }
+        vkBindBufferMemory(device, readback.buffer, readback.memory, 0);
+        void *mapped = nullptr;
+        vkMapMemory(device, readback.memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+        readback.mapped = static_cast<const uint8_t *>(mapped);
+        readback.state = BufferState::Free;
+    }
+}
+
+void FrameCapture::destroyBuffers()
+{
+    for (auto &readback : buffers)
+    {
+        vkUnmapMemory(device, readback.memory);
+        vkDestroyBuffer(device, readback.buffer, nullptr);
+        vkFreeMemory(device, readback.memory, nullptr);
+    }
+    buffers.clear();
+}
+
+void FrameCapture::drain()
+{
+    for (uint32_t slot = 0; slot < slotBuffers.size(); slot++)
+    {
+        frameCompleted(slot);
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [this] { return jobs.empty() && !writing; });
+}
+
+void FrameCapture::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        jobAvailable.wait(lock, [this] { return stopWriter || !jobs.empty(); });
+        if (jobs.empty())
+        {
+            return;
+        }
+        Job job = jobs.front();
+        jobs.pop_front();
+        writing = true;
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        writeFrame(buffers[job.buffer], job.frame);
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        lock.lock();
+        buffers[job.buffer].state = BufferState::Free;
+        counters.written++;
+        totalWriteMs += elapsed;
+        writing = false;
+        jobDone.notify_all();
+    }
+}
+
+void FrameCapture::writeFrame(const ReadbackBuffer &readback, uint64_t frame)
+{
+    if (!readback.coherent)
+    {
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = readback.memory;
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(device, 1, &range);
+    }
+
+    size_t pixelCount = size_t(extent.width) * extent.height;
+    rgba.resize(pixelCount * 4);
+    if (swizzle)
+    {
+        const uint8_t *source = readback.mapped;
+        for (size_t i = 0; i < pixelCount; i++)
+        {
+            rgba[i * 4 + 0] = source[i * 4 + 2];
+            rgba[i * 4 + 1] = source[i * 4 + 1];
+            rgba[i * 4 + 2] = source[i * 4 + 0];
+            rgba[i * 4 + 3] = source[i * 4 + 3];
+        }
+    }
+    else
+    {
+        memcpy(rgba.data(), readback.mapped, rgba.size());
+    }
+
+    try
+    {
+        if (sink == Sink::Png)
+        {
+            writePng(formatFramePath(path, frame), rgba.data(), extent.width, extent.height);
+        }
+        else if (stream != nullptr && fwrite(rgba.data(), 1, rgba.size(), stream) != rgba.size())
+        {
+            logStream(LogLevel::Error) << "Frame capture: failed to write frame " << frame << ", closing the stream\n";
+            closeStream();
+        }
+    }
+    catch (const std::exception &e)
+    {
+        logStream(LogLevel::Error) << e.what() << '\n';
+    }
+
+    if (config.keepLastFrame)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        keptFrame = rgba;
+        keptExtent = extent;
+    }
+}
+
+void FrameCapture::openStream()
+{
+    if (sink == Sink::Raw)
+    {
+        if (path == "-")
+        {
+#ifdef _WIN32
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+            stream = stdout;
+        }
+        else
+        {
+            stream = fopen(path.c_str(), "wb");
+        }
+    }
+    else if (sink == Sink::Pipe)
+    {
+#ifdef _WIN32
+        stream = popen(path.c_str(), "wb");
+#else
+        stream = popen(path.c_str(), "w");
+#endif
+    }
+    else
+    {
+        return;
+    }
+    if (stream == nullptr)
+    {
+        throw std::runtime_error("=====Failed to open capture output: " + path + "=====");
+    }
+}
+
+void FrameCapture::closeStream()
+{
+    if (stream == nullptr)
+    {
+        return;
+    }
+    if (sink == Sink::Pipe)
+    {
+        pclose(stream);
+    }
+    else if (stream == stdout)
+    {
+        fflush(stdout);
+    }
+    else
+    {
+        fclose(stream);
+    }
+    stream = nullptr;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "synchronization2.h"
+
+// 把swap chain image拷贝到一组HOST_VISIBLE的readback buffer中，不在渲染线程上等待：
+// 拷贝随本帧的command buffer执行，该frame slot的fence signal之后(几帧之后)才交给写入线程，
+// 写入线程转换为RGBA8后编码为PNG，或者把原始帧写到文件/管道
+// 所有buffer都在等待写入时跳过新的帧(计入dropped)，而不是阻塞渲染
+class FrameCapture
+{
+public:
+    struct Config
+    {
+        // png:<path>      每帧一张PNG，path中可以用printf格式(例如frame_%05d.png)插入帧号
+        // raw:<path>      连续的RGBA8帧写入文件或命名管道，"-"为stdout
+        // pipe:<command>  连续的RGBA8帧写入command的stdin(例如ffmpeg -f rawvideo ...)
+        std::string target;
+        // 从第几帧开始捕获
+        uint64_t firstFrame = 0;
+        // 捕获的帧数，0表示一直捕获
+        uint32_t frameCount = 0;
+        // readback buffer的数量，多于frames in flight的部分给写入线程留出时间
+        uint32_t bufferCount = 4;
+        // 保留最后写入的一帧，用于与golden image比较
+        bool keepLastFrame = false;
+    };
+
+    struct Stats
+    {
+        uint64_t recorded = 0;
+        uint64_t written = 0;
+        uint64_t dropped = 0;
+        double averageWriteMs = 0.0;
+    };
+
+    ~FrameCapture();
+
+    // target格式错误时抛出std::runtime_error
+    void setConfig(const Config &config);
+    bool enabled() const { return sink != Sink::None; }
+
+    // synchronization需要在stop之前一直有效
+    void start(VkDevice device, const Synchronization2 &synchronization, const VkPhysicalDeviceMemoryProperties &memoryProperties, uint32_t frameSlots);
+    // swap chain(重新)创建之后调用，此时设备必须空闲；格式不支持时返回false，本swap chain上不再捕获
+    // format为VK_FORMAT_UNDEFINED表示swap chain image不能被拷贝
+    bool resize(VkExtent2D extent, VkFormat format);
+    // 写完所有帧、关闭输出并销毁buffer，设备必须空闲
+    void stop();
+
+    bool wantsFrame(uint64_t frame) const;
+    // 捕获了frameCount帧并且全部写完
+    bool finished() const;
+
+    // 在image的最后一次写入之后录制：oldLayout -> TRANSFER_SRC，拷贝，再转为newLayout(通常为PRESENT_SRC)
+    // 没有空闲buffer时不录制任何命令并返回false，调用方需要自己完成layout转换
+    bool recordCopy(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint64_t frame, VkImage image,
+        VkImageLayout oldLayout, VkImageLayout newLayout);
+    // frameSlot的fence signal之后调用
+    void frameCompleted(uint32_t frameSlot);
+
+    Stats stats() const;
+    // keepLastFrame时有效，RGBA8
+    std::vector<uint8_t> lastFrame(uint32_t &width, uint32_t &height) const;
+
+private:
+    enum class Sink
+    {
+        None,
+        Png,
+        Raw,
+        Pipe,
+    };
+
+    enum class BufferState
+    {
+        Free,
+        InFlight,
+        Writing,
+    };
+
+    struct ReadbackBuffer
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        const uint8_t *mapped = nullptr;
+        bool coherent = false;
+        BufferState state = BufferState::Free;
+        uint64_t frame = 0;
+    };
+
+    struct Job
+    {
+        uint32_t buffer;
+        uint64_t frame;
+    };
+
+    void createBuffers();
+    void destroyBuffers();
+    // 交出所有已完成的拷贝并等待写入线程处理完
+    void drain();
+    void writerLoop();
+    void writeFrame(const ReadbackBuffer &buffer, uint64_t frame);
+    void openStream();
+    void closeStream();
+
+    Config config;
+    Sink sink = Sink::None;
+    std::string path;
+
+    VkDevice device = VK_NULL_HANDLE;
+    const Synchronization2 *synchronization = nullptr;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    VkExtent2D extent{};
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    bool swizzle = false;
+    bool formatSupported = false;
+
+    std::vector<ReadbackBuffer> buffers;
+    // 每个frame slot本帧使用的buffer，UINT32_MAX表示没有
+    std::vector<uint32_t> slotBuffers;
+
+    // buffers的state、jobs与统计由mutex保护
+    mutable std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobDone;
+    std::deque<Job> jobs;
+    bool writing = false;
+    bool stopWriter = false;
+    std::thread writer;
+    FILE *stream = nullptr;
+    Stats counters;
+    double totalWriteMs = 0.0;
+    std::vector<uint8_t> rgba;
+    std::vector<uint8_t> keptFrame;
+    VkExtent2D keptExtent{};
+};
@@ -0,0 +1,556 @@
+#include "frame_metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using SocketHandle = SOCKET;
+#define closeSocket closesocket
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using SocketHandle = int;
+const SocketHandle INVALID_SOCKET = -1;
+#define closeSocket close
+#endif
+
+namespace
+{
+    const char *const statisticNames[pipelineStatisticCount] = {
+        "vertex_invocations",
+        "clipping_invocations",
+        "clipping_primitives",
+        "fragment_invocations",
+        "compute_invocations",
+    };
+
+    bool startsWith(const std::string &text, const char *prefix)
+    {
+        return text.compare(0, strlen(prefix), prefix) == 0;
+    }
+
+    // 每秒一行每帧的平均值，峰值取窗口中最大的一帧
+    class StdoutMetricsSink : public MetricsSink
+    {
+    public:
+        void write(const FrameMetricsSample &sample) override
+        {
+            auto now = std::chrono::steady_clock::now();
+            if (frames == 0)
+            {
+                windowStart = now;
+            }
+            frames++;
+            gpuMs += sample.gpuMs;
+            for (uint32_t i = 0; i < apiCallCount; i++)
+            {
+                calls[i] += sample.calls.calls[i];
+                peakCalls[i] = std::max(peakCalls[i], sample.calls.calls[i]);
+            }
+            passCount = sample.passCount;
+            for (uint32_t pass = 0; pass < sample.passCount; pass++)
+            {
+                passNames[pass] = sample.passNames[pass];
+                if (!sample.passMeasured[pass])
+                {
+                    continue;
+                }
+                passFrames[pass]++;
+                for (uint32_t i = 0; i < pipelineStatisticCount; i++)
+                {
+                    statistics[pass][i] += sample.passes[pass].values[i];
+                }
+            }
+            if (now - windowStart < std::chrono::seconds(1))
+            {
+                return;
+            }
+
+            printf("Metrics | %u frames | gpu %.2f ms", frames, gpuMs / frames);
+            for (uint32_t i = 0; i < apiCallCount; i++)
+            {
+                if (peakCalls[i] > 0)
+                {
+                    printf(" | %s %.1f (peak %llu)", apiCallName(static_cast<ApiCall>(i)), static_cast<double>(calls[i]) / frames,
+                        static_cast<unsigned long long>(peakCalls[i]));
+                }
+            }
+            for (uint32_t pass = 0; pass < passCount; pass++)
+            {
+                if (passFrames[pass] == 0)
+                {
+                    continue;
+                }
+                printf(" | %s:", passNames[pass]);
+                for (uint32_t i = 0; i < pipelineStatisticCount; i++)
+                {
+                    printf(" %s %.0f", statisticNames[i], static_cast<double>(statistics[pass][i]) / passFrames[pass]);
+                }
+            }
+            printf("\n");
+            fflush(stdout);
+
+            frames = 0;
+            gpuMs = 0.0;
+            memset(calls, 0, sizeof(calls));
+            memset(peakCalls, 0, sizeof(peakCalls));
+            memset(passFrames, 0, sizeof(passFrames));
+            memset(statistics, 0, sizeof(statistics));
+        }
+
+    private:
+        std::chrono::steady_clock::time_point windowStart{};
+        uint32_t frames = 0;
+        double gpuMs = 0.0;
+        uint64_t calls[apiCallCount] = {};
+        uint64_t peakCalls[apiCallCount] = {};
+        uint32_t passCount = 0;
+        const char *passNames[FrameMetricsSample::maxPasses] = {};
+        uint32_t passFrames[FrameMetricsSample::maxPasses] = {};
+        uint64_t statistics[FrameMetricsSample::maxPasses][pipelineStatisticCount] = {};
+    };
+
+    // 列在第一帧确定：frame、gpu_ms、每种命令、每个pass的每种统计；没有测量的pass留空
+    class CsvMetricsSink : public MetricsSink
+    {
+    public:
+        explicit CsvMetricsSink(const std::string &path)
+        {
+            file = fopen(path.c_str(), "w");
+            if (file == nullptr)
+            {
+                throw std::runtime_error("=====Failed to open metrics file: " + path + "=====");
+            }
+        }
+
+        ~CsvMetricsSink() override
+        {
+            fclose(file);
+        }
+
+        void write(const FrameMetricsSample &sample) override
+        {
+            if (!headerWritten)
+            {
+                headerWritten = true;
+                passCount = sample.passCount;
+                fprintf(file, "frame,gpu_ms");
+                for (uint32_t i = 0; i < apiCallCount; i++)
+                {
+                    fprintf(file, ",%s", apiCallName(static_cast<ApiCall>(i)));
+                }
+                for (uint32_t pass = 0; pass < passCount; pass++)
+                {
+                    for (uint32_t i = 0; i < pipelineStatisticCount; i++)
+                    {
+                        fprintf(file, ",%s_%s", sample.passNames[pass], statisticNames[i]);
+                    }
+                }
+                fprintf(file, "\n");
+            }
+
+            fprintf(file, "%llu,%.4f", static_cast<unsigned long long>(sample.frame), sample.gpuMs);
+            for (uint32_t i = 0; i < apiCallCount; i++)
+            {
+                fprintf(file, ",%llu", static_cast<unsigned long long>(sample.calls.calls[i]));
+            }
+            for (uint32_t pass = 0; pass < passCount; pass++)
+            {
+                for (uint32_t i = 0; i < pipelineStatisticCount; i++)
+                {
+                    if (pass < sample.passCount && sample.passMeasured[pass])
+                    {
+                        fprintf(file, ",%llu", static_cast<unsigned long long>(sample.passes[pass].values[i]));
+                    }
+                    else
+                    {
+                        fprintf(file, ",");
+                    }
+                }
+            }
+            fprintf(file, "\n");
+        }
+
+    private:
+        FILE *file = nullptr;
+        bool headerWritten = false;
+        uint32_t passCount = 0;
+    };
+
+    // 后台线程在127.0.0.1上响应任意HTTP请求；渲染线程只在锁内拷贝最后一帧与累计值
+    class PrometheusMetricsSink : public MetricsSink
+    {
+    public:
+        explicit PrometheusMetricsSink(uint16_t port)
+        {
+#ifdef _WIN32
+            WSADATA data;
+            if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+            {
+                throw std::runtime_error("=====Failed to initialize Winsock!=====");
+            }
+#endif
+            listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            if (listener == INVALID_SOCKET)
+            {
+                cleanupSockets();
+                throw std::runtime_error("=====Failed to create metrics socket!=====");
+            }
+            int reuse = 1;
+            setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+            //只监听本机，不把指标暴露到网络上
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 || listen(listener, 4) != 0)
+            {
+                closeSocket(listener);
+                cleanupSockets();
+                throw std::runtime_error("=====Failed to listen on metrics port " + std::to_string(port) + "=====");
+            }
+            server = std::thread(&PrometheusMetricsSink::serverLoop, this);
+        }
+
+        ~PrometheusMetricsSink() override
+        {
+            stop = true;
+            server.join();
+            closeSocket(listener);
+            cleanupSockets();
+        }
+
+        void write(const FrameMetricsSample &sample) override
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            latest = sample;
+            frames++;
+            for (uint32_t i = 0; i < apiCallCount; i++)
+            {
+                callTotals[i] += sample.calls.calls[i];
+            }
+            for (uint32_t pass = 0; pass < sample.passCount; pass++)
+            {
+                if (!sample.passMeasured[pass])
+                {
+                    continue;
+                }
+                for (uint32_t i = 0; i < pipelineStatisticCount; i++)
+                {
+                    statisticTotals[pass][i] += sample.passes[pass].values[i];
+                }
+            }
+        }
+
+    private:
+        static void cleanupSockets()
+        {
+#ifdef _WIN32
+            WSACleanup();
+#endif
+        }
+
+        void serverLoop()
+        {
+            //超时后检查一次是否需要退出
+            while (!stop)
+            {
+                fd_set readable;
+                FD_ZERO(&readable);
+                FD_SET(listener, &readable);
+                timeval timeout{0, 100 * 1000};
+                if (select(static_cast<int>(listener + 1), &readable, nullptr, nullptr, &timeout) <= 0)
+                {
+                    continue;
+                }
+                SocketHandle client = accept(listener, nullptr, nullptr);
+                if (client == INVALID_SOCKET)
+                {
+                    continue;
+                }
+                //请求的内容不影响响应，读掉请求头即可；客户端一秒内没有发送就放弃
+                FD_ZERO(&readable);
+                FD_SET(client, &readable);
+                timeval requestTimeout{1, 0};
+                if (select(static_cast<int>(client + 1), &readable, nullptr, nullptr, &requestTimeout) > 0)
+                {
+                    char request[1024];
+                    recv(client, request, sizeof(request), 0);
+                    std::string body = format();
+                    std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                                           std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+                    size_t sent = 0;
+                    while (sent < response.size())
+                    {
+                        int result = send(client, response.data() + sent, static_cast<int>(response.size() - sent), 0);
+                        if (result <= 0)
+                        {
+                            break;
+                        }
+                        sent += static_cast<size_t>(result);
+                    }
+                }
+                closeSocket(client);
+            }
+        }
+
+        std::string format()
+        {
+            FrameMetricsSample sample;
+            uint64_t frameTotal;
+            uint64_t calls[apiCallCount];
+            uint64_t statistics[FrameMetricsSample::maxPasses][pipelineStatisticCount];
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                sample = latest;
+                frameTotal = frames;
+                memcpy(calls, callTotals, sizeof(calls));
+                memcpy(statistics, statisticTotals, sizeof(statistics));
+            }
+
+            std::string text;
+            char line[256];
+            auto append = [&](const char *format, auto... values) {
+                snprintf(line, sizeof(line), format, values...);
+                text += line;
+            };
+            append("# HELP kutory_frames_total Frames whose metrics have been collected.\n# TYPE kutory_frames_total counter\n");
+            append("kutory_frames_total %llu\n", static_cast<unsigned long long>(frameTotal));
+            append("# HELP kutory_frame_gpu_ms GPU time of the last collected frame.\n# TYPE kutory_frame_gpu_ms gauge\n");
+            append("kutory_frame_gpu_ms %.4f\n", sample.gpuMs);
+            append("# HELP kutory_frame_api_calls Vulkan commands recorded or submitted in the last collected frame.\n"
+                   "# TYPE kutory_frame_api_calls gauge\n");
+            for (uint32_t i = 0; i < apiCallCount; i++)
+            {
+                append("kutory_frame_api_calls{call=\"%s\"} %llu\n", apiCallName(static_cast<ApiCall>(i)),
+                    static_cast<unsigned long long>(sample.calls.calls[i]));
+            }
+            append("# HELP kutory_api_calls_total Vulkan commands recorded or submitted.\n# TYPE kutory_api_calls_total counter\n");
+            for (uint32_t i = 0; i < apiCallCount; i++)
+            {
+                append("kutory_api_calls_total{call=\"%s\"} %llu\n", apiCallName(static_cast<ApiCall>(i)), static_cast<unsigned long long>(calls[i]));
+            }
+            append("# HELP kutory_pass_pipeline_statistic Pipeline statistics of each pass in the last collected frame.\n"
+                   "# TYPE kutory_pass_pipeline_statistic gauge\n");
+            for (uint32_t pass = 0; pass < sample.passCount; pass++)
+            {
+                for (uint32_t i = 0; sample.passMeasured[pass] && i < pipelineStatisticCount; i++)
+                {
+                    append("kutory_pass_pipeline_statistic{pass=\"%s\",statistic=\"%s\"} %llu\n", sample.passNames[pass], statisticNames[i],
+                        static_cast<unsigned long long>(sample.passes[pass].values[i]));
+                }
+            }
+            append("# HELP kutory_pass_pipeline_statistics_total Pipeline statistics of each pass.\n"
+                   "# TYPE kutory_pass_pipeline_statistics_total counter\n");
+            for (uint32_t pass = 0; pass < sample.passCount; pass++)
+            {
+                for (uint32_t i = 0; i < pipelineStatisticCount; i++)
+                {
+                    append("kutory_pass_pipeline_statistics_total{pass=\"%s\",statistic=\"%s\"} %llu\n", sample.passNames[pass], statisticNames[i],
+                        static_cast<unsigned long long>(statistics[pass][i]));
+                }
+            }
+            return text;
+        }
+
+        SocketHandle listener = INVALID_SOCKET;
+        std::thread server;
+        std::atomic<bool> stop{false};
+
+        std::mutex mutex;
+        FrameMetricsSample latest;
+        uint64_t frames = 0;
+        uint64_t callTotals[apiCallCount] = {};
+        uint64_t statisticTotals[FrameMetricsSample::maxPasses][pipelineStatisticCount] = {};
+    };
+}
+
+const char *pipelineStatisticName(PipelineStatistic statistic)
+{
+    uint32_t index = static_cast<uint32_t>(statistic);
+    return index < pipelineStatisticCount ? statisticNames[index] : "unknown";
+}
+
+std::unique_ptr<MetricsSink> createMetricsSink(const std::string &target)
+{
+    if (target == "stdout")
+    {
+        return std::make_unique<StdoutMetricsSink>();
+    }
+    if (startsWith(target, "csv:") && target.size() > 4)
+    {
+        return std::make_unique<CsvMetricsSink>(target.substr(4));
+    }
+    if (startsWith(target, "prometheus:"))
+    {
+        char *end = nullptr;
+        unsigned long port = strtoul(target.c_str() + 11, &end, 10);
+        if (end != target.c_str() + 11 && *end == '\0' && port > 0 && port <= 65535)
+        {
+            return std::make_unique<PrometheusMetricsSink>(static_cast<uint16_t>(port));
+        }
+    }
+    throw std::runtime_error("=====Invalid metrics target: " + target + " (expected stdout, csv:<path> or prometheus:<port>)=====");
+}
+
+void FrameMetrics::setTargets(const std::string &targets)
+{
+    size_t start = 0;
+    while (start < targets.size())
+    {
+        size_t comma = targets.find(',', start);
+        if (comma == std::string::npos)
+        {
+            comma = targets.size();
+        }
+        if (comma > start)
+        {
+            addSink(createMetricsSink(targets.substr(start, comma - start)));
+        }
+        start = comma + 1;
+    }
+}
+
+void FrameMetrics::addSink(std::unique_ptr<MetricsSink> sink)
+{
+    sinks.push_back(std::move(sink));
+}
+
+uint32_t FrameMetrics::addPass(const char *name)
+{
+    if (passNames.size() >= FrameMetricsSample::maxPasses)
+    {
+        throw std::runtime_error("=====Too many metrics passes!=====");
+    }
+    passNames.push_back(name);
+    return static_cast<uint32_t>(passNames.size() - 1);
+}
+
+VkQueryPipelineStatisticFlags FrameMetrics::statisticFlags() const
+{
+    return VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+           VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+           VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+}
+
+void FrameMetrics::create(VkDevice device, bool pipelineStatistics, uint32_t frameSlots)
+{
+    this->device = device;
+    slots.assign(frameSlots, Slot{});
+    for (Slot &slot : slots)
+    {
+        slot.sample.passCount = static_cast<uint32_t>(passNames.size());
+        std::copy(passNames.begin(), passNames.end(), slot.sample.passNames);
+    }
+    if (!pipelineStatistics || passNames.empty())
+    {
+        return;
+    }
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    queryPoolInfo.queryCount = frameSlots * FrameMetricsSample::maxPasses;
+    queryPoolInfo.pipelineStatistics = statisticFlags();
+    if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create pipeline statistics query pool!=====");
+    }
+}
+
+void FrameMetrics::destroy()
+{
+    if (queryPool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(device, queryPool, nullptr);
+        queryPool = VK_NULL_HANDLE;
+    }
+    slots.clear();
+    sinks.clear();
+}
+
+void FrameMetrics::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot)
+{
+    if (!enabled())
+    {
+        return;
+    }
+    Slot &slot = slots[frameSlot];
+    std::fill(std::begin(slot.passRecorded), std::end(slot.passRecorded), false);
+    if (queryPool != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(commandBuffer, queryPool, frameSlot * FrameMetricsSample::maxPasses, FrameMetricsSample::maxPasses);
+    }
+}
+
+void FrameMetrics::beginPass(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint32_t pass)
+{
+    if (queryPool == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    vkCmdBeginQuery(commandBuffer, queryPool, frameSlot * FrameMetricsSample::maxPasses + pass, 0);
+    slots[frameSlot].passRecorded[pass] = true;
+}
+
+void FrameMetrics::endPass(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint32_t pass)
+{
+    if (queryPool == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    vkCmdEndQuery(commandBuffer, queryPool, frameSlot * FrameMetricsSample::maxPasses + pass);
+}
+
+void FrameMetrics::endFrame(uint32_t frameSlot, uint64_t frame, const ApiCallCounts &calls)
+{
+    if (!enabled())
+    {
+        return;
+    }
+    Slot &slot = slots[frameSlot];
+    slot.pending = true;
+    slot.sample.frame = frame;
+    slot.sample.calls = calls;
+}
+
+void FrameMetrics::frameCompleted(uint32_t frameSlot, double gpuMs)
+{
+    if (!enabled() || !slots[frameSlot].pending)
+    {
+        return;
+    }
+    Slot &slot = slots[frameSlot];
+    slot.pending = false;
+    slot.sample.gpuMs = gpuMs;
+    //fence已经signal，结果可用，不需要WAIT
+    for (uint32_t pass = 0; pass < slot.sample.passCount; pass++)
+    {
+        PipelineStatistics &statistics = slot.sample.passes[pass];
+        slot.sample.passMeasured[pass] = slot.passRecorded[pass] &&
+            vkGetQueryPoolResults(device, queryPool, frameSlot * FrameMetricsSample::maxPasses + pass, 1, sizeof(statistics.values),
+                statistics.values, sizeof(statistics.values), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+        if (!slot.sample.passMeasured[pass])
+        {
+            statistics = PipelineStatistics{};
+        }
+    }
+    for (auto &sink : sinks)
+    {
+        sink->write(slot.sample);
+    }
+}
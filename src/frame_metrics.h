@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "api_call_counter.h"
+
+// 与VK_QUERY_TYPE_PIPELINE_STATISTICS的结果顺序一致(按统计位从低到高)
+enum class PipelineStatistic : uint32_t
+{
+    VertexInvocations,
+    ClippingInvocations,
+    ClippingPrimitives,
+    FragmentInvocations,
+    ComputeInvocations,
+    Count,
+};
+
+const uint32_t pipelineStatisticCount = static_cast<uint32_t>(PipelineStatistic::Count);
+
+// 小写下划线形式，用作CSV列名与Prometheus的标签
+const char *pipelineStatisticName(PipelineStatistic statistic);
+
+struct PipelineStatistics
+{
+    uint64_t values[pipelineStatisticCount] = {};
+
+    uint64_t operator[](PipelineStatistic statistic) const { return values[static_cast<uint32_t>(statistic)]; }
+};
+
+// 一帧的指标，GPU部分在该帧的fence signal之后读回
+struct FrameMetricsSample
+{
+    static const uint32_t maxPasses = 4;
+
+    uint64_t frame = 0;
+    // 没有timestamp query时为0
+    double gpuMs = 0.0;
+    // 本帧drawFrame中录制与提交的命令
+    ApiCallCounts calls;
+    uint32_t passCount = 0;
+    // FrameMetrics::addPass传入的名称
+    const char *passNames[maxPasses] = {};
+    // 设备不支持pipeline statistics或该pass本帧没有执行时为false
+    bool passMeasured[maxPasses] = {};
+    PipelineStatistics passes[maxPasses];
+};
+
+// 指标的输出目标；write在渲染线程上每帧调用一次，不能阻塞，也不能在稳定运行时分配内存
+class MetricsSink
+{
+public:
+    virtual ~MetricsSink() = default;
+    virtual void write(const FrameMetricsSample &sample) = 0;
+};
+
+// stdout             每秒输出一次每帧的平均值与峰值
+// csv:<path>         每帧一行，第一行为列名，便于CI比较每帧的工作量
+// prometheus:<port>  在127.0.0.1:<port>上以Prometheus文本格式提供最后一帧的数值与累计值
+// 格式错误或无法打开时抛出std::runtime_error
+std::unique_ptr<MetricsSink> createMetricsSink(const std::string &target);
+
+// 每帧的工作量：每个pass一个pipeline statistics query，加上ApiCallScope统计的命令数，一起交给所有sink
+// 与timestamp一样按frame slot保存，fence signal之后读回，不在渲染线程上等待GPU
+class FrameMetrics
+{
+public:
+    // targets为逗号分隔的createMetricsSink格式，为空时不启用
+    void setTargets(const std::string &targets);
+    void addSink(std::unique_ptr<MetricsSink> sink);
+    bool enabled() const { return !sinks.empty(); }
+
+    // 在create之前登记，返回pass编号；name需要一直有效
+    uint32_t addPass(const char *name);
+    // pipelineStatistics为false(设备没有启用pipelineStatisticsQuery)时只输出命令数与GPU时间
+    void create(VkDevice device, bool pipelineStatistics, uint32_t frameSlots);
+    // 关闭所有sink，设备必须空闲
+    void destroy();
+
+    bool measuresPipelineStatistics() const { return queryPool != VK_NULL_HANDLE; }
+    // 在pass中执行的secondary command buffer需要在inheritance中声明这些统计
+    VkQueryPipelineStatisticFlags statisticFlags() const;
+
+    // 在command buffer开头、任何pass之前调用
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot);
+    // 每个pass每帧最多一次，pass之间不能嵌套；在render pass之外begin/end，或者在同一个subpass中
+    void beginPass(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint32_t pass);
+    void endPass(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint32_t pass);
+    // 本帧提交与present之后调用
+    void endFrame(uint32_t frameSlot, uint64_t frame, const ApiCallCounts &calls);
+    // frameSlot的fence signal之后调用，读回pipeline statistics并交给所有sink
+    void frameCompleted(uint32_t frameSlot, double gpuMs);
+
+private:
+    struct Slot
+    {
+        bool pending = false;
+        bool passRecorded[FrameMetricsSample::maxPasses] = {};
+        FrameMetricsSample sample;
+    };
+
+    std::vector<std::unique_ptr<MetricsSink>> sinks;
+    std::vector<const char *> passNames;
+
+    VkDevice device = VK_NULL_HANDLE;
+    // 每个slot maxPasses个query
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    std::vector<Slot> slots;
+};
@@ -0,0 +1,135 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+    // 滑动平均的权重，越小越平滑
+    const double estimateWeight = 0.1;
+    // 预测误差的安全余量，防止醒得太晚让GPU空转
+    const double wakeMarginMs = 0.5;
+    // 系统sleep精度有限，最后这段时间改为yield自旋
+    const auto spinThreshold = std::chrono::microseconds(1500);
+
+    FramePacer::Clock::duration toDuration(double milliseconds)
+    {
+        return std::chrono::duration_cast<FramePacer::Clock::duration>(std::chrono::duration<double, std::milli>(milliseconds));
+    }
+
+    double toMilliseconds(FramePacer::Clock::duration duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    void accumulate(double &estimate, double sample)
+    {
+        estimate = estimate == 0.0 ? sample : estimate + (sample - estimate) * estimateWeight;
+    }
+}
+
+void FramePacer::setFrameLimit(double fps)
+{
+    minFrameInterval = fps > 0.0 ? toDuration(1000.0 / fps) : Clock::duration{0};
+}
+
+FramePacer::Clock::time_point FramePacer::predictWakeTime() const
+{
+    if (!hasHistory)
+    {
+        return Clock::time_point{};
+    }
+
+    Clock::time_point wake = lastFrameStart + minFrameInterval;
+    if (lowLatency)
+    {
+        //下一帧的GPU工作最早在上一帧GPU完成后开始，提前"CPU耗时+余量"醒来即可
+        Clock::time_point justInTime = predictedGpuEnd - toDuration(cpuEstimateMs + wakeMarginMs);
+        wake = std::max(wake, justInTime);
+    }
+    return wake;
+}
+
+FramePacer::Clock::time_point FramePacer::beginFrame()
+{
+    Clock::time_point before = Clock::now();
+    Clock::time_point wake = predictWakeTime();
+    if (wake > before)
+    {
+        sleepUntil(wake);
+    }
+
+    frameStart = Clock::now();
+    statsSleepMs += toMilliseconds(frameStart - before);
+    if (statsWindowStart == Clock::time_point{})
+    {
+        statsWindowStart = frameStart;
+    }
+    return frameStart;
+}
+
+void FramePacer::endFrame()
+{
+    Clock::time_point now = Clock::now();
+    double cpuMs = toMilliseconds(now - frameStart);
+    accumulate(cpuEstimateMs, cpuMs);
+
+    //GPU忙时新提交的帧要排在上一帧之后
+    Clock::time_point gpuStart = hasHistory ? std::max(now, predictedGpuEnd) : now;
+    predictedGpuEnd = gpuStart + toDuration(gpuEstimateMs);
+
+    lastFrameStart = frameStart;
+    hasHistory = true;
+
+    statsFrames++;
+    statsCpuMs += cpuMs;
+}
+
+void FramePacer::reportGpuTime(double milliseconds)
+{
+    accumulate(gpuEstimateMs, milliseconds);
+    statsGpuMs += milliseconds;
+    statsGpuSamples++;
+}
+
+void FramePacer::reportLatency(double milliseconds)
+{
+    statsLatencyMs += milliseconds;
+    statsLatencySamples++;
+}
+
+bool FramePacer::pollStats(Stats &stats)
+{
+    Clock::time_point now = Clock::now();
+    double windowMs = toMilliseconds(now - statsWindowStart);
+    if (statsFrames == 0 || windowMs < 1000.0)
+    {
+        return false;
+    }
+
+    stats.fps = statsFrames * 1000.0 / windowMs;
+    stats.cpuMs = statsCpuMs / statsFrames;
+    stats.gpuMs = statsGpuSamples > 0 ? statsGpuMs / statsGpuSamples : 0.0;
+    stats.sleepMs = statsSleepMs / statsFrames;
+    stats.latencyMs = statsLatencySamples > 0 ? statsLatencyMs / statsLatencySamples : 0.0;
+    stats.latencySamples = statsLatencySamples;
+
+    statsWindowStart = now;
+    statsFrames = 0;
+    statsCpuMs = statsGpuMs = statsSleepMs = statsLatencyMs = 0.0;
+    statsGpuSamples = statsLatencySamples = 0;
+    return true;
+}
+
+void FramePacer::sleepUntil(Clock::time_point target)
+{
+    Clock::time_point now = Clock::now();
+    if (target - now > spinThreshold)
+    {
+        std::this_thread::sleep_until(target - spinThreshold);
+    }
+    while (Clock::now() < target)
+    {
+        std::this_thread::yield();
+    }
+}
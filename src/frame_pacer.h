@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// 帧节奏控制：限制帧率，并在低延迟模式下把CPU的帧开始推迟到
+// "预测的GPU开始时间 - 预计CPU耗时"附近，让输入采样尽量靠近GPU真正开始渲染的时刻
+// 不依赖Vulkan，耗时数据由调用方通过timestamp query/present wait提供
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats
+    {
+        double fps = 0.0;
+        double cpuMs = 0.0;     // 帧开始到提交的CPU耗时
+        double gpuMs = 0.0;     // GPU执行耗时(timestamp)
+        double sleepMs = 0.0;   // 每帧限制器睡眠的平均时间
+        double latencyMs = 0.0; // 输入采样到显示(或GPU完成)的平均延迟
+        uint32_t latencySamples = 0;
+    };
+
+    void setFrameLimit(double fps);
+    void setLowLatency(bool enabled) { lowLatency = enabled; }
+
+    // 在采样输入(glfwPollEvents)之前调用，必要时睡眠，返回本帧开始(输入采样)时间
+    Clock::time_point beginFrame();
+    // 本帧命令提交到队列之后调用
+    void endFrame();
+
+    void reportGpuTime(double milliseconds);
+    void reportLatency(double milliseconds);
+
+    // 预测中下一帧应当醒来的时间点，仅供调试与测试
+    Clock::time_point predictWakeTime() const;
+
+    // 每隔一秒返回一次累计统计
+    bool pollStats(Stats &stats);
+
+private:
+    static void sleepUntil(Clock::time_point target);
+
+    Clock::duration minFrameInterval{0};
+    bool lowLatency = false;
+
+    Clock::time_point frameStart{};
+    Clock::time_point lastFrameStart{};
+    // 预测的上一帧GPU完成时间，即下一帧最早可以开始执行的时间
+    Clock::time_point predictedGpuEnd{};
+    bool hasHistory = false;
+
+    // 指数滑动平均的估计值(毫秒)
+    double cpuEstimateMs = 0.0;
+    double gpuEstimateMs = 0.0;
+
+    // 统计窗口
+    Clock::time_point statsWindowStart{};
+    uint32_t statsFrames = 0;
+    double statsCpuMs = 0.0;
+    double statsGpuMs = 0.0;
+    uint32_t statsGpuSamples = 0;
+    double statsSleepMs = 0.0;
+    double statsLatencyMs = 0.0;
+    uint32_t statsLatencySamples = 0;
+};
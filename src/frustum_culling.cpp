@@ -0,0 +1,450 @@
+#include "frustum_culling.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KUTORY_CULLING_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define KUTORY_CULLING_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC/Clang需要为AVX2函数单独打开指令集，其余部分仍按基础指令集编译
+#if defined(KUTORY_CULLING_X86) && (defined(__GNUC__) || defined(__clang__))
+#define KUTORY_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define KUTORY_TARGET_AVX2
+#endif
+
+namespace
+{
+    // 每块的对象数，必须是64的倍数，保证各线程写入不同的word
+    const size_t chunkSize = 16384;
+
+    inline uint32_t countBits(uint64_t bits)
+    {
+#ifdef _MSC_VER
+        return static_cast<uint32_t>(__popcnt64(bits));
+#else
+        return static_cast<uint32_t>(__builtin_popcountll(bits));
+#endif
+    }
+
+    inline bool sphereVisible(const Frustum &frustum, float x, float y, float z, float radius)
+    {
+        for (const auto &plane : frustum.planes)
+        {
+            if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < -radius)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 向量部分处理不完的尾部用标量补齐，返回[index, end)的可见位
+    inline uint64_t cullTail(const Frustum &frustum, const SphereArrays &spheres, size_t index, size_t end, uint32_t shift)
+    {
+        uint64_t bits = 0;
+        for (; index < end; index++, shift++)
+        {
+            if (sphereVisible(frustum, spheres.x[index], spheres.y[index], spheres.z[index], spheres.radius[index]))
+            {
+                bits |= uint64_t(1) << shift;
+            }
+        }
+        return bits;
+    }
+
+    size_t cullScalar(const Frustum &frustum, const SphereArrays &spheres, size_t begin, size_t end, uint64_t *visibleBits)
+    {
+        size_t visible = 0;
+        for (size_t word = begin; word < end; word += 64)
+        {
+            uint64_t bits = cullTail(frustum, spheres, word, std::min(word + 64, end), 0);
+            visibleBits[word / 64] = bits;
+            visible += countBits(bits);
+        }
+        return visible;
+    }
+
+#ifdef KUTORY_CULLING_X86
+    // SSE2是x86-64的基础指令集，没有FMA，一次处理两组4个对象
+    size_t cullSse(const Frustum &frustum, const SphereArrays &spheres, size_t begin, size_t end, uint64_t *visibleBits)
+    {
+        __m128 planes[6][4];
+        for (int p = 0; p < 6; p++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+            }
+        }
+
+        size_t visible = 0;
+        for (size_t word = begin; word < end; word += 64)
+        {
+            size_t wordEnd = std::min(word + 64, end);
+            uint64_t bits = 0;
+            size_t i = word;
+            for (; i + 8 <= wordEnd; i += 8)
+            {
+                uint32_t mask = 0;
+                for (size_t half = 0; half < 8; half += 4)
+                {
+                    __m128 x = _mm_loadu_ps(spheres.x + i + half);
+                    __m128 y = _mm_loadu_ps(spheres.y + i + half);
+                    __m128 z = _mm_loadu_ps(spheres.z + i + half);
+                    __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(spheres.radius + i + half));
+                    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                    for (int p = 0; p < 6; p++)
+                    {
+                        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+                            _mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+                        inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+                    }
+                    mask |= static_cast<uint32_t>(_mm_movemask_ps(inside)) << half;
+                }
+                bits |= uint64_t(mask) << (i - word);
+            }
+            bits |= cullTail(frustum, spheres, i, wordEnd, static_cast<uint32_t>(i - word));
+            visibleBits[word / 64] = bits;
+            visible += countBits(bits);
+        }
+        return visible;
+    }
+
+    // 8个对象一条指令，每个平面3次FMA加一次比较
+    KUTORY_TARGET_AVX2 size_t cullAvx2(const Frustum &frustum, const SphereArrays &spheres, size_t begin, size_t end, uint64_t *visibleBits)
+    {
+        __m256 planes[6][4];
+        for (int p = 0; p < 6; p++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+            }
+        }
+
+        size_t visible = 0;
+        for (size_t word = begin; word < end; word += 64)
+        {
+            size_t wordEnd = std::min(word + 64, end);
+            uint64_t bits = 0;
+            size_t i = word;
+            for (; i + 8 <= wordEnd; i += 8)
+            {
+                __m256 x = _mm256_loadu_ps(spheres.x + i);
+                __m256 y = _mm256_loadu_ps(spheres.y + i);
+                __m256 z = _mm256_loadu_ps(spheres.z + i);
+                __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(spheres.radius + i));
+                __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+                for (int p = 0; p < 6; p++)
+                {
+                    __m256 distance = _mm256_fmadd_ps(planes[p][0], x,
+                        _mm256_fmadd_ps(planes[p][1], y, _mm256_fmadd_ps(planes[p][2], z, planes[p][3])));
+                    inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+                }
+                bits |= uint64_t(static_cast<uint32_t>(_mm256_movemask_ps(inside))) << (i - word);
+            }
+            bits |= cullTail(frustum, spheres, i, wordEnd, static_cast<uint32_t>(i - word));
+            visibleBits[word / 64] = bits;
+            visible += countBits(bits);
+        }
+        return visible;
+    }
+
+    bool cpuSupportsAvx2()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool fma = (info[2] & (1 << 12)) != 0;
+        //操作系统需要保存YMM寄存器
+        if (!osxsave || !fma || (_xgetbv(0) & 6) != 6)
+        {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    }
+#endif
+
+#ifdef KUTORY_CULLING_NEON
+    // 两组4个对象拼成8位
+    size_t cullNeon(const Frustum &frustum, const SphereArrays &spheres, size_t begin, size_t end, uint64_t *visibleBits)
+    {
+        float32x4_t planes[6][4];
+        for (int p = 0; p < 6; p++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                planes[p][c] = vdupq_n_f32(frustum.planes[p][c]);
+            }
+        }
+        const uint32_t laneBitValues[4] = {1, 2, 4, 8};
+        const uint32x4_t laneBits = vld1q_u32(laneBitValues);
+
+        size_t visible = 0;
+        for (size_t word = begin; word < end; word += 64)
+        {
+            size_t wordEnd = std::min(word + 64, end);
+            uint64_t bits = 0;
+            size_t i = word;
+            for (; i + 8 <= wordEnd; i += 8)
+            {
+                uint32_t mask = 0;
+                for (size_t half = 0; half < 8; half += 4)
+                {
+                    float32x4_t x = vld1q_f32(spheres.x + i + half);
+                    float32x4_t y = vld1q_f32(spheres.y + i + half);
+                    float32x4_t z = vld1q_f32(spheres.z + i + half);
+                    float32x4_t negRadius = vnegq_f32(vld1q_f32(spheres.radius + i + half));
+                    uint32x4_t inside = vdupq_n_u32(0xFFFFFFFFu);
+                    for (int p = 0; p < 6; p++)
+                    {
+                        float32x4_t distance = vfmaq_f32(vfmaq_f32(vfmaq_f32(planes[p][3], planes[p][2], z), planes[p][1], y), planes[p][0], x);
+                        inside = vandq_u32(inside, vcgeq_f32(distance, negRadius));
+                    }
+                    mask |= vaddvq_u32(vandq_u32(inside, laneBits)) << half;
+                }
+                bits |= uint64_t(mask) << (i - word);
+            }
+            bits |= cullTail(frustum, spheres, i, wordEnd, static_cast<uint32_t>(i - word));
+            visibleBits[word / 64] = bits;
+            visible += countBits(bits);
+        }
+        return visible;
+    }
+#endif
+}
+
+Frustum frustumFromMatrix(const float *m)
+{
+    // 列主序：第r行第c列为m[c * 4 + r]
+    Frustum frustum{};
+    for (int c = 0; c < 4; c++)
+    {
+        float x = m[c * 4 + 0];
+        float y = m[c * 4 + 1];
+        float z = m[c * 4 + 2];
+        float w = m[c * 4 + 3];
+        frustum.planes[0][c] = w + x; // left
+        frustum.planes[1][c] = w - x; // right
+        frustum.planes[2][c] = w + y; // bottom
+        frustum.planes[3][c] = w - y; // top
+        frustum.planes[4][c] = z;     // near：Vulkan的深度范围从0开始
+        frustum.planes[5][c] = w - z; // far
+    }
+
+    for (auto &plane : frustum.planes)
+    {
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f)
+        {
+            for (float &value : plane)
+            {
+                value /= length;
+            }
+        }
+    }
+    return frustum;
+}
+
+bool cullingKernelSupported(CullingKernel kernel)
+{
+    switch (kernel)
+    {
+    case CullingKernel::Scalar:
+        return true;
+#ifdef KUTORY_CULLING_X86
+    case CullingKernel::Sse:
+        return true;
+    case CullingKernel::Avx2:
+    {
+        static const bool supported = cpuSupportsAvx2();
+        return supported;
+    }
+#endif
+#ifdef KUTORY_CULLING_NEON
+    case CullingKernel::Neon:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+CullingKernel bestCullingKernel()
+{
+    for (CullingKernel kernel : {CullingKernel::Avx2, CullingKernel::Neon, CullingKernel::Sse})
+    {
+        if (cullingKernelSupported(kernel))
+        {
+            return kernel;
+        }
+    }
+    return CullingKernel::Scalar;
+}
+
+const char *cullingKernelName(CullingKernel kernel)
+{
+    switch (kernel)
+    {
+    case CullingKernel::Scalar:
+        return "scalar";
+    case CullingKernel::Sse:
+        return "sse";
+    case CullingKernel::Avx2:
+        return "avx2";
+    case CullingKernel::Neon:
+        return "neon";
+    }
+    return "unknown";
+}
+
+size_t cullSpheres(CullingKernel kernel, const Frustum &frustum, const SphereArrays &spheres, size_t begin, size_t end, uint64_t *visibleBits)
+{
+    switch (kernel)
+    {
+#ifdef KUTORY_CULLING_X86
+    case CullingKernel::Sse:
+        return cullSse(frustum, spheres, begin, end, visibleBits);
+    case CullingKernel::Avx2:
+        if (cullingKernelSupported(CullingKernel::Avx2))
+        {
+            return cullAvx2(frustum, spheres, begin, end, visibleBits);
+        }
+        return cullSse(frustum, spheres, begin, end, visibleBits);
+#endif
+#ifdef KUTORY_CULLING_NEON
+    case CullingKernel::Neon:
+        return cullNeon(frustum, spheres, begin, end, visibleBits);
+#endif
+    default:
+        return cullScalar(frustum, spheres, begin, end, visibleBits);
+    }
+}
+
+FrustumCuller::FrustumCuller() : kernel(bestCullingKernel())
+{
+    setThreadCount(0);
+}
+
+FrustumCuller::~FrustumCuller()
+{
+    stopWorkers();
+}
+
+void FrustumCuller::setThreadCount(uint32_t count)
+{
+    stopWorkers();
+    threads = count > 0 ? count : std::max(1u, std::thread::hardware_concurrency());
+}
+
+size_t FrustumCuller::cull(const Frustum &frustum, const SphereArrays &spheres, size_t count, std::vector<uint64_t> &visibleBits)
+{
+    visibleBits.resize((count + 63) / 64);
+    if (count == 0)
+    {
+        return 0;
+    }
+    //唤醒工作线程本身有几十微秒的开销，对象少时不值得
+    if (threads <= 1 || count <= chunkSize * 2)
+    {
+        return cullSpheres(kernel, frustum, spheres, 0, count, visibleBits.data());
+    }
+    if (workers.empty())
+    {
+        startWorkers();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobFrustum = frustum;
+        jobSpheres = spheres;
+        jobCount = count;
+        jobBits = visibleBits.data();
+        nextChunk.store(0, std::memory_order_relaxed);
+        visibleCount.store(0, std::memory_order_relaxed);
+        pendingWorkers = static_cast<uint32_t>(workers.size());
+        generation++;
+    }
+    wake.notify_all();
+
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pendingWorkers == 0; });
+    return visibleCount.load(std::memory_order_relaxed);
+}
+
+void FrustumCuller::startWorkers()
+{
+    stopping = false;
+    //调用线程也处理分块，只需要threads - 1个工作线程
+    //起始generation在这里确定，线程启动晚于第一次分发时也不会错过任务
+    for (uint32_t i = 1; i < threads; i++)
+    {
+        workers.emplace_back(&FrustumCuller::workerLoop, this, generation);
+    }
+}
+
+void FrustumCuller::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void FrustumCuller::workerLoop(uint64_t seen)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping)
+        {
+            return;
+        }
+        seen = generation;
+        lock.unlock();
+        runChunks();
+        lock.lock();
+        if (--pendingWorkers == 0)
+        {
+            done.notify_one();
+        }
+    }
+}
+
+void FrustumCuller::runChunks()
+{
+    size_t visible = 0;
+    for (;;)
+    {
+        size_t begin = nextChunk.fetch_add(1, std::memory_order_relaxed) * chunkSize;
+        if (begin >= jobCount)
+        {
+            break;
+        }
+        visible += cullSpheres(kernel, jobFrustum, jobSpheres, begin, std::min(begin + chunkSize, jobCount), jobBits);
+    }
+    visibleCount.fetch_add(visible, std::memory_order_relaxed);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 6个平面(left/right/bottom/top/near/far)，ax + by + cz + d >= 0为内侧，法线已归一化
+struct Frustum
+{
+    float planes[6][4];
+};
+
+// 从列主序(glm布局)的view-projection矩阵提取，clip空间深度为Vulkan的[0, w]
+// reverse-Z只是交换了near与far，提取方式不变
+Frustum frustumFromMatrix(const float *viewProjection);
+
+// 包围球按分量分开存放，每个数组至少count个元素
+struct SphereArrays
+{
+    const float *x = nullptr;
+    const float *y = nullptr;
+    const float *z = nullptr;
+    const float *radius = nullptr;
+};
+
+enum class CullingKernel
+{
+    Scalar,
+    Sse,
+    Avx2,
+    Neon,
+};
+
+// 按运行时检测到的CPU特性选择，AVX2需要CPU与操作系统都支持
+CullingKernel bestCullingKernel();
+bool cullingKernelSupported(CullingKernel kernel);
+const char *cullingKernelName(CullingKernel kernel);
+
+// 测试[begin, end)中的球，可见的对象在visibleBits中置位(第i个对象对应visibleBits[i / 64]的第i % 64位)
+// begin必须是64的倍数，覆盖到的word会被整体写入；返回可见数量
+size_t cullSpheres(CullingKernel kernel, const Frustum &frustum, const SphereArrays &spheres, size_t begin, size_t end, uint64_t *visibleBits);
+
+// 把对象分块分给常驻的工作线程(调用线程也参与)，每块内用SIMD一次测试多个对象
+// 对象较少时直接在调用线程上完成，不唤醒工作线程
+class FrustumCuller
+{
+public:
+    FrustumCuller();
+    ~FrustumCuller();
+
+    // 0表示std::thread::hardware_concurrency()，包括调用线程；需要在第一次cull之前调用
+    void setThreadCount(uint32_t count);
+    uint32_t threadCount() const { return threads; }
+    void setKernel(CullingKernel kernel) { this->kernel = kernel; }
+    CullingKernel activeKernel() const { return kernel; }
+
+    // visibleBits被调整为(count + 63) / 64个word，返回可见数量
+    size_t cull(const Frustum &frustum, const SphereArrays &spheres, size_t count, std::vector<uint64_t> &visibleBits);
+
+private:
+    void startWorkers();
+    void stopWorkers();
+    void workerLoop(uint64_t seen);
+    // 领取并处理分块，直到没有剩余
+    void runChunks();
+
+    CullingKernel kernel;
+    uint32_t threads = 0;
+    std::vector<std::thread> workers;
+
+    // 当前任务，generation变化时工作线程开始领取分块
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    uint32_t pendingWorkers = 0;
+    bool stopping = false;
+
+    Frustum jobFrustum{};
+    SphereArrays jobSpheres;
+    size_t jobCount = 0;
+    uint64_t *jobBits = nullptr;
+    std::atomic<size_t> nextChunk{0};
+    std::atomic<size_t> visibleCount{0};
+};
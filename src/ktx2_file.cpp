@@ -0,0 +1,148 @@
+#include "ktx2_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    const uint8_t ktx2Identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+    // identifier + 9个uint32 + dfd/kvd的4个uint32 + sgd的2个uint64
+    const size_t headerSize = 80;
+    const size_t levelIndexEntrySize = 24;
+
+    // Khronos Data Format里的颜色模型与transfer function
+    const uint8_t dfdModelEtc1s = 163;
+    const uint8_t dfdModelUastc = 166;
+    const uint8_t dfdTransferSrgb = 2;
+    // ETC1S的alpha slice与UASTC的RGBA/RRRG通道编号
+    const uint8_t dfdChannelEtc1sAaa = 15;
+    const uint8_t dfdChannelUastcRgba = 3;
+    const uint8_t dfdChannelUastcRrrg = 5;
+
+    template <typename T>
+    T read(const uint8_t *data, size_t size, size_t offset)
+    {
+        if (offset + sizeof(T) > size)
+        {
+            throw std::runtime_error("=====Truncated KTX2 file!=====");
+        }
+        T value;
+        memcpy(&value, data + offset, sizeof(T));
+        return value;
+    }
+
+    bool formatHasAlpha(VkFormat format)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_R8G8B8_UNORM:
+        case VK_FORMAT_R8G8B8_SRGB:
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+            return false;
+        default:
+            return true;
+        }
+    }
+}
+
+Ktx2File Ktx2File::parse(const uint8_t *data, size_t size)
+{
+    if (size < headerSize || memcmp(data, ktx2Identifier, sizeof(ktx2Identifier)) != 0)
+    {
+        throw std::runtime_error("=====Not a KTX2 file!=====");
+    }
+
+    Ktx2File file;
+    file.vkFormat = static_cast<VkFormat>(read<uint32_t>(data, size, 12));
+    file.pixelWidth = read<uint32_t>(data, size, 20);
+    file.pixelHeight = read<uint32_t>(data, size, 24);
+    uint32_t pixelDepth = read<uint32_t>(data, size, 28);
+    file.layerCount = read<uint32_t>(data, size, 32);
+    file.faceCount = read<uint32_t>(data, size, 36);
+    uint32_t levelCount = read<uint32_t>(data, size, 40);
+    file.supercompression = static_cast<Supercompression>(read<uint32_t>(data, size, 44));
+    uint32_t dfdByteOffset = read<uint32_t>(data, size, 48);
+    uint32_t dfdByteLength = read<uint32_t>(data, size, 52);
+
+    if (file.pixelWidth == 0 || file.pixelHeight == 0 || pixelDepth > 1 || file.layerCount > 1 || file.faceCount != 1)
+    {
+        throw std::runtime_error("=====Only single 2D KTX2 textures are supported!=====");
+    }
+
+    // 完整的mip链最多floor(log2(max(w,h)))+1级，更多的level index只能来自损坏的文件
+    uint32_t maxLevels = 1;
+    for (uint32_t extent = std::max(file.pixelWidth, file.pixelHeight); extent > 1; extent >>= 1)
+    {
+        maxLevels++;
+    }
+    if (levelCount > maxLevels)
+    {
+        throw std::runtime_error("=====KTX2 file has " + std::to_string(levelCount) + " levels, at most " + std::to_string(maxLevels) + " are possible!=====");
+    }
+
+    // levelCount为0表示要求加载方自己生成mip，这里按只有一级处理
+    uint32_t levels = levelCount > 0 ? levelCount : 1;
+    for (uint32_t i = 0; i < levels; i++)
+    {
+        size_t entry = headerSize + i * levelIndexEntrySize;
+        Level level;
+        level.byteOffset = read<uint64_t>(data, size, entry);
+        level.byteLength = read<uint64_t>(data, size, entry + 8);
+        level.uncompressedByteLength = read<uint64_t>(data, size, entry + 16);
+        //分开比较，byteOffset + byteLength可能溢出回绕成一个很小的值
+        if (level.byteLength > size || level.byteOffset > size - level.byteLength)
+        {
+            throw std::runtime_error("=====KTX2 level " + std::to_string(i) + " is out of range!=====");
+        }
+        file.levels.push_back(level);
+    }
+
+    // DFD：dfdTotalSize(4) + basic descriptor block，颜色模型等在block的第8个字节开始
+    if (dfdByteLength >= 4 + 24)
+    {
+        size_t block = dfdByteOffset + 4;
+        uint16_t descriptorBlockSize = read<uint16_t>(data, size, block + 6);
+        uint8_t colorModel = read<uint8_t>(data, size, block + 8);
+        uint8_t transferFunction = read<uint8_t>(data, size, block + 10);
+        file.srgb = transferFunction == dfdTransferSrgb;
+
+        uint32_t sampleCount = descriptorBlockSize >= 24 ? (descriptorBlockSize - 24) / 16 : 0;
+        if (colorModel == dfdModelEtc1s)
+        {
+            file.encoding = Encoding::Etc1s;
+            for (uint32_t i = 0; i < sampleCount; i++)
+            {
+                uint8_t channel = read<uint8_t>(data, size, block + 24 + i * 16 + 3) & 0x0F;
+                file.hasAlpha = file.hasAlpha || channel == dfdChannelEtc1sAaa;
+            }
+        }
+        else if (colorModel == dfdModelUastc)
+        {
+            file.encoding = Encoding::Uastc;
+            if (sampleCount > 0)
+            {
+                uint8_t channel = read<uint8_t>(data, size, block + 24 + 3) & 0x0F;
+                file.hasAlpha = channel == dfdChannelUastcRgba || channel == dfdChannelUastcRrrg;
+            }
+        }
+    }
+
+    if (file.encoding == Encoding::Native)
+    {
+        if (file.vkFormat == VK_FORMAT_UNDEFINED)
+        {
+            throw std::runtime_error("=====KTX2 file has no format and is not Basis Universal!=====");
+        }
+        if (file.supercompression != Supercompression::None)
+        {
+            throw std::runtime_error("=====Zstandard/ZLIB supercompressed KTX2 files are not supported!=====");
+        }
+        file.hasAlpha = formatHasAlpha(file.vkFormat);
+    }
+    return file;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// KTX2容器的解析，只读取header、level index与DFD中需要的字段，不拷贝数据
+// 规范：https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+struct Ktx2File
+{
+    enum class Supercompression : uint32_t
+    {
+        None = 0,
+        BasisLZ = 1,
+        Zstandard = 2,
+        ZLIB = 3,
+    };
+
+    // 数据的编码方式，决定之后能转码成什么格式
+    enum class Encoding
+    {
+        // vkFormat本身就是GPU可用的格式(RGBA8或已经压缩好的BC/ETC2/ASTC)
+        Native,
+        // Basis Universal ETC1S(BasisLZ超压缩)
+        Etc1s,
+        // Basis Universal UASTC
+        Uastc,
+    };
+
+    struct Level
+    {
+        uint64_t byteOffset = 0;
+        uint64_t byteLength = 0;
+        uint64_t uncompressedByteLength = 0;
+    };
+
+    VkFormat vkFormat = VK_FORMAT_UNDEFINED;
+    uint32_t pixelWidth = 0;
+    uint32_t pixelHeight = 0;
+    uint32_t layerCount = 0;
+    uint32_t faceCount = 0;
+    Supercompression supercompression = Supercompression::None;
+    Encoding encoding = Encoding::Native;
+    // DFD中的transfer function为sRGB
+    bool srgb = false;
+    // Basis数据由DFD判断；Native格式由vkFormat判断
+    bool hasAlpha = false;
+    // levels[0]为最精细的一级
+    std::vector<Level> levels;
+
+    // 数据不合法或不是KTX2时抛出std::runtime_error
+    static Ktx2File parse(const uint8_t *data, size_t size);
+};
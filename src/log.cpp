@@ -0,0 +1,80 @@
+#include "log.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+
+namespace
+{
+    LogLevel currentLevel = LogLevel::Info;
+
+    // 丢弃所有写入的内容，被关闭的级别返回它，调用方不需要到处判断
+    class NullBuffer : public std::streambuf
+    {
+    protected:
+        int overflow(int c) override { return traits_type::not_eof(c); }
+        std::streamsize xsputn(const char *, std::streamsize count) override { return count; }
+    };
+
+    std::ostream &nullStream()
+    {
+        static NullBuffer buffer;
+        static std::ostream stream(&buffer);
+        return stream;
+    }
+}
+
+void setLogLevel(LogLevel level)
+{
+    currentLevel = level;
+}
+
+LogLevel getLogLevel()
+{
+    return currentLevel;
+}
+
+bool logEnabled(LogLevel level)
+{
+    return static_cast<int>(level) <= static_cast<int>(currentLevel);
+}
+
+std::ostream &logStream(LogLevel level)
+{
+    if (!logEnabled(level))
+    {
+        return nullStream();
+    }
+    return level <= LogLevel::Warning ? std::cerr : std::cout;
+}
+
+LogLevel parseLogLevel(const char *name)
+{
+    if (strcmp(name, "error") == 0)
+        return LogLevel::Error;
+    if (strcmp(name, "warning") == 0)
+        return LogLevel::Warning;
+    if (strcmp(name, "info") == 0)
+        return LogLevel::Info;
+    if (strcmp(name, "verbose") == 0)
+        return LogLevel::Verbose;
+    throw std::runtime_error(std::string("=====Unknown log level: ") + name + "=====");
+}
+
+const char *logLevelName(LogLevel level)
+{
+    switch (level)
+    {
+    case LogLevel::Error:
+        return "error";
+    case LogLevel::Warning:
+        return "warning";
+    case LogLevel::Info:
+        return "info";
+    case LogLevel::Verbose:
+        return "verbose";
+    }
+    return "unknown";
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <iosfwd>
+
+// 控制台输出的详细程度，数值越大输出越多
+enum class LogLevel
+{
+    Error = 0,
+    Warning = 1,
+    Info = 2,
+    // 逐条列出layer、instance/device扩展等启动时的详细信息
+    Verbose = 3,
+};
+
+void setLogLevel(LogLevel level);
+LogLevel getLogLevel();
+bool logEnabled(LogLevel level);
+
+// Error/Warning写到std::cerr，其余写到std::cout；级别被关闭时返回一个丢弃所有内容的流
+std::ostream &logStream(LogLevel level);
+
+// 解析error/warning/info/verbose，格式错误时抛出std::runtime_error
+LogLevel parseLogLevel(const char *name);
+const char *logLevelName(LogLevel level);
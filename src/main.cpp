@@ -11,6 +11,33 @@
 #include <limits>
 #include <algorithm>
 #include <fstream>
+#include <array>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdio>
+
+#include "allocation_counter.h"
+#include "api_call_counter.h"
+#include "app_settings.h"
+#include "command_cache.h"
+#include "debug_message_log.h"
+#include "device_selection.h"
+#include "draw_list.h"
+#include "dynamic_resolution.h"
+#include "frame_arena.h"
+#include "frame_capture.h"
+#include "frame_metrics.h"
+#include "frame_pacer.h"
+#include "log.h"
+#include "pipeline_variants.h"
+#include "png_image.h"
+#include "queue_submitter.h"
+#include "renderer_config.h"
+#include "startup_trace.h"
+#include "synchronization2.h"
+#include "texture_streamer.h"
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
@@ -23,12 +50,31 @@ const std::vector<const char*> deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
-// validation层仅在Debug模式下作用
-#ifdef NDEBUG
-const bool enableValidationLayers = false;
-#else
-const bool enableValidationLayers = true;
-#endif
+// 可选扩展：支持时用于精确测量输入到显示的延迟
+const std::vector<const char*> presentWaitExtensions = {
+    VK_KHR_PRESENT_ID_EXTENSION_NAME,
+    VK_KHR_PRESENT_WAIT_EXTENSION_NAME
+};
+
+// DrawList排序键中的pass与pipeline id，pass决定先后，pipeline在pass内排序
+enum DrawPass : uint32_t
+{
+    DrawPassDepthPrepass,
+    DrawPassOpaque,
+};
+
+enum DrawPipeline : uint32_t
+{
+    DrawPipelineDepthPrepass,
+    DrawPipelineOpaque,
+};
+
+// triangle.frag中specialization constant的constant_id
+enum FragmentConstant : uint32_t
+{
+    FragmentConstantTextured = 0,
+    FragmentConstantTextureTaps = 1,
+};
 
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT *pCreateInfo, const VkAllocationCallbacks *pAllocator, VkDebugUtilsMessengerEXT *pDebugMessenger)
 {
@@ -52,6 +98,18 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
     }
 }
 
+// 1.0的loader没有导出vkEnumerateInstanceVersion，需要通过vkGetInstanceProcAddr查询
+uint32_t EnumerateInstanceVersion()
+{
+    auto func = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+    uint32_t apiVersion = VK_API_VERSION_1_0;
+    if (func != nullptr && func(&apiVersion) != VK_SUCCESS)
+    {
+        apiVersion = VK_API_VERSION_1_0;
+    }
+    return apiVersion;
+}
+
 //Loading a shader
 static std::vector<char> readFile(const std::string& filename){
     std::ifstream file(filename, std::ios::ate | std::ios::binary);
@@ -71,20 +129,67 @@ static std::vector<char> readFile(const std::string& filename){
     return buffer;
 }
 
+// Config见renderer_config.h，决定validation、frames in flight、MSAA与profiling等编译期开关
+template <typename Config>
 class HelloTriangleApplication
 {
+    static_assert(Config::framesInFlight >= 1, "framesInFlight must be at least 1");
+    static_assert(Config::msaaSamples >= VK_SAMPLE_COUNT_1_BIT && Config::msaaSamples <= VK_SAMPLE_COUNT_64_BIT &&
+                      (Config::msaaSamples & (Config::msaaSamples - 1)) == 0,
+        "msaaSamples must be a single VkSampleCountFlagBits value");
+    //其他模块的命令计数由KUTORY_PROFILING编译，两者不一致时每帧仍会计数或者--metrics没有数据
+    static_assert(Config::profiling == (KUTORY_PROFILING != 0), "Config::profiling must match KUTORY_PROFILING");
+
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = Config::framesInFlight;
+    static constexpr bool enableValidationLayers = Config::validation;
+    static constexpr bool preferDynamicRendering = Config::dynamicRendering;
+    static constexpr bool enableDepthPrepass = Config::depthPrepass;
+
 public:
+    explicit HelloTriangleApplication(const AppSettings &settings) : settings(settings)
+    {
+        setLogLevel(settings.logLevel);
+        if constexpr (!Config::profiling)
+        {
+            if (!settings.metricsTargets.empty() || !settings.startupTracePath.empty() || settings.startupBudgetMs > 0.0)
+            {
+                logStream(LogLevel::Warning) << "--metrics, --startup-trace and --startup-budget-ms need a build with KUTORY_PROFILING, ignoring them\n";
+            }
+        }
+        framePacer.setFrameLimit(settings.fpsLimit);
+        framePacer.setLowLatency(settings.lowLatency);
+
+        FrameCapture::Config captureConfig;
+        captureConfig.target = settings.captureTarget;
+        captureConfig.firstFrame = settings.captureStart;
+        captureConfig.frameCount = settings.captureFrames;
+        captureConfig.keepLastFrame = !settings.goldenImagePath.empty();
+        frameCapture.setConfig(captureConfig);
+        if (!settings.goldenImagePath.empty() && !frameCapture.enabled())
+        {
+            throw std::runtime_error("=====--golden requires --capture=====");
+        }
+        //headless时没有窗口可以关闭，只能在--exit-after或捕获完指定帧数后退出
+        if (settings.headless && settings.exitAfterFrames == 0 && !(frameCapture.enabled() && settings.captureFrames > 0))
+        {
+            throw std::runtime_error("=====--headless requires --exit-after or --capture with --capture-frames=====");
+        }
+    }
+
     void run()
     {
-        initWindow();
-        initVulkan();
+        measureStartup("initWindow", [this] { initWindow(); });
+        measureStartup("initVulkan", [this] { initVulkan(); });
         mainLoop();
         cleanup();
+        checkGoldenImage();
     }
 
 private:
     //类成员
-    GLFWwindow *window;
+    AppSettings settings;
+    //headless模式下为nullptr
+    GLFWwindow *window = nullptr;
     VkInstance instance;
     VkDebugUtilsMessengerEXT debugMessenger;
     // 将显卡存储到VkPhysicalDevice句柄中，且随着VkInstance的销毁而销毁
@@ -97,23 +202,119 @@ private:
     VkSwapchainKHR swapChain;
     std::vector<VkImage> swapChainImages;
     VkFormat swapChainImageFormat;
+    VkPresentModeKHR swapChainPresentMode;
     VkExtent2D swapChainExtent;
     std::vector<VkImageView> swapChainImageViews;//store the image views
-    //Render pass
-    VkRenderPass renderPass;
+    //Render pass(dynamic rendering模式下为VK_NULL_HANDLE)
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    //Descriptor：每个frame in flight一个set，绑定流式加载的纹理
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorPool descriptorPool;
+    std::vector<VkDescriptorSet> descriptorSets;
     //Pipeline layout
     VkPipelineLayout pipelineLayout;
     VkPipeline graphicsPipeline;
+    VkPipeline depthPrepassPipeline = VK_NULL_HANDLE;
+    //同一份SPIR-V按specialization constant创建的pipeline变体，键为DrawPipeline与常量取值
+    PipelineVariantCache pipelineVariants;
+    //按排序键录制draw，只在状态变化时bind；descriptor set的id即frame索引
+    DrawList drawList;
+    DrawResources drawResources;
+    //--cache-commands：draw录制在secondary command buffer中，依赖不变时每帧直接执行
+    //版本号在创建swap chain、pipeline与写入descriptor时递增，缓存据此自动失效
+    CommandCache commandCache;
+    uint64_t swapChainVersion = 0;
+    uint64_t pipelineVersion = 0;
+    std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> descriptorVersions{};
+    std::array<VkImageView, MAX_FRAMES_IN_FLIGHT> descriptorImageViews{};
+    //Depth buffer
+    VkImage depthImage;
+    VkDeviceMemory depthImageMemory;
+    VkImageView depthImageView;
+    VkFormat depthFormat;
+    //MSAA color target，在subpass结束时resolve到swap chain image
+    VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkImage colorImage = VK_NULL_HANDLE;
+    VkDeviceMemory colorImageMemory = VK_NULL_HANDLE;
+    VkImageView colorImageView = VK_NULL_HANDLE;
     //framebuffer
     std::vector<VkFramebuffer> swapChainFramebuffers;
     //Command pools
     VkCommandPool commandPool;
-    //Commandbuffer
-    VkCommandBuffer commandBuffer;
-
-    VkSemaphore imageAvailableSemaphore;
-    VkSemaphore renderFinishedSemaphore;
-    VkFence inFlightFence;
+    //Commandbuffer，每个frame in flight一个
+    std::vector<VkCommandBuffer> commandBuffers;
+
+    //imageAvailable按frame索引；renderFinished按swap chain image索引，
+    //因为presentation引擎何时用完它只与image相关
+    std::vector<VkSemaphore> imageAvailableSemaphores;
+    std::vector<VkSemaphore> renderFinishedSemaphores;
+    std::vector<VkFence> inFlightFences;
+    uint32_t currentFrame = 0;
+
+    //Frame pacing
+    FramePacer framePacer;
+    //每帧两个timestamp，记录GPU执行时间
+    VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+    float timestampPeriod = 1.0f;
+    std::array<bool, MAX_FRAMES_IN_FLIGHT> frameTimingPending{};
+    std::array<FramePacer::Clock::time_point, MAX_FRAMES_IN_FLIGHT> frameInputTimes{};
+
+    //--metrics：每个pass的pipeline statistics与每帧的命令数
+    FrameMetrics frameMetrics;
+    bool pipelineStatisticsEnabled = false;
+    bool inheritedQueriesEnabled = false;
+    uint32_t scenePass = 0;
+    uint32_t upscalePass = 0;
+
+    //VK_KHR_present_wait：后台线程等待每次present真正显示，计算输入到显示的延迟
+    bool presentWaitEnabled = false;
+    PFN_vkWaitForPresentKHR pfnWaitForPresentKHR = nullptr;
+    uint64_t nextPresentId = 1;
+    std::thread presentWaitThread;
+    std::mutex presentWaitMutex;
+    std::condition_variable presentWaitCondition;
+    //固定容量的环形队列，避免每帧在堆上分配；等待线程跟不上时丢弃最旧的记录
+    static const size_t maxPendingPresents = 64;
+    std::array<std::pair<uint64_t, FramePacer::Clock::time_point>, maxPendingPresents> pendingPresents{};
+    size_t pendingPresentHead = 0;
+    size_t pendingPresentCount = 0;
+    std::vector<double> measuredLatencies;
+    std::atomic<bool> presentWaitStop{false};
+
+    //窗口大小改变时由GLFW回调置位，drawFrame中重建swap chain
+    bool framebufferResized = false;
+
+    //纹理流式加载，显存预算通过VK_EXT_memory_budget跟踪
+    bool memoryBudgetEnabled = false;
+    TextureStreamer textureStreamer;
+    uint32_t demoTexture = 0;
+
+    //每帧的临时内存，该帧的fence signal之后整体复用；不够时下一帧自动扩容
+    static const size_t frameArenaBytes = 256 * 1024;
+    FrameArena frameArena;
+    //--check-frame-allocations：启动与重建swap chain之后预热这么多帧再检查
+    static const uint64_t allocationCheckWarmupFrames = 60;
+    uint64_t allocationCheckStartFrame = allocationCheckWarmupFrames;
+
+    //Dynamic rendering
+    uint32_t instanceApiVersion = VK_API_VERSION_1_0;
+    bool dynamicRenderingEnabled = false;
+    PFN_vkCmdBeginRendering pfnCmdBeginRendering = nullptr;
+    PFN_vkCmdEndRendering pfnCmdEndRendering = nullptr;
+
+    //barrier与提交都使用synchronization2，不支持时由Synchronization2转换为旧接口
+    Synchronization2 synchronization2;
+    //每帧每个队列只调用一次vkQueueSubmit2
+    QueueSubmitter queueSubmitter;
+
+    //--dynamic-resolution：按GPU时间缩小渲染区域，再放大锐化到swap chain
+    bool dynamicResolutionEnabled = false;
+    DynamicResolution dynamicResolution;
+    ResolutionController resolutionController;
+    //本帧的渲染区域，关闭动态分辨率时等于swapChainExtent
+    VkExtent2D renderExtent{};
+    //每个slot录制时使用的比例，读回GPU时间时按它换算
+    std::array<float, MAX_FRAMES_IN_FLIGHT> frameResolutionScales{};
 
     struct QueueFamilyIndices
     {
@@ -122,7 +323,7 @@ private:
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentFamily;
 
-        bool isComplete()
+        bool isComplete() const
         {
             return graphicsFamily.has_value() && presentFamily.has_value();
         }
@@ -140,23 +341,75 @@ private:
         std::vector<VkSurfaceFormatKHR> formats;
         std::vector<VkPresentModeKHR> presentModes;
     };
+
+    //pickPhysicalDevice时对每个设备查询一次，之后的步骤都读这里，不再重复查询
+    struct DeviceCapabilities
+    {
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+        VkPhysicalDeviceProperties properties{};
+        VkPhysicalDeviceFeatures features{};
+        VkPhysicalDeviceMemoryProperties memoryProperties{};
+        std::vector<VkQueueFamilyProperties> queueFamilies;
+        std::set<std::string> extensions;
+        QueueFamilyIndices queueFamilyIndices;
+        //capabilities.currentExtent会随窗口大小变化，createSwapChain时单独刷新
+        SwapChainSupportDetails swapChainSupport;
+        bool dynamicRendering = false;
+        bool presentWait = false;
+        //synchronization2在1.3中是核心特性，1.1/1.2通过VK_KHR_synchronization2支持
+        bool synchronization2 = false;
+        bool synchronization2Core = false;
+    };
+    //选中设备的缓存
+    DeviceCapabilities deviceCaps;
+
+    //Validation layer消息的异步输出，以及每帧PERFORMANCE警告的统计
+    DebugMessageLog debugMessageLog;
+    uint32_t lastFramePerformanceWarnings = 0;
+    uint64_t statsPerformanceWarnings = 0;
+    uint32_t statsPerformanceWarningPeak = 0;
+    uint32_t statsFrames = 0;
+
+    //启动阶段计时，从构造到第一帧提交
+    StartupTrace startupTrace;
+    bool startupReported = false;
+
+    //截图/录制与golden image比较，frameNumber为已提交的帧数
+    FrameCapture frameCapture;
+    uint64_t frameNumber = 0;
     
 
     void initWindow()
     {
+        //headless模式不创建窗口，surface由VK_EXT_headless_surface提供
+        if (settings.headless)
+        {
+            return;
+        }
         glfwInit();
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
         window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
+        glfwSetWindowUserPointer(window, this);
+        glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+    }
+
+    static void framebufferResizeCallback(GLFWwindow* window, int width, int height)
+    {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+        app->framebufferResized = true;
     }
 
     void createInstance()
     {
         // 检查Layer层的支持情况
-        if (enableValidationLayers && !checkValidationLayerSupport())
+        if constexpr (enableValidationLayers)
         {
-            throw std::runtime_error("=====Validation layers requested, but not available!=====");
+            if (!checkValidationLayerSupport())
+            {
+                throw std::runtime_error("=====Validation layers requested, but not available!=====");
+            }
         }
 
         // 创建实例
@@ -171,7 +424,9 @@ private:
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "Kutory Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        // dynamic rendering需要1.3、present wait的特性查询需要1.1，按loader支持的版本请求，最高1.3
+        instanceApiVersion = std::min(EnumerateInstanceVersion(), VK_API_VERSION_1_3);
+        appInfo.apiVersion = instanceApiVersion;
 
         // 该部分不是可选的
         VkInstanceCreateInfo createInfo{};
@@ -185,8 +440,9 @@ private:
 
         VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
         // 如果开启Validation调试，将validation层的信息（开启层数、开启扩展的名称）记录到VkInstanceCreateInfo中
-        if (enableValidationLayers)
+        if constexpr (enableValidationLayers)
         {
+            debugMessageLog.start(DebugMessageLog::optionsForLogLevel(settings.logLevel));
             createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
             createInfo.ppEnabledLayerNames = validationLayers.data();
 
@@ -217,12 +473,15 @@ private:
         std::vector<VkLayerProperties> availableLayers(layerCount);
         vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
 
-        std::cout << '\n'
-                  << "Here are all avalilable layers:" << '\n';
-        for (const auto &layerProperties : availableLayers)
+        if (logEnabled(LogLevel::Verbose))
         {
-            // 输出所有的availableLayers的layerName
-            std::cout << '\t' << layerProperties.layerName << '\n';
+            std::cout << '\n'
+                      << "Here are all avalilable layers:" << '\n';
+            for (const auto &layerProperties : availableLayers)
+            {
+                // 输出所有的availableLayers的layerName
+                std::cout << '\t' << layerProperties.layerName << '\n';
+            }
         }
         // 检查availableLayers列表中是否存在所有validationLayers图层
         for (const char *layerName : validationLayers)
@@ -249,30 +508,41 @@ private:
     // 根据是否启用验证层返回所需的扩展列表
     std::vector<const char *> getRequiredExtensions()
     {
-        uint32_t glfwExtensionCount = 0;
-        const char **glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-        std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        std::vector<const char *> extensions;
+        if (settings.headless)
+        {
+            extensions = {VK_KHR_SURFACE_EXTENSION_NAME, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME};
+        }
+        else
+        {
+            uint32_t glfwExtensionCount = 0;
+            const char **glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
-        if (enableValidationLayers)
+        if constexpr (enableValidationLayers)
         {
             // set up a debug messenger
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
         }
 
-        // To retrieve（检索） a list of supported extensions before creating an instance
-        uint32_t extensionCount = 0;
-        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
-        // Allocate an array to hold the extension details
-        std::vector<VkExtensionProperties> vkextensions(extensionCount);
-        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, vkextensions.data());
-
-        // Output extensions
-        std::cout << "Here are all available instance extensions:\n";
-        for (const auto &extension : vkextensions)
+        // 完整的扩展列表只用于输出，非verbose时跳过枚举
+        if (logEnabled(LogLevel::Verbose))
         {
-            std::cout << '\t' << extension.extensionName << '\n';
+            // To retrieve（检索） a list of supported extensions before creating an instance
+            uint32_t extensionCount = 0;
+            vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+            // Allocate an array to hold the extension details
+            std::vector<VkExtensionProperties> vkextensions(extensionCount);
+            vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, vkextensions.data());
+
+            // Output extensions
+            std::cout << "Here are all available instance extensions:\n";
+            for (const auto &extension : vkextensions)
+            {
+                std::cout << '\t' << extension.extensionName << '\n';
+            }
         }
 
         return extensions;
@@ -285,46 +555,63 @@ private:
         const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData,
         void *pUserData)
     {
-
-        std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
-        if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT)
-        {
-            // Message is important enough to show
-        }
+        // 只入队，过滤、去重、限速与输出都在DebugMessageLog的后台线程完成
+        static_cast<DebugMessageLog *>(pUserData)->submit(messageSeverity, messageType, pCallbackData);
         return VK_FALSE;
     }
 
     void initVulkan()
     {
+        // 每一步单独计时，--startup-trace时写出Chrome trace
         // 第一步，创建Instance
-        createInstance();
-        setupDebugMessenger();
-        createSurface();
-        pickPhysicalDevice();
-        createLogicalDevice();
-        createSwapChain();
-        createImageViews();
-        createRenderPass();
-        createGraphicsPipeline();
-        createFramebuffers();
-        createCommandPool();
-        createCommandBuffer();
-        createSyncObjects();
+        measureStartup("createInstance", [this] { createInstance(); });
+        measureStartup("setupDebugMessenger", [this] { setupDebugMessenger(); });
+        measureStartup("createSurface", [this] { createSurface(); });
+        measureStartup("pickPhysicalDevice", [this] { pickPhysicalDevice(); });
+        measureStartup("createLogicalDevice", [this] { createLogicalDevice(); });
+        frameCapture.start(device, synchronization2, deviceCaps.memoryProperties, MAX_FRAMES_IN_FLIGHT);
+        createDynamicResolution();
+        measureStartup("createSwapChain", [this] { createSwapChain(); });
+        measureStartup("createImageViews", [this] { createImageViews(); });
+        measureStartup("createColorResources", [this] { createColorResources(); });
+        measureStartup("createDepthResources", [this] { createDepthResources(); });
+        if (!dynamicRenderingEnabled)
+        {
+            measureStartup("createRenderPass", [this] { createRenderPass(); });
+        }
+        measureStartup("createDescriptorSetLayout", [this] { createDescriptorSetLayout(); });
+        measureStartup("createGraphicsPipeline", [this] { createGraphicsPipeline(); });
+        if (!dynamicRenderingEnabled)
+        {
+            measureStartup("createFramebuffers", [this] { createFramebuffers(); });
+        }
+        measureStartup("createCommandPool", [this] { createCommandPool(); });
+        frameArena.create(MAX_FRAMES_IN_FLIGHT, frameArenaBytes);
+        measureStartup("createTextures", [this] { createTextures(); });
+        measureStartup("createDescriptorPool", [this] { createDescriptorPool(); });
+        measureStartup("createDescriptorSets", [this] { createDescriptorSets(); });
+        createDrawResources();
+        measureStartup("createCommandBuffers", [this] { createCommandBuffers(); });
+        measureStartup("createSyncObjects", [this] { createSyncObjects(); });
+        measureStartup("createTimestampQueries", [this] { createTimestampQueries(); });
+        measureStartup("createFrameMetrics", [this] { createFrameMetrics(); });
+        measureStartup("startPresentWaitThread", [this] { startPresentWaitThread(); });
     }
 
     void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo)
     {
         createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-        createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+        // 只订阅当前日志级别需要的severity，VERBOSE/INFO只在--log-level=verbose时订阅
+        createInfo.messageSeverity = debugMessageLog.severityMask();
         createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
         createInfo.pfnUserCallback = debugCallback;
-        createInfo.pUserData = nullptr; // Optional
+        createInfo.pUserData = &debugMessageLog;
     }
 
     void setupDebugMessenger()
     {
-        if (!enableValidationLayers)
+        if constexpr (!enableValidationLayers)
             return;
 
         VkDebugUtilsMessengerCreateInfoEXT createInfo{};
@@ -358,6 +645,18 @@ private:
         */
 
 
+        if (settings.headless)
+        {
+            auto func = (PFN_vkCreateHeadlessSurfaceEXT)vkGetInstanceProcAddr(instance, "vkCreateHeadlessSurfaceEXT");
+            VkHeadlessSurfaceCreateInfoEXT createInfo{};
+            createInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+            if (func == nullptr || func(instance, &createInfo, nullptr, &surface) != VK_SUCCESS)
+            {
+                throw std::runtime_error("=====Failed to create headless surface!=====");
+            }
+            return;
+        }
+
         //使用GLFW
         if(glfwCreateWindowSurface(instance, window,nullptr,&surface)!= VK_SUCCESS){
             throw std::runtime_error("=====Failed to create window surface!=====");
@@ -375,127 +674,251 @@ private:
         std::vector<VkPhysicalDevice> devices(deviceCount);
         vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
-        // 调用设备检查函数来检查GPUs的可用性
+        // 每个设备只查询一次，打分与后续创建都使用这份缓存
+        std::vector<DeviceCapabilities> capabilities;
         for (const auto &device : devices)
         {
-            if (isDeviceSuitable(device))
+            measureStartup("queryDeviceCapabilities", [&] { capabilities.push_back(queryDeviceCapabilities(device)); });
+        }
+
+        // 给所有设备打分，选分数最高的；--gpu/KUTORY_GPU可以按索引或名称强制指定
+        std::vector<DeviceCandidate> candidates;
+        for (const auto &caps : capabilities)
+        {
+            candidates.push_back(describeDevice(caps));
+        }
+
+        std::ostream &info = logStream(LogLevel::Info);
+        info << '\n' << "Here are all GPUs:" << '\n';
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            DeviceScore score = scoreDevice(candidates[i]);
+            info << '\t' << i << ": " << candidates[i].name << " [" << deviceTypeName(candidates[i].deviceType) << "] "
+                 << (score.suitable ? "score " + std::to_string(score.score) : std::string("not suitable")) << '\n';
+        }
+
+        DeviceSelection selection = selectDevice(candidates, settings.gpuSelector);
+        deviceCaps = capabilities[selection.index];
+        physicalDevice = deviceCaps.physicalDevice;
+
+        info << "Selected GPU " << selection.index << ": " << candidates[selection.index].name
+             << (selection.overridden ? " (requested by \"" + settings.gpuSelector + "\")" : std::string(" (highest score)")) << '\n';
+        for (const auto &reason : selection.score.reasons)
+        {
+            info << "\t" << reason << '\n';
+        }
+
+        dynamicRenderingEnabled = preferDynamicRendering && deviceCaps.dynamicRendering;
+        msaaSamples = chooseMsaaSampleCount(deviceCaps.properties, Config::msaaSamples);
+        info << "MSAA samples: " << msaaSamples << '\n';
+        presentWaitEnabled = deviceCaps.presentWait;
+        info << "Latency measurement: " << (presentWaitEnabled ? "VK_KHR_present_wait" : "GPU completion (approximate)") << '\n';
+        info << "Rendering path: " << (dynamicRenderingEnabled ? "dynamic rendering" : "render pass + framebuffer") << '\n';
+        info << "Submission: " << (deviceCaps.synchronization2 ? "vkQueueSubmit2 (synchronization2)" : "vkQueueSubmit") << '\n';
+    }
+
+    // 一次性查询设备的属性、特性、内存、队列、扩展与surface支持情况
+    DeviceCapabilities queryDeviceCapabilities(VkPhysicalDevice device)
+    {
+        DeviceCapabilities caps;
+        caps.physicalDevice = device;
+
+        // 查询基本设备属性（名称、类型、Vulkan支持版本等）
+        vkGetPhysicalDeviceProperties(device, &caps.properties);
+        // 查询设备特性（纹理压缩、64位浮点数、Multiviewport渲染等可选功能）
+        vkGetPhysicalDeviceFeatures(device, &caps.features);
+        vkGetPhysicalDeviceMemoryProperties(device, &caps.memoryProperties);
+
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+        caps.queueFamilies.resize(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, caps.queueFamilies.data());
+        caps.queueFamilyIndices = findQueueFamilies(device, caps.queueFamilies);
+
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+        for (const auto &extension : availableExtensions)
+        {
+            caps.extensions.insert(extension.extensionName);
+        }
+
+        if (logEnabled(LogLevel::Verbose))
+        {
+            std::cout << '\n'
+                      << "Here are all avalilable device extensions of " << caps.properties.deviceName << ":" << '\n';
+            for (const auto &extension : availableExtensions)
             {
-                // 找第一个可以用的设备
-                physicalDevice = device;
-                break;
+                // 输出所有的availableExtensionsextensionName
+                std::cout << '\t' << extension.extensionName << '\n';
             }
         }
-        if (physicalDevice == VK_NULL_HANDLE)
+
+        //先验证swap chain extension可用，再查询surface的支持情况
+        if (checkDeviceExtensionSupport(caps))
         {
-            throw std::runtime_error("=====No suitable GPU!=====");
+            caps.swapChainSupport = querySwapChainSupport(device);
         }
 
-        // 使用ordered map来对候选设备进行自动排序
-        //  std::multimap<int, VkPhysicalDevice> candidates;
-        //  for(const auto& device : devices) {
-        //      int score = rateDeviceSuitability(device);
-        //      candidates.insert(std::make_pair(score, device));
-        //  }
-        //  if(candidates.rbegin()->first > 0){
-        //      physicalDevice = candidates.rbegin()->second;
-        //  }else {
-        //      throw std::runtime_error("No suitable GPU!");
-        //  }
+        caps.dynamicRendering = checkDynamicRenderingSupport(caps);
+        caps.presentWait = checkPresentWaitSupport(caps);
+        checkSynchronization2Support(caps);
+        return caps;
     }
 
     // 检查当前的设备能否支持Vulkan的功能
-    bool isDeviceSuitable(VkPhysicalDevice device)
+    bool isDeviceSuitable(const DeviceCapabilities &caps)
     {
-        // 查询基本设备属性（名称、类型、Vulkan支持版本等）
-        VkPhysicalDeviceProperties deviceProperties;
-        vkGetPhysicalDeviceProperties(device, &deviceProperties);
+        // 以下代码示例为选择仅适用与支持几何着色器显卡
+        // return caps.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
+        // caps.features.geometryShader;
 
-        // 查询设备特性（纹理压缩、64位浮点数、Multiviewport渲染等可选功能）
-        VkPhysicalDeviceFeatures deviceFeatures;
-        vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+        bool extensionSupported = checkDeviceExtensionSupport(caps);
 
-        // 以下代码示例为选择仅适用与支持几何着色器显卡
-        // return deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
-        // deviceFeatures.geometryShader;
+        //验证SwapChain支持是否足够
+        //本例只需要至少一种支持的Format和一种支持的PresentMode即可
+        bool swapChainAdequate = !caps.swapChainSupport.formats.empty() && !caps.swapChainSupport.presentModes.empty();
+
+        return caps.queueFamilyIndices.isComplete() && extensionSupported && swapChainAdequate;
+    }
+
+    //dynamic rendering要求instance与device都为1.3，且dynamicRendering特性可用
+    bool checkDynamicRenderingSupport(const DeviceCapabilities &caps)
+    {
+        if (instanceApiVersion < VK_API_VERSION_1_3 || caps.properties.apiVersion < VK_API_VERSION_1_3)
+        {
+            return false;
+        }
 
-        QueueFamilyIndices indices = findQueueFamilies(device);
+        VkPhysicalDeviceVulkan13Features features13{};
+        features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &features13;
+        vkGetPhysicalDeviceFeatures2(caps.physicalDevice, &features2);
 
-        bool extensionSupported = checkDeviceExtensionSupport(device);
+        return features13.dynamicRendering == VK_TRUE;
+    }
 
-        //验证SwapChain支持是否足够
-        bool swapChainAdequate = false;
-        //先验证extension可用
-        if(extensionSupported){
-            SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
-            //本例只需要至少一种支持的Format和一种支持的PresentMode即可
-            swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+    //present_id与present_wait需要同时支持，特性查询依赖1.1的vkGetPhysicalDeviceFeatures2
+    bool checkPresentWaitSupport(const DeviceCapabilities &caps)
+    {
+        if (instanceApiVersion < VK_API_VERSION_1_1)
+        {
+            return false;
         }
-        
-        return indices.isComplete() && extensionSupported && swapChainAdequate ;
+
+        for (const char *extension : presentWaitExtensions)
+        {
+            if (caps.extensions.count(extension) == 0)
+            {
+                return false;
+            }
+        }
+
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &presentIdFeatures;
+        vkGetPhysicalDeviceFeatures2(caps.physicalDevice, &features2);
+
+        return presentIdFeatures.presentId == VK_TRUE && presentWaitFeatures.presentWait == VK_TRUE;
     }
 
-    //Additional check 检查设备的Swap chain extensions
-    bool checkDeviceExtensionSupport(VkPhysicalDevice device){
-        uint32_t extensionCount;
-        vkEnumerateDeviceExtensionProperties(device,nullptr,&extensionCount,nullptr);
+    //1.3设备查询核心特性，否则需要扩展以及1.1的vkGetPhysicalDeviceFeatures2
+    void checkSynchronization2Support(DeviceCapabilities &caps)
+    {
+        if (instanceApiVersion < VK_API_VERSION_1_1)
+        {
+            return;
+        }
 
-        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-        vkEnumerateDeviceExtensionProperties(device,nullptr,&extensionCount,availableExtensions.data());
-        
-        std::set<std::string> requiredExtensions(deviceExtensions.begin(),deviceExtensions.end());
+        if (instanceApiVersion >= VK_API_VERSION_1_3 && caps.properties.apiVersion >= VK_API_VERSION_1_3)
+        {
+            VkPhysicalDeviceVulkan13Features features13{};
+            features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+            VkPhysicalDeviceFeatures2 features2{};
+            features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features2.pNext = &features13;
+            vkGetPhysicalDeviceFeatures2(caps.physicalDevice, &features2);
+            caps.synchronization2 = caps.synchronization2Core = features13.synchronization2 == VK_TRUE;
+            return;
+        }
 
-        std::cout << '\n'
-                  << "Here are all avalilable device extensions:" << '\n';
-        for(const auto& extension : availableExtensions){
-            // 输出所有的availableExtensionsextensionName
-            std::cout << '\t' << extension.extensionName << '\n';
-            requiredExtensions.erase(extension.extensionName);
+        if (caps.extensions.count(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) == 0)
+        {
+            return;
         }
-        
-        return requiredExtensions.empty();
+        VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+        synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &synchronization2Features;
+        vkGetPhysicalDeviceFeatures2(caps.physicalDevice, &features2);
+        caps.synchronization2 = synchronization2Features.synchronization2 == VK_TRUE;
     }
 
-    // 给物理设备打分以选取最适合的设备
-    int rateDeviceSuitability(VkPhysicalDevice device)
+    //颜色与深度attachment共用采样数，取两者都支持且不超过requested的最大值
+    VkSampleCountFlagBits chooseMsaaSampleCount(const VkPhysicalDeviceProperties &deviceProperties, VkSampleCountFlagBits requested)
     {
-        int score = 0;
-
-        // 查询基本设备属性（名称、类型、Vulkan支持版本等）
-        VkPhysicalDeviceProperties deviceProperties;
-        vkGetPhysicalDeviceProperties(device, &deviceProperties);
-        // 查询设备特性（纹理压缩、64位浮点数、Multiviewport渲染等可选功能）
-        VkPhysicalDeviceFeatures deviceFeatures;
-        vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+        VkSampleCountFlags counts = deviceProperties.limits.framebufferColorSampleCounts & deviceProperties.limits.framebufferDepthSampleCounts;
+        const VkSampleCountFlagBits candidates[] = {VK_SAMPLE_COUNT_8_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT};
+        for (VkSampleCountFlagBits candidate : candidates)
+        {
+            if (candidate <= requested && (counts & candidate))
+            {
+                return candidate;
+            }
+        }
+        return VK_SAMPLE_COUNT_1_BIT;
+    }
 
-        // Discrete GPUs（独立显卡）拥有更高的性能，+1000分！
-        if (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+    //Additional check 检查设备的Swap chain extensions
+    bool checkDeviceExtensionSupport(const DeviceCapabilities &caps){
+        for (const char *extension : deviceExtensions)
         {
-            score += 1000;
+            if (caps.extensions.count(extension) == 0)
+            {
+                return false;
+            }
         }
+        return true;
+    }
 
-        // Textures size作为打分重要依据
-        score += deviceProperties.limits.maxImageDimension2D;
+    // 收集打分需要的设备信息，是否满足本程序的最低要求由isDeviceSuitable决定
+    DeviceCandidate describeDevice(const DeviceCapabilities &caps)
+    {
+        DeviceCandidate candidate;
+        candidate.name = caps.properties.deviceName;
+        candidate.deviceType = caps.properties.deviceType;
+        candidate.apiVersion = caps.properties.apiVersion;
+        candidate.maxImageDimension2D = caps.properties.limits.maxImageDimension2D;
 
-        // 一票否决项，不支持几何着色器的GPU直接0分！
-        if (!deviceFeatures.geometryShader)
+        for (uint32_t i = 0; i < caps.memoryProperties.memoryHeapCount; i++)
         {
-            return 0;
+            if (caps.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+            {
+                candidate.deviceLocalHeapSize = std::max(candidate.deviceLocalHeapSize, caps.memoryProperties.memoryHeaps[i].size);
+            }
         }
 
-        return score;
+        candidate.queueFamilies = caps.queueFamilies;
+        candidate.extensions.assign(caps.extensions.begin(), caps.extensions.end());
+        candidate.meetsRequirements = isDeviceSuitable(caps);
+        return candidate;
     }
 
     // 检查设备支持哪些Queue families，以及其中哪一个支持我们需要使用的命令
-    QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device)
+    QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, const std::vector<VkQueueFamilyProperties> &queueFamilies)
     {
         QueueFamilyIndices indices;
-        // Logic to find graphics queue family
-        uint32_t queueFamilyCount = 0;
-        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
-        int i = 0;
+        uint32_t i = 0;
         for (const auto &queueFamily : queueFamilies)
         {
             if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
@@ -572,17 +995,43 @@ private:
     VK_PRESENT_MODE_FIFO_RELAXED_KHR 程序延迟且队列在最后一个vertical blank时不同，不等待立即传输
     VK_PRESENT_MODE_MAILBOX_KHR 队满直接替换新图像，三重缓冲，避免撕裂同时低延迟
     */
+    //优先使用settings中指定的模式，不支持时回退到MAILBOX，FIFO是规范保证一定支持的
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
     {
-        for(const auto& availablePresentMode : availablePresentModes){
-            if(availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR){
-                return availablePresentMode;
+        auto isAvailable = [&](VkPresentModeKHR mode) {
+            return std::find(availablePresentModes.begin(), availablePresentModes.end(), mode) != availablePresentModes.end();
+        };
+
+        if (settings.presentMode.has_value())
+        {
+            if (isAvailable(settings.presentMode.value()))
+            {
+                return settings.presentMode.value();
             }
+            logStream(LogLevel::Warning) << "Present mode " << presentModeName(settings.presentMode.value()) << " is not supported, falling back\n";
+        }
+
+        if (isAvailable(VK_PRESENT_MODE_MAILBOX_KHR))
+        {
+            return VK_PRESENT_MODE_MAILBOX_KHR;
         }
 
         return VK_PRESENT_MODE_FIFO_KHR;
     }
 
+    //默认比最小值多一张，避免等待驱动释放image；指定值会被限制在surface支持的范围内
+    uint32_t chooseSwapImageCount(const VkSurfaceCapabilitiesKHR& capabilities)
+    {
+        uint32_t imageCount = settings.swapChainImageCount > 0 ? settings.swapChainImageCount : capabilities.minImageCount + 1;
+        imageCount = std::max(imageCount, capabilities.minImageCount);
+        //不要超过最大值，0表示没有最大值
+        if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount)
+        {
+            imageCount = capabilities.maxImageCount;
+        }
+        return imageCount;
+    }
+
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) 
     {
         //通过currentExtent来确认当前分辨率
@@ -590,8 +1039,11 @@ private:
             return capabilities.currentExtent;
         } else {
         //一些窗口管理器在currentExtent值为uint32_t的最大值时会选择minImageExtent与maxImageExtent之间最匹配的窗口分辨率
-            int width, height;
-            glfwGetFramebufferSize(window, &width, &height);
+            int width = WIDTH, height = HEIGHT;
+            if (window != nullptr)
+            {
+                glfwGetFramebufferSize(window, &width, &height);
+            }
 
             VkExtent2D actualExtent = {
                 static_cast<uint32_t>(width),
@@ -608,7 +1060,7 @@ private:
 
     void createLogicalDevice()
     {
-        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        const QueueFamilyIndices &indices = deviceCaps.queueFamilyIndices;
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(),indices.presentFamily.value()};
@@ -628,20 +1080,76 @@ private:
         
         // 指定将使用的Device features
         VkPhysicalDeviceFeatures deviceFeatures{};
+        // 压缩纹理格式：设备支持哪些就全部启用，加载KTX2时再按格式支持情况选择转码目标
+        deviceFeatures.textureCompressionBC = deviceCaps.features.textureCompressionBC;
+        deviceFeatures.textureCompressionETC2 = deviceCaps.features.textureCompressionETC2;
+        deviceFeatures.textureCompressionASTC_LDR = deviceCaps.features.textureCompressionASTC_LDR;
+        // --metrics需要pipeline statistics；缓存的secondary command buffer在query中执行还需要inheritedQueries
+        if (Config::profiling && !settings.metricsTargets.empty())
+        {
+            deviceFeatures.pipelineStatisticsQuery = deviceCaps.features.pipelineStatisticsQuery;
+            deviceFeatures.inheritedQueries = deviceCaps.features.inheritedQueries;
+        }
+        pipelineStatisticsEnabled = deviceFeatures.pipelineStatisticsQuery == VK_TRUE;
+        inheritedQueriesEnabled = deviceFeatures.inheritedQueries == VK_TRUE;
+
+        // 1.3与扩展特性通过pNext链启用
+        void *featureChain = nullptr;
+        VkPhysicalDeviceVulkan13Features features13{};
+        features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        features13.dynamicRendering = dynamicRenderingEnabled ? VK_TRUE : VK_FALSE;
+        features13.synchronization2 = deviceCaps.synchronization2Core ? VK_TRUE : VK_FALSE;
+        if (dynamicRenderingEnabled || deviceCaps.synchronization2Core)
+        {
+            features13.pNext = featureChain;
+            featureChain = &features13;
+        }
+
+        std::vector<const char*> enabledExtensions(deviceExtensions.begin(), deviceExtensions.end());
+        VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+        synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+        synchronization2Features.synchronization2 = VK_TRUE;
+        if (deviceCaps.synchronization2 && !deviceCaps.synchronization2Core)
+        {
+            enabledExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+            synchronization2Features.pNext = featureChain;
+            featureChain = &synchronization2Features;
+        }
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        presentIdFeatures.presentId = VK_TRUE;
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        presentWaitFeatures.presentWait = VK_TRUE;
+        if (presentWaitEnabled)
+        {
+            enabledExtensions.insert(enabledExtensions.end(), presentWaitExtensions.begin(), presentWaitExtensions.end());
+            presentIdFeatures.pNext = featureChain;
+            presentWaitFeatures.pNext = &presentIdFeatures;
+            featureChain = &presentWaitFeatures;
+        }
+
+        //查询显存预算需要1.1的vkGetPhysicalDeviceMemoryProperties2
+        memoryBudgetEnabled = instanceApiVersion >= VK_API_VERSION_1_1 && deviceCaps.extensions.count(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) > 0;
+        if (memoryBudgetEnabled)
+        {
+            enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
 
         // 使用前两个结构以及其他信息来填充VkDeviceCreateInfo主体结构以创建逻辑设备
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = featureChain;
         //Queue
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         //Features
         createInfo.pEnabledFeatures = &deviceFeatures;
         //Extensions
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
         //Layers(.enabledLayerCount & .ppEnabledLayerNames are Out of date in new Vulkan)
-        if (enableValidationLayers){
+        if constexpr (enableValidationLayers){
             createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
             createInfo.ppEnabledLayerNames = validationLayers.data();
         }
@@ -657,23 +1165,65 @@ private:
         //创建Queue handles。参数为逻辑设备、QueueFamily、队列索引、存储句柄的指针
         vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
         vkGetDeviceQueue(device, indices.presentFamily.value(),0,&presentQueue);
+
+        if (dynamicRenderingEnabled)
+        {
+            //直接从device取函数指针，避免依赖loader导出1.3符号
+            pfnCmdBeginRendering = (PFN_vkCmdBeginRendering)vkGetDeviceProcAddr(device, "vkCmdBeginRendering");
+            pfnCmdEndRendering = (PFN_vkCmdEndRendering)vkGetDeviceProcAddr(device, "vkCmdEndRendering");
+            if (pfnCmdBeginRendering == nullptr || pfnCmdEndRendering == nullptr)
+            {
+                throw std::runtime_error("=====Failed to load dynamic rendering functions!=====");
+            }
+        }
+
+        synchronization2.load(device, deviceCaps.synchronization2, deviceCaps.synchronization2Core);
+        queueSubmitter.create(synchronization2);
+
+        if (presentWaitEnabled)
+        {
+            pfnWaitForPresentKHR = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(device, "vkWaitForPresentKHR");
+            presentWaitEnabled = pfnWaitForPresentKHR != nullptr;
+        }
+    }
+
+    //在createSwapChain之前决定，swap chain需要额外的TRANSFER_DST usage
+    void createDynamicResolution()
+    {
+        if (settings.dynamicResolutionMs <= 0.0)
+        {
+            return;
+        }
+        const SwapChainSupportDetails &swapChainSupport = deviceCaps.swapChainSupport;
+        VkFormat format = chooseSwapSurfaceFormat(swapChainSupport.formats).format;
+        if ((swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) == 0 ||
+            !DynamicResolution::isSupported(deviceCaps.physicalDevice, format))
+        {
+            logStream(LogLevel::Warning) << "Swap chain format cannot be upscaled into, dynamic resolution disabled\n";
+            return;
+        }
+
+        dynamicResolution.create(device, synchronization2, deviceCaps.memoryProperties, "shader");
+        ResolutionController::Config config;
+        config.targetMs = settings.dynamicResolutionMs;
+        resolutionController.setConfig(config);
+        dynamicResolutionEnabled = true;
+        logStream(LogLevel::Info) << "Dynamic resolution: target " << settings.dynamicResolutionMs << " ms GPU time\n";
     }
 
     //Behind create logic device
     void createSwapChain()
     {
-        SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
+        //formats与present modes在pickPhysicalDevice时已缓存，只有capabilities会随窗口大小变化
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &deviceCaps.swapChainSupport.capabilities);
+        const SwapChainSupportDetails &swapChainSupport = deviceCaps.swapChainSupport;
 
         VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
         VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
         VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
     
         //决定在SwapChain中拥有多少个图像
-        uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-        //不要超过最大值，0表示没有最大值
-        if(swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount){
-            imageCount = swapChainSupport.capabilities.maxImageCount;
-        }
+        uint32_t imageCount = chooseSwapImageCount(swapChainSupport.capabilities);
 
         //Create swap chain,fill in a struct
         VkSwapchainCreateInfoKHR createInfo{};
@@ -687,8 +1237,19 @@ private:
         createInfo.imageArrayLayers = 1;
         //使用swap chain中的图像用作什么操作，下为直接渲染，用作color attachment
         createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        //捕获时需要从swap chain image拷贝出来
+        bool captureSupported = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+        if (frameCapture.enabled() && captureSupported)
+        {
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
+        //动态分辨率时场景渲染到单独的target，swap chain image只作为blit的目标
+        if (dynamicResolutionEnabled)
+        {
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        }
     
-        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        const QueueFamilyIndices &indices = deviceCaps.queueFamilyIndices;
         uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
 
         //指定如何处理在多个queue families中使用swap chain image
@@ -728,87 +1289,300 @@ private:
         //Store as member variables
         swapChainImageFormat = surfaceFormat.format;
         swapChainExtent = extent;
+        swapChainPresentMode = presentMode;
+        swapChainVersion++;
+        logStream(LogLevel::Info) << "Swap chain: " << presentModeName(presentMode) << ", " << imageCount << " images\n";
+
+        if (frameCapture.enabled())
+        {
+            if (!captureSupported)
+            {
+                logStream(LogLevel::Warning) << "Swap chain images cannot be used as a transfer source, frame capture disabled\n";
+            }
+            frameCapture.resize(extent, captureSupported ? surfaceFormat.format : VK_FORMAT_UNDEFINED);
+        }
+        if (dynamicResolutionEnabled)
+        {
+            dynamicResolution.resize(extent, surfaceFormat.format);
+        }
+
+        //renderFinished semaphore与swap chain image一一对应
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        renderFinishedSemaphores.resize(swapChainImages.size());
+        for (auto &semaphore : renderFinishedSemaphores)
+        {
+            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS)
+            {
+                throw std::runtime_error("=====Failed to create semaphores!=====");
+            }
+        }
     }
 
     void createImageViews()
     {
         swapChainImageViews.resize(swapChainImages.size());
         for(size_t i = 0; i<swapChainImages.size();i++){
-            VkImageViewCreateInfo createInfo{};
-            createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-            createInfo.image = swapChainImages[i];
-            //将图像视为2D纹理
-            createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-            createInfo.format = swapChainImageFormat;
-            //to swizzle the color channels around
-            createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-            createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-            createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-            createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-            //Image's purpose
-            createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            createInfo.subresourceRange.baseMipLevel = 0;
-            createInfo.subresourceRange.levelCount = 1;
-            createInfo.subresourceRange.baseArrayLayer = 0;
-            createInfo.subresourceRange.layerCount = 1;
-
-            if(vkCreateImageView(device,&createInfo,nullptr, &swapChainImageViews[i]) != VK_SUCCESS){
-                throw std::runtime_error("=====Failed to create image view!=====");
-            }
+            swapChainImageViews[i] = createImageView(swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
         }
     
     }
 
-    VkShaderModule createShaderModule(const std::vector<char>& code){
-        VkShaderModuleCreateInfo createInfo{};
-        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data()); 
-        VkShaderModule shaderModule;
-        if(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS){
-            throw std::runtime_error("=====Failed to create shader module!=====");
+    VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+    {
+        VkImageViewCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        createInfo.image = image;
+        //将图像视为2D纹理
+        createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        createInfo.format = format;
+        //to swizzle the color channels around
+        createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        //Image's purpose
+        createInfo.subresourceRange.aspectMask = aspectFlags;
+        createInfo.subresourceRange.baseMipLevel = 0;
+        createInfo.subresourceRange.levelCount = 1;
+        createInfo.subresourceRange.baseArrayLayer = 0;
+        createInfo.subresourceRange.layerCount = 1;
+
+        VkImageView imageView;
+        if(vkCreateImageView(device,&createInfo,nullptr, &imageView) != VK_SUCCESS){
+            throw std::runtime_error("=====Failed to create image view!=====");
         }
-        return shaderModule;
+        return imageView;
     }
 
-    void createRenderPass(){
-        //指定渲染时使用多少颜色和深度缓冲区，每个缓冲区多少samples
-        VkAttachmentDescription colorAttachment{};
-        colorAttachment.format = swapChainImageFormat;
-        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        //How to deal with the data in the attachment
-        //Color and depth
-        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-        //Stencil
-        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    
-        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    //在显卡提供的memory types中找到满足typeFilter与属性要求的类型
+    std::optional<uint32_t> findMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+    {
+        const VkPhysicalDeviceMemoryProperties &memProperties = deviceCaps.memoryProperties;
 
-        //Subpass and attachment references
-        VkAttachmentReference colorAttachmentRef{};
-        colorAttachmentRef.attachment = 0;
-        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+        {
+            if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+            {
+                return i;
+            }
+        }
+        return std::nullopt;
+    }
 
-        VkSubpassDescription subpass{};
-        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        subpass.colorAttachmentCount = 1;
-        subpass.pColorAttachments = &colorAttachmentRef;
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+    {
+        std::optional<uint32_t> index = findMemoryTypeIndex(typeFilter, properties);
+        if (!index.has_value())
+        {
+            throw std::runtime_error("=====Failed to find suitable memory type!=====");
+        }
+        return index.value();
+    }
+
+    //创建image并为其分配、绑定一块专用的device memory
+    void createImage(uint32_t width, uint32_t height, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling,
+        VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
+    {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = width;
+        imageInfo.extent.height = height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = format;
+        imageInfo.tiling = tiling;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = usage;
+        imageInfo.samples = numSamples;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+        {
+            throw std::runtime_error("=====Failed to create image!=====");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+        //LAZILY_ALLOCATED一般只有tile-based GPU提供，桌面GPU上退回普通的device local内存
+        if ((properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) &&
+            !findMemoryTypeIndex(memRequirements.memoryTypeBits, properties).has_value())
+        {
+            properties &= ~VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+        }
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
+        {
+            throw std::runtime_error("=====Failed to allocate image memory!=====");
+        }
+
+        vkBindImageMemory(device, image, imageMemory, 0);
+    }
+
+    //按优先级返回第一个支持所需features的格式
+    VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features)
+    {
+        for (VkFormat format : candidates)
+        {
+            VkFormatProperties props;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+
+            if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features)
+            {
+                return format;
+            }
+            else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features)
+            {
+                return format;
+            }
+        }
+
+        throw std::runtime_error("=====Failed to find supported format!=====");
+    }
+
+    //Reverse-Z需要浮点深度才能发挥精度优势，D32优先，D24S8兜底
+    VkFormat findDepthFormat()
+    {
+        return findSupportedFormat(
+            {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    }
+
+    bool hasStencilComponent(VkFormat format)
+    {
+        return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+    }
+
+    //深度缓冲与swap chain同尺寸，随swap chain一起重建
+    //内容从不写回内存，声明为transient，tile-based GPU上可以完全不分配物理内存
+    void createDepthResources()
+    {
+        depthFormat = findDepthFormat();
+
+        createImage(swapChainExtent.width, swapChainExtent.height, msaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+            depthImage, depthImageMemory);
+        depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+    }
+
+    //多重采样的color target只在tile上存在，subpass结束时resolve到swap chain image
+    //storeOp为DONT_CARE，不需要把完整的多采样数据写回显存
+    void createColorResources()
+    {
+        if (msaaSamples == VK_SAMPLE_COUNT_1_BIT)
+        {
+            return;
+        }
+
+        createImage(swapChainExtent.width, swapChainExtent.height, msaaSamples, swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+            colorImage, colorImageMemory);
+        colorImageView = createImageView(colorImage, swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+
+    VkShaderModule createShaderModule(const std::vector<char>& code){
+        VkShaderModuleCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        createInfo.codeSize = code.size();
+        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data()); 
+        VkShaderModule shaderModule;
+        if(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS){
+            throw std::runtime_error("=====Failed to create shader module!=====");
+        }
+        return shaderModule;
+    }
 
+    void createRenderPass(){
+        bool msaaEnabled = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+
+        //指定渲染时使用多少颜色和深度缓冲区，每个缓冲区多少samples
+        VkAttachmentDescription colorAttachment{};
+        colorAttachment.format = swapChainImageFormat;
+        colorAttachment.samples = msaaSamples;
+        //How to deal with the data in the attachment
+        //Color and depth
+        //开启MSAA时多采样图像在subpass末尾resolve后即可丢弃
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = msaaEnabled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+        //Stencil
+        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    
+        //动态分辨率时最终的color target是场景target，之后由upscale读取，保持COLOR_ATTACHMENT_OPTIMAL
+        VkImageLayout outputLayout = dynamicResolutionEnabled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachment.finalLayout = msaaEnabled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : outputLayout;
+
+        //Resolve attachment，即swap chain image(动态分辨率时为场景target)
+        VkAttachmentDescription colorAttachmentResolve{};
+        colorAttachmentResolve.format = swapChainImageFormat;
+        colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachmentResolve.finalLayout = outputLayout;
+
+        //Depth attachment
+        //深度只在本帧内使用，storeOp为DONT_CARE，tile-based GPU上不必写回内存
+        VkAttachmentDescription depthAttachment{};
+        depthAttachment.format = depthFormat;
+        depthAttachment.samples = msaaSamples;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        //Subpass and attachment references
+        VkAttachmentReference colorAttachmentRef{};
+        colorAttachmentRef.attachment = 0;
+        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference depthAttachmentRef{};
+        depthAttachmentRef.attachment = 1;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference colorAttachmentResolveRef{};
+        colorAttachmentResolveRef.attachment = 2;
+        colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorAttachmentRef;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+        //resolve在subpass结束时于tile memory中完成
+        subpass.pResolveAttachments = msaaEnabled ? &colorAttachmentResolveRef : nullptr;
+
+        //深度缓冲与多重采样的color target在帧之间复用，需要等上一帧的写入完成再清除
         VkSubpassDependency dependency{};
         dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
         dependency.dstSubpass = 0;
-        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.srcAccessMask = 0;
-        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
+        //不开MSAA时只用前两个
+        std::array<VkAttachmentDescription, 3> attachments = {colorAttachment, depthAttachment, colorAttachmentResolve};
         VkRenderPassCreateInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        renderPassInfo.attachmentCount = 1;
-        renderPassInfo.pAttachments = &colorAttachment;
+        renderPassInfo.attachmentCount = msaaEnabled ? 3 : 2;
+        renderPassInfo.pAttachments = attachments.data();
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
         renderPassInfo.dependencyCount = 1;
@@ -821,8 +1595,8 @@ private:
     }
 
     void createGraphicsPipeline(){
-        auto vertShaderCode = readFile("../shader/vert.spv");
-        auto fragShaderCode = readFile("../shader/frag.spv");
+        auto vertShaderCode = readFile("shader/vert.spv");
+        auto fragShaderCode = readFile("shader/frag.spv");
 
         //we're allowed to destroy the shader modules again as soon as pipeline creation is finished
         VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
@@ -843,9 +1617,18 @@ private:
         fragShaderStageInfo.pName = "main";
 
         VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo,fragShaderStageInfo};
+
+        //Specialization constants：质量档位决定代入fragment shader的常量，不同变体共用同一份SPIR-V
+        SpecializationConstants opaqueConstants;
+        opaqueConstants.set(FragmentConstantTextured, settings.shaderQuality != ShaderQuality::Low);
+        opaqueConstants.set(FragmentConstantTextureTaps, settings.shaderQuality == ShaderQuality::High ? 4 : 1);
+        //预渲染不输出颜色，关闭纹理后fragment shader被折叠为空
+        SpecializationConstants depthOnlyConstants;
+        depthOnlyConstants.set(FragmentConstantTextured, false);
+        depthOnlyConstants.set(FragmentConstantTextureTaps, 1);
     
         //Dynamic state
-        std::vector<VkDynamicState> dynamicStates = {
+        std::array<VkDynamicState, 2> dynamicStates = {
             VK_DYNAMIC_STATE_VIEWPORT,
             VK_DYNAMIC_STATE_SCISSOR
         };
@@ -917,14 +1700,25 @@ private:
         VkPipelineMultisampleStateCreateInfo multisampling{};
         multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
         multisampling.sampleShadingEnable = VK_FALSE;
-        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        multisampling.rasterizationSamples = msaaSamples;
         multisampling.minSampleShading = 1.0f;
         multisampling.pSampleMask = nullptr;
         multisampling.alphaToCoverageEnable = VK_FALSE;
         multisampling.alphaToOneEnable = VK_FALSE;
 
         //Depth and stencil testing
+        //Reverse-Z：近平面映射到1、远平面映射到0，清除为0并用GREATER比较
+        //浮点深度的精度集中在0附近，正好抵消透视除法带来的远处精度损失
+        //fragment shader不写gl_FragDepth也不discard，驱动可以做early-Z剔除
         VkPipelineDepthStencilStateCreateInfo depthstencil{};
+        depthstencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depthstencil.depthTestEnable = VK_TRUE;
+        depthstencil.depthWriteEnable = VK_TRUE;
+        depthstencil.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+        depthstencil.depthBoundsTestEnable = VK_FALSE;
+        depthstencil.minDepthBounds = 0.0f; // Optional
+        depthstencil.maxDepthBounds = 1.0f; // Optional
+        depthstencil.stencilTestEnable = VK_FALSE;
 
         //Color blending
         //Two ways:1.Mix 2.Combine using a bitwise operation
@@ -975,8 +1769,8 @@ private:
         //Change uniform values in shaders, specifies push constants
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 0; // Optional
-        pipelineLayoutInfo.pSetLayouts = nullptr; // Optional
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
         pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
         pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
         if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
@@ -992,19 +1786,62 @@ private:
         pipelineInfo.pViewportState = &viewportState;
         pipelineInfo.pRasterizationState = &rasterizer;
         pipelineInfo.pMultisampleState = &multisampling;
-        pipelineInfo.pDepthStencilState = nullptr; // Optional
+        pipelineInfo.pDepthStencilState = &depthstencil;
         pipelineInfo.pColorBlendState = &colorBlending;
         pipelineInfo.pDynamicState = &dynamicState;
         pipelineInfo.layout = pipelineLayout;
         pipelineInfo.renderPass = renderPass;
         pipelineInfo.subpass = 0;
+
+        //Dynamic rendering没有render pass，attachment格式通过pNext告诉pipeline
+        VkPipelineRenderingCreateInfo renderingCreateInfo{};
+        renderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+        renderingCreateInfo.colorAttachmentCount = 1;
+        renderingCreateInfo.pColorAttachmentFormats = &swapChainImageFormat;
+        renderingCreateInfo.depthAttachmentFormat = depthFormat;
+        renderingCreateInfo.stencilAttachmentFormat = hasStencilComponent(depthFormat) ? depthFormat : VK_FORMAT_UNDEFINED;
+        if (dynamicRenderingEnabled)
+        {
+            pipelineInfo.pNext = &renderingCreateInfo;
+            pipelineInfo.renderPass = VK_NULL_HANDLE;
+        }
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
         pipelineInfo.basePipelineIndex = -1; // Optional
 
-        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-            throw std::runtime_error("=====Failed to create graphics pipeline!=====");
+        //缓存未命中时由它创建：把specialization info填进两个stage，其余状态与pipelineInfo相同
+        auto buildVariant = [&](const char *name) {
+            return [&, name](const VkSpecializationInfo *specialization, VkPipelineCache pipelineCache) {
+                shaderStages[0].pSpecializationInfo = specialization;
+                shaderStages[1].pSpecializationInfo = specialization;
+                VkPipeline pipeline;
+                if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+                    throw std::runtime_error(std::string("=====Failed to create ") + name + " pipeline!=====");
+                }
+                return pipeline;
+            };
+        };
+        pipelineVariants.create(device);
+
+        if constexpr (enableDepthPrepass)
+        {
+            //预渲染pipeline只写深度，关闭颜色输出
+            VkPipelineColorBlendAttachmentState depthOnlyBlendAttachment = colorBlendAttachment;
+            depthOnlyBlendAttachment.colorWriteMask = 0;
+            colorBlending.pAttachments = &depthOnlyBlendAttachment;
+
+            depthPrepassPipeline = pipelineVariants.get({DrawPipelineDepthPrepass, depthOnlyConstants}, buildVariant("depth prepass"));
+
+            //着色pass只处理深度与预渲染结果相等的fragment，不再写深度
+            colorBlending.pAttachments = &colorBlendAttachment;
+            depthstencil.depthWriteEnable = VK_FALSE;
+            depthstencil.depthCompareOp = VK_COMPARE_OP_EQUAL;
         }
 
+        graphicsPipeline = pipelineVariants.get({DrawPipelineOpaque, opaqueConstants}, buildVariant("graphics"));
+        pipelineVersion++;
+        logStream(LogLevel::Verbose) << "Shader quality " << shaderQualityName(settings.shaderQuality) << ", "
+            << pipelineVariants.size() << " pipeline variants\n";
+
         //Destroy shader moudule
         vkDestroyShaderModule(device, fragShaderModule, nullptr);
         vkDestroyShaderModule(device, vertShaderModule, nullptr);
@@ -1015,15 +1852,28 @@ private:
         swapChainFramebuffers.resize(swapChainImageViews.size());
 
         for(size_t i = 0; i< swapChainImageViews.size(); i++){
-            VkImageView attachments[] = {
-                swapChainImageViews[i]
-            };
+            //所有framebuffer共用同一个深度缓冲，同一时间只有一个subpass在使用
+            //顺序与createRenderPass中的attachments一致
+            std::array<VkImageView, 3> attachments;
+            uint32_t attachmentCount;
+            //动态分辨率时渲染到场景target，swap chain image由blit写入
+            VkImageView outputView = dynamicResolutionEnabled ? dynamicResolution.sceneView() : swapChainImageViews[i];
+            if (msaaSamples != VK_SAMPLE_COUNT_1_BIT)
+            {
+                attachments = {colorImageView, depthImageView, outputView};
+                attachmentCount = 3;
+            }
+            else
+            {
+                attachments = {outputView, depthImageView, VK_NULL_HANDLE};
+                attachmentCount = 2;
+            }
 
             VkFramebufferCreateInfo framebufferInfo{};
             framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
             framebufferInfo.renderPass = renderPass;
-            framebufferInfo.attachmentCount = 1;
-            framebufferInfo.pAttachments = attachments;
+            framebufferInfo.attachmentCount = attachmentCount;
+            framebufferInfo.pAttachments = attachments.data();
             framebufferInfo.width = swapChainExtent.width;
             framebufferInfo.height = swapChainExtent.height;
             framebufferInfo.layers = 1;
@@ -1035,7 +1885,7 @@ private:
     }
 
     void createCommandPool(){
-        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+        const QueueFamilyIndices &queueFamilyIndices = deviceCaps.queueFamilyIndices;
 
         VkCommandPoolCreateInfo poolInfo{};
         poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -1050,18 +1900,132 @@ private:
         }
     }
 
-    void createCommandBuffer(){
+    //binding 0：fragment shader采样的纹理
+    void createDescriptorSetLayout()
+    {
+        VkDescriptorSetLayoutBinding samplerLayoutBinding{};
+        samplerLayoutBinding.binding = 0;
+        samplerLayoutBinding.descriptorCount = 1;
+        samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        samplerLayoutBinding.pImmutableSamplers = nullptr;
+        samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &samplerLayoutBinding;
+
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("=====Failed to create descriptor set layout!=====");
+        }
+    }
+
+    void createTextures()
+    {
+        TextureStreamer::Config config;
+        config.budgetBytes = static_cast<VkDeviceSize>(settings.textureBudgetMb * 1024.0 * 1024.0);
+        textureStreamer.create(physicalDevice, device, synchronization2, memoryBudgetEnabled, MAX_FRAMES_IN_FLIGHT, config);
+
+        if (!settings.texturePath.empty())
+        {
+            auto isFormatSupported = [this](VkFormat format)
+            {
+                VkFormatProperties properties;
+                vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+                return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+            };
+            demoTexture = textureStreamer.addTexture(createKtx2Texture(settings.texturePath, isFormatSupported));
+            return;
+        }
+
+        //2048x2048的演示纹理，启动时只有64x64及以下的mip常驻
+        demoTexture = textureStreamer.addTexture(createCheckerboardTexture(2048));
+    }
+
+    void createDescriptorPool()
+    {
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("=====Failed to create descriptor pool!=====");
+        }
+    }
+
+    //set的内容在录制每帧时写入，因为纹理的image view会随常驻级别变化
+    void createDescriptorSets()
+    {
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        allocInfo.pSetLayouts = layouts.data();
+
+        descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+        if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS)
+        {
+            throw std::runtime_error("=====Failed to allocate descriptor sets!=====");
+        }
+    }
+
+    //流式更新之后写入本帧的descriptor set；该set上一次的使用已随fence完成
+    //只在纹理的image view变化时写入：写入会使绑定了该set的command buffer失效
+    void updateTextureDescriptor(uint32_t frame)
+    {
+        VkImageView imageView = textureStreamer.imageView(demoTexture);
+        if (imageView == descriptorImageViews[frame])
+        {
+            return;
+        }
+        descriptorImageViews[frame] = imageView;
+        descriptorVersions[frame]++;
+
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = imageView;
+        imageInfo.sampler = textureStreamer.sampler();
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = descriptorSets[frame];
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pImageInfo = &imageInfo;
+
+        vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+    }
+
+    void createCommandBuffers(){
+        commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.commandPool = commandPool;
         //Primary:Can be submitted to a queue
         //Secondary:Can be cakked from primary command buffers
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = 1;
+        allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
 
-        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
             throw std::runtime_error("=====Failed to allocate command buffers!=====");
         }
+
+        if (settings.cacheCommands)
+        {
+            commandCache.create(device, commandPool, MAX_FRAMES_IN_FLIGHT);
+        }
     }
 
     void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex){
@@ -1075,49 +2039,348 @@ private:
             throw std::runtime_error("=====Failed to begin recording command buffer!=====");
         }
 
-        //Starting a render pass
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = renderPass;
-        renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
-        //定义渲染区域大小，之外的像素undefined
-        renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = swapChainExtent;
+        if (timestampQueryPool != VK_NULL_HANDLE)
+        {
+            vkCmdResetQueryPool(commandBuffer, timestampQueryPool, currentFrame * 2, 2);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, currentFrame * 2);
+        }
+        if constexpr (Config::profiling)
+        {
+            frameMetrics.beginFrame(commandBuffer, currentFrame);
+        }
+        //缓存的secondary command buffer在query中执行需要inheritedQueries，不支持时不统计scene
+        bool measureScene = !settings.cacheCommands || inheritedQueriesEnabled;
+
+        //比例在录制时固定，GPU时间读回后按同一个比例换算
+        frameResolutionScales[currentFrame] = dynamicResolutionEnabled ? resolutionController.scale() : 1.0f;
+        renderExtent = dynamicResolutionEnabled ? dynamicResolution.renderExtent(frameResolutionScales[currentFrame]) : swapChainExtent;
+
+        //三角形的UV覆盖NDC中[-0.5, 0.5]，即屏幕长边的一半，据此决定需要的mip
+        //动态分辨率下按实际渲染的尺寸选择，缩小时少加载一级
+        float textureScreenSize = 0.5f * static_cast<float>(std::max(renderExtent.width, renderExtent.height));
+        textureStreamer.requestScreenSize(demoTexture, textureScreenSize);
+        textureStreamer.recordUpdates(commandBuffer, currentFrame, frameArena.current());
+        updateTextureDescriptor(currentFrame);
+        buildDrawList();
+
+        //clearValues的顺序与attachments一致；reverse-Z下深度清除为0(远平面)
+        std::array<VkClearValue, 2> clearValues{};
+        clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+        clearValues[1].depthStencil = {0.0f, 0};
+
+        bool msaaEnabled = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+
+        //场景target的旧内容在上一帧的upscale读完之后才能覆盖
+        VkImageView outputView = swapChainImageViews[imageIndex];
+        if (dynamicResolutionEnabled)
+        {
+            dynamicResolution.recordBeginScene(commandBuffer, dynamicRenderingEnabled);
+            outputView = dynamicResolution.sceneView();
+        }
+
+        if (dynamicRenderingEnabled)
+        {
+            //没有render pass帮忙做layout转换，需要显式的image barrier
+            //srcStage与imageAvailableSemaphore的等待阶段一致，保证acquire之后才写入
+            if (!dynamicResolutionEnabled)
+            {
+                transitionImageLayout(commandBuffer, swapChainImages[imageIndex],
+                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                    VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE,
+                    VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+            }
+            //深度缓冲每帧都会清除，旧内容可以丢弃；等待上一帧的深度写入完成
+            transitionImageLayout(commandBuffer, depthImage,
+                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                hasStencilComponent(depthFormat) ? (VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT) : VK_IMAGE_ASPECT_DEPTH_BIT);
+            //多重采样的color target所有帧共用，与深度一样要等待上一帧的写入完成
+            if (msaaEnabled)
+            {
+                transitionImageLayout(commandBuffer, colorImage,
+                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                    VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+            }
 
-        VkClearValue clearColor = {{{0.0f,0.0f,0.0f,1.0f}}};
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
+            VkRenderingAttachmentInfo colorAttachment{};
+            colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+            colorAttachment.imageView = outputView;
+            colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            colorAttachment.clearValue = clearValues[0];
+            if (msaaEnabled)
+            {
+                //渲染到多采样图像，rendering结束时平均resolve到swap chain image
+                colorAttachment.imageView = colorImageView;
+                colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+                colorAttachment.resolveImageView = outputView;
+                colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            }
 
-        //vkCmd前缀的函数用于记录commands
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-        
+            VkRenderingAttachmentInfo depthAttachment{};
+            depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+            depthAttachment.imageView = depthImageView;
+            depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            depthAttachment.clearValue = clearValues[1];
+
+            VkRenderingInfo renderingInfo{};
+            renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+            renderingInfo.renderArea.offset = {0, 0};
+            renderingInfo.renderArea.extent = renderExtent;
+            renderingInfo.layerCount = 1;
+            renderingInfo.colorAttachmentCount = 1;
+            renderingInfo.pColorAttachments = &colorAttachment;
+            renderingInfo.pDepthAttachment = &depthAttachment;
+            if (settings.cacheCommands)
+            {
+                renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+            }
+
+            beginMetricsPass(commandBuffer, scenePass, measureScene);
+            pfnCmdBeginRendering(commandBuffer, &renderingInfo);
+            countApiCall(ApiCall::BeginRenderPass);
+            if (settings.cacheCommands)
+            {
+                executeCachedDrawCommands(commandBuffer);
+            }
+            else
+            {
+                recordDrawCommands(commandBuffer);
+            }
+            pfnCmdEndRendering(commandBuffer);
+            endMetricsPass(commandBuffer, scenePass, measureScene);
+
+            if (dynamicResolutionEnabled)
+            {
+                recordUpscale(commandBuffer, imageIndex);
+            }
+            else
+            {
+                //捕获时拷贝顺带完成到PRESENT_SRC的转换
+                bool captured = frameCapture.wantsFrame(frameNumber) &&
+                    frameCapture.recordCopy(commandBuffer, currentFrame, frameNumber, swapChainImages[imageIndex],
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+                if (!captured)
+                {
+                    transitionImageLayout(commandBuffer, swapChainImages[imageIndex],
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+                }
+            }
+        }
+        else
+        {
+            //Starting a render pass
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = renderPass;
+            renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+            //定义渲染区域大小，之外的像素undefined
+            renderPassInfo.renderArea.offset = {0, 0};
+            renderPassInfo.renderArea.extent = renderExtent;
+
+            renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+            renderPassInfo.pClearValues = clearValues.data();
+
+            //vkCmd前缀的函数用于记录commands
+            beginMetricsPass(commandBuffer, scenePass, measureScene);
+            countApiCall(ApiCall::BeginRenderPass);
+            if (settings.cacheCommands)
+            {
+                vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                executeCachedDrawCommands(commandBuffer);
+            }
+            else
+            {
+                vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+                recordDrawCommands(commandBuffer);
+            }
+            vkCmdEndRenderPass(commandBuffer);
+            endMetricsPass(commandBuffer, scenePass, measureScene);
+
+            if (dynamicResolutionEnabled)
+            {
+                recordUpscale(commandBuffer, imageIndex);
+            }
+            //render pass结束时已经是PRESENT_SRC，拷贝完再转回去
+            else if (frameCapture.wantsFrame(frameNumber))
+            {
+                frameCapture.recordCopy(commandBuffer, currentFrame, frameNumber, swapChainImages[imageIndex],
+                    VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+            }
+        }
+
+        if (timestampQueryPool != VK_NULL_HANDLE)
+        {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, currentFrame * 2 + 1);
+        }
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+    }
+
+    //--metrics的pass query，关闭profiling时整个调用在编译期去掉
+    void beginMetricsPass(VkCommandBuffer commandBuffer, uint32_t pass, bool measured = true)
+    {
+        if constexpr (Config::profiling)
+        {
+            if (measured)
+            {
+                frameMetrics.beginPass(commandBuffer, currentFrame, pass);
+            }
+        }
+    }
+
+    void endMetricsPass(VkCommandBuffer commandBuffer, uint32_t pass, bool measured = true)
+    {
+        if constexpr (Config::profiling)
+        {
+            if (measured)
+            {
+                frameMetrics.endPass(commandBuffer, currentFrame, pass);
+            }
+        }
+    }
+
+    //场景target放大到swap chain image，然后捕获或直接转为PRESENT_SRC
+    void recordUpscale(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+    {
+        beginMetricsPass(commandBuffer, upscalePass);
+        dynamicResolution.recordUpscale(commandBuffer, renderExtent, swapChainImages[imageIndex], static_cast<float>(settings.upscaleSharpness));
+        endMetricsPass(commandBuffer, upscalePass);
+        bool captured = frameCapture.wantsFrame(frameNumber) &&
+            frameCapture.recordCopy(commandBuffer, currentFrame, frameNumber, swapChainImages[imageIndex],
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+        if (!captured)
+        {
+            transitionImageLayout(commandBuffer, swapChainImages[imageIndex],
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+        }
+    }
+
+    //两种渲染路径共用的绘制命令，只绘制到本帧的渲染区域
+    void recordDrawCommands(VkCommandBuffer commandBuffer){
         VkViewport viewport{};
         viewport.x = 0.0f;
         viewport.y = 0.0f;
-        viewport.width = static_cast<float>(swapChainExtent.width);
-        viewport.height = static_cast<float>(swapChainExtent.height);
+        viewport.width = static_cast<float>(renderExtent.width);
+        viewport.height = static_cast<float>(renderExtent.height);
         viewport.minDepth = 0.0f;
         viewport.maxDepth = 1.0f;
         vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
         VkRect2D scissor{};
         scissor.offset = {0, 0};
-        scissor.extent = swapChainExtent;
+        scissor.extent = renderExtent;
         vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-        //(,vertexCount,instanceCount,firstVertex(offset),firstInstance(offset))
-        vkCmdDraw(commandBuffer,3,1,0,0);
+        drawList.record(commandBuffer, drawResources);
+    }
 
-        vkCmdEndRenderPass(commandBuffer);
+    //每帧重新生成并排序，内容哈希不变时缓存的secondary command buffer继续有效
+    void buildDrawList()
+    {
+        drawList.clear();
+        DrawKeyFields triangle;
+        triangle.descriptorSet = currentFrame;
+        //先把深度写满，第二遍只有可见的fragment会通过EQUAL测试
+        if constexpr (enableDepthPrepass)
+        {
+            triangle.pass = DrawPassDepthPrepass;
+            triangle.pipeline = DrawPipelineDepthPrepass;
+            drawList.add(packDrawKey(triangle), 0);
+        }
+        triangle.pass = DrawPassOpaque;
+        triangle.pipeline = DrawPipelineOpaque;
+        drawList.add(packDrawKey(triangle), 0);
 
-        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        drawList.sort();
+    }
+
+    //secondary command buffer不继承viewport/scissor，recordDrawCommands在其中重新设置
+    void executeCachedDrawCommands(VkCommandBuffer commandBuffer)
+    {
+        VkCommandBufferInheritanceRenderingInfo renderingInheritance{};
+        renderingInheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+        renderingInheritance.colorAttachmentCount = 1;
+        renderingInheritance.pColorAttachmentFormats = &swapChainImageFormat;
+        renderingInheritance.depthAttachmentFormat = depthFormat;
+        renderingInheritance.stencilAttachmentFormat = hasStencilComponent(depthFormat) ? depthFormat : VK_FORMAT_UNDEFINED;
+        renderingInheritance.rasterizationSamples = msaaSamples;
+
+        VkCommandBufferInheritanceInfo inheritance{};
+        inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        if (dynamicRenderingEnabled)
         {
-            throw std::runtime_error("failed to record command buffer!");
+            inheritance.pNext = &renderingInheritance;
+        }
+        else
+        {
+            //framebuffer每个swap chain image不同，留空即可在任意framebuffer中执行
+            inheritance.renderPass = renderPass;
+            inheritance.subpass = 0;
+        }
+        //在scene的pipeline statistics query中执行
+        if constexpr (Config::profiling)
+        {
+            if (frameMetrics.measuresPipelineStatistics() && inheritedQueriesEnabled)
+            {
+                inheritance.pipelineStatistics = frameMetrics.statisticFlags();
+            }
         }
+
+        CommandCache::Dependencies dependencies;
+        dependencies.swapChain = swapChainVersion;
+        dependencies.pipelines = pipelineVersion;
+        dependencies.descriptors = descriptorVersions[currentFrame];
+        dependencies.content = drawList.contentHash();
+        dependencies.viewport = (static_cast<uint64_t>(renderExtent.width) << 32) | renderExtent.height;
+        VkCommandBuffer secondary = commandCache.get(currentFrame, dependencies, inheritance,
+            [this](VkCommandBuffer secondaryCommandBuffer) { recordDrawCommands(secondaryCommandBuffer); });
+        vkCmdExecuteCommands(commandBuffer, 1, &secondary);
+        countApiCall(ApiCall::ExecuteCommands);
+    }
+
+    //排序键中的id到pipeline、descriptor set与mesh的映射
+    void createDrawResources()
+    {
+        drawResources.layout = pipelineLayout;
+        drawResources.pipelines.assign({depthPrepassPipeline, graphicsPipeline});
+        drawResources.descriptorSets = descriptorSets;
+        //三角形的顶点写在vertex shader中
+        DrawResources::Mesh triangleMesh;
+        triangleMesh.vertexCount = 3;
+        drawResources.meshes.assign({triangleMesh});
+    }
+
+    void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image,
+        VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess,
+        VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+        VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT)
+    {
+        VkImageMemoryBarrier2 barrier = makeImageBarrier(image, oldLayout, newLayout, srcStage, srcAccess, dstStage, dstAccess, aspectMask);
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+        synchronization2.imageBarrier(commandBuffer, barrier);
     }
 
     void createSyncObjects(){
+        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+
         VkSemaphoreCreateInfo semaphoreInfo{};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
     
@@ -1125,42 +2388,160 @@ private:
         fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphore) != VK_SUCCESS ||
-            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore) != VK_SUCCESS ||
-            vkCreateFence(device, &fenceInfo, nullptr, &inFlightFence) != VK_SUCCESS)
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
         {
-            throw std::runtime_error("=====Failed to create semaphores!=====");
+            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+                vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("=====Failed to create semaphores!=====");
+            }
         }
     }
 
-    void drawFrame(){
-        vkWaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
-        vkResetFences(device, 1, &inFlightFence);
+    //graphics queue支持timestamp时才创建，GPU耗时用于帧节奏预测
+    void createTimestampQueries()
+    {
+        //关闭profiling时只有动态分辨率与低延迟模式需要GPU时间
+        if constexpr (!Config::profiling)
+        {
+            if (!dynamicResolutionEnabled && !settings.lowLatency)
+            {
+                return;
+            }
+        }
+        uint32_t graphicsFamily = deviceCaps.queueFamilyIndices.graphicsFamily.value();
+        if (deviceCaps.queueFamilies[graphicsFamily].timestampValidBits == 0)
+        {
+            return;
+        }
 
-        uint32_t imageIndex;
-        vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
-    
-        vkResetCommandBuffer(commandBuffer, 0);
-        recordCommandBuffer(commandBuffer, imageIndex);
+        timestampPeriod = deviceCaps.properties.limits.timestampPeriod;
+
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * 2;
+        if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestampQueryPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("=====Failed to create timestamp query pool!=====");
+        }
+    }
+
+    //--metrics为空时不统计；pass在create之前登记，顺序即CSV中列的顺序
+    void createFrameMetrics()
+    {
+        if constexpr (!Config::profiling)
+        {
+            return;
+        }
+        frameMetrics.setTargets(settings.metricsTargets);
+        if (!frameMetrics.enabled())
+        {
+            return;
+        }
+        scenePass = frameMetrics.addPass("scene");
+        upscalePass = frameMetrics.addPass("upscale");
+        frameMetrics.create(device, pipelineStatisticsEnabled, MAX_FRAMES_IN_FLIGHT);
+        if (!pipelineStatisticsEnabled)
+        {
+            logStream(LogLevel::Warning) << "Device does not support pipelineStatisticsQuery, --metrics reports command counts only\n";
+        }
+        else if (settings.cacheCommands && !inheritedQueriesEnabled)
+        {
+            logStream(LogLevel::Warning) << "Device does not support inheritedQueries, scene statistics are not measured with --cache-commands\n";
+        }
+    }
 
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    //frame的fence signal后读取GPU耗时；没有present wait时用GPU完成时间近似延迟
+    void collectFrameTiming(uint32_t frame)
+    {
+        if (!frameTimingPending[frame])
+        {
+            return;
+        }
+        frameTimingPending[frame] = false;
 
-        VkSemaphore waitSemaphores[] = {imageAvailableSemaphore};
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
+        double gpuMs = 0.0;
+        if (timestampQueryPool != VK_NULL_HANDLE)
+        {
+            uint64_t timestamps[2] = {};
+            if (vkGetQueryPoolResults(device, timestampQueryPool, frame * 2, 2, sizeof(timestamps), timestamps,
+                    sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+            {
+                gpuMs = (timestamps[1] - timestamps[0]) * timestampPeriod / 1e6;
+                framePacer.reportGpuTime(gpuMs);
+                if (dynamicResolutionEnabled)
+                {
+                    resolutionController.update(gpuMs, frameResolutionScales[frame]);
+                }
+            }
+        }
+        if constexpr (Config::profiling)
+        {
+            frameMetrics.frameCompleted(frame, gpuMs);
+        }
 
-        VkSemaphore signalSemaphores[] = {renderFinishedSemaphore};
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = signalSemaphores;
+        if (!presentWaitEnabled)
+        {
+            std::chrono::duration<double, std::milli> latency = FramePacer::Clock::now() - frameInputTimes[frame];
+            framePacer.reportLatency(latency.count());
+        }
+    }
 
-        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFence) != VK_SUCCESS) {
-            throw std::runtime_error("=====Failed to submit draw command buffer!=====");
+    //不阻塞地检查已完成的帧，尽早拿到计时结果
+    void pollCompletedFrames()
+    {
+        for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+        {
+            if (frameTimingPending[frame] && vkGetFenceStatus(device, inFlightFences[frame]) == VK_SUCCESS)
+            {
+                collectFrameTiming(frame);
+            }
         }
+    }
+
+    void drawFrame(FramePacer::Clock::time_point inputTime){
+        //本帧录制、提交与present的命令数
+        ApiCallScope frameCalls;
+        pollCompletedFrames();
+
+        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        frameArena.beginFrame(currentFrame);
+        collectFrameTiming(currentFrame);
+        //该slot上一次的拷贝已经完成，交给写入线程
+        frameCapture.frameCompleted(currentFrame);
+
+        uint32_t imageIndex;
+        VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            recreateSwapChain();
+            return;
+        }
+        else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+        {
+            throw std::runtime_error("=====Failed to acquire swap chain image!=====");
+        }
+
+        //确定会提交工作后再reset，避免提前返回时fence永远无法signal
+        vkResetFences(device, 1, &inFlightFences[currentFrame]);
+    
+        vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+        recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+
+        //本帧graphics队列上的所有工作一次提交；之后加入的pass只需要add/wait/signal
+        VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[imageIndex]};
+        //动态分辨率时swap chain image只在upscale的blit中写入，场景渲染不必等待acquire
+        VkPipelineStageFlags2 acquireWaitStage = dynamicResolutionEnabled ? VK_PIPELINE_STAGE_2_TRANSFER_BIT : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+        queueSubmitter.wait(graphicsQueue, imageAvailableSemaphores[currentFrame], acquireWaitStage);
+        queueSubmitter.add(graphicsQueue, commandBuffers[currentFrame]);
+        //present要等本帧的所有命令(包括捕获的拷贝)完成
+        queueSubmitter.signal(graphicsQueue, renderFinishedSemaphores[imageIndex], VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+        queueSubmitter.submit(graphicsQueue, inFlightFences[currentFrame]);
+        frameTimingPending[currentFrame] = true;
+        frameInputTimes[currentFrame] = inputTime;
+        frameNumber++;
+        framePacer.endFrame();
 
         VkPresentInfoKHR presentInfo{};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1174,49 +2555,380 @@ private:
         presentInfo.pImageIndices = &imageIndex;
         presentInfo.pResults = nullptr; // Optional
 
-        vkQueuePresentKHR(presentQueue, &presentInfo);
+        //给每次present一个递增的id，后台线程用vkWaitForPresentKHR等待它真正显示
+        uint64_t presentId = nextPresentId;
+        VkPresentIdKHR presentIdInfo{};
+        presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        presentIdInfo.swapchainCount = 1;
+        presentIdInfo.pPresentIds = &presentId;
+        if (presentWaitEnabled)
+        {
+            presentInfo.pNext = &presentIdInfo;
+            nextPresentId++;
+        }
+
+        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+        countApiCall(ApiCall::Present);
+        if (presentWaitEnabled && (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR))
+        {
+            std::lock_guard<std::mutex> lock(presentWaitMutex);
+            if (pendingPresentCount == maxPendingPresents)
+            {
+                pendingPresentHead = (pendingPresentHead + 1) % maxPendingPresents;
+                pendingPresentCount--;
+            }
+            pendingPresents[(pendingPresentHead + pendingPresentCount) % maxPendingPresents] = {presentId, inputTime};
+            pendingPresentCount++;
+            presentWaitCondition.notify_one();
+        }
+
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized)
+        {
+            framebufferResized = false;
+            recreateSwapChain();
+        }
+        else if (result != VK_SUCCESS)
+        {
+            throw std::runtime_error("=====Failed to present swap chain image!=====");
+        }
+
+        //frameNumber在提交时已经递增
+        if constexpr (Config::profiling)
+        {
+            frameMetrics.endFrame(currentFrame, frameNumber - 1, frameCalls.counts());
+        }
+        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
     }
 
-    void mainLoop()
+    void startPresentWaitThread()
+    {
+        if (!presentWaitEnabled)
+        {
+            return;
+        }
+        presentWaitStop = false;
+        presentWaitThread = std::thread(&HelloTriangleApplication::presentWaitLoop, this);
+    }
+
+    //swap chain销毁前必须停止等待线程
+    void stopPresentWaitThread()
+    {
+        if (!presentWaitThread.joinable())
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(presentWaitMutex);
+            presentWaitStop = true;
+            pendingPresentHead = 0;
+            pendingPresentCount = 0;
+        }
+        presentWaitCondition.notify_one();
+        presentWaitThread.join();
+    }
+
+    void presentWaitLoop()
+    {
+        //超时后检查一次是否需要退出
+        const uint64_t waitTimeoutNs = 100 * 1000 * 1000;
+        while (true)
+        {
+            std::pair<uint64_t, FramePacer::Clock::time_point> present;
+            {
+                std::unique_lock<std::mutex> lock(presentWaitMutex);
+                presentWaitCondition.wait(lock, [this] { return presentWaitStop || pendingPresentCount > 0; });
+                if (presentWaitStop)
+                {
+                    return;
+                }
+                present = pendingPresents[pendingPresentHead];
+                pendingPresentHead = (pendingPresentHead + 1) % maxPendingPresents;
+                pendingPresentCount--;
+            }
+
+            VkResult result;
+            do
+            {
+                result = pfnWaitForPresentKHR(device, swapChain, present.first, waitTimeoutNs);
+            } while (result == VK_TIMEOUT && !presentWaitStop);
+
+            if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)
+            {
+                std::chrono::duration<double, std::milli> latency = FramePacer::Clock::now() - present.second;
+                std::lock_guard<std::mutex> lock(presentWaitMutex);
+                measuredLatencies.push_back(latency.count());
+            }
+        }
+    }
+
+    //汇总延迟数据，每秒刷新一次窗口标题
+    //本帧API调用触发的PERFORMANCE消息已在callback中同步计数
+    void countPerformanceWarnings()
+    {
+        if constexpr (!enableValidationLayers)
+        {
+            return;
+        }
+        lastFramePerformanceWarnings = debugMessageLog.takePerformanceWarnings();
+        statsPerformanceWarnings += lastFramePerformanceWarnings;
+        statsPerformanceWarningPeak = std::max(statsPerformanceWarningPeak, lastFramePerformanceWarnings);
+        statsFrames++;
+    }
+
+    void updateFrameStats()
+    {
+        if (presentWaitEnabled)
+        {
+            std::lock_guard<std::mutex> lock(presentWaitMutex);
+            for (double latency : measuredLatencies)
+            {
+                framePacer.reportLatency(latency);
+            }
+            measuredLatencies.clear();
+        }
+
+        FramePacer::Stats stats;
+        if (!framePacer.pollStats(stats))
+        {
+            return;
+        }
+
+        char text[384];
+        int length = snprintf(text, sizeof(text), "Vulkan | %s | %.1f fps | cpu %.2f ms | gpu %.2f ms | sleep %.2f ms | latency %.2f ms (%s)",
+            presentModeName(swapChainPresentMode), stats.fps, stats.cpuMs, stats.gpuMs, stats.sleepMs, stats.latencyMs,
+            presentWaitEnabled ? "present" : "gpu");
+        if (enableValidationLayers && length > 0 && static_cast<size_t>(length) < sizeof(text))
+        {
+            length += snprintf(text + length, sizeof(text) - length, " | perf warnings %.2f/frame (peak %u)",
+                statsFrames > 0 ? static_cast<double>(statsPerformanceWarnings) / statsFrames : 0.0, statsPerformanceWarningPeak);
+        }
+        const TextureStreamer::Stats &textureStats = textureStreamer.stats();
+        if (length > 0 && static_cast<size_t>(length) < sizeof(text))
+        {
+            length += snprintf(text + length, sizeof(text) - length, " | textures %.1f/%.0f MB",
+                textureStats.residentBytes / (1024.0 * 1024.0), textureStats.budgetBytes / (1024.0 * 1024.0));
+        }
+        if (dynamicResolutionEnabled && length > 0 && static_cast<size_t>(length) < sizeof(text))
+        {
+            length += snprintf(text + length, sizeof(text) - length, " | res %.0f%%", resolutionController.scale() * 100.0f);
+        }
+        //最后一帧的数值
+        const DrawList::Stats &drawStats = drawList.stats();
+        if (length > 0 && static_cast<size_t>(length) < sizeof(text))
+        {
+            snprintf(text + length, sizeof(text) - length, " | draws %u, binds %u (%u avoided)",
+                drawStats.drawCalls, drawStats.binds(), drawStats.redundantBindsAvoided);
+        }
+        statsPerformanceWarnings = 0;
+        statsPerformanceWarningPeak = 0;
+        statsFrames = 0;
+        if (window != nullptr)
+        {
+            glfwSetWindowTitle(window, text);
+        }
+        if (settings.printFrameStats)
+        {
+            std::cout << text << '\n';
+        }
+    }
+
+    //窗口大小改变后重建swap chain相关对象
+    //dynamic rendering模式下没有framebuffer，只需重建swap chain与image views
+    void recreateSwapChain()
     {
-        while (!glfwWindowShouldClose(window))
+        //最小化时framebuffer为0，等待窗口恢复
+        int width = 0, height = 0;
+        while (window != nullptr && (width == 0 || height == 0))
         {
-            glfwPollEvents();
-            drawFrame();
+            glfwGetFramebufferSize(window, &width, &height);
+            if (width == 0 || height == 0)
+            {
+                glfwWaitEvents();
+            }
         }
 
         vkDeviceWaitIdle(device);
+        stopPresentWaitThread();
+
+        cleanupSwapChain();
+
+        createSwapChain();
+        createImageViews();
+        createColorResources();
+        createDepthResources();
+        if (!dynamicRenderingEnabled)
+        {
+            createFramebuffers();
+        }
+        startPresentWaitThread();
+        //重建时的分配不算，并且新尺寸下arena可能需要重新扩容
+        allocationCheckStartFrame = frameNumber + allocationCheckWarmupFrames;
     }
 
-    void cleanup()
+    void cleanupSwapChain()
     {
+        if (colorImageView != VK_NULL_HANDLE)
+        {
+            vkDestroyImageView(device, colorImageView, nullptr);
+            vkDestroyImage(device, colorImage, nullptr);
+            vkFreeMemory(device, colorImageMemory, nullptr);
+            colorImageView = VK_NULL_HANDLE;
+        }
+
+        vkDestroyImageView(device, depthImageView, nullptr);
+        vkDestroyImage(device, depthImage, nullptr);
+        vkFreeMemory(device, depthImageMemory, nullptr);
+
+        dynamicResolution.releaseTargets();
+
         //Destroy framebuffer,before image views
         for(auto framebuffer : swapChainFramebuffers){
             vkDestroyFramebuffer(device,framebuffer,nullptr);
         }
+        swapChainFramebuffers.clear();
 
         //Destroy image views
         for (auto imageView : swapChainImageViews) {
-        vkDestroyImageView(device, imageView, nullptr);
+            vkDestroyImageView(device, imageView, nullptr);
         }
-        //在销毁设备之前清理Swap chain
+        swapChainImageViews.clear();
+
+        for (auto semaphore : renderFinishedSemaphores) {
+            vkDestroySemaphore(device, semaphore, nullptr);
+        }
+        renderFinishedSemaphores.clear();
+
         vkDestroySwapchainKHR(device, swapChain, nullptr);
+    }
+
+    void mainLoop()
+    {
+        if (settings.checkFrameAllocations && !allocationCountingEnabled())
+        {
+            logStream(LogLevel::Warning) << "--check-frame-allocations needs a build with KUTORY_COUNT_ALLOCATIONS, ignoring it\n";
+        }
+
+        while (window == nullptr || !glfwWindowShouldClose(window))
+        {
+            AllocationScope frameAllocations;
+            uint64_t frame = frameNumber;
+            //限制器先睡到预测的时间点，再采样输入，让输入尽量"新鲜"
+            FramePacer::Clock::time_point inputTime = framePacer.beginFrame();
+            if (window != nullptr)
+            {
+                glfwPollEvents();
+            }
+            if (!startupReported)
+            {
+                //冷启动计到第一帧提交为止
+                measureStartup("firstFrame", [&] { drawFrame(inputTime); });
+                reportStartup();
+            }
+            else
+            {
+                drawFrame(inputTime);
+            }
+            countPerformanceWarnings();
+            updateFrameStats();
+
+            if (settings.checkFrameAllocations && frame >= allocationCheckStartFrame && frameAllocations.allocations() > 0)
+            {
+                throw std::runtime_error("=====Frame " + std::to_string(frame) + " made " + std::to_string(frameAllocations.allocations()) +
+                    " heap allocations (" + std::to_string(frameAllocations.bytes()) + " bytes) after warm-up!=====");
+            }
 
-        vkDestroyPipeline(device, graphicsPipeline, nullptr);
+            if (settings.exitAfterFrames > 0 && frameNumber >= settings.exitAfterFrames)
+            {
+                break;
+            }
+            //headless时没有窗口可以关闭，捕获完成后退出
+            if (window == nullptr && frameCapture.finished())
+            {
+                break;
+            }
+        }
+
+        vkDeviceWaitIdle(device);
+        stopPresentWaitThread();
+    }
+
+    //关闭profiling时直接执行，不记录耗时
+    template <typename Function>
+    void measureStartup(const char *name, Function &&function)
+    {
+        if constexpr (Config::profiling)
+        {
+            startupTrace.measure(name, std::forward<Function>(function));
+        }
+        else
+        {
+            function();
+        }
+    }
+
+    void reportStartup()
+    {
+        startupReported = true;
+        if constexpr (!Config::profiling)
+        {
+            return;
+        }
+
+        if (logEnabled(LogLevel::Verbose))
+        {
+            startupTrace.printSummary(std::cout);
+        }
+        logStream(LogLevel::Info) << "Startup: " << startupTrace.totalMs() << " ms to first frame\n";
+        if (settings.startupBudgetMs > 0.0 && startupTrace.totalMs() > settings.startupBudgetMs)
+        {
+            logStream(LogLevel::Warning) << "Startup took " << startupTrace.totalMs() << " ms, over the budget of "
+                                         << settings.startupBudgetMs << " ms\n";
+        }
+
+        if (!settings.startupTracePath.empty())
+        {
+            startupTrace.writeChromeTrace(settings.startupTracePath);
+            logStream(LogLevel::Info) << "Startup trace written to " << settings.startupTracePath << '\n';
+        }
+    }
+
+    void cleanup()
+    {
+        //写完剩余的帧，readback buffer在设备销毁前释放
+        frameCapture.stop();
+
+        //在销毁设备之前清理Swap chain
+        cleanupSwapChain();
+
+        //graphicsPipeline与depthPrepassPipeline归变体缓存所有
+        pipelineVariants.destroy();
         vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        textureStreamer.destroy();
+        dynamicResolution.destroy();
         vkDestroyRenderPass(device, renderPass, nullptr);
 
+        if (settings.cacheCommands)
+        {
+            const CommandCache::Stats &cacheStats = commandCache.stats();
+            logStream(LogLevel::Info) << "Command cache: " << cacheStats.recorded << " recorded, " << cacheStats.reused << " reused\n";
+        }
+        commandCache.destroy();
         //销毁设备前销毁，因为整个程序都会使用
         vkDestroyCommandPool(device, commandPool, nullptr);
 
-        vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
-        vkDestroySemaphore(device, renderFinishedSemaphore, nullptr);
-        vkDestroyFence(device, inFlightFence, nullptr);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+            vkDestroyFence(device, inFlightFences[i], nullptr);
+        }
+        vkDestroyQueryPool(device, timestampQueryPool, nullptr);
+        frameMetrics.destroy();
 
         //销毁设备，销毁时设备队列也被隐式清理
         vkDestroyDevice(device, nullptr);
 
-        if (enableValidationLayers)
+        if constexpr (enableValidationLayers)
         {
             DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
         }
@@ -1225,18 +2937,54 @@ private:
         vkDestroySurfaceKHR(instance, surface, nullptr);
         //再销毁Innstance
         vkDestroyInstance(instance, nullptr);
+        //instance销毁时的消息也已入队，最后停止日志线程
+        debugMessageLog.stop();
+
+        if (window != nullptr)
+        {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
+    }
+
+    //与--golden给出的PNG比较最后捕获的一帧，超过0.1%的像素超出容差时失败并写出差异图
+    void checkGoldenImage()
+    {
+        if (settings.goldenImagePath.empty())
+        {
+            return;
+        }
+        uint32_t width = 0, height = 0;
+        std::vector<uint8_t> actual = frameCapture.lastFrame(width, height);
+        if (actual.empty())
+        {
+            throw std::runtime_error("=====No frame was captured for the golden image comparison!=====");
+        }
+        PngImage expected = readPng(settings.goldenImagePath);
+        if (expected.width != width || expected.height != height)
+        {
+            throw std::runtime_error("=====Golden image is " + std::to_string(expected.width) + "x" + std::to_string(expected.height) +
+                                     ", captured frame is " + std::to_string(width) + "x" + std::to_string(height) + "=====");
+        }
 
-        glfwDestroyWindow(window);
-        glfwTerminate();
+        ImageDifference difference = compareImages(actual.data(), expected.pixels.data(), width, height, settings.goldenTolerance);
+        uint64_t allowed = uint64_t(width) * height / 1000;
+        logStream(LogLevel::Info) << "Golden image: " << difference.mismatchedPixels << " pixels differ, max channel difference "
+                                  << difference.maxChannelDifference << '\n';
+        if (difference.mismatchedPixels > allowed)
+        {
+            std::string diffPath = settings.goldenImagePath + ".diff.png";
+            writePng(diffPath, difference.diffImage.data(), width, height);
+            throw std::runtime_error("=====Golden image mismatch, see " + diffPath + "=====");
+        }
     }
 };
 
-int main()
+int main(int argc, char **argv)
 {
-    HelloTriangleApplication app;
-
     try
     {
+        HelloTriangleApplication<BuildRendererConfig> app(parseAppSettings(argc, argv));
         app.run();
     }
     catch (const std::exception &e)
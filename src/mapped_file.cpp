@@ -0,0 +1,93 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string &path)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("=====Failed to open file: " + path + "=====");
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    length = static_cast<size_t>(fileSize.QuadPart);
+    fileHandle = file;
+    if (length == 0)
+    {
+        return;
+    }
+
+    mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle == nullptr)
+    {
+        CloseHandle(file);
+        throw std::runtime_error("=====Failed to map file: " + path + "=====");
+    }
+    bytes = static_cast<const uint8_t *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (bytes == nullptr)
+    {
+        CloseHandle(mappingHandle);
+        CloseHandle(file);
+        throw std::runtime_error("=====Failed to map file: " + path + "=====");
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (bytes != nullptr)
+        UnmapViewOfFile(bytes);
+    if (mappingHandle != nullptr)
+        CloseHandle(mappingHandle);
+    if (fileHandle != nullptr)
+        CloseHandle(fileHandle);
+}
+#else
+MappedFile::MappedFile(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("=====Failed to open file: " + path + "=====");
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("=====Failed to stat file: " + path + "=====");
+    }
+    length = static_cast<size_t>(info.st_size);
+    if (length > 0)
+    {
+        void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("=====Failed to map file: " + path + "=====");
+        }
+        bytes = static_cast<const uint8_t *>(mapping);
+    }
+    // 映射建立后文件描述符可以关闭
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (bytes != nullptr)
+    {
+        munmap(const_cast<uint8_t *>(bytes), length);
+    }
+}
+#endif
@@ -0,0 +1,168 @@
+#include "mesh_file.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    const char meshMagic[4] = {'K', 'M', 'S', 'H'};
+    const size_t headerSize = 128;
+    const size_t sectionAlignment = 16;
+    // header中6个段偏移的位置
+    const size_t sectionTableOffset = 72;
+
+    // 文件直接映射成这些结构体，布局不能改变
+    static_assert(sizeof(PackedVertex) == 16, "PackedVertex layout changed");
+    static_assert(sizeof(MeshLod) == 20, "MeshLod layout changed");
+    static_assert(sizeof(Meshlet) == 48, "Meshlet layout changed");
+
+    template <typename T>
+    T read(const uint8_t *data, size_t size, size_t offset)
+    {
+        if (offset + sizeof(T) > size)
+        {
+            throw std::runtime_error("=====Truncated mesh file!=====");
+        }
+        T value;
+        memcpy(&value, data + offset, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    const T *section(const uint8_t *data, size_t size, uint64_t offset, uint64_t count, const char *name)
+    {
+        if (offset % sectionAlignment != 0 || offset > size || count > (size - offset) / sizeof(T))
+        {
+            throw std::runtime_error(std::string("=====Mesh file section out of range: ") + name + "=====");
+        }
+        return reinterpret_cast<const T *>(data + offset);
+    }
+
+    size_t align(size_t offset)
+    {
+        return (offset + sectionAlignment - 1) & ~(sectionAlignment - 1);
+    }
+}
+
+MeshFile MeshFile::parse(const uint8_t *data, size_t size)
+{
+    if (size < headerSize || memcmp(data, meshMagic, sizeof(meshMagic)) != 0)
+    {
+        throw std::runtime_error("=====Not a mesh file!=====");
+    }
+    if (read<uint32_t>(data, size, 4) != version)
+    {
+        throw std::runtime_error("=====Unsupported mesh file version!=====");
+    }
+    if (reinterpret_cast<uintptr_t>(data) % 4 != 0)
+    {
+        throw std::runtime_error("=====Mesh file data is not aligned!=====");
+    }
+
+    MeshFile file;
+    file.vertexCount = read<uint32_t>(data, size, 8);
+    file.indexCount = read<uint32_t>(data, size, 12);
+    file.lodCount = read<uint32_t>(data, size, 16);
+    file.meshletCount = read<uint32_t>(data, size, 20);
+    file.meshletVertexCount = read<uint32_t>(data, size, 24);
+    file.meshletTriangleBytes = read<uint32_t>(data, size, 28);
+    for (int k = 0; k < 3; k++)
+    {
+        file.quantization.offset[k] = read<float>(data, size, 32 + k * 4);
+        file.quantization.scale[k] = read<float>(data, size, 44 + k * 4);
+        file.center[k] = read<float>(data, size, 56 + k * 4);
+    }
+    file.radius = read<float>(data, size, 68);
+
+    uint64_t offsets[6];
+    for (int i = 0; i < 6; i++)
+    {
+        offsets[i] = read<uint64_t>(data, size, sectionTableOffset + i * 8);
+    }
+    file.vertices = section<PackedVertex>(data, size, offsets[0], file.vertexCount, "vertices");
+    file.indices = section<uint32_t>(data, size, offsets[1], file.indexCount, "indices");
+    file.lods = section<MeshLod>(data, size, offsets[2], file.lodCount, "lods");
+    file.meshlets = section<Meshlet>(data, size, offsets[3], file.meshletCount, "meshlets");
+    file.meshletVertices = section<uint32_t>(data, size, offsets[4], file.meshletVertexCount, "meshlet vertices");
+    file.meshletTriangles = section<uint8_t>(data, size, offsets[5], file.meshletTriangleBytes, "meshlet triangles");
+
+    //LOD与meshlet引用的范围必须在数组内，之后使用时不再检查
+    for (uint32_t i = 0; i < file.lodCount; i++)
+    {
+        const MeshLod &lod = file.lods[i];
+        if (uint64_t(lod.indexOffset) + lod.indexCount > file.indexCount || uint64_t(lod.meshletOffset) + lod.meshletCount > file.meshletCount)
+        {
+            throw std::runtime_error("=====Mesh LOD " + std::to_string(i) + " is out of range!=====");
+        }
+    }
+    for (uint32_t i = 0; i < file.meshletCount; i++)
+    {
+        const Meshlet &meshlet = file.meshlets[i];
+        if (uint64_t(meshlet.vertexOffset) + meshlet.vertexCount > file.meshletVertexCount ||
+            uint64_t(meshlet.triangleOffset) + uint64_t(meshlet.triangleCount) * 3 > file.meshletTriangleBytes)
+        {
+            throw std::runtime_error("=====Meshlet " + std::to_string(i) + " is out of range!=====");
+        }
+    }
+    return file;
+}
+
+void writeMeshFile(const std::string &path, const MeshAsset &asset)
+{
+    struct Section
+    {
+        const void *data;
+        size_t bytes;
+    };
+    Section sections[6] = {
+        {asset.vertices.data(), asset.vertices.size() * sizeof(PackedVertex)},
+        {asset.indices.data(), asset.indices.size() * sizeof(uint32_t)},
+        {asset.lods.data(), asset.lods.size() * sizeof(MeshLod)},
+        {asset.meshlets.data(), asset.meshlets.size() * sizeof(Meshlet)},
+        {asset.meshletVertices.data(), asset.meshletVertices.size() * sizeof(uint32_t)},
+        {asset.meshletTriangles.data(), asset.meshletTriangles.size()},
+    };
+
+    std::vector<uint8_t> header(headerSize, 0);
+    auto put = [&](size_t offset, const void *value, size_t bytes) { memcpy(header.data() + offset, value, bytes); };
+    uint32_t counts[7] = {
+        MeshFile::version,
+        uint32_t(asset.vertices.size()),
+        uint32_t(asset.indices.size()),
+        uint32_t(asset.lods.size()),
+        uint32_t(asset.meshlets.size()),
+        uint32_t(asset.meshletVertices.size()),
+        uint32_t(asset.meshletTriangles.size()),
+    };
+    put(0, meshMagic, sizeof(meshMagic));
+    put(4, counts, sizeof(counts));
+    put(32, asset.quantization.offset, 12);
+    put(44, asset.quantization.scale, 12);
+    put(56, asset.center, 12);
+    put(68, &asset.radius, 4);
+    size_t offset = headerSize;
+    for (int i = 0; i < 6; i++)
+    {
+        uint64_t sectionOffset = offset;
+        put(sectionTableOffset + i * 8, &sectionOffset, 8);
+        offset = align(offset + sections[i].bytes);
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("=====Failed to open file for writing: " + path + "=====");
+    }
+    file.write(reinterpret_cast<const char *>(header.data()), header.size());
+    const char padding[sectionAlignment] = {};
+    for (const Section &current : sections)
+    {
+        file.write(static_cast<const char *>(current.data), current.bytes);
+        file.write(padding, align(current.bytes) - current.bytes);
+    }
+    if (!file)
+    {
+        throw std::runtime_error("=====Failed to write mesh file: " + path + "=====");
+    }
+}
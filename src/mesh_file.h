@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "mesh_processing.h"
+
+// 处理好的网格的二进制格式(.kmesh)，小端：
+//   header(128字节) + vertices + indices + lods + meshlets + meshletVertices + meshletTriangles
+// 每段从16字节边界开始，内容与内存中的结构体完全相同，mmap之后可以直接当数组使用或整段上传到GPU
+struct MeshFile
+{
+    static const uint32_t version = 1;
+
+    MeshQuantization quantization;
+    float center[3] = {};
+    float radius = 0.0f;
+
+    // 指向parse传入的数据，数据释放后失效
+    const PackedVertex *vertices = nullptr;
+    uint32_t vertexCount = 0;
+    const uint32_t *indices = nullptr;
+    uint32_t indexCount = 0;
+    const MeshLod *lods = nullptr;
+    uint32_t lodCount = 0;
+    const Meshlet *meshlets = nullptr;
+    uint32_t meshletCount = 0;
+    const uint32_t *meshletVertices = nullptr;
+    uint32_t meshletVertexCount = 0;
+    const uint8_t *meshletTriangles = nullptr;
+    uint32_t meshletTriangleBytes = 0;
+
+    // 不拷贝数据；data需要4字节对齐(mmap的起始地址总是满足)，格式错误或越界时抛出std::runtime_error
+    static MeshFile parse(const uint8_t *data, size_t size);
+};
+
+// 失败时抛出std::runtime_error
+void writeMeshFile(const std::string &path, const MeshAsset &asset);
@@ -0,0 +1,1141 @@
+#include "mesh_processing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+    // Forsyth算法模拟的LRU缓存大小，比真实硬件大一些效果更稳定
+    const uint32_t forsythCacheSize = 32;
+    // overdraw优化判断冷缓存时使用的FIFO大小
+    const uint32_t overdrawCacheSize = 16;
+    // 边界平面的quadric权重，越大边界越不容易变形
+    const double borderWeight = 10.0;
+
+    void subtract(const float a[3], const float b[3], float out[3])
+    {
+        out[0] = a[0] - b[0];
+        out[1] = a[1] - b[1];
+        out[2] = a[2] - b[2];
+    }
+
+    void cross(const float a[3], const float b[3], float out[3])
+    {
+        out[0] = a[1] * b[2] - a[2] * b[1];
+        out[1] = a[2] * b[0] - a[0] * b[2];
+        out[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    float dot(const float a[3], const float b[3])
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    // 未归一化的三角形法线，长度为面积的两倍
+    void triangleNormal(const float a[3], const float b[3], const float c[3], float out[3])
+    {
+        float ab[3], ac[3];
+        subtract(b, a, ab);
+        subtract(c, a, ac);
+        cross(ab, ac, out);
+    }
+
+    float vertexScore(int cachePosition, uint32_t remainingTriangles)
+    {
+        if (remainingTriangles == 0)
+        {
+            return -1.0f;
+        }
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            //刚用过的三角形的三个顶点分数固定，避免总是沿同一方向推进
+            if (cachePosition < 3)
+            {
+                score = 0.75f;
+            }
+            else
+            {
+                score = std::pow(1.0f - float(cachePosition - 3) / float(forsythCacheSize - 3), 1.5f);
+            }
+        }
+        //剩余三角形少的顶点优先处理，避免留下孤立的三角形
+        return score + 2.0f / std::sqrt(float(remainingTriangles));
+    }
+
+    // 对称4x4矩阵的10个元素，weight为累计的三角形面积，用于把误差换算成平均距离
+    struct Quadric
+    {
+        double a2 = 0, ab = 0, ac = 0, ad = 0;
+        double b2 = 0, bc = 0, bd = 0;
+        double c2 = 0, cd = 0;
+        double d2 = 0;
+        double weight = 0;
+
+        void addPlane(double a, double b, double c, double d, double w)
+        {
+            a2 += a * a * w;
+            ab += a * b * w;
+            ac += a * c * w;
+            ad += a * d * w;
+            b2 += b * b * w;
+            bc += b * c * w;
+            bd += b * d * w;
+            c2 += c * c * w;
+            cd += c * d * w;
+            d2 += d * d * w;
+        }
+
+        void add(const Quadric &other)
+        {
+            a2 += other.a2;
+            ab += other.ab;
+            ac += other.ac;
+            ad += other.ad;
+            b2 += other.b2;
+            bc += other.bc;
+            bd += other.bd;
+            c2 += other.c2;
+            cd += other.cd;
+            d2 += other.d2;
+            weight += other.weight;
+        }
+
+        // 到累计平面的加权平均距离
+        float error(const float p[3]) const
+        {
+            double x = p[0], y = p[1], z = p[2];
+            double value = a2 * x * x + b2 * y * y + c2 * z * z + 2.0 * (ab * x * y + ac * x * z + bc * y * z) +
+                           2.0 * (ad * x + bd * y + cd * z) + d2;
+            return float(std::sqrt(std::max(value, 0.0) / std::max(weight, 1e-20)));
+        }
+    };
+
+    struct PositionKey
+    {
+        uint32_t bits[3];
+
+        bool operator==(const PositionKey &other) const { return memcmp(bits, other.bits, sizeof(bits)) == 0; }
+    };
+
+    struct PositionKeyHash
+    {
+        size_t operator()(const PositionKey &key) const
+        {
+            uint64_t h = key.bits[0] * 0x9E3779B1ull;
+            h = (h ^ key.bits[1]) * 0x85EBCA77ull;
+            h = (h ^ key.bits[2]) * 0xC2B2AE3Dull;
+            return size_t(h ^ (h >> 29));
+        }
+    };
+
+    enum VertexKind : uint8_t
+    {
+        // 内部顶点，可以折叠到任意相邻顶点
+        KindManifold,
+        // 开放边界上的顶点，只能沿边界折叠
+        KindBorder,
+        // 接缝或非流形顶点，不移动
+        KindLocked,
+    };
+
+    uint64_t edgeKey(uint32_t a, uint32_t b)
+    {
+        return (uint64_t(a) << 32) | b;
+    }
+
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        float error;
+    };
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize)
+{
+    VertexCacheStats stats;
+    if (indices.empty())
+    {
+        return stats;
+    }
+    //顶点进入缓存的时间戳，距今超过cacheSize次miss即已被挤出FIFO
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    size_t misses = 0;
+    size_t uniqueVertices = 0;
+    for (uint32_t index : indices)
+    {
+        if (timestamps[index] == 0)
+        {
+            uniqueVertices++;
+        }
+        if (time - timestamps[index] > cacheSize)
+        {
+            timestamps[index] = time++;
+            misses++;
+        }
+    }
+    stats.acmr = float(misses) / float(indices.size() / 3);
+    stats.atvr = float(misses) / float(uniqueVertices);
+    return stats;
+}
+
+std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    std::vector<uint32_t> result;
+    result.reserve(triangleCount * 3);
+
+    //每个顶点所在的未输出三角形，连续存放
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+    {
+        remaining[indices[i]]++;
+    }
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+    {
+        adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> scores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        scores[v] = vertexScore(-1, remaining[v]);
+    }
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        triangleScores[t] = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> cache, nextCache;
+    cache.reserve(forsythCacheSize + 3);
+    nextCache.reserve(forsythCacheSize + 3);
+    size_t cursor = 0;
+    int64_t best = -1;
+    for (size_t count = 0; count < triangleCount; count++)
+    {
+        if (best < 0)
+        {
+            //缓存中的顶点都没有剩余三角形，从头顺序找下一个
+            while (emitted[cursor])
+            {
+                cursor++;
+            }
+            best = int64_t(cursor);
+        }
+        uint32_t triangle = uint32_t(best);
+        emitted[triangle] = true;
+        const uint32_t *corners = &indices[triangle * 3];
+        result.insert(result.end(), corners, corners + 3);
+
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t v = corners[k];
+            uint32_t *begin = &adjacency[offsets[v]];
+            uint32_t *end = begin + remaining[v];
+            uint32_t *it = std::find(begin, end, triangle);
+            if (it != end)
+            {
+                *it = *(end - 1);
+                remaining[v]--;
+            }
+        }
+
+        nextCache.assign(corners, corners + 3);
+        for (uint32_t v : cache)
+        {
+            if (v != corners[0] && v != corners[1] && v != corners[2])
+            {
+                nextCache.push_back(v);
+            }
+        }
+        for (size_t i = 0; i < nextCache.size(); i++)
+        {
+            cachePosition[nextCache[i]] = i < forsythCacheSize ? int(i) : -1;
+        }
+
+        //更新缓存内(以及刚被挤出)顶点的分数，并在它们的三角形中找下一个最佳三角形
+        best = -1;
+        float bestScore = -1.0f;
+        for (uint32_t v : nextCache)
+        {
+            float score = vertexScore(cachePosition[v], remaining[v]);
+            float delta = score - scores[v];
+            scores[v] = score;
+            for (uint32_t i = offsets[v]; i < offsets[v] + remaining[v]; i++)
+            {
+                triangleScores[adjacency[i]] += delta;
+            }
+        }
+        for (size_t i = 0; i < std::min<size_t>(nextCache.size(), forsythCacheSize); i++)
+        {
+            uint32_t v = nextCache[i];
+            for (uint32_t j = offsets[v]; j < offsets[v] + remaining[v]; j++)
+            {
+                uint32_t t = adjacency[j];
+                if (triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    best = t;
+                }
+            }
+        }
+        if (nextCache.size() > forsythCacheSize)
+        {
+            nextCache.resize(forsythCacheSize);
+        }
+        cache.swap(nextCache);
+    }
+    return result;
+}
+
+std::vector<uint32_t> optimizeOverdraw(const std::vector<uint32_t> &indices, const std::vector<MeshVertex> &vertices)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return indices;
+    }
+
+    //三个顶点都不在FIFO中的三角形是一段新的开始，在这里切开不会增加cache miss
+    std::vector<uint32_t> clusterStarts;
+    std::vector<uint32_t> timestamps(vertices.size(), 0);
+    uint32_t time = overdrawCacheSize + 1;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        int misses = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t v = indices[t * 3 + k];
+            if (time - timestamps[v] > overdrawCacheSize)
+            {
+                timestamps[v] = time++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3)
+        {
+            clusterStarts.push_back(uint32_t(t));
+        }
+    }
+    clusterStarts.push_back(uint32_t(triangleCount));
+    size_t clusterCount = clusterStarts.size() - 1;
+
+    //按面积加权的网格中心，以及每簇的中心与平均法线
+    std::vector<float> clusterData(clusterCount * 6, 0.0f);
+    std::vector<float> clusterArea(clusterCount, 0.0f);
+    float meshCenter[3] = {};
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        float *center = &clusterData[c * 6];
+        float *normal = &clusterData[c * 6 + 3];
+        for (uint32_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+        {
+            const float *a = vertices[indices[t * 3]].position;
+            const float *b = vertices[indices[t * 3 + 1]].position;
+            const float *p = vertices[indices[t * 3 + 2]].position;
+            float n[3];
+            triangleNormal(a, b, p, n);
+            float area = std::sqrt(dot(n, n)) * 0.5f;
+            for (int k = 0; k < 3; k++)
+            {
+                center[k] += (a[k] + b[k] + p[k]) / 3.0f * area;
+                normal[k] += n[k];
+            }
+            clusterArea[c] += area;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            meshCenter[k] += center[k];
+        }
+        meshArea += clusterArea[c];
+    }
+    for (int k = 0; k < 3; k++)
+    {
+        meshCenter[k] /= std::max(meshArea, 1e-20f);
+    }
+
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        float *center = &clusterData[c * 6];
+        float *normal = &clusterData[c * 6 + 3];
+        float offset[3];
+        for (int k = 0; k < 3; k++)
+        {
+            offset[k] = center[k] / std::max(clusterArea[c], 1e-20f) - meshCenter[k];
+        }
+        float length = std::sqrt(dot(normal, normal));
+        sortKeys[c] = length > 0.0f ? dot(offset, normal) / length : 0.0f;
+    }
+    std::vector<uint32_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        order[c] = uint32_t(c);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (uint32_t c : order)
+    {
+        result.insert(result.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+    }
+    return result;
+}
+
+std::vector<uint32_t> optimizeVertexFetchRemap(const std::vector<uint32_t> &indices, size_t vertexCount)
+{
+    std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+    uint32_t next = 0;
+    for (uint32_t index : indices)
+    {
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = next++;
+        }
+    }
+    return remap;
+}
+
+std::vector<uint32_t> simplifyMesh(const std::vector<uint32_t> &indices, const std::vector<MeshVertex> &vertices,
+    size_t targetIndexCount, float targetError, float *resultError)
+{
+    size_t vertexCount = vertices.size();
+    float maxError = 0.0f;
+
+    //位置相同的顶点(UV/法线接缝)共用一个位置编号，拓扑与误差都按位置计算
+    std::vector<uint32_t> positionIds(vertexCount);
+    std::vector<uint32_t> wedgeCount(vertexCount, 0);
+    {
+        std::unordered_map<PositionKey, uint32_t, PositionKeyHash> positions;
+        positions.reserve(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            PositionKey key;
+            memcpy(key.bits, vertices[v].position, sizeof(key.bits));
+            auto inserted = positions.emplace(key, uint32_t(v));
+            positionIds[v] = inserted.first->second;
+        }
+    }
+    {
+        std::vector<bool> used(vertexCount, false);
+        for (uint32_t index : indices)
+        {
+            if (!used[index])
+            {
+                used[index] = true;
+                wedgeCount[positionIds[index]]++;
+            }
+        }
+    }
+
+    //每个三角形的平面按面积加权加到三个顶点上
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t < indices.size() / 3; t++)
+    {
+        const float *a = vertices[indices[t * 3]].position;
+        const float *b = vertices[indices[t * 3 + 1]].position;
+        const float *c = vertices[indices[t * 3 + 2]].position;
+        float n[3];
+        triangleNormal(a, b, c, n);
+        float length = std::sqrt(dot(n, n));
+        if (length == 0.0f)
+        {
+            continue;
+        }
+        double area = length * 0.5;
+        double d = -(n[0] * a[0] + n[1] * a[1] + n[2] * a[2]) / length;
+        for (int k = 0; k < 3; k++)
+        {
+            Quadric &q = quadrics[positionIds[indices[t * 3 + k]]];
+            q.addPlane(n[0] / length, n[1] / length, n[2] / length, d, area);
+            q.weight += area;
+        }
+    }
+
+    std::vector<uint32_t> current = indices;
+    std::vector<uint8_t> kinds(vertexCount);
+    std::vector<uint32_t> offsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::unordered_set<uint64_t> directedEdges;
+    std::vector<Collapse> collapses;
+    std::vector<uint64_t> edges;
+    std::vector<uint32_t> ringFrom, ringTo;
+    bool addedBorderQuadrics = false;
+
+    while (current.size() > targetIndexCount)
+    {
+        size_t triangleCount = current.size() / 3;
+
+        //按位置统计有向边：反向边不存在的是开放边界，同向出现两次的是非流形边
+        directedEdges.clear();
+        std::fill(kinds.begin(), kinds.end(), uint8_t(KindManifold));
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t a = positionIds[current[t * 3 + k]];
+                uint32_t b = positionIds[current[t * 3 + (k + 1) % 3]];
+                if (!directedEdges.insert(edgeKey(a, b)).second)
+                {
+                    kinds[a] = KindLocked;
+                    kinds[b] = KindLocked;
+                }
+            }
+        }
+        auto isBorderEdge = [&](uint32_t a, uint32_t b) {
+            uint32_t pa = positionIds[a], pb = positionIds[b];
+            return directedEdges.count(edgeKey(pa, pb)) + directedEdges.count(edgeKey(pb, pa)) == 1;
+        };
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t a = current[t * 3 + k];
+                uint32_t b = current[t * 3 + (k + 1) % 3];
+                if (!isBorderEdge(a, b))
+                {
+                    continue;
+                }
+                uint32_t pa = positionIds[a], pb = positionIds[b];
+                if (kinds[pa] == KindManifold)
+                    kinds[pa] = KindBorder;
+                if (kinds[pb] == KindManifold)
+                    kinds[pb] = KindBorder;
+
+                //第一轮给边界加上垂直于三角形、经过边界边的平面，之后边界折叠时误差才能反映形状变化
+                if (!addedBorderQuadrics)
+                {
+                    const float *pa3 = vertices[a].position;
+                    const float *pb3 = vertices[b].position;
+                    const float *pc3 = vertices[current[t * 3 + (k + 2) % 3]].position;
+                    float n[3], edge[3], m[3];
+                    triangleNormal(pa3, pb3, pc3, n);
+                    subtract(pb3, pa3, edge);
+                    cross(edge, n, m);
+                    float length = std::sqrt(dot(m, m));
+                    if (length > 0.0f)
+                    {
+                        double d = -(m[0] * pa3[0] + m[1] * pa3[1] + m[2] * pa3[2]) / length;
+                        double weight = dot(edge, edge) * borderWeight;
+                        quadrics[pa].addPlane(m[0] / length, m[1] / length, m[2] / length, d, weight);
+                        quadrics[pb].addPlane(m[0] / length, m[1] / length, m[2] / length, d, weight);
+                    }
+                }
+            }
+        }
+        addedBorderQuadrics = true;
+        auto kindOf = [&](uint32_t v) {
+            uint32_t p = positionIds[v];
+            return wedgeCount[p] > 1 ? uint8_t(KindLocked) : kinds[p];
+        };
+
+        //顶点到三角形的邻接表
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (uint32_t index : current)
+        {
+            offsets[index + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            offsets[v + 1] += offsets[v];
+        }
+        adjacency.resize(current.size());
+        {
+            std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < current.size(); i++)
+            {
+                adjacency[fill[current[i]]++] = uint32_t(i / 3);
+            }
+        }
+
+        //所有边的两个方向中代价较小且允许的一个
+        edges.clear();
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t a = current[t * 3 + k];
+                uint32_t b = current[t * 3 + (k + 1) % 3];
+                if (a != b)
+                {
+                    edges.push_back(edgeKey(std::min(a, b), std::max(a, b)));
+                }
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        auto allowed = [&](uint32_t from, uint32_t to) {
+            uint8_t kind = kindOf(from);
+            return kind == KindManifold || (kind == KindBorder && isBorderEdge(from, to));
+        };
+        auto cost = [&](uint32_t from, uint32_t to) {
+            Quadric q = quadrics[positionIds[from]];
+            q.add(quadrics[positionIds[to]]);
+            return q.error(vertices[to].position);
+        };
+        collapses.clear();
+        for (uint64_t edge : edges)
+        {
+            uint32_t a = uint32_t(edge >> 32), b = uint32_t(edge);
+            Collapse collapse{0, 0, INFINITY};
+            if (allowed(a, b))
+            {
+                collapse = Collapse{a, b, cost(a, b)};
+            }
+            if (allowed(b, a))
+            {
+                float error = cost(b, a);
+                if (error < collapse.error)
+                {
+                    collapse = Collapse{b, a, error};
+                }
+            }
+            if (collapse.error <= targetError)
+            {
+                collapses.push_back(collapse);
+            }
+        }
+        if (collapses.empty())
+        {
+            break;
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y) { return x.error < y.error; });
+
+        //按代价从小到大折叠；一轮中被改动的顶点及其一环邻域不再参与，保证邻接表与翻转检查仍然有效
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            remap[v] = uint32_t(v);
+        }
+        std::fill(touched.begin(), touched.end(), false);
+        size_t collapsed = 0;
+        size_t remainingTriangles = triangleCount;
+        for (const Collapse &collapse : collapses)
+        {
+            if (remainingTriangles * 3 <= targetIndexCount)
+            {
+                break;
+            }
+            uint32_t from = collapse.from, to = collapse.to;
+            if (touched[from] || touched[to])
+            {
+                continue;
+            }
+
+            auto ring = [&](uint32_t v, std::vector<uint32_t> &out) {
+                out.clear();
+                for (uint32_t i = offsets[v]; i < offsets[v + 1]; i++)
+                {
+                    for (int k = 0; k < 3; k++)
+                    {
+                        uint32_t p = positionIds[current[adjacency[i] * 3 + k]];
+                        if (p != positionIds[v])
+                        {
+                            out.push_back(p);
+                        }
+                    }
+                }
+                std::sort(out.begin(), out.end());
+                out.erase(std::unique(out.begin(), out.end()), out.end());
+            };
+            //link condition：两个端点的公共邻居只能是共享三角形的第三个顶点，否则折叠后会产生非流形
+            ring(from, ringFrom);
+            ring(to, ringTo);
+            size_t common = 0;
+            for (size_t i = 0, j = 0; i < ringFrom.size() && j < ringTo.size();)
+            {
+                if (ringFrom[i] < ringTo[j])
+                    i++;
+                else if (ringFrom[i] > ringTo[j])
+                    j++;
+                else
+                {
+                    common++;
+                    i++;
+                    j++;
+                }
+            }
+            size_t shared = 0;
+            bool valid = true;
+            bool toIsSeam = wedgeCount[positionIds[to]] > 1;
+            for (uint32_t i = offsets[from]; i < offsets[from + 1] && valid; i++)
+            {
+                const uint32_t *corners = &current[adjacency[i] * 3];
+                if (corners[0] == to || corners[1] == to || corners[2] == to)
+                {
+                    shared++;
+                    continue;
+                }
+                //折叠到接缝顶点时，其他接缝顶点可能位于接缝另一侧，改用的UV会错
+                float before[3], after[3];
+                const float *p[3], *q[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    if (toIsSeam && corners[k] != from && wedgeCount[positionIds[corners[k]]] > 1)
+                    {
+                        valid = false;
+                    }
+                    p[k] = vertices[corners[k]].position;
+                    q[k] = corners[k] == from ? vertices[to].position : p[k];
+                }
+                //三角形不能翻转
+                triangleNormal(p[0], p[1], p[2], before);
+                triangleNormal(q[0], q[1], q[2], after);
+                if (dot(before, after) <= 0.0f)
+                {
+                    valid = false;
+                }
+            }
+            if (!valid || common != shared)
+            {
+                continue;
+            }
+
+            remap[from] = to;
+            quadrics[positionIds[to]].add(quadrics[positionIds[from]]);
+            maxError = std::max(maxError, collapse.error);
+            remainingTriangles -= shared;
+            collapsed++;
+            touched[from] = true;
+            touched[to] = true;
+            for (uint32_t i = offsets[from]; i < offsets[from + 1]; i++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    touched[current[adjacency[i] * 3 + k]] = true;
+                }
+            }
+        }
+        if (collapsed == 0)
+        {
+            break;
+        }
+
+        //改写索引并去掉退化的三角形
+        size_t write = 0;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            uint32_t a = remap[current[t * 3]], b = remap[current[t * 3 + 1]], c = remap[current[t * 3 + 2]];
+            if (a != b && b != c && a != c)
+            {
+                current[write++] = a;
+                current[write++] = b;
+                current[write++] = c;
+            }
+        }
+        current.resize(write);
+    }
+
+    if (resultError != nullptr)
+    {
+        *resultError = maxError;
+    }
+    return current;
+}
+
+void buildMeshlets(const std::vector<uint32_t> &indices, const std::vector<MeshVertex> &vertices, uint32_t maxVertices,
+    uint32_t maxTriangles, std::vector<Meshlet> &meshlets, std::vector<uint32_t> &meshletVertices, std::vector<uint8_t> &meshletTriangles)
+{
+    //局部索引是uint8
+    maxVertices = std::min(std::max(maxVertices, 3u), 256u);
+    maxTriangles = std::max(maxTriangles, 1u);
+    std::vector<uint32_t> localIndex(vertices.size(), UINT32_MAX);
+    Meshlet meshlet;
+    meshlet.vertexOffset = uint32_t(meshletVertices.size());
+    meshlet.triangleOffset = uint32_t(meshletTriangles.size());
+
+    auto finish = [&]() {
+        const uint32_t *globals = &meshletVertices[meshlet.vertexOffset];
+        const uint8_t *locals = &meshletTriangles[meshlet.triangleOffset];
+
+        //包围球：AABB中心到最远顶点
+        float minimum[3] = {INFINITY, INFINITY, INFINITY};
+        float maximum[3] = {-INFINITY, -INFINITY, -INFINITY};
+        for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+        {
+            const float *p = vertices[globals[i]].position;
+            for (int k = 0; k < 3; k++)
+            {
+                minimum[k] = std::min(minimum[k], p[k]);
+                maximum[k] = std::max(maximum[k], p[k]);
+            }
+        }
+        float radius = 0.0f;
+        for (int k = 0; k < 3; k++)
+        {
+            meshlet.center[k] = (minimum[k] + maximum[k]) * 0.5f;
+        }
+        for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+        {
+            float offset[3];
+            subtract(vertices[globals[i]].position, meshlet.center, offset);
+            radius = std::max(radius, dot(offset, offset));
+        }
+        meshlet.radius = std::sqrt(radius);
+
+        //法线锥：轴为三角形单位法线的平均，半角为轴与法线的最大夹角
+        std::vector<float> normals;
+        normals.reserve(meshlet.triangleCount * 3);
+        float axis[3] = {};
+        for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+        {
+            float n[3];
+            triangleNormal(vertices[globals[locals[t * 3]]].position, vertices[globals[locals[t * 3 + 1]]].position,
+                vertices[globals[locals[t * 3 + 2]]].position, n);
+            float length = std::sqrt(dot(n, n));
+            if (length == 0.0f)
+            {
+                continue;
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                normals.push_back(n[k] / length);
+                axis[k] += n[k] / length;
+            }
+        }
+        float axisLength = std::sqrt(dot(axis, axis));
+        meshlet.coneCutoff = 1.0f;
+        if (axisLength > 0.0f)
+        {
+            float minimumDot = 1.0f;
+            for (int k = 0; k < 3; k++)
+            {
+                meshlet.coneAxis[k] = axis[k] / axisLength;
+            }
+            for (size_t i = 0; i < normals.size(); i += 3)
+            {
+                minimumDot = std::min(minimumDot, dot(&normals[i], meshlet.coneAxis));
+            }
+            //超过半球的锥不可能整体背对相机
+            if (minimumDot > 0.0f)
+            {
+                meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+            }
+        }
+
+        for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+        {
+            localIndex[globals[i]] = UINT32_MAX;
+        }
+        meshlets.push_back(meshlet);
+        //下一个meshlet的三角形从4字节边界开始，GPU可以按uint读取
+        meshletTriangles.resize((meshletTriangles.size() + 3) & ~size_t(3), 0);
+        meshlet = Meshlet();
+        meshlet.vertexOffset = uint32_t(meshletVertices.size());
+        meshlet.triangleOffset = uint32_t(meshletTriangles.size());
+    };
+
+    for (size_t t = 0; t < indices.size() / 3; t++)
+    {
+        const uint32_t *corners = &indices[t * 3];
+        uint32_t newVertices = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            bool duplicate = (k > 0 && corners[k] == corners[0]) || (k > 1 && corners[k] == corners[1]);
+            if (localIndex[corners[k]] == UINT32_MAX && !duplicate)
+            {
+                newVertices++;
+            }
+        }
+        if (meshlet.vertexCount + newVertices > maxVertices || meshlet.triangleCount >= maxTriangles)
+        {
+            finish();
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t &local = localIndex[corners[k]];
+            if (local == UINT32_MAX)
+            {
+                local = meshlet.vertexCount++;
+                meshletVertices.push_back(corners[k]);
+            }
+            meshletTriangles.push_back(uint8_t(local));
+        }
+        meshlet.triangleCount++;
+    }
+    if (meshlet.triangleCount > 0)
+    {
+        finish();
+    }
+}
+
+bool meshletBackfacing(const Meshlet &meshlet, const float cameraPosition[3])
+{
+    float offset[3];
+    subtract(meshlet.center, cameraPosition, offset);
+    return dot(offset, meshlet.coneAxis) >= meshlet.coneCutoff * std::sqrt(dot(offset, offset)) + meshlet.radius;
+}
+
+uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (exponent == 0xFF)
+    {
+        return uint16_t(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+    }
+    int32_t halfExponent = int32_t(exponent) - 127 + 15;
+    if (halfExponent >= 31)
+    {
+        return uint16_t(sign | 0x7C00);
+    }
+    //结果为非规格化数，就近舍入到偶数
+    if (halfExponent <= 0)
+    {
+        if (halfExponent < -10)
+        {
+            return uint16_t(sign);
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = uint32_t(14 - halfExponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+        {
+            half++;
+        }
+        return uint16_t(sign | half);
+    }
+    //尾数进位溢出时会进到指数上，结果仍然正确
+    uint32_t half = (uint32_t(halfExponent) << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+    {
+        half++;
+    }
+    return uint16_t(sign | half);
+}
+
+float halfToFloat(uint16_t value)
+{
+    uint32_t exponent = (value >> 10) & 0x1F;
+    uint32_t mantissa = value & 0x3FF;
+    float result;
+    if (exponent == 0)
+    {
+        result = std::ldexp(float(mantissa), -24);
+    }
+    else if (exponent == 31)
+    {
+        result = mantissa != 0 ? NAN : INFINITY;
+    }
+    else
+    {
+        uint32_t bits = ((exponent + 112) << 23) | (mantissa << 13);
+        memcpy(&result, &bits, sizeof(result));
+    }
+    return (value & 0x8000) ? -result : result;
+}
+
+PackedVertex quantizeVertex(const MeshVertex &vertex, const MeshQuantization &quantization)
+{
+    PackedVertex packed{};
+    for (int k = 0; k < 3; k++)
+    {
+        float unorm = quantization.scale[k] > 0.0f ? (vertex.position[k] - quantization.offset[k]) / quantization.scale[k] : 0.0f;
+        packed.position[k] = uint16_t(std::min(std::max(std::lround(unorm), 0l), 65535l));
+    }
+
+    //八面体映射：投影到|x| + |y| + |z| = 1，下半球沿对角线翻到外侧
+    const float *n = vertex.normal;
+    float length = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+    float x = length > 0.0f ? n[0] / length : 0.0f;
+    float y = length > 0.0f ? n[1] / length : 0.0f;
+    if (length > 0.0f && n[2] < 0.0f)
+    {
+        float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    packed.normal[0] = int16_t(std::lround(std::min(std::max(x, -1.0f), 1.0f) * 32767.0f));
+    packed.normal[1] = int16_t(std::lround(std::min(std::max(y, -1.0f), 1.0f) * 32767.0f));
+
+    packed.uv[0] = floatToHalf(vertex.uv[0]);
+    packed.uv[1] = floatToHalf(vertex.uv[1]);
+    return packed;
+}
+
+MeshVertex dequantizeVertex(const PackedVertex &packed, const MeshQuantization &quantization)
+{
+    MeshVertex vertex;
+    for (int k = 0; k < 3; k++)
+    {
+        vertex.position[k] = quantization.offset[k] + float(packed.position[k]) * quantization.scale[k];
+    }
+
+    float x = std::max(packed.normal[0] / 32767.0f, -1.0f);
+    float y = std::max(packed.normal[1] / 32767.0f, -1.0f);
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    if (z < 0.0f)
+    {
+        float unfoldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float unfoldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = unfoldedX;
+        y = unfoldedY;
+    }
+    float length = std::sqrt(x * x + y * y + z * z);
+    vertex.normal[0] = x / length;
+    vertex.normal[1] = y / length;
+    vertex.normal[2] = z / length;
+
+    vertex.uv[0] = halfToFloat(packed.uv[0]);
+    vertex.uv[1] = halfToFloat(packed.uv[1]);
+    return vertex;
+}
+
+MeshAsset importMesh(const std::vector<MeshVertex> &vertices, const std::vector<uint32_t> &indices, const MeshImportOptions &options)
+{
+    MeshAsset asset;
+    if (vertices.empty() || indices.size() < 3)
+    {
+        return asset;
+    }
+
+    float minimum[3] = {INFINITY, INFINITY, INFINITY};
+    float maximum[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (const MeshVertex &vertex : vertices)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            minimum[k] = std::min(minimum[k], vertex.position[k]);
+            maximum[k] = std::max(maximum[k], vertex.position[k]);
+        }
+    }
+    float radius = 0.0f;
+    for (int k = 0; k < 3; k++)
+    {
+        asset.center[k] = (minimum[k] + maximum[k]) * 0.5f;
+        asset.quantization.offset[k] = minimum[k];
+        asset.quantization.scale[k] = (maximum[k] - minimum[k]) / 65535.0f;
+    }
+    for (const MeshVertex &vertex : vertices)
+    {
+        float offset[3];
+        subtract(vertex.position, asset.center, offset);
+        radius = std::max(radius, dot(offset, offset));
+    }
+    asset.radius = std::sqrt(radius);
+
+    //每一级从上一级简化，误差按各级之和估计(上界)
+    std::vector<std::vector<uint32_t>> levels;
+    std::vector<float> errors;
+    std::vector<uint32_t> valid;
+    valid.reserve(indices.size());
+    for (size_t t = 0; t < indices.size() / 3; t++)
+    {
+        if (indices[t * 3] != indices[t * 3 + 1] && indices[t * 3 + 1] != indices[t * 3 + 2] && indices[t * 3] != indices[t * 3 + 2])
+        {
+            valid.insert(valid.end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+        }
+    }
+    levels.push_back(optimizeOverdraw(optimizeVertexCache(valid, vertices.size()), vertices));
+    errors.push_back(0.0f);
+    while (levels.size() < std::max(options.maxLods, 1u))
+    {
+        const std::vector<uint32_t> &previous = levels.back();
+        if (previous.size() / 3 <= options.lodMinTriangles)
+        {
+            break;
+        }
+        size_t target = size_t(float(previous.size() / 3) * options.lodReduction) * 3;
+        float error = 0.0f;
+        std::vector<uint32_t> simplified = simplifyMesh(previous, vertices, target, options.lodMaxError * asset.radius, &error);
+        //减少不到10%时再分级没有意义
+        if (simplified.empty() || simplified.size() > previous.size() * 9 / 10)
+        {
+            break;
+        }
+        levels.push_back(optimizeOverdraw(optimizeVertexCache(simplified, vertices.size()), vertices));
+        errors.push_back(errors.back() + error);
+    }
+
+    //所有LOD共用vertex buffer，按LOD0开始的首次使用顺序重排，粗的LOD访问的顶点也大多在前面
+    std::vector<uint32_t> all;
+    for (const std::vector<uint32_t> &level : levels)
+    {
+        all.insert(all.end(), level.begin(), level.end());
+    }
+    std::vector<uint32_t> remap = optimizeVertexFetchRemap(all, vertices.size());
+    size_t usedVertices = 0;
+    for (uint32_t index : remap)
+    {
+        usedVertices += index != UINT32_MAX ? 1 : 0;
+    }
+    std::vector<MeshVertex> ordered(usedVertices);
+    for (size_t v = 0; v < vertices.size(); v++)
+    {
+        if (remap[v] != UINT32_MAX)
+        {
+            ordered[remap[v]] = vertices[v];
+        }
+    }
+
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        std::vector<uint32_t> &level = levels[i];
+        for (uint32_t &index : level)
+        {
+            index = remap[index];
+        }
+        MeshLod lod;
+        lod.indexOffset = uint32_t(asset.indices.size());
+        lod.indexCount = uint32_t(level.size());
+        lod.meshletOffset = uint32_t(asset.meshlets.size());
+        lod.error = errors[i];
+        asset.indices.insert(asset.indices.end(), level.begin(), level.end());
+        buildMeshlets(level, ordered, options.meshletMaxVertices, options.meshletMaxTriangles, asset.meshlets, asset.meshletVertices,
+            asset.meshletTriangles);
+        lod.meshletCount = uint32_t(asset.meshlets.size()) - lod.meshletOffset;
+        asset.lods.push_back(lod);
+    }
+
+    asset.vertices.reserve(ordered.size());
+    for (const MeshVertex &vertex : ordered)
+    {
+        asset.vertices.push_back(quantizeVertex(vertex, asset.quantization));
+    }
+    return asset;
+}
+
+uint32_t selectMeshLod(const MeshLod *lods, uint32_t lodCount, float distance, float projectionScale, float pixelThreshold)
+{
+    //相机在包围球内时总是用最精细的一级
+    if (distance <= 0.0f)
+    {
+        return 0;
+    }
+    uint32_t selected = 0;
+    for (uint32_t i = 1; i < lodCount; i++)
+    {
+        if (lods[i].error * projectionScale / distance > pixelThreshold)
+        {
+            break;
+        }
+        selected = i;
+    }
+    return selected;
+}
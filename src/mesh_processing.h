@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 导入时的网格处理，全部在CPU上完成：
+//   顶点缓存/overdraw优化 -> QEM简化出LOD链 -> 顶点按首次使用重排 -> 量化 -> 切分meshlet
+// 结果由mesh_file.h写成可以直接mmap使用的二进制文件
+
+// 导入时的完整精度顶点
+struct MeshVertex
+{
+    float position[3] = {};
+    float normal[3] = {0.0f, 0.0f, 1.0f};
+    float uv[2] = {};
+};
+
+// 量化后的顶点，16字节：
+//   position：相对网格AABB的16位unorm(VK_FORMAT_R16G16B16A16_UNORM，w恒为0)
+//   normal  ：八面体映射后的16位snorm(VK_FORMAT_R16G16_SNORM)
+//   uv      ：half float(VK_FORMAT_R16G16_SFLOAT)，可以超出[0, 1]用于重复贴图
+struct PackedVertex
+{
+    uint16_t position[4];
+    int16_t normal[2];
+    uint16_t uv[2];
+};
+
+// 反量化：position = offset + unorm * scale
+struct MeshQuantization
+{
+    float offset[3] = {};
+    float scale[3] = {1.0f, 1.0f, 1.0f};
+};
+
+// 一级LOD：在共享的index buffer与meshlet数组中的范围
+// error为相对原始网格的最大几何误差(模型空间长度)，LOD越粗误差越大
+struct MeshLod
+{
+    uint32_t indexOffset = 0;
+    uint32_t indexCount = 0;
+    uint32_t meshletOffset = 0;
+    uint32_t meshletCount = 0;
+    float error = 0.0f;
+};
+
+// meshlet：最多maxVertices个顶点、maxTriangles个三角形
+// 顶点是meshletVertices[vertexOffset, +vertexCount)中的全局索引，三角形是
+// meshletTriangles[triangleOffset, +triangleCount * 3)中的局部索引(uint8)，每个meshlet的三角形按4字节对齐
+// 包围球用于视锥/遮挡剔除，法线锥用于整块背面剔除(见meshletBackfacing)
+struct Meshlet
+{
+    uint32_t vertexOffset = 0;
+    uint32_t triangleOffset = 0;
+    uint32_t vertexCount = 0;
+    uint32_t triangleCount = 0;
+    float center[3] = {};
+    float radius = 0.0f;
+    float coneAxis[3] = {};
+    // 法线锥半角的正弦；锥太宽无法剔除时为1
+    float coneCutoff = 1.0f;
+};
+
+struct MeshImportOptions
+{
+    // 包括原始网格在内的最大级数
+    uint32_t maxLods = 6;
+    // 每级的目标三角形数为上一级的比例
+    float lodReduction = 0.5f;
+    // 每级允许的最大简化误差，相对网格包围球半径
+    float lodMaxError = 0.05f;
+    // 三角形少于这个数时不再继续简化
+    uint32_t lodMinTriangles = 64;
+    // 64/124是常见GPU上mesh shader的推荐值
+    uint32_t meshletMaxVertices = 64;
+    uint32_t meshletMaxTriangles = 124;
+};
+
+struct MeshAsset
+{
+    std::vector<PackedVertex> vertices;
+    // 所有LOD的索引依次排列，都引用同一个vertex buffer
+    std::vector<uint32_t> indices;
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint8_t> meshletTriangles;
+    MeshQuantization quantization;
+    // 整个网格的包围球
+    float center[3] = {};
+    float radius = 0.0f;
+};
+
+// 模拟FIFO顶点缓存得到的统计
+struct VertexCacheStats
+{
+    // 平均每个三角形的cache miss(average cache miss ratio)，理想值约0.5，最差3
+    float acmr = 0.0f;
+    // 平均每个被引用顶点的cache miss，理想值1
+    float atvr = 0.0f;
+};
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize = 16);
+
+// Tom Forsyth的线性时间顶点缓存优化，按模拟的LRU缓存给顶点打分，每次输出分数最高的三角形
+std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount);
+// 在缓存优化后的顺序上，把每段从冷缓存开始的三角形作为一簇，按簇朝外的程度排序，
+// 外侧的簇先画，内部被挡住的像素更容易被early-Z剔除；簇内顺序不变，ACMR基本不受影响
+std::vector<uint32_t> optimizeOverdraw(const std::vector<uint32_t> &indices, const std::vector<MeshVertex> &vertices);
+// 按首次被引用的顺序给顶点重新编号，返回旧索引到新索引的映射，未使用的顶点为UINT32_MAX
+// 调用方用这个映射重排vertex buffer并改写indices
+std::vector<uint32_t> optimizeVertexFetchRemap(const std::vector<uint32_t> &indices, size_t vertexCount);
+
+// 二次误差度量(QEM)的边折叠简化，顶点只会折叠到相邻的已有顶点上，所以结果仍然引用原vertex buffer
+// UV/法线接缝上的顶点不移动，边界顶点只沿边界折叠；targetError为模型空间长度
+// 返回简化后的indices，resultError为实际产生的最大误差
+std::vector<uint32_t> simplifyMesh(const std::vector<uint32_t> &indices, const std::vector<MeshVertex> &vertices,
+    size_t targetIndexCount, float targetError, float *resultError);
+
+// 按indices顺序贪心地切分，indices应该已经做过缓存优化，相邻三角形共享的顶点较多
+void buildMeshlets(const std::vector<uint32_t> &indices, const std::vector<MeshVertex> &vertices, uint32_t maxVertices,
+    uint32_t maxTriangles, std::vector<Meshlet> &meshlets, std::vector<uint32_t> &meshletVertices, std::vector<uint8_t> &meshletTriangles);
+// 相机在法线锥的背面，meshlet中所有三角形都背对相机
+bool meshletBackfacing(const Meshlet &meshlet, const float cameraPosition[3]);
+
+PackedVertex quantizeVertex(const MeshVertex &vertex, const MeshQuantization &quantization);
+MeshVertex dequantizeVertex(const PackedVertex &vertex, const MeshQuantization &quantization);
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+// 完整的导入流程，vertices中不应有完全相同的顶点
+MeshAsset importMesh(const std::vector<MeshVertex> &vertices, const std::vector<uint32_t> &indices, const MeshImportOptions &options);
+
+// 按屏幕空间误差选择LOD：误差投影到屏幕上不超过pixelThreshold像素的最粗一级
+// distance为相机到包围球最近点的距离，projectionScale = 视口高度(像素) / (2 * tan(fovY / 2))
+uint32_t selectMeshLod(const MeshLod *lods, uint32_t lodCount, float distance, float projectionScale, float pixelThreshold);
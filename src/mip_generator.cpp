@@ -0,0 +1,443 @@
+#include "mip_generator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    // 计数器之间的间隔，不小于任何设备的minStorageBufferOffsetAlignment
+    const VkDeviceSize counterStride = 256;
+
+    struct PushConstants
+    {
+        float invSourceSize[2];
+        uint32_t mips;
+        uint32_t numWorkGroups;
+        uint32_t srgb;
+    };
+
+    std::vector<char> readShader(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("=====Failed to open shader file: " + path + "=====");
+        }
+        std::vector<char> code(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(code.data(), code.size());
+        return code;
+    }
+
+    uint32_t findMemoryType(const VkPhysicalDeviceMemoryProperties &memoryProperties, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+    {
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+        {
+            if ((typeFilter & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+            {
+                return i;
+            }
+        }
+        throw std::runtime_error("=====Failed to find mip generator memory type!=====");
+    }
+
+    VkImageView createView(VkDevice device, VkImage image, VkFormat format, uint32_t level)
+    {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = level;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        VkImageView view;
+        if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS)
+        {
+            throw std::runtime_error("=====Failed to create mip view!=====");
+        }
+        return view;
+    }
+
+    VkImageMemoryBarrier imageBarrier(VkImage image, uint32_t baseLevel, uint32_t levelCount,
+        VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+    {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = baseLevel;
+        barrier.subresourceRange.levelCount = levelCount;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        return barrier;
+    }
+}
+
+void MipGenerator::create(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties, const std::string &shaderDirectory,
+    bool subgroupQuad, uint32_t maxTargets)
+{
+    this->device = device;
+
+    VkDescriptorSetLayoutBinding bindings[4]{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = maxMips;
+    bindings[2].binding = 2;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[2].descriptorCount = 1;
+    bindings[3].binding = 3;
+    bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[3].descriptorCount = 1;
+    for (auto &binding : bindings)
+    {
+        binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 4;
+    layoutInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create mip generator descriptor set layout!=====");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create mip generator pipeline layout!=====");
+    }
+
+    //每种存储格式一个pipeline，文件名与CMakeLists.txt中的add_shader一致
+    static const char *variantNames[VariantCount] = {"rgba8", "rgba16f", "r32f"};
+    for (uint32_t variant = 0; variant < VariantCount; variant++)
+    {
+        std::string path = shaderDirectory + "/spd_" + variantNames[variant] + (subgroupQuad ? "" : "_lds") + ".spv";
+        std::vector<char> code = readShader(path);
+
+        VkShaderModuleCreateInfo moduleInfo{};
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.codeSize = code.size();
+        moduleInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+        VkShaderModule module;
+        if (vkCreateShaderModule(device, &moduleInfo, nullptr, &module) != VK_SUCCESS)
+        {
+            throw std::runtime_error("=====Failed to create shader module: " + path + "=====");
+        }
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = module;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = pipelineLayout;
+        VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipelines[variant]);
+        vkDestroyShaderModule(device, module, nullptr);
+        if (result != VK_SUCCESS)
+        {
+            throw std::runtime_error("=====Failed to create mip generator pipeline!=====");
+        }
+    }
+
+    VkDescriptorPoolSize poolSizes[3]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = maxTargets;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = maxTargets * (maxMips + 1);
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[2].descriptorCount = maxTargets;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolInfo.poolSizeCount = 3;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = maxTargets;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create mip generator descriptor pool!=====");
+    }
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create mip generator sampler!=====");
+    }
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = counterStride * maxTargets;
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &counterBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create mip generator counter buffer!=====");
+    }
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, counterBuffer, &memRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    //计数器只需在创建时清零一次，之后由shader自己复位，所以直接用HOST_VISIBLE内存
+    allocInfo.memoryTypeIndex = findMemoryType(memoryProperties, memRequirements.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &counterMemory) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to allocate mip generator counter memory!=====");
+    }
+    vkBindBufferMemory(device, counterBuffer, counterMemory, 0);
+    void *mapped = nullptr;
+    vkMapMemory(device, counterMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    memset(mapped, 0, static_cast<size_t>(bufferInfo.size));
+    vkUnmapMemory(device, counterMemory);
+
+    targets.clear();
+    freeTargets.clear();
+    targets.resize(maxTargets);
+    for (uint32_t i = maxTargets; i-- > 0;)
+    {
+        freeTargets.push_back(i);
+    }
+}
+
+void MipGenerator::destroy()
+{
+    if (device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < targets.size(); i++)
+    {
+        if (targets[i].image != VK_NULL_HANDLE)
+        {
+            removeTarget(i);
+        }
+    }
+    vkDestroyBuffer(device, counterBuffer, nullptr);
+    vkFreeMemory(device, counterMemory, nullptr);
+    vkDestroySampler(device, sampler, nullptr);
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    for (auto &pipeline : pipelines)
+    {
+        vkDestroyPipeline(device, pipeline, nullptr);
+        pipeline = VK_NULL_HANDLE;
+    }
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    targets.clear();
+    freeTargets.clear();
+    device = VK_NULL_HANDLE;
+}
+
+bool MipGenerator::supportsSubgroupQuad(VkPhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+    subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &subgroupProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    return properties.properties.apiVersion >= VK_API_VERSION_1_1 &&
+           subgroupProperties.subgroupSize >= 4 &&
+           (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+           (subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_QUAD_BIT);
+}
+
+bool MipGenerator::isFormatSupported(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+    case VK_FORMAT_R32_SFLOAT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+MipGenerator::Variant MipGenerator::variantForFormat(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        return Rgba8;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return Rgba16f;
+    case VK_FORMAT_R32_SFLOAT:
+        return R32f;
+    default:
+        throw std::runtime_error("=====Unsupported mip generator format!=====");
+    }
+}
+
+uint32_t MipGenerator::addTarget(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+    if (freeTargets.empty())
+    {
+        throw std::runtime_error("=====Too many mip generator targets!=====");
+    }
+    //第二阶段只有一个workgroup，从最多64x64的mip6继续缩小
+    if (width > 4096 || height > 4096 || mipLevels > maxMips + 1)
+    {
+        throw std::runtime_error("=====Mip generator supports images up to 4096x4096!=====");
+    }
+    if (mipLevels < 2)
+    {
+        throw std::runtime_error("=====Mip generator target needs at least two mip levels!=====");
+    }
+
+    uint32_t index = freeTargets.back();
+    freeTargets.pop_back();
+    Target &target = targets[index];
+    target.image = image;
+    target.variant = variantForFormat(format);
+    target.srgb = format == VK_FORMAT_R8G8B8A8_SRGB;
+    target.width = width;
+    target.height = height;
+    target.mips = mipLevels - 1;
+    target.groupsX = (width + 63) / 64;
+    target.groupsY = (height + 63) / 64;
+
+    //采样用原格式(sRGB时由硬件解码后再过滤)，存储用UNORM
+    VkFormat storageFormat = target.srgb ? VK_FORMAT_R8G8B8A8_UNORM : format;
+    target.sourceView = createView(device, image, format, 0);
+    target.mipViews.clear();
+    for (uint32_t level = 1; level < mipLevels; level++)
+    {
+        target.mipViews.push_back(createView(device, image, storageFormat, level));
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+    if (vkAllocateDescriptorSets(device, &allocInfo, &target.descriptorSet) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to allocate mip generator descriptor set!=====");
+    }
+
+    VkDescriptorImageInfo sourceInfo{};
+    sourceInfo.sampler = sampler;
+    sourceInfo.imageView = target.sourceView;
+    sourceInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    //数组中没有对应级别的元素填最后一级，shader按mips判断不会写入
+    VkDescriptorImageInfo mipInfos[maxMips]{};
+    for (uint32_t i = 0; i < maxMips; i++)
+    {
+        mipInfos[i].imageView = target.mipViews[std::min<size_t>(i, target.mipViews.size() - 1)];
+        mipInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    }
+
+    VkDescriptorBufferInfo counterInfo{};
+    counterInfo.buffer = counterBuffer;
+    counterInfo.offset = counterStride * index;
+    counterInfo.range = sizeof(uint32_t);
+
+    VkWriteDescriptorSet writes[4]{};
+    for (auto &write : writes)
+    {
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = target.descriptorSet;
+        write.descriptorCount = 1;
+    }
+    writes[0].dstBinding = 0;
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[0].pImageInfo = &sourceInfo;
+    writes[1].dstBinding = 1;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[1].descriptorCount = maxMips;
+    writes[1].pImageInfo = mipInfos;
+    writes[2].dstBinding = 2;
+    writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[2].pImageInfo = &mipInfos[5];
+    writes[3].dstBinding = 3;
+    writes[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[3].pBufferInfo = &counterInfo;
+    vkUpdateDescriptorSets(device, 4, writes, 0, nullptr);
+
+    return index;
+}
+
+void MipGenerator::removeTarget(uint32_t index)
+{
+    Target &target = targets[index];
+    vkFreeDescriptorSets(device, descriptorPool, 1, &target.descriptorSet);
+    vkDestroyImageView(device, target.sourceView, nullptr);
+    for (VkImageView view : target.mipViews)
+    {
+        vkDestroyImageView(device, view, nullptr);
+    }
+    target = Target{};
+    freeTargets.push_back(index);
+}
+
+void MipGenerator::record(VkCommandBuffer commandBuffer, uint32_t index,
+    VkImageLayout mip0Layout, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+    VkPipelineStageFlags dstStage) const
+{
+    const Target &target = targets[index];
+
+    //整张image在dispatch期间使用GENERAL：mip0被采样，其余级别被写入，mip6同时被读取
+    VkImageMemoryBarrier barriers[2] = {
+        imageBarrier(target.image, 0, 1, mip0Layout, VK_IMAGE_LAYOUT_GENERAL, srcAccess, VK_ACCESS_SHADER_READ_BIT),
+        imageBarrier(target.image, 1, target.mips, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+            0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+    };
+    vkCmdPipelineBarrier(commandBuffer, srcStage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+    PushConstants constants{};
+    constants.invSourceSize[0] = 1.0f / target.width;
+    constants.invSourceSize[1] = 1.0f / target.height;
+    constants.mips = target.mips;
+    constants.numWorkGroups = target.groupsX * target.groupsY;
+    constants.srgb = target.srgb ? 1 : 0;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[target.variant]);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &target.descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(commandBuffer, target.groupsX, target.groupsY, 1);
+
+    VkImageMemoryBarrier barrier = imageBarrier(target.image, 0, target.mips + 1,
+        VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
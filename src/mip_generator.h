@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 在GPU上用一次compute dispatch生成整条mip链(shader/spd.comp)，代替逐级vkCmdBlitImage加barrier
+// 每个目标image加入时创建好各级view与descriptor set，之后每次生成只需录制两个barrier与一次dispatch，
+// 所以同一张render target(bloom、曝光的降采样链)可以每帧重复生成
+class MipGenerator
+{
+public:
+    // mip0之下最多生成的级数，mip0最大4096x4096
+    static const uint32_t maxMips = 12;
+
+    // shaderDirectory中需要有spd_*.spv，subgroupQuad为false时使用shared memory版本
+    void create(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties, const std::string &shaderDirectory,
+        bool subgroupQuad, uint32_t maxTargets);
+    void destroy();
+
+    // compute阶段是否支持subgroup quad操作(需要Vulkan 1.1)
+    static bool supportsSubgroupQuad(VkPhysicalDevice physicalDevice);
+    // 支持RGBA8(UNORM/SRGB)、RGBA16F与R32F，mip0用线性过滤采样，R32F需要设备支持SAMPLED_IMAGE_FILTER_LINEAR
+    static bool isFormatSupported(VkFormat format);
+
+    // image需要SAMPLED与STORAGE usage，SRGB格式还需要VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT(存储时使用UNORM view)
+    uint32_t addTarget(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels);
+    // 调用方保证没有正在执行的命令使用该目标
+    void removeTarget(uint32_t target);
+
+    // 由mip0生成其余各级。mip0的当前layout为mip0Layout，之前的写入由srcStage/srcAccess描述；
+    // 结束后所有级别处于SHADER_READ_ONLY_OPTIMAL，对dstStage的采样可见
+    void record(VkCommandBuffer commandBuffer, uint32_t target,
+        VkImageLayout mip0Layout, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+        VkPipelineStageFlags dstStage) const;
+
+private:
+    enum Variant
+    {
+        Rgba8,
+        Rgba16f,
+        R32f,
+        VariantCount,
+    };
+
+    struct Target
+    {
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView sourceView = VK_NULL_HANDLE;
+        std::vector<VkImageView> mipViews;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        Variant variant = Rgba8;
+        bool srgb = false;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t mips = 0;
+        uint32_t groupsX = 0;
+        uint32_t groupsY = 0;
+    };
+
+    static Variant variantForFormat(VkFormat format);
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipelines[VariantCount] = {};
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+    // 每个目标一个全局计数器，用来找出最后完成的workgroup，shader执行完会自己清零
+    VkBuffer counterBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory counterMemory = VK_NULL_HANDLE;
+    std::vector<Target> targets;
+    std::vector<uint32_t> freeTargets;
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// 有界、无锁的多生产者单消费者队列(Vyukov的环形缓冲区算法)
+// 每个槽位带一个序号：序号 == 写位置 表示可写，== 读位置+1 表示可读
+// 生产者只在写位置上做CAS，不会阻塞；队列满时tryPush返回false，由调用方决定丢弃还是重试
+template <typename T, size_t Capacity>
+class MpscQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    MpscQueue()
+    {
+        for (size_t i = 0; i < Capacity; i++)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    // 任意线程可调用
+    template <typename Fill>
+    bool tryPush(Fill &&fill)
+    {
+        size_t position = writePosition.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;)
+        {
+            cell = &cells[position & (Capacity - 1)];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0)
+            {
+                if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                // 消费者还没有读走这一圈之前的数据
+                return false;
+            }
+            else
+            {
+                position = writePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        // 槽位已经属于当前生产者，直接原地填充，避免额外拷贝
+        std::forward<Fill>(fill)(cell->value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 只能由唯一的消费者线程调用
+    bool tryPop(T &value)
+    {
+        Cell &cell = cells[readPosition & (Capacity - 1)];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (sequence != readPosition + 1)
+        {
+            return false;
+        }
+
+        value = std::move(cell.value);
+        cell.sequence.store(readPosition + Capacity, std::memory_order_release);
+        readPosition++;
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    // 生产者与消费者的位置放在不同cache line，避免伪共享
+    alignas(64) Cell cells[Capacity];
+    alignas(64) std::atomic<size_t> writePosition{0};
+    alignas(64) size_t readPosition = 0;
+};
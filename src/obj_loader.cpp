@@ -0,0 +1,200 @@
+#include "obj_loader.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace
+{
+    struct Corner
+    {
+        int position = -1;
+        int uv = -1;
+        int normal = -1;
+
+        bool operator==(const Corner &other) const { return position == other.position && uv == other.uv && normal == other.normal; }
+    };
+
+    struct CornerHash
+    {
+        size_t operator()(const Corner &corner) const
+        {
+            uint64_t h = uint32_t(corner.position) * 0x9E3779B97F4A7C15ull;
+            h = (h ^ uint32_t(corner.uv)) * 0xC2B2AE3D27D4EB4Full;
+            h = (h ^ uint32_t(corner.normal)) * 0x165667B19E3779F9ull;
+            return size_t(h ^ (h >> 32));
+        }
+    };
+
+    // OBJ的索引从1开始，负数表示从末尾倒数；缺省时为-1
+    int resolveIndex(long index, size_t count)
+    {
+        if (index > 0 && size_t(index) <= count)
+            return int(index - 1);
+        if (index < 0 && size_t(-index) <= count)
+            return int(long(count) + index);
+        return -1;
+    }
+}
+
+void loadObj(const std::string &path, std::vector<MeshVertex> &vertices, std::vector<uint32_t> &indices)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("=====Failed to open OBJ file: " + path + "=====");
+    }
+
+    std::vector<float> positions, uvs, normals;
+    std::unordered_map<Corner, uint32_t, CornerHash> cornerVertices;
+    std::vector<int> vertexPositions;
+    std::vector<uint32_t> polygon;
+    vertices.clear();
+    indices.clear();
+
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        const char *p = line.c_str();
+        while (*p == ' ' || *p == '\t')
+            p++;
+
+        if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+        {
+            char *end;
+            for (int k = 0; k < 3; k++)
+            {
+                positions.push_back(strtof(p + (k == 0 ? 1 : 0), &end));
+                p = end;
+            }
+        }
+        else if (p[0] == 'v' && p[1] == 't')
+        {
+            char *end;
+            float u = strtof(p + 2, &end);
+            float v = strtof(end, &end);
+            //OBJ的纹理坐标原点在左下角
+            uvs.push_back(u);
+            uvs.push_back(1.0f - v);
+        }
+        else if (p[0] == 'v' && p[1] == 'n')
+        {
+            char *end = const_cast<char *>(p + 2);
+            for (int k = 0; k < 3; k++)
+            {
+                normals.push_back(strtof(end, &end));
+            }
+        }
+        else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+        {
+            polygon.clear();
+            char *cursor = const_cast<char *>(p + 1);
+            while (true)
+            {
+                while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r')
+                    cursor++;
+                if (*cursor == '\0')
+                    break;
+
+                Corner corner;
+                char *end;
+                corner.position = resolveIndex(strtol(cursor, &end, 10), positions.size() / 3);
+                if (end == cursor || corner.position < 0)
+                {
+                    throw std::runtime_error("=====Invalid face in " + path + " line " + std::to_string(lineNumber) + "=====");
+                }
+                cursor = end;
+                if (*cursor == '/')
+                {
+                    cursor++;
+                    if (*cursor != '/')
+                    {
+                        corner.uv = resolveIndex(strtol(cursor, &end, 10), uvs.size() / 2);
+                        cursor = end;
+                    }
+                    if (*cursor == '/')
+                    {
+                        cursor++;
+                        corner.normal = resolveIndex(strtol(cursor, &end, 10), normals.size() / 3);
+                        cursor = end;
+                    }
+                }
+                //跳过无法解析的剩余部分
+                while (*cursor != '\0' && *cursor != ' ' && *cursor != '\t' && *cursor != '\r')
+                    cursor++;
+
+                auto inserted = cornerVertices.emplace(corner, uint32_t(vertices.size()));
+                if (inserted.second)
+                {
+                    MeshVertex vertex;
+                    memcpy(vertex.position, &positions[corner.position * 3], sizeof(vertex.position));
+                    if (corner.uv >= 0)
+                        memcpy(vertex.uv, &uvs[corner.uv * 2], sizeof(vertex.uv));
+                    if (corner.normal >= 0)
+                        memcpy(vertex.normal, &normals[corner.normal * 3], sizeof(vertex.normal));
+                    vertices.push_back(vertex);
+                    vertexPositions.push_back(corner.normal >= 0 ? -1 : corner.position);
+                }
+                polygon.push_back(inserted.first->second);
+            }
+            for (size_t i = 2; i < polygon.size(); i++)
+            {
+                indices.push_back(polygon[0]);
+                indices.push_back(polygon[i - 1]);
+                indices.push_back(polygon[i]);
+            }
+        }
+    }
+    if (indices.empty())
+    {
+        throw std::runtime_error("=====OBJ file has no faces: " + path + "=====");
+    }
+
+    //没有法线的顶点：按position累加相邻三角形的面积加权法线，接缝两侧得到相同的法线
+    bool missingNormals = false;
+    for (int position : vertexPositions)
+    {
+        missingNormals = missingNormals || position >= 0;
+    }
+    if (!missingNormals)
+    {
+        return;
+    }
+    std::vector<float> generated(positions.size(), 0.0f);
+    for (size_t t = 0; t < indices.size() / 3; t++)
+    {
+        const float *a = vertices[indices[t * 3]].position;
+        const float *b = vertices[indices[t * 3 + 1]].position;
+        const float *c = vertices[indices[t * 3 + 2]].position;
+        float ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        float ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        float n[3] = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+        for (int k = 0; k < 3; k++)
+        {
+            int position = vertexPositions[indices[t * 3 + k]];
+            if (position >= 0)
+            {
+                for (int i = 0; i < 3; i++)
+                    generated[position * 3 + i] += n[i];
+            }
+        }
+    }
+    for (size_t v = 0; v < vertices.size(); v++)
+    {
+        int position = vertexPositions[v];
+        if (position < 0)
+            continue;
+        const float *n = &generated[position * 3];
+        float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length > 0.0f)
+        {
+            for (int i = 0; i < 3; i++)
+                vertices[v].normal[i] = n[i] / length;
+        }
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mesh_processing.h"
+
+// Wavefront OBJ中的三角网格：只读取v/vt/vn/f，多边形按扇形三角化，材质与分组被忽略
+// 相同的position/uv/normal组合只生成一个顶点；文件没有法线时按面积加权生成平滑法线
+// 失败时抛出std::runtime_error
+void loadObj(const std::string &path, std::vector<MeshVertex> &vertices, std::vector<uint32_t> &indices);
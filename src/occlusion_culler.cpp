@@ -0,0 +1,724 @@
+#include "occlusion_culler.h"
+
+#include "frustum_culling.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    // 每帧的uniform与计数器在frameBuffer中的位置，不小于任何设备的min*BufferOffsetAlignment
+    const VkDeviceSize frameStride = 512;
+    const VkDeviceSize countersOffset = 256;
+
+    // PipelineVariantKey::base
+    enum PipelineBase : uint32_t
+    {
+        PipelineCull,
+        PipelineHiz,
+        PipelineHizMultisample,
+    };
+
+    // 与shader中的constant_id一致，REVERSE_Z在两个shader中相同
+    enum Constant : uint32_t
+    {
+        ConstantReverseZ = 0,
+        // occlusion_cull.comp
+        ConstantCompact = 1,
+        // hiz.comp
+        ConstantSampleCount = 1,
+    };
+
+    struct HizPushConstants
+    {
+        int32_t sourceSize[2];
+        int32_t destinationSize[2];
+    };
+
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    VkShaderModule loadShader(VkDevice device, const std::string &path)
+    {
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("=====Failed to open shader file: " + path + "=====");
+        }
+        std::vector<char> code(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(code.data(), code.size());
+
+        VkShaderModuleCreateInfo moduleInfo{};
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.codeSize = code.size();
+        moduleInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+        VkShaderModule module;
+        if (vkCreateShaderModule(device, &moduleInfo, nullptr, &module) != VK_SUCCESS)
+        {
+            throw std::runtime_error("=====Failed to create shader module: " + path + "=====");
+        }
+        return module;
+    }
+
+    VkImageView createView(VkDevice device, VkImage image, VkFormat format, uint32_t baseLevel, uint32_t levelCount)
+    {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = baseLevel;
+        viewInfo.subresourceRange.levelCount = levelCount;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        VkImageView view;
+        if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS)
+        {
+            throw std::runtime_error("=====Failed to create depth pyramid view!=====");
+        }
+        return view;
+    }
+
+    // 不大于value的2的幂
+    uint32_t previousPowerOfTwo(uint32_t value)
+    {
+        uint32_t result = 1;
+        while (result * 2 <= value)
+        {
+            result *= 2;
+        }
+        return result;
+    }
+
+    VkImageAspectFlags depthAspect(VkFormat format)
+    {
+        bool stencil = format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D16_UNORM_S8_UINT;
+        return VK_IMAGE_ASPECT_DEPTH_BIT | (stencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+    }
+}
+
+void OcclusionCuller::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &memory)
+{
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create occlusion culling buffer!=====");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = UINT32_MAX;
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    {
+        if ((memRequirements.memoryTypeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            allocInfo.memoryTypeIndex = i;
+            break;
+        }
+    }
+    if (allocInfo.memoryTypeIndex == UINT32_MAX)
+    {
+        throw std::runtime_error("=====Failed to find occlusion culling memory type!=====");
+    }
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to allocate occlusion culling memory!=====");
+    }
+    vkBindBufferMemory(device, buffer, memory, 0);
+}
+
+void OcclusionCuller::create(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties, const std::string &shaderDirectory,
+    uint32_t maxObjects, uint32_t framesInFlight, bool drawIndirectCount)
+{
+    this->device = device;
+    this->memoryProperties = memoryProperties;
+    this->shaderDirectory = shaderDirectory;
+    this->maxObjects = std::max(maxObjects, 1u);
+    this->framesInFlight = framesInFlight;
+    objectCount = 0;
+
+    if (drawIndirectCount)
+    {
+        pfnCmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCount)vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCount");
+        if (pfnCmdDrawIndexedIndirectCount == nullptr)
+        {
+            pfnCmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCount)vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR");
+        }
+    }
+    compact = pfnCmdDrawIndexedIndirectCount != nullptr;
+
+    //剔除：uniform、包围球、命令模板、状态、Early/Late命令、计数器、金字塔
+    VkDescriptorSetLayoutBinding cullBindings[8]{};
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        cullBindings[i].binding = i;
+        cullBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        cullBindings[i].descriptorCount = 1;
+        cullBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    cullBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    cullBindings[7].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 8;
+    layoutInfo.pBindings = cullBindings;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &cullSetLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create occlusion culling descriptor set layout!=====");
+    }
+
+    //金字塔的每一级：源(深度缓冲或上一级)与目标
+    VkDescriptorSetLayoutBinding hizBindings[2]{};
+    hizBindings[0].binding = 0;
+    hizBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    hizBindings[0].descriptorCount = 1;
+    hizBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    hizBindings[1].binding = 1;
+    hizBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    hizBindings[1].descriptorCount = 1;
+    hizBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = hizBindings;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &hizSetLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create depth pyramid descriptor set layout!=====");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(uint32_t);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &cullSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create occlusion culling pipeline layout!=====");
+    }
+    pushConstantRange.size = sizeof(HizPushConstants);
+    pipelineLayoutInfo.pSetLayouts = &hizSetLayout;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &hizPipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create depth pyramid pipeline layout!=====");
+    }
+
+    //文件名与CMakeLists.txt中的add_shader一致
+    cullShader = loadShader(device, shaderDirectory + "/occlusion_cull.spv");
+    hizShader = loadShader(device, shaderDirectory + "/hiz.spv");
+    hizMultisampleShader = loadShader(device, shaderDirectory + "/hiz_ms.spv");
+    pipelines.create(device);
+
+    VkDescriptorPoolSize poolSizes[4]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount = framesInFlight;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = framesInFlight * 6;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[2].descriptorCount = framesInFlight + maxPyramidLevels;
+    poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[3].descriptorCount = maxPyramidLevels;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    //金字塔的set随深度缓冲的大小重新分配
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolInfo.poolSizeCount = 4;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = framesInFlight + maxPyramidLevels;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create occlusion culling descriptor pool!=====");
+    }
+
+    //texelFetch不经过过滤，sampler只是combined image sampler的要求
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.maxLod = static_cast<float>(maxPyramidLevels);
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create occlusion culling sampler!=====");
+    }
+
+    commandOffset = alignUp(VkDeviceSize(this->maxObjects) * sizeof(float) * 4, 256);
+    createBuffer(commandOffset + VkDeviceSize(this->maxObjects) * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, objectBuffer, objectMemory);
+    vkMapMemory(device, objectMemory, 0, VK_WHOLE_SIZE, 0, &objectMapped);
+
+    createBuffer(VkDeviceSize(this->maxObjects) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, stateBuffer, stateMemory);
+
+    lateOffset = alignUp(VkDeviceSize(this->maxObjects) * sizeof(VkDrawIndexedIndirectCommand), 256);
+    createBuffer(lateOffset * 2, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawBuffer, drawMemory);
+
+    //只有几百字节，GPU直接读写HOST_VISIBLE内存的开销可以忽略，省去上传与读回的拷贝
+    createBuffer(frameStride * framesInFlight,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frameBuffer, frameMemory);
+    void *mapped = nullptr;
+    vkMapMemory(device, frameMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    frameMapped = static_cast<uint8_t *>(mapped);
+    memset(frameMapped, 0, static_cast<size_t>(frameStride * framesInFlight));
+
+    std::vector<VkDescriptorSetLayout> layouts(framesInFlight, cullSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = framesInFlight;
+    allocInfo.pSetLayouts = layouts.data();
+    cullSets.resize(framesInFlight);
+    if (vkAllocateDescriptorSets(device, &allocInfo, cullSets.data()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to allocate occlusion culling descriptor sets!=====");
+    }
+    writeCullDescriptors();
+    createPipelines();
+}
+
+void OcclusionCuller::destroy()
+{
+    if (device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    destroyPyramid();
+    pipelines.destroy();
+    vkDestroyShaderModule(device, cullShader, nullptr);
+    vkDestroyShaderModule(device, hizShader, nullptr);
+    vkDestroyShaderModule(device, hizMultisampleShader, nullptr);
+
+    vkDestroyBuffer(device, objectBuffer, nullptr);
+    vkFreeMemory(device, objectMemory, nullptr);
+    vkDestroyBuffer(device, stateBuffer, nullptr);
+    vkFreeMemory(device, stateMemory, nullptr);
+    vkDestroyBuffer(device, drawBuffer, nullptr);
+    vkFreeMemory(device, drawMemory, nullptr);
+    vkDestroyBuffer(device, frameBuffer, nullptr);
+    vkFreeMemory(device, frameMemory, nullptr);
+
+    vkDestroySampler(device, sampler, nullptr);
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+    vkDestroyPipelineLayout(device, hizPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, cullSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, hizSetLayout, nullptr);
+    cullSets.clear();
+    device = VK_NULL_HANDLE;
+}
+
+void OcclusionCuller::setConfig(const Config &config)
+{
+    bool rebuild = config.reverseZ != this->config.reverseZ;
+    this->config = config;
+    if (device != VK_NULL_HANDLE && rebuild)
+    {
+        //比较方向变了，旧的金字塔不能再用
+        pyramidValid = false;
+        createPipelines();
+    }
+}
+
+void OcclusionCuller::createPipelines()
+{
+    auto builder = [this](VkShaderModule module, VkPipelineLayout layout) {
+        return [this, module, layout](const VkSpecializationInfo *specialization, VkPipelineCache pipelineCache) {
+            VkComputePipelineCreateInfo pipelineInfo{};
+            pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            pipelineInfo.stage.module = module;
+            pipelineInfo.stage.pName = "main";
+            pipelineInfo.stage.pSpecializationInfo = specialization;
+            pipelineInfo.layout = layout;
+            VkPipeline pipeline;
+            if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+            {
+                throw std::runtime_error("=====Failed to create occlusion culling pipeline!=====");
+            }
+            return pipeline;
+        };
+    };
+
+    SpecializationConstants cullConstants;
+    cullConstants.set(ConstantReverseZ, config.reverseZ);
+    cullConstants.set(ConstantCompact, compact);
+    cullPipeline = pipelines.get({PipelineCull, cullConstants}, builder(cullShader, cullPipelineLayout));
+
+    SpecializationConstants hizConstants;
+    hizConstants.set(ConstantReverseZ, config.reverseZ);
+    hizConstants.set(ConstantSampleCount, uint32_t(1));
+    hizReducePipeline = pipelines.get({PipelineHiz, hizConstants}, builder(hizShader, hizPipelineLayout));
+    hizDepthPipeline = hizReducePipeline;
+    if (depthSamples != VK_SAMPLE_COUNT_1_BIT)
+    {
+        hizConstants.set(ConstantSampleCount, static_cast<uint32_t>(depthSamples));
+        hizDepthPipeline = pipelines.get({PipelineHizMultisample, hizConstants}, builder(hizMultisampleShader, hizPipelineLayout));
+    }
+}
+
+void OcclusionCuller::writeCullDescriptors()
+{
+    VkDeviceSize boundsSize = VkDeviceSize(maxObjects) * sizeof(float) * 4;
+    VkDeviceSize commandsSize = VkDeviceSize(maxObjects) * sizeof(VkDrawIndexedIndirectCommand);
+    for (uint32_t frame = 0; frame < framesInFlight; frame++)
+    {
+        VkDescriptorBufferInfo bufferInfos[7] = {
+            {frameBuffer, frameStride * frame, sizeof(Uniforms)},
+            {objectBuffer, 0, boundsSize},
+            {objectBuffer, commandOffset, commandsSize},
+            {stateBuffer, 0, VkDeviceSize(maxObjects) * sizeof(uint32_t)},
+            {drawBuffer, 0, commandsSize},
+            {drawBuffer, lateOffset, commandsSize},
+            {frameBuffer, frameStride * frame + countersOffset, sizeof(Counters)},
+        };
+        VkDescriptorImageInfo pyramidInfo{};
+        pyramidInfo.sampler = sampler;
+        pyramidInfo.imageView = pyramidView;
+        pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet writes[8]{};
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = cullSets[frame];
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pBufferInfo = i < 7 ? &bufferInfos[i] : nullptr;
+        }
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writes[7].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[7].pImageInfo = &pyramidInfo;
+        //还没有深度缓冲时金字塔的binding留到setDepthSource再写
+        vkUpdateDescriptorSets(device, pyramidView != VK_NULL_HANDLE ? 8 : 7, writes, 0, nullptr);
+    }
+}
+
+void OcclusionCuller::setObjects(const std::vector<OcclusionObject> &objects)
+{
+    if (objects.size() > maxObjects)
+    {
+        throw std::runtime_error("=====Too many objects for occlusion culling!=====");
+    }
+    objectCount = static_cast<uint32_t>(objects.size());
+    float *bounds = static_cast<float *>(objectMapped);
+    auto *commands = reinterpret_cast<VkDrawIndexedIndirectCommand *>(static_cast<uint8_t *>(objectMapped) + commandOffset);
+    for (uint32_t i = 0; i < objectCount; i++)
+    {
+        bounds[i * 4 + 0] = objects[i].center[0];
+        bounds[i * 4 + 1] = objects[i].center[1];
+        bounds[i * 4 + 2] = objects[i].center[2];
+        bounds[i * 4 + 3] = objects[i].radius;
+        commands[i] = objects[i].command;
+    }
+}
+
+void OcclusionCuller::destroyPyramid()
+{
+    if (!hizSets.empty())
+    {
+        vkFreeDescriptorSets(device, descriptorPool, static_cast<uint32_t>(hizSets.size()), hizSets.data());
+        hizSets.clear();
+    }
+    for (VkImageView view : pyramidLevelViews)
+    {
+        vkDestroyImageView(device, view, nullptr);
+    }
+    pyramidLevelViews.clear();
+    if (pyramidView != VK_NULL_HANDLE)
+    {
+        vkDestroyImageView(device, pyramidView, nullptr);
+        vkDestroyImage(device, pyramidImage, nullptr);
+        vkFreeMemory(device, pyramidMemory, nullptr);
+        pyramidView = VK_NULL_HANDLE;
+        pyramidImage = VK_NULL_HANDLE;
+        pyramidMemory = VK_NULL_HANDLE;
+    }
+    pyramidInitialized = false;
+    pyramidValid = false;
+}
+
+void OcclusionCuller::setDepthSource(VkImage depthImage, VkImageView depthView, VkFormat depthFormat, VkExtent2D extent, VkSampleCountFlagBits samples)
+{
+    destroyPyramid();
+    this->depthImage = depthImage;
+    this->depthView = depthView;
+    this->depthFormat = depthFormat;
+    depthExtent = extent;
+    depthSamples = samples;
+    createPipelines();
+
+    //第0级取不大于深度缓冲的2的幂，之后每级正好减半，shader中的2x2覆盖关系才成立
+    pyramidExtent.width = previousPowerOfTwo(std::max(extent.width, 1u));
+    pyramidExtent.height = previousPowerOfTwo(std::max(extent.height, 1u));
+    uint32_t levels = 1;
+    while ((std::max(pyramidExtent.width, pyramidExtent.height) >> levels) > 0)
+    {
+        levels++;
+    }
+    if (levels > maxPyramidLevels)
+    {
+        throw std::runtime_error("=====Depth buffer too large for the depth pyramid!=====");
+    }
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.extent = {pyramidExtent.width, pyramidExtent.height, 1};
+    imageInfo.mipLevels = levels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(device, &imageInfo, nullptr, &pyramidImage) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create depth pyramid!=====");
+    }
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, pyramidImage, &memRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = UINT32_MAX;
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    {
+        if ((memRequirements.memoryTypeBits & (1u << i)) &&
+            (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+        {
+            allocInfo.memoryTypeIndex = i;
+            break;
+        }
+    }
+    if (allocInfo.memoryTypeIndex == UINT32_MAX || vkAllocateMemory(device, &allocInfo, nullptr, &pyramidMemory) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to allocate depth pyramid memory!=====");
+    }
+    vkBindImageMemory(device, pyramidImage, pyramidMemory, 0);
+
+    pyramidView = createView(device, pyramidImage, VK_FORMAT_R32_SFLOAT, 0, levels);
+    for (uint32_t level = 0; level < levels; level++)
+    {
+        pyramidLevelViews.push_back(createView(device, pyramidImage, VK_FORMAT_R32_SFLOAT, level, 1));
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(levels, hizSetLayout);
+    VkDescriptorSetAllocateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = descriptorPool;
+    setInfo.descriptorSetCount = levels;
+    setInfo.pSetLayouts = layouts.data();
+    hizSets.resize(levels);
+    if (vkAllocateDescriptorSets(device, &setInfo, hizSets.data()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to allocate depth pyramid descriptor sets!=====");
+    }
+    for (uint32_t level = 0; level < levels; level++)
+    {
+        VkDescriptorImageInfo sourceInfo{};
+        sourceInfo.sampler = sampler;
+        sourceInfo.imageView = level == 0 ? depthView : pyramidLevelViews[level - 1];
+        sourceInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+        VkDescriptorImageInfo destinationInfo{};
+        destinationInfo.imageView = pyramidLevelViews[level];
+        destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet writes[2]{};
+        writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[0].dstSet = hizSets[level];
+        writes[0].dstBinding = 0;
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[0].pImageInfo = &sourceInfo;
+        writes[1] = writes[0];
+        writes[1].dstBinding = 1;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[1].pImageInfo = &destinationInfo;
+        vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+    }
+    writeCullDescriptors();
+}
+
+void OcclusionCuller::recordCull(VkCommandBuffer commandBuffer, uint32_t frame, Phase phase, const float *viewProjection)
+{
+    uint8_t *frameData = frameMapped + frameStride * frame;
+    if (phase == Early)
+    {
+        if (pyramidView == VK_NULL_HANDLE)
+        {
+            throw std::runtime_error("=====Occlusion culling needs a depth source!=====");
+        }
+        memcpy(currentViewProjection, viewProjection, sizeof(currentViewProjection));
+
+        Uniforms uniforms{};
+        memcpy(uniforms.viewProjection, viewProjection, sizeof(uniforms.viewProjection));
+        memcpy(uniforms.pyramidViewProjection, pyramidViewProjection, sizeof(uniforms.pyramidViewProjection));
+        Frustum frustum = frustumFromMatrix(viewProjection);
+        memcpy(uniforms.planes, frustum.planes, sizeof(uniforms.planes));
+        uniforms.pyramidSize[0] = static_cast<float>(pyramidExtent.width);
+        uniforms.pyramidSize[1] = static_cast<float>(pyramidExtent.height);
+        uniforms.objectCount = objectCount;
+        uniforms.pyramidValid = pyramidValid && config.occlusion ? 1 : 0;
+        //该帧上一次的提交已经完成(调用方等待过fence)，直接由CPU写入，提交时对GPU可见
+        memcpy(frameData, &uniforms, sizeof(uniforms));
+        memset(frameData + countersOffset, 0, sizeof(Counters));
+
+        //上一帧的indirect draw读取与Late的状态读取完成后才能覆盖
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    uint32_t phaseIndex = phase == Early ? 0 : 1;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullSets[frame], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(phaseIndex), &phaseIndex);
+    //Late也要执行：不紧凑输出时需要把没有补画的对象写成空命令
+    if (objectCount > 0)
+    {
+        vkCmdDispatch(commandBuffer, (objectCount + 63) / 64, 1, 1);
+    }
+
+    //Early的状态由Late读取；Late之后计数器由CPU读回
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | (phase == Early ? VK_ACCESS_SHADER_READ_BIT : VK_ACCESS_HOST_READ_BIT);
+    VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                                    (phase == Early ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_HOST_BIT);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void OcclusionCuller::recordDraws(VkCommandBuffer commandBuffer, uint32_t frame, Phase phase) const
+{
+    if (objectCount == 0)
+    {
+        return;
+    }
+    VkDeviceSize offset = phase == Early ? 0 : lateOffset;
+    uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    if (compact)
+    {
+        VkDeviceSize countOffset = frameStride * frame + countersOffset + (phase == Early ? 0 : sizeof(uint32_t));
+        pfnCmdDrawIndexedIndirectCount(commandBuffer, drawBuffer, offset, frameBuffer, countOffset, objectCount, stride);
+    }
+    else
+    {
+        vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, offset, objectCount, stride);
+    }
+}
+
+void OcclusionCuller::recordDepthPyramid(VkCommandBuffer commandBuffer, VkImageLayout depthLayout)
+{
+    //深度缓冲转为只读供compute采样；金字塔上一次被Early读取
+    VkImageMemoryBarrier barriers[2]{};
+    barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[0].oldLayout = depthLayout;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].image = depthImage;
+    barriers[0].subresourceRange = {depthAspect(depthFormat), 0, 1, 0, 1};
+    barriers[1] = barriers[0];
+    barriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barriers[1].oldLayout = pyramidInitialized ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barriers[1].image = pyramidImage;
+    barriers[1].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, static_cast<uint32_t>(hizSets.size()), 0, 1};
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+    VkMemoryBarrier levelBarrier{};
+    levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkExtent2D source = depthExtent;
+    VkExtent2D destination = pyramidExtent;
+    for (uint32_t level = 0; level < hizSets.size(); level++)
+    {
+        if (level > 0)
+        {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+        }
+        if (level <= 1)
+        {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, level == 0 ? hizDepthPipeline : hizReducePipeline);
+        }
+        HizPushConstants constants{};
+        constants.sourceSize[0] = static_cast<int32_t>(source.width);
+        constants.sourceSize[1] = static_cast<int32_t>(source.height);
+        constants.destinationSize[0] = static_cast<int32_t>(destination.width);
+        constants.destinationSize[1] = static_cast<int32_t>(destination.height);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, hizPipelineLayout, 0, 1, &hizSets[level], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, hizPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(commandBuffer, (destination.width + 7) / 8, (destination.height + 7) / 8, 1);
+
+        source = destination;
+        destination.width = std::max(destination.width / 2, 1u);
+        destination.height = std::max(destination.height / 2, 1u);
+    }
+
+    //深度缓冲恢复为attachment供Late的draw使用，金字塔供Late剔除读取
+    barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    barriers[0].newLayout = depthLayout;
+    barriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        0, 0, nullptr, 0, nullptr, 2, barriers);
+
+    //下一帧的Early使用这个金字塔与生成它时的矩阵
+    memcpy(pyramidViewProjection, currentViewProjection, sizeof(pyramidViewProjection));
+    pyramidInitialized = true;
+    pyramidValid = true;
+}
+
+OcclusionCuller::Stats OcclusionCuller::stats(uint32_t frame) const
+{
+    Counters counters;
+    memcpy(&counters, frameMapped + frameStride * frame + countersOffset, sizeof(counters));
+    Stats stats;
+    stats.tested = counters.tested;
+    stats.frustumCulled = counters.frustumCulled;
+    stats.occlusionCulled = counters.occlusionCulled;
+    stats.drawnEarly = counters.earlyCount;
+    stats.drawnLate = counters.lateCount;
+    return stats;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pipeline_variants.h"
+
+// 剔除的输入：世界空间包围球与对象可见时使用的draw命令
+// draw命令原样写入indirect buffer，firstInstance不为0时需要设备开启drawIndirectFirstInstance
+struct OcclusionObject
+{
+    float center[3] = {};
+    float radius = 0.0f;
+    VkDrawIndexedIndirectCommand command{};
+};
+
+// GPU上的两阶段Hi-Z遮挡剔除(shader/hiz.comp、shader/occlusion_cull.comp)，每帧的顺序：
+//   recordCull(Early) -> 在render pass中recordDraws(Early) -> 结束render pass
+//   -> recordDepthPyramid -> recordCull(Late) -> 以LOAD打开render pass并recordDraws(Late)
+// Early用上一帧的深度金字塔测试，被遮挡的对象在Late中用本帧第一批draw的深度重新测试，
+// 所以相机移动或遮挡物消失时不会有对象漏画一帧
+class OcclusionCuller
+{
+public:
+    enum Phase
+    {
+        Early,
+        Late,
+    };
+
+    struct Config
+    {
+        // 与深度测试的方向一致：reverse-Z时越近深度越大
+        bool reverseZ = true;
+        // 关闭时只做视锥剔除，所有对象在Early中绘制
+        bool occlusion = true;
+    };
+
+    // 金字塔最多的级数，第0级最大32768x32768
+    static const uint32_t maxPyramidLevels = 16;
+
+    struct Stats
+    {
+        uint32_t tested = 0;
+        uint32_t frustumCulled = 0;
+        uint32_t occlusionCulled = 0;
+        uint32_t drawnEarly = 0;
+        uint32_t drawnLate = 0;
+
+        uint32_t drawn() const { return drawnEarly + drawnLate; }
+    };
+
+    // drawIndirectCount为true时需要Vulkan 1.2的drawIndirectCount特性，命令被紧凑地写入并用
+    // vkCmdDrawIndexedIndirectCount绘制；否则每个对象占一个位置，需要multiDrawIndirect
+    void create(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties, const std::string &shaderDirectory,
+        uint32_t maxObjects, uint32_t framesInFlight, bool drawIndirectCount);
+    void destroy();
+    void setConfig(const Config &config);
+
+    // 上传对象，调用方保证GPU没有在使用剔除的结果
+    void setObjects(const std::vector<OcclusionObject> &objects);
+    // 深度缓冲创建或改变大小时调用，depthView只含depth aspect，image需要SAMPLED usage
+    // 之前的金字塔作废，下一帧Early只做视锥剔除
+    void setDepthSource(VkImage depthImage, VkImageView depthView, VkFormat depthFormat, VkExtent2D extent, VkSampleCountFlagBits samples);
+
+    // Early时写入本帧的矩阵(列主序)并清零计数器，Late忽略viewProjection；结束后结果可被indirect draw读取
+    void recordCull(VkCommandBuffer commandBuffer, uint32_t frame, Phase phase, const float *viewProjection);
+    // 在render pass/dynamic rendering内调用，调用方负责bind pipeline与其他状态
+    void recordDraws(VkCommandBuffer commandBuffer, uint32_t frame, Phase phase) const;
+    // 在Early的draw结束后(render pass外)调用，深度缓冲的layout为depthLayout，结束时恢复
+    void recordDepthPyramid(VkCommandBuffer commandBuffer, VkImageLayout depthLayout);
+
+    // 在该帧的fence signal之后、同一frame下一次recordCull(Early)之前读取
+    Stats stats(uint32_t frame) const;
+
+private:
+    struct Uniforms
+    {
+        float viewProjection[16];
+        float pyramidViewProjection[16];
+        float planes[6][4];
+        float pyramidSize[2];
+        uint32_t objectCount;
+        uint32_t pyramidValid;
+    };
+
+    struct Counters
+    {
+        uint32_t earlyCount;
+        uint32_t lateCount;
+        uint32_t tested;
+        uint32_t frustumCulled;
+        uint32_t occlusionCulled;
+    };
+
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &memory);
+    void destroyPyramid();
+    void createPipelines();
+    void writeCullDescriptors();
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    std::string shaderDirectory;
+    Config config;
+    uint32_t maxObjects = 0;
+    uint32_t objectCount = 0;
+    uint32_t framesInFlight = 0;
+    bool compact = false;
+    PFN_vkCmdDrawIndexedIndirectCount pfnCmdDrawIndexedIndirectCount = nullptr;
+
+    // 同一份SPIR-V按REVERSE_Z/COMPACT/SAMPLE_COUNT创建的compute pipeline
+    PipelineVariantCache pipelines;
+    VkShaderModule cullShader = VK_NULL_HANDLE;
+    VkShaderModule hizShader = VK_NULL_HANDLE;
+    VkShaderModule hizMultisampleShader = VK_NULL_HANDLE;
+    VkPipeline cullPipeline = VK_NULL_HANDLE;
+    // 第0级从深度缓冲生成(可能是多重采样)，之后各级从上一级生成
+    VkPipeline hizDepthPipeline = VK_NULL_HANDLE;
+    VkPipeline hizReducePipeline = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout hizSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipelineLayout hizPipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> cullSets;
+    VkSampler sampler = VK_NULL_HANDLE;
+
+    // 包围球与draw命令模板，HOST_VISIBLE，由setObjects直接写入
+    VkBuffer objectBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory objectMemory = VK_NULL_HANDLE;
+    void *objectMapped = nullptr;
+    VkDeviceSize commandOffset = 0;
+    // 每个对象在Early中的结果，Late据此决定是否重新测试
+    VkBuffer stateBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory stateMemory = VK_NULL_HANDLE;
+    // Early与Late的indirect命令，各占lateOffset字节
+    VkBuffer drawBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory drawMemory = VK_NULL_HANDLE;
+    VkDeviceSize lateOffset = 0;
+    // 每帧一份uniform与计数器(也是indirect count)，HOST_VISIBLE以便直接写入与读回
+    VkBuffer frameBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory frameMemory = VK_NULL_HANDLE;
+    uint8_t *frameMapped = nullptr;
+
+    // 深度金字塔，R32F，整个生命周期保持GENERAL layout
+    VkImage depthImage = VK_NULL_HANDLE;
+    VkImageView depthView = VK_NULL_HANDLE;
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    VkExtent2D depthExtent{};
+    VkSampleCountFlagBits depthSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkImage pyramidImage = VK_NULL_HANDLE;
+    VkDeviceMemory pyramidMemory = VK_NULL_HANDLE;
+    VkImageView pyramidView = VK_NULL_HANDLE;
+    std::vector<VkImageView> pyramidLevelViews;
+    std::vector<VkDescriptorSet> hizSets;
+    VkExtent2D pyramidExtent{};
+    bool pyramidInitialized = false;
+    bool pyramidValid = false;
+    float currentViewProjection[16] = {};
+    float pyramidViewProjection[16] = {};
+};
@@ -0,0 +1,157 @@
+#include "pipeline_variants.h"
+
+#include "log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+SpecializationConstants &SpecializationConstants::setBits(uint32_t id, uint32_t bits)
+{
+    auto it = std::lower_bound(entries.begin(), entries.end(), id,
+        [](const VkSpecializationMapEntry &entry, uint32_t constantId) { return entry.constantID < constantId; });
+    size_t index = static_cast<size_t>(it - entries.begin());
+    if (it != entries.end() && it->constantID == id)
+    {
+        values[index] = bits;
+        return *this;
+    }
+    entries.insert(it, VkSpecializationMapEntry{id, 0, sizeof(uint32_t)});
+    values.insert(values.begin() + index, bits);
+    //插入后重新计算偏移
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        entries[i].offset = static_cast<uint32_t>(i * sizeof(uint32_t));
+    }
+    return *this;
+}
+
+SpecializationConstants &SpecializationConstants::set(uint32_t id, uint32_t value)
+{
+    return setBits(id, value);
+}
+
+SpecializationConstants &SpecializationConstants::set(uint32_t id, int32_t value)
+{
+    return setBits(id, static_cast<uint32_t>(value));
+}
+
+SpecializationConstants &SpecializationConstants::set(uint32_t id, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return setBits(id, bits);
+}
+
+SpecializationConstants &SpecializationConstants::set(uint32_t id, bool value)
+{
+    return setBits(id, value ? VK_TRUE : VK_FALSE);
+}
+
+VkSpecializationInfo SpecializationConstants::info() const
+{
+    VkSpecializationInfo info{};
+    info.mapEntryCount = static_cast<uint32_t>(entries.size());
+    info.pMapEntries = entries.data();
+    info.dataSize = values.size() * sizeof(uint32_t);
+    info.pData = values.data();
+    return info;
+}
+
+uint64_t SpecializationConstants::hash() const
+{
+    // FNV-1a
+    uint64_t result = 14695981039346656037ull;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        result = (result ^ entries[i].constantID) * 1099511628211ull;
+        result = (result ^ values[i]) * 1099511628211ull;
+    }
+    return result;
+}
+
+std::string SpecializationConstants::describe() const
+{
+    std::string text;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (i > 0)
+        {
+            text += ' ';
+        }
+        text += std::to_string(entries[i].constantID) + "=" + std::to_string(values[i]);
+    }
+    return text.empty() ? "default" : text;
+}
+
+bool SpecializationConstants::operator==(const SpecializationConstants &other) const
+{
+    if (entries.size() != other.entries.size() || values != other.values)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (entries[i].constantID != other.entries[i].constantID)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PipelineVariantCache::create(VkDevice device)
+{
+    this->device = device;
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create pipeline cache!=====");
+    }
+}
+
+void PipelineVariantCache::destroy()
+{
+    if (device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    clear();
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
+    pipelineCache = VK_NULL_HANDLE;
+    device = VK_NULL_HANDLE;
+}
+
+void PipelineVariantCache::clear()
+{
+    for (auto &entry : pipelines)
+    {
+        vkDestroyPipeline(device, entry.second, nullptr);
+    }
+    pipelines.clear();
+}
+
+VkPipeline PipelineVariantCache::get(const PipelineVariantKey &key, const Builder &builder)
+{
+    auto it = pipelines.find(key);
+    if (it != pipelines.end())
+    {
+        counters.hits++;
+        return it->second;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    VkSpecializationInfo specialization = key.constants.info();
+    VkPipeline pipeline = builder(key.constants.empty() ? nullptr : &specialization, pipelineCache);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    pipelines.emplace(key, pipeline);
+    counters.created++;
+    counters.createMs += ms;
+    logStream(LogLevel::Verbose) << "Pipeline variant " << key.base << " [" << key.constants.describe() << "] created in " << ms << " ms\n";
+    return pipeline;
+}
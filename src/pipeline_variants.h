@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 一组specialization constant的取值，按constant_id排序保存，每个值占4字节(bool以VkBool32传入)
+// 同一份SPIR-V在创建pipeline时代入不同取值，驱动把它们当作常量折叠，不需要为每种组合编译一个.spv
+class SpecializationConstants
+{
+public:
+    SpecializationConstants &set(uint32_t id, uint32_t value);
+    SpecializationConstants &set(uint32_t id, int32_t value);
+    SpecializationConstants &set(uint32_t id, float value);
+    SpecializationConstants &set(uint32_t id, bool value);
+
+    // 指向内部存储，对象修改或销毁后失效；所有stage可以共用，shader中不存在的id被忽略
+    VkSpecializationInfo info() const;
+    bool empty() const { return entries.empty(); }
+    uint64_t hash() const;
+    // 形如"0=1 1=4"，用于日志
+    std::string describe() const;
+
+    bool operator==(const SpecializationConstants &other) const;
+
+private:
+    SpecializationConstants &setBits(uint32_t id, uint32_t bits);
+
+    std::vector<VkSpecializationMapEntry> entries;
+    std::vector<uint32_t> values;
+};
+
+// pipeline变体的键：base区分固定管线状态不同的pipeline(例如depth prepass与opaque)，
+// constants为代入shader的specialization constant
+struct PipelineVariantKey
+{
+    uint32_t base = 0;
+    SpecializationConstants constants;
+
+    bool operator==(const PipelineVariantKey &other) const { return base == other.base && constants == other.constants; }
+};
+
+// 按键缓存创建好的pipeline，相同的键只创建一次；
+// 所有变体共用一个VkPipelineCache，驱动可以复用同一SPIR-V在不同变体之间的编译结果
+class PipelineVariantCache
+{
+public:
+    // 用specialization info填好各个stage后创建pipeline，创建失败时抛出std::runtime_error
+    using Builder = std::function<VkPipeline(const VkSpecializationInfo *specialization, VkPipelineCache pipelineCache)>;
+
+    struct Stats
+    {
+        uint32_t created = 0;
+        uint32_t hits = 0;
+        double createMs = 0.0;
+    };
+
+    void create(VkDevice device);
+    // 销毁所有变体与VkPipelineCache，调用前GPU不能再使用它们
+    void destroy();
+    // 销毁所有变体但保留VkPipelineCache，用于重新创建pipeline(例如attachment格式变化)
+    void clear();
+
+    VkPipeline get(const PipelineVariantKey &key, const Builder &builder);
+    const Stats &stats() const { return counters; }
+    size_t size() const { return pipelines.size(); }
+
+private:
+    struct KeyHash
+    {
+        size_t operator()(const PipelineVariantKey &key) const
+        {
+            return static_cast<size_t>(key.constants.hash() ^ (uint64_t(key.base) * 0x9E3779B97F4A7C15ull));
+        }
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    std::unordered_map<PipelineVariantKey, VkPipeline, KeyHash> pipelines;
+    Stats counters;
+};
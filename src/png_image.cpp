@@ -0,0 +1,743 @@
+#include "png_image.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    const uint8_t pngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    // deflate的长度/距离符号表(RFC 1951 3.2.5)
+    const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    const uint16_t distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    const uint8_t distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    const uint32_t windowSize = 32768;
+    const uint32_t maxMatch = 258;
+    const uint32_t hashBits = 15;
+    // 每个位置最多比较的候选数，在压缩率与速度之间折中
+    const uint32_t maxChain = 16;
+
+    struct CrcTable
+    {
+        uint32_t entries[256];
+
+        CrcTable()
+        {
+            for (uint32_t n = 0; n < 256; n++)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++)
+                {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[n] = c;
+            }
+        }
+    };
+
+    uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0)
+    {
+        //局部静态变量的初始化是线程安全的，写入线程与主线程都可能调用
+        static const CrcTable table;
+        const uint32_t *crcTable = table.entries;
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    uint32_t adler32(const uint8_t *data, size_t size)
+    {
+        uint32_t a = 1, b = 0;
+        while (size > 0)
+        {
+            // 5552是保证32位累加不溢出的最大块长
+            size_t block = std::min<size_t>(size, 5552);
+            size -= block;
+            while (block-- > 0)
+            {
+                a += *data++;
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    void putBigEndian(std::vector<uint8_t> &out, uint32_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    uint32_t getBigEndian(const uint8_t *data)
+    {
+        return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+    }
+
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(std::vector<uint8_t> &out) : out(out) {}
+
+        void writeBits(uint32_t value, uint32_t count)
+        {
+            buffer |= value << bitCount;
+            bitCount += count;
+            while (bitCount >= 8)
+            {
+                out.push_back(static_cast<uint8_t>(buffer));
+                buffer >>= 8;
+                bitCount -= 8;
+            }
+        }
+
+        // Huffman码从最高位开始写
+        void writeCode(uint32_t code, uint32_t length)
+        {
+            uint32_t reversed = 0;
+            for (uint32_t i = 0; i < length; i++)
+            {
+                reversed = (reversed << 1) | ((code >> i) & 1);
+            }
+            writeBits(reversed, length);
+        }
+
+        void flush()
+        {
+            if (bitCount > 0)
+            {
+                out.push_back(static_cast<uint8_t>(buffer));
+            }
+            buffer = 0;
+            bitCount = 0;
+        }
+
+    private:
+        std::vector<uint8_t> &out;
+        uint32_t buffer = 0;
+        uint32_t bitCount = 0;
+    };
+
+    void writeFixedSymbol(BitWriter &writer, uint32_t symbol)
+    {
+        if (symbol < 144)
+            writer.writeCode(0x30 + symbol, 8);
+        else if (symbol < 256)
+            writer.writeCode(0x190 + symbol - 144, 9);
+        else if (symbol < 280)
+            writer.writeCode(symbol - 256, 7);
+        else
+            writer.writeCode(0xC0 + symbol - 280, 8);
+    }
+
+    void writeMatch(BitWriter &writer, uint32_t length, uint32_t distance)
+    {
+        uint32_t code = 28;
+        while (lengthBase[code] > length)
+        {
+            code--;
+        }
+        writeFixedSymbol(writer, 257 + code);
+        writer.writeBits(length - lengthBase[code], lengthExtra[code]);
+
+        code = 29;
+        while (distanceBase[code] > distance)
+        {
+            code--;
+        }
+        writer.writeCode(code, 5);
+        writer.writeBits(distance - distanceBase[code], distanceExtra[code]);
+    }
+
+    // zlib流：一个使用固定Huffman表的deflate block，LZ77用hash链查找匹配
+    std::vector<uint8_t> zlibCompress(const uint8_t *data, size_t size)
+    {
+        std::vector<uint8_t> out;
+        out.reserve(size / 2 + 64);
+        out.push_back(0x78);
+        out.push_back(0x01);
+
+        BitWriter writer(out);
+        writer.writeBits(1, 1); // BFINAL
+        writer.writeBits(1, 2); // BTYPE = 固定Huffman
+
+        std::vector<int32_t> head(size_t(1) << hashBits, -1);
+        std::vector<int32_t> previous(windowSize, -1);
+        auto hashAt = [&](size_t position)
+        {
+            uint32_t value = uint32_t(data[position]) | (uint32_t(data[position + 1]) << 8) | (uint32_t(data[position + 2]) << 16);
+            return (value * 2654435761u) >> (32 - hashBits);
+        };
+        auto insert = [&](size_t position)
+        {
+            if (position + 3 <= size)
+            {
+                uint32_t hash = hashAt(position);
+                previous[position % windowSize] = head[hash];
+                head[hash] = static_cast<int32_t>(position);
+            }
+        };
+
+        size_t position = 0;
+        while (position < size)
+        {
+            uint32_t bestLength = 0;
+            uint32_t bestDistance = 0;
+            if (position + 3 <= size)
+            {
+                uint32_t limit = static_cast<uint32_t>(std::min<size_t>(maxMatch, size - position));
+                int32_t candidate = head[hashAt(position)];
+                for (uint32_t chain = 0; chain < maxChain && candidate >= 0; chain++)
+                {
+                    size_t distance = position - static_cast<size_t>(candidate);
+                    if (distance > windowSize)
+                    {
+                        break;
+                    }
+                    const uint8_t *a = data + candidate;
+                    const uint8_t *b = data + position;
+                    uint32_t length = 0;
+                    while (length < limit && a[length] == b[length])
+                    {
+                        length++;
+                    }
+                    if (length > bestLength)
+                    {
+                        bestLength = length;
+                        bestDistance = static_cast<uint32_t>(distance);
+                        if (length == limit)
+                        {
+                            break;
+                        }
+                    }
+                    int32_t next = previous[candidate % windowSize];
+                    // 链上的位置必须严格递减，否则是被覆盖的旧项
+                    if (next >= candidate)
+                    {
+                        break;
+                    }
+                    candidate = next;
+                }
+            }
+
+            if (bestLength >= 3)
+            {
+                writeMatch(writer, bestLength, bestDistance);
+                for (uint32_t i = 0; i < bestLength; i++)
+                {
+                    insert(position + i);
+                }
+                position += bestLength;
+            }
+            else
+            {
+                writeFixedSymbol(writer, data[position]);
+                insert(position);
+                position++;
+            }
+        }
+        writeFixedSymbol(writer, 256);
+        writer.flush();
+        putBigEndian(out, adler32(data, size));
+        return out;
+    }
+
+    class Inflater
+    {
+    public:
+        Inflater(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+        std::vector<uint8_t> run()
+        {
+            if (size < 2 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20))
+            {
+                throw std::runtime_error("=====Invalid zlib stream in PNG!=====");
+            }
+            position = 2;
+            bool last = false;
+            while (!last)
+            {
+                last = bits(1) == 1;
+                uint32_t type = bits(2);
+                if (type == 0)
+                    stored();
+                else if (type == 1)
+                    fixed();
+                else if (type == 2)
+                    dynamic();
+                else
+                    throw std::runtime_error("=====Invalid deflate block in PNG!=====");
+            }
+            return std::move(out);
+        }
+
+    private:
+        struct Huffman
+        {
+            uint16_t count[16];
+            uint16_t symbol[288];
+        };
+
+        uint32_t bits(uint32_t count)
+        {
+            while (bitCount < count)
+            {
+                if (position >= size)
+                {
+                    throw std::runtime_error("=====Truncated deflate stream in PNG!=====");
+                }
+                buffer |= uint32_t(data[position++]) << bitCount;
+                bitCount += 8;
+            }
+            uint32_t value = buffer & ((1u << count) - 1);
+            buffer >>= count;
+            bitCount -= count;
+            return value;
+        }
+
+        static void build(Huffman &huffman, const uint8_t *lengths, uint32_t count)
+        {
+            memset(huffman.count, 0, sizeof(huffman.count));
+            for (uint32_t i = 0; i < count; i++)
+            {
+                huffman.count[lengths[i]]++;
+            }
+            huffman.count[0] = 0;
+            uint16_t offsets[16];
+            offsets[1] = 0;
+            for (uint32_t length = 1; length < 15; length++)
+            {
+                offsets[length + 1] = offsets[length] + huffman.count[length];
+            }
+            for (uint32_t i = 0; i < count; i++)
+            {
+                if (lengths[i] != 0)
+                {
+                    huffman.symbol[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+                }
+            }
+        }
+
+        // 按规范Huffman码逐位解码
+        uint32_t decode(const Huffman &huffman)
+        {
+            int code = 0, first = 0, index = 0;
+            for (uint32_t length = 1; length < 16; length++)
+            {
+                code |= static_cast<int>(bits(1));
+                int count = huffman.count[length];
+                if (code - count < first)
+                {
+                    return huffman.symbol[index + (code - first)];
+                }
+                index += count;
+                first = (first + count) << 1;
+                code <<= 1;
+            }
+            throw std::runtime_error("=====Invalid Huffman code in PNG!=====");
+        }
+
+        void stored()
+        {
+            buffer = 0;
+            bitCount = 0;
+            if (position + 4 > size)
+            {
+                throw std::runtime_error("=====Truncated deflate stream in PNG!=====");
+            }
+            uint32_t length = data[position] | (data[position + 1] << 8);
+            uint32_t inverse = data[position + 2] | (data[position + 3] << 8);
+            position += 4;
+            if ((length ^ 0xFFFF) != inverse || position + length > size)
+            {
+                throw std::runtime_error("=====Invalid stored block in PNG!=====");
+            }
+            out.insert(out.end(), data + position, data + position + length);
+            position += length;
+        }
+
+        void fixed()
+        {
+            uint8_t lengths[288 + 30];
+            memset(lengths, 8, 144);
+            memset(lengths + 144, 9, 112);
+            memset(lengths + 256, 7, 24);
+            memset(lengths + 280, 8, 8);
+            memset(lengths + 288, 5, 30);
+            Huffman literal, distance;
+            build(literal, lengths, 288);
+            build(distance, lengths + 288, 30);
+            codes(literal, distance);
+        }
+
+        void dynamic()
+        {
+            static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+            uint32_t literalCount = bits(5) + 257;
+            uint32_t distanceCount = bits(5) + 1;
+            uint32_t codeCount = bits(4) + 4;
+            if (literalCount > 286 || distanceCount > 30)
+            {
+                throw std::runtime_error("=====Invalid dynamic block in PNG!=====");
+            }
+
+            uint8_t lengths[288 + 30] = {};
+            for (uint32_t i = 0; i < codeCount; i++)
+            {
+                lengths[order[i]] = static_cast<uint8_t>(bits(3));
+            }
+            Huffman lengthCode;
+            build(lengthCode, lengths, 19);
+
+            uint32_t index = 0;
+            memset(lengths, 0, sizeof(lengths));
+            while (index < literalCount + distanceCount)
+            {
+                uint32_t symbol = decode(lengthCode);
+                if (symbol < 16)
+                {
+                    lengths[index++] = static_cast<uint8_t>(symbol);
+                    continue;
+                }
+                uint8_t value = 0;
+                uint32_t repeat;
+                if (symbol == 16)
+                {
+                    if (index == 0)
+                    {
+                        throw std::runtime_error("=====Invalid dynamic block in PNG!=====");
+                    }
+                    value = lengths[index - 1];
+                    repeat = 3 + bits(2);
+                }
+                else if (symbol == 17)
+                {
+                    repeat = 3 + bits(3);
+                }
+                else
+                {
+                    repeat = 11 + bits(7);
+                }
+                if (index + repeat > literalCount + distanceCount)
+                {
+                    throw std::runtime_error("=====Invalid dynamic block in PNG!=====");
+                }
+                while (repeat-- > 0)
+                {
+                    lengths[index++] = value;
+                }
+            }
+
+            Huffman literal, distance;
+            build(literal, lengths, literalCount);
+            build(distance, lengths + literalCount, distanceCount);
+            codes(literal, distance);
+        }
+
+        void codes(const Huffman &literal, const Huffman &distance)
+        {
+            for (;;)
+            {
+                uint32_t symbol = decode(literal);
+                if (symbol < 256)
+                {
+                    out.push_back(static_cast<uint8_t>(symbol));
+                    continue;
+                }
+                if (symbol == 256)
+                {
+                    return;
+                }
+                symbol -= 257;
+                if (symbol >= 29)
+                {
+                    throw std::runtime_error("=====Invalid length code in PNG!=====");
+                }
+                uint32_t length = lengthBase[symbol] + bits(lengthExtra[symbol]);
+                uint32_t distanceSymbol = decode(distance);
+                if (distanceSymbol >= 30)
+                {
+                    throw std::runtime_error("=====Invalid distance code in PNG!=====");
+                }
+                uint32_t offset = distanceBase[distanceSymbol] + bits(distanceExtra[distanceSymbol]);
+                if (offset > out.size())
+                {
+                    throw std::runtime_error("=====Invalid distance in PNG!=====");
+                }
+                // 距离可能小于长度(重复模式)，只能逐字节复制
+                size_t from = out.size() - offset;
+                for (uint32_t i = 0; i < length; i++)
+                {
+                    out.push_back(out[from + i]);
+                }
+            }
+        }
+
+        const uint8_t *data;
+        size_t size;
+        size_t position = 0;
+        uint32_t buffer = 0;
+        uint32_t bitCount = 0;
+        std::vector<uint8_t> out;
+    };
+
+    uint8_t paeth(int a, int b, int c)
+    {
+        int p = a + b - c;
+        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc)
+            return static_cast<uint8_t>(a);
+        return static_cast<uint8_t>(pb <= pc ? b : c);
+    }
+
+    void appendChunk(std::vector<uint8_t> &png, const char *type, const uint8_t *data, size_t size)
+    {
+        putBigEndian(png, static_cast<uint32_t>(size));
+        size_t start = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data, data + size);
+        putBigEndian(png, crc32(png.data() + start, size + 4));
+    }
+}
+
+std::vector<uint8_t> encodePng(const uint8_t *rgba, uint32_t width, uint32_t height)
+{
+    const size_t rowBytes = size_t(width) * 4;
+    std::vector<uint8_t> filtered((rowBytes + 1) * height);
+    std::vector<uint8_t> candidate(rowBytes);
+    std::vector<uint8_t> best(rowBytes);
+    std::vector<uint8_t> zeroRow(rowBytes, 0);
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t *row = rgba + rowBytes * y;
+        const uint8_t *above = y > 0 ? row - rowBytes : zeroRow.data();
+        //五种filter都试一遍，取有符号残差绝对值和最小的
+        uint64_t bestScore = UINT64_MAX;
+        uint8_t bestFilter = 0;
+        for (uint8_t filter = 0; filter < 5; filter++)
+        {
+            uint64_t score = 0;
+            for (size_t i = 0; i < rowBytes; i++)
+            {
+                int a = i >= 4 ? row[i - 4] : 0;
+                int b = above[i];
+                int c = i >= 4 ? above[i - 4] : 0;
+                int predicted = 0;
+                switch (filter)
+                {
+                case 1: predicted = a; break;
+                case 2: predicted = b; break;
+                case 3: predicted = (a + b) / 2; break;
+                case 4: predicted = paeth(a, b, c); break;
+                default: break;
+                }
+                uint8_t value = static_cast<uint8_t>(row[i] - predicted);
+                candidate[i] = value;
+                score += static_cast<uint64_t>(std::abs(static_cast<int8_t>(value)));
+            }
+            if (score < bestScore)
+            {
+                bestScore = score;
+                bestFilter = filter;
+                best.swap(candidate);
+            }
+        }
+        uint8_t *destination = filtered.data() + (rowBytes + 1) * y;
+        destination[0] = bestFilter;
+        memcpy(destination + 1, best.data(), rowBytes);
+    }
+
+    std::vector<uint8_t> png(pngSignature, pngSignature + 8);
+    uint8_t header[13];
+    for (int i = 0; i < 4; i++)
+    {
+        header[i] = static_cast<uint8_t>(width >> (24 - 8 * i));
+        header[4 + i] = static_cast<uint8_t>(height >> (24 - 8 * i));
+    }
+    header[8] = 8;  // bit depth
+    header[9] = 6;  // RGBA
+    header[10] = 0; // deflate
+    header[11] = 0; // adaptive filter
+    header[12] = 0; // 非隔行
+    appendChunk(png, "IHDR", header, sizeof(header));
+    std::vector<uint8_t> compressed = zlibCompress(filtered.data(), filtered.size());
+    appendChunk(png, "IDAT", compressed.data(), compressed.size());
+    appendChunk(png, "IEND", nullptr, 0);
+    return png;
+}
+
+void writePng(const std::string &path, const uint8_t *rgba, uint32_t width, uint32_t height)
+{
+    std::vector<uint8_t> png = encodePng(rgba, width, height);
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        throw std::runtime_error("=====Failed to open " + path + " for writing!=====");
+    }
+    size_t written = fwrite(png.data(), 1, png.size(), file);
+    fclose(file);
+    if (written != png.size())
+    {
+        throw std::runtime_error("=====Failed to write " + path + "!=====");
+    }
+}
+
+PngImage decodePng(const uint8_t *data, size_t size)
+{
+    if (size < 8 || memcmp(data, pngSignature, 8) != 0)
+    {
+        throw std::runtime_error("=====Not a PNG file!=====");
+    }
+
+    PngImage image;
+    uint32_t channels = 0;
+    std::vector<uint8_t> compressed;
+    size_t position = 8;
+    while (position + 12 <= size)
+    {
+        uint32_t length = getBigEndian(data + position);
+        const uint8_t *type = data + position + 4;
+        const uint8_t *chunk = data + position + 8;
+        if (length > size - position - 12)
+        {
+            throw std::runtime_error("=====Truncated PNG chunk!=====");
+        }
+        if (memcmp(type, "IHDR", 4) == 0)
+        {
+            if (length < 13)
+            {
+                throw std::runtime_error("=====Invalid PNG header!=====");
+            }
+            image.width = getBigEndian(chunk);
+            image.height = getBigEndian(chunk + 4);
+            uint8_t bitDepth = chunk[8];
+            uint8_t colorType = chunk[9];
+            uint8_t interlace = chunk[12];
+            if (bitDepth != 8 || (colorType != 2 && colorType != 6) || interlace != 0)
+            {
+                throw std::runtime_error("=====Only 8-bit RGB/RGBA non-interlaced PNG is supported!=====");
+            }
+            channels = colorType == 6 ? 4 : 3;
+        }
+        else if (memcmp(type, "IDAT", 4) == 0)
+        {
+            compressed.insert(compressed.end(), chunk, chunk + length);
+        }
+        else if (memcmp(type, "IEND", 4) == 0)
+        {
+            break;
+        }
+        position += 12 + length;
+    }
+    if (channels == 0 || image.width == 0 || image.height == 0)
+    {
+        throw std::runtime_error("=====PNG has no image header!=====");
+    }
+
+    std::vector<uint8_t> filtered = Inflater(compressed.data(), compressed.size()).run();
+    const size_t rowBytes = size_t(image.width) * channels;
+    if (filtered.size() < (rowBytes + 1) * image.height)
+    {
+        throw std::runtime_error("=====PNG image data is too short!=====");
+    }
+
+    std::vector<uint8_t> raw(rowBytes * image.height);
+    for (uint32_t y = 0; y < image.height; y++)
+    {
+        const uint8_t *source = filtered.data() + (rowBytes + 1) * y;
+        uint8_t filter = source[0];
+        source++;
+        uint8_t *row = raw.data() + rowBytes * y;
+        const uint8_t *above = y > 0 ? row - rowBytes : nullptr;
+        for (size_t i = 0; i < rowBytes; i++)
+        {
+            int a = i >= channels ? row[i - channels] : 0;
+            int b = above ? above[i] : 0;
+            int c = (above && i >= channels) ? above[i - channels] : 0;
+            int predicted = 0;
+            switch (filter)
+            {
+            case 0: break;
+            case 1: predicted = a; break;
+            case 2: predicted = b; break;
+            case 3: predicted = (a + b) / 2; break;
+            case 4: predicted = paeth(a, b, c); break;
+            default: throw std::runtime_error("=====Invalid PNG filter!=====");
+            }
+            row[i] = static_cast<uint8_t>(source[i] + predicted);
+        }
+    }
+
+    image.pixels.resize(size_t(image.width) * image.height * 4);
+    for (size_t i = 0; i < size_t(image.width) * image.height; i++)
+    {
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            image.pixels[i * 4 + c] = raw[i * channels + c];
+        }
+        image.pixels[i * 4 + 3] = channels == 4 ? raw[i * 4 + 3] : 255;
+    }
+    return image;
+}
+
+PngImage readPng(const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        throw std::runtime_error("=====Failed to open " + path + "!=====");
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[65536];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        data.insert(data.end(), chunk, chunk + read);
+    }
+    fclose(file);
+    return decodePng(data.data(), data.size());
+}
+
+ImageDifference compareImages(const uint8_t *actual, const uint8_t *expected, uint32_t width, uint32_t height, uint32_t tolerance)
+{
+    ImageDifference difference;
+    size_t count = size_t(width) * height;
+    difference.diffImage.resize(count * 4);
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t pixelDifference = 0;
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            pixelDifference = std::max<uint32_t>(pixelDifference, std::abs(int(actual[i * 4 + c]) - int(expected[i * 4 + c])));
+        }
+        difference.maxChannelDifference = std::max(difference.maxChannelDifference, pixelDifference);
+        uint8_t *diff = &difference.diffImage[i * 4];
+        if (pixelDifference > tolerance)
+        {
+            difference.mismatchedPixels++;
+            diff[0] = 255;
+            diff[1] = 0;
+            diff[2] = 0;
+        }
+        else
+        {
+            diff[0] = actual[i * 4] / 3;
+            diff[1] = actual[i * 4 + 1] / 3;
+            diff[2] = actual[i * 4 + 2] / 3;
+        }
+        diff[3] = 255;
+    }
+    return difference;
+}
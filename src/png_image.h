@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 不依赖zlib的PNG读写，只处理8位RGB/RGBA、非隔行的图像
+// 写入：每行选择绝对值和最小的filter，deflate使用固定Huffman表与LZ77
+// 读取：完整的inflate(stored/fixed/dynamic)，用于和golden image比较
+struct PngImage
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // 紧密排列的RGBA8
+    std::vector<uint8_t> pixels;
+};
+
+std::vector<uint8_t> encodePng(const uint8_t *rgba, uint32_t width, uint32_t height);
+// 失败时抛出std::runtime_error
+void writePng(const std::string &path, const uint8_t *rgba, uint32_t width, uint32_t height);
+
+// 不支持的格式或数据损坏时抛出std::runtime_error
+PngImage decodePng(const uint8_t *data, size_t size);
+PngImage readPng(const std::string &path);
+
+struct ImageDifference
+{
+    // 任一通道差值超过tolerance的像素数
+    uint64_t mismatchedPixels = 0;
+    uint32_t maxChannelDifference = 0;
+    // 与输入同尺寸，不同的像素为红色，其余为变暗的原图
+    std::vector<uint8_t> diffImage;
+};
+
+ImageDifference compareImages(const uint8_t *actual, const uint8_t *expected, uint32_t width, uint32_t height, uint32_t tolerance);
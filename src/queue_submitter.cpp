@@ -0,0 +1,172 @@
+#include "queue_submitter.h"
+
+#include <stdexcept>
+
+#include "api_call_counter.h"
+
+void QueueSubmitter::create(const Synchronization2 &synchronization)
+{
+    this->synchronization = &synchronization;
+    queues.clear();
+    counters = {};
+}
+
+QueueSubmitter::QueueWork &QueueSubmitter::work(VkQueue queue)
+{
+    for (auto &queueWork : queues)
+    {
+        if (queueWork.queue == queue)
+        {
+            return queueWork;
+        }
+    }
+    queues.emplace_back();
+    queues.back().queue = queue;
+    return queues.back();
+}
+
+QueueSubmitter::Batch &QueueSubmitter::batch(QueueWork &queueWork, bool needNew)
+{
+    if (needNew || queueWork.batches.empty())
+    {
+        Batch next;
+        next.firstWait = static_cast<uint32_t>(queueWork.waits.size());
+        next.firstCommandBuffer = static_cast<uint32_t>(queueWork.commandBuffers.size());
+        next.firstSignal = static_cast<uint32_t>(queueWork.signals.size());
+        queueWork.batches.push_back(next);
+    }
+    return queueWork.batches.back();
+}
+
+void QueueSubmitter::wait(VkQueue queue, VkSemaphore semaphore, VkPipelineStageFlags2 stageMask)
+{
+    QueueWork &queueWork = work(queue);
+    bool needNew = !queueWork.batches.empty() &&
+        (queueWork.batches.back().commandBufferCount > 0 || queueWork.batches.back().signalCount > 0);
+    Batch &current = batch(queueWork, needNew);
+
+    VkSemaphoreSubmitInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    info.semaphore = semaphore;
+    info.stageMask = stageMask;
+    queueWork.waits.push_back(info);
+    current.waitCount++;
+}
+
+void QueueSubmitter::add(VkQueue queue, VkCommandBuffer commandBuffer)
+{
+    QueueWork &queueWork = work(queue);
+    bool needNew = !queueWork.batches.empty() && queueWork.batches.back().signalCount > 0;
+    Batch &current = batch(queueWork, needNew);
+
+    VkCommandBufferSubmitInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+    info.commandBuffer = commandBuffer;
+    queueWork.commandBuffers.push_back(info);
+    current.commandBufferCount++;
+}
+
+void QueueSubmitter::signal(VkQueue queue, VkSemaphore semaphore, VkPipelineStageFlags2 stageMask)
+{
+    QueueWork &queueWork = work(queue);
+    Batch &current = batch(queueWork, false);
+
+    VkSemaphoreSubmitInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    info.semaphore = semaphore;
+    info.stageMask = stageMask;
+    queueWork.signals.push_back(info);
+    current.signalCount++;
+}
+
+bool QueueSubmitter::pending() const
+{
+    for (const auto &queueWork : queues)
+    {
+        if (!queueWork.batches.empty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void QueueSubmitter::submit(VkQueue queue, VkFence fence)
+{
+    QueueWork &queueWork = work(queue);
+    if (synchronization == nullptr || !synchronization->enabled())
+    {
+        submitLegacy(queueWork, fence);
+    }
+    else
+    {
+        //指针在全部加入之后才取，避免vector扩容后失效
+        submitInfos.clear();
+        for (const Batch &current : queueWork.batches)
+        {
+            VkSubmitInfo2 info{};
+            info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+            info.waitSemaphoreInfoCount = current.waitCount;
+            info.pWaitSemaphoreInfos = queueWork.waits.data() + current.firstWait;
+            info.commandBufferInfoCount = current.commandBufferCount;
+            info.pCommandBufferInfos = queueWork.commandBuffers.data() + current.firstCommandBuffer;
+            info.signalSemaphoreInfoCount = current.signalCount;
+            info.pSignalSemaphoreInfos = queueWork.signals.data() + current.firstSignal;
+            submitInfos.push_back(info);
+        }
+        if (synchronization->queueSubmit2(queue, static_cast<uint32_t>(submitInfos.size()), submitInfos.data(), fence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("=====Failed to submit command buffers!=====");
+        }
+    }
+
+    counters.submitCalls++;
+    countApiCall(ApiCall::Submit);
+    counters.batches += queueWork.batches.size();
+    counters.commandBuffers += queueWork.commandBuffers.size();
+    queueWork.batches.clear();
+    queueWork.waits.clear();
+    queueWork.commandBuffers.clear();
+    queueWork.signals.clear();
+}
+
+void QueueSubmitter::submitLegacy(QueueWork &queueWork, VkFence fence)
+{
+    legacySemaphores.clear();
+    legacyWaitStages.clear();
+    legacyCommandBuffers.clear();
+    for (const auto &info : queueWork.waits)
+    {
+        legacySemaphores.push_back(info.semaphore);
+        legacyWaitStages.push_back(legacyStageMask(info.stageMask, false));
+    }
+    //signal的stage在旧接口中固定为ALL_COMMANDS
+    for (const auto &info : queueWork.signals)
+    {
+        legacySemaphores.push_back(info.semaphore);
+    }
+    for (const auto &info : queueWork.commandBuffers)
+    {
+        legacyCommandBuffers.push_back(info.commandBuffer);
+    }
+
+    size_t signalBase = queueWork.waits.size();
+    legacySubmitInfos.clear();
+    for (const Batch &current : queueWork.batches)
+    {
+        VkSubmitInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        info.waitSemaphoreCount = current.waitCount;
+        info.pWaitSemaphores = legacySemaphores.data() + current.firstWait;
+        info.pWaitDstStageMask = legacyWaitStages.data() + current.firstWait;
+        info.commandBufferCount = current.commandBufferCount;
+        info.pCommandBuffers = legacyCommandBuffers.data() + current.firstCommandBuffer;
+        info.signalSemaphoreCount = current.signalCount;
+        info.pSignalSemaphores = legacySemaphores.data() + signalBase + current.firstSignal;
+        legacySubmitInfos.push_back(info);
+    }
+    if (vkQueueSubmit(queueWork.queue, static_cast<uint32_t>(legacySubmitInfos.size()), legacySubmitInfos.data(), fence) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to submit command buffers!=====");
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+#include "synchronization2.h"
+
+// 收集一帧中每个队列的command buffer与semaphore等待/signal，每个队列只调用一次vkQueueSubmit2
+// 按加入顺序切分成batch(VkSubmitInfo2)：等待总是作用于整个batch之前，signal总是在整个batch之后，
+// 所以在已有command buffer之后加入等待、或在signal之后加入command buffer时开始新的batch
+// 设备不支持synchronization2时同样只调用一次vkQueueSubmit
+// 容器在帧之间复用，稳定后不再分配内存
+class QueueSubmitter
+{
+public:
+    struct Stats
+    {
+        // 累计的vkQueueSubmit(2)调用与其中的batch、command buffer数
+        uint64_t submitCalls = 0;
+        uint64_t batches = 0;
+        uint64_t commandBuffers = 0;
+    };
+
+    void create(const Synchronization2 &synchronization);
+
+    void wait(VkQueue queue, VkSemaphore semaphore, VkPipelineStageFlags2 stageMask);
+    void add(VkQueue queue, VkCommandBuffer commandBuffer);
+    void signal(VkQueue queue, VkSemaphore semaphore, VkPipelineStageFlags2 stageMask);
+
+    // 提交queue上收集的所有batch，fence在最后一个batch完成后signal；没有工作时只signal fence
+    // 失败时抛出std::runtime_error
+    void submit(VkQueue queue, VkFence fence = VK_NULL_HANDLE);
+    // 是否还有未提交的工作
+    bool pending() const;
+
+    const Stats &stats() const { return counters; }
+
+private:
+    struct Batch
+    {
+        uint32_t firstWait = 0;
+        uint32_t waitCount = 0;
+        uint32_t firstCommandBuffer = 0;
+        uint32_t commandBufferCount = 0;
+        uint32_t firstSignal = 0;
+        uint32_t signalCount = 0;
+    };
+
+    struct QueueWork
+    {
+        VkQueue queue = VK_NULL_HANDLE;
+        std::vector<Batch> batches;
+        std::vector<VkSemaphoreSubmitInfo> waits;
+        std::vector<VkCommandBufferSubmitInfo> commandBuffers;
+        std::vector<VkSemaphoreSubmitInfo> signals;
+    };
+
+    QueueWork &work(VkQueue queue);
+    // 最后一个batch；needNew为true时新开一个
+    Batch &batch(QueueWork &queueWork, bool needNew);
+    void submitLegacy(QueueWork &queueWork, VkFence fence);
+
+    const Synchronization2 *synchronization = nullptr;
+    // 一帧通常只用到一两个队列，线性查找
+    std::vector<QueueWork> queues;
+    std::vector<VkSubmitInfo2> submitInfos;
+    // 旧接口需要的分开的数组
+    std::vector<VkSubmitInfo> legacySubmitInfos;
+    std::vector<VkSemaphore> legacySemaphores;
+    std::vector<VkPipelineStageFlags> legacyWaitStages;
+    std::vector<VkCommandBuffer> legacyCommandBuffers;
+    Stats counters;
+};
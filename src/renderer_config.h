@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+// 为0时去掉所有测量代码：GPU计时(动态分辨率与低延迟模式需要时除外)、--metrics、命令计数与启动阶段计时
+// Debug默认开启，Release默认关闭；CMake的KUTORY_PROFILING选项在Release中开启
+// 不是模板的模块(DrawList、QueueSubmitter等)按这个宏计数，所以它必须与所选配置的profiling一致
+#ifndef KUTORY_PROFILING
+#ifdef NDEBUG
+#define KUTORY_PROFILING 0
+#else
+#define KUTORY_PROFILING 1
+#endif
+#endif
+
+// 编译期确定的渲染器配置，作为HelloTriangleApplication的模板参数
+// 关闭的功能在if constexpr中整段去掉，每帧的路径上不留下运行时判断
+// 新的配置继承RendererConfig，只重新声明需要改变的项
+struct RendererConfig
+{
+    // VK_LAYER_KHRONOS_validation、debug messenger与PERFORMANCE警告的统计
+    static constexpr bool validation = false;
+    // CPU可以领先GPU的帧数，每帧拥有独立的command buffer、semaphore与fence
+    static constexpr uint32_t framesInFlight = 2;
+    // MSAA采样数(1/2/4/8)，会被限制在设备framebufferColor/DepthSampleCounts支持的范围内
+    static constexpr VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_4_BIT;
+    // timestamp query、--metrics、命令计数与启动阶段计时
+    static constexpr bool profiling = false;
+    // 优先使用dynamic rendering(Vulkan 1.3核心)，设备或loader不支持1.3时回退到传统的render pass路径
+    static constexpr bool dynamicRendering = true;
+    // 深度预渲染：先只写深度，再以EQUAL比较着色，每个像素只执行一次fragment shader
+    // 适合overdraw很高、fragment shader较重的场景
+    static constexpr bool depthPrepass = false;
+};
+
+struct DebugRendererConfig : RendererConfig
+{
+    static constexpr bool validation = true;
+    static constexpr bool profiling = true;
+};
+
+// 没有任何测量代码
+struct ReleaseRendererConfig : RendererConfig
+{
+    static constexpr bool profiling = false;
+};
+
+// 与Release相同的代码，加上测量
+struct ProfilingRendererConfig : RendererConfig
+{
+    static constexpr bool profiling = true;
+};
+
+// validation层仅在Debug模式下作用
+#if !defined(NDEBUG)
+using BuildRendererConfig = DebugRendererConfig;
+#elif KUTORY_PROFILING
+using BuildRendererConfig = ProfilingRendererConfig;
+#else
+using BuildRendererConfig = ReleaseRendererConfig;
+#endif
@@ -0,0 +1,205 @@
+#include "scene.h"
+
+#include <cmath>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+    inline uint32_t lowestBit(uint64_t bits)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, bits);
+        return static_cast<uint32_t>(index);
+#else
+        return static_cast<uint32_t>(__builtin_ctzll(bits));
+#endif
+    }
+}
+
+void Scene::reserve(size_t count)
+{
+    for (auto *array : {&transformArrays.positionX, &transformArrays.positionY, &transformArrays.positionZ,
+             &transformArrays.rotationX, &transformArrays.rotationY, &transformArrays.rotationZ, &transformArrays.rotationW,
+             &transformArrays.scale, &localCenterX, &localCenterY, &localCenterZ, &localExtentX, &localExtentY, &localExtentZ,
+             &boundsArrays.centerX, &boundsArrays.centerY, &boundsArrays.centerZ, &boundsArrays.radius,
+             &boundsArrays.minX, &boundsArrays.minY, &boundsArrays.minZ, &boundsArrays.maxX, &boundsArrays.maxY, &boundsArrays.maxZ})
+    {
+        array->reserve(count);
+    }
+    drawKeyArray.reserve(count);
+    dirtyFlags.reserve(count);
+}
+
+void Scene::clear()
+{
+    transformArrays = Transforms{};
+    localCenterX.clear();
+    localCenterY.clear();
+    localCenterZ.clear();
+    localExtentX.clear();
+    localExtentY.clear();
+    localExtentZ.clear();
+    boundsArrays = Bounds{};
+    drawKeyArray.clear();
+    dirtyFlags.clear();
+    dirtyObjects.clear();
+    visibleBits.clear();
+    changeVersion++;
+}
+
+uint32_t Scene::add(const ObjectDesc &object)
+{
+    uint32_t index = static_cast<uint32_t>(size());
+    transformArrays.positionX.push_back(object.position[0]);
+    transformArrays.positionY.push_back(object.position[1]);
+    transformArrays.positionZ.push_back(object.position[2]);
+    transformArrays.rotationX.push_back(object.rotation[0]);
+    transformArrays.rotationY.push_back(object.rotation[1]);
+    transformArrays.rotationZ.push_back(object.rotation[2]);
+    transformArrays.rotationW.push_back(object.rotation[3]);
+    transformArrays.scale.push_back(object.scale);
+
+    localCenterX.push_back(0.5f * (object.boundsMin[0] + object.boundsMax[0]));
+    localCenterY.push_back(0.5f * (object.boundsMin[1] + object.boundsMax[1]));
+    localCenterZ.push_back(0.5f * (object.boundsMin[2] + object.boundsMax[2]));
+    localExtentX.push_back(0.5f * (object.boundsMax[0] - object.boundsMin[0]));
+    localExtentY.push_back(0.5f * (object.boundsMax[1] - object.boundsMin[1]));
+    localExtentZ.push_back(0.5f * (object.boundsMax[2] - object.boundsMin[2]));
+
+    for (auto *array : {&boundsArrays.centerX, &boundsArrays.centerY, &boundsArrays.centerZ, &boundsArrays.radius,
+             &boundsArrays.minX, &boundsArrays.minY, &boundsArrays.minZ, &boundsArrays.maxX, &boundsArrays.maxY, &boundsArrays.maxZ})
+    {
+        array->push_back(0.0f);
+    }
+    drawKeyArray.push_back(object.drawKey);
+
+    dirtyFlags.push_back(0);
+    markDirty(index);
+    return index;
+}
+
+void Scene::setTransform(uint32_t object, const float position[3], const float rotation[4], float scale)
+{
+    if (object >= size())
+    {
+        throw std::runtime_error("=====Scene object index out of range!=====");
+    }
+    transformArrays.positionX[object] = position[0];
+    transformArrays.positionY[object] = position[1];
+    transformArrays.positionZ[object] = position[2];
+    transformArrays.rotationX[object] = rotation[0];
+    transformArrays.rotationY[object] = rotation[1];
+    transformArrays.rotationZ[object] = rotation[2];
+    transformArrays.rotationW[object] = rotation[3];
+    transformArrays.scale[object] = scale;
+    markDirty(object);
+}
+
+void Scene::setDrawKey(uint32_t object, uint64_t drawKey)
+{
+    if (object >= size())
+    {
+        throw std::runtime_error("=====Scene object index out of range!=====");
+    }
+    drawKeyArray[object] = drawKey;
+    changeVersion++;
+}
+
+void Scene::markDirty(uint32_t object)
+{
+    if (!dirtyFlags[object])
+    {
+        dirtyFlags[object] = 1;
+        dirtyObjects.push_back(object);
+    }
+    changeVersion++;
+}
+
+void Scene::updateBounds()
+{
+    for (uint32_t object : dirtyObjects)
+    {
+        computeBounds(object);
+        dirtyFlags[object] = 0;
+    }
+    dirtyObjects.clear();
+}
+
+void Scene::computeBounds(uint32_t i)
+{
+    float qx = transformArrays.rotationX[i];
+    float qy = transformArrays.rotationY[i];
+    float qz = transformArrays.rotationZ[i];
+    float qw = transformArrays.rotationW[i];
+    float s = transformArrays.scale[i];
+
+    //四元数转为旋转矩阵
+    float r[3][3] = {
+        {1.0f - 2.0f * (qy * qy + qz * qz), 2.0f * (qx * qy - qw * qz), 2.0f * (qx * qz + qw * qy)},
+        {2.0f * (qx * qy + qw * qz), 1.0f - 2.0f * (qx * qx + qz * qz), 2.0f * (qy * qz - qw * qx)},
+        {2.0f * (qx * qz - qw * qy), 2.0f * (qy * qz + qw * qx), 1.0f - 2.0f * (qx * qx + qy * qy)},
+    };
+    float localCenter[3] = {localCenterX[i] * s, localCenterY[i] * s, localCenterZ[i] * s};
+    float localExtent[3] = {localExtentX[i] * s, localExtentY[i] * s, localExtentZ[i] * s};
+    float position[3] = {transformArrays.positionX[i], transformArrays.positionY[i], transformArrays.positionZ[i]};
+
+    //旋转后的AABB：中心直接变换，半边长取旋转矩阵的绝对值相乘
+    float center[3];
+    float extent[3];
+    for (int row = 0; row < 3; row++)
+    {
+        center[row] = position[row];
+        extent[row] = 0.0f;
+        for (int column = 0; column < 3; column++)
+        {
+            center[row] += r[row][column] * localCenter[column];
+            extent[row] += std::fabs(r[row][column]) * localExtent[column];
+        }
+    }
+
+    boundsArrays.centerX[i] = center[0];
+    boundsArrays.centerY[i] = center[1];
+    boundsArrays.centerZ[i] = center[2];
+    //半径与旋转无关，取模型空间AABB的半对角线
+    boundsArrays.radius[i] = std::sqrt(localExtent[0] * localExtent[0] + localExtent[1] * localExtent[1] + localExtent[2] * localExtent[2]);
+    boundsArrays.minX[i] = center[0] - extent[0];
+    boundsArrays.minY[i] = center[1] - extent[1];
+    boundsArrays.minZ[i] = center[2] - extent[2];
+    boundsArrays.maxX[i] = center[0] + extent[0];
+    boundsArrays.maxY[i] = center[1] + extent[1];
+    boundsArrays.maxZ[i] = center[2] + extent[2];
+}
+
+SphereArrays Scene::spheres() const
+{
+    SphereArrays spheres;
+    spheres.x = boundsArrays.centerX.data();
+    spheres.y = boundsArrays.centerY.data();
+    spheres.z = boundsArrays.centerZ.data();
+    spheres.radius = boundsArrays.radius.data();
+    return spheres;
+}
+
+size_t Scene::cull(FrustumCuller &culler, const Frustum &frustum, std::vector<uint32_t> &visibleObjects)
+{
+    updateBounds();
+    size_t visible = culler.cull(frustum, spheres(), size(), visibleBits);
+
+    visibleObjects.resize(visible);
+    size_t output = 0;
+    for (size_t word = 0; word < visibleBits.size(); word++)
+    {
+        uint64_t bits = visibleBits[word];
+        while (bits != 0)
+        {
+            visibleObjects[output++] = static_cast<uint32_t>(word * 64 + lowestBit(bits));
+            bits &= bits - 1;
+        }
+    }
+    return visible;
+}
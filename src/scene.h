@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frustum_culling.h"
+
+// 场景对象按分量分开存放(structure of arrays)，剔除、排序等批量处理只读取自己需要的数组，
+// 并且可以直接用SIMD连续加载；对象索引即添加顺序，在clear之前保持不变
+class Scene
+{
+public:
+    struct ObjectDesc
+    {
+        float position[3] = {0.0f, 0.0f, 0.0f};
+        // 四元数xyzw
+        float rotation[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        // 只支持等比缩放，包围球半径可以直接乘以scale
+        float scale = 1.0f;
+        // 模型空间AABB
+        float boundsMin[3] = {-0.5f, -0.5f, -0.5f};
+        float boundsMax[3] = {0.5f, 0.5f, 0.5f};
+        uint64_t drawKey = 0;
+    };
+
+    struct Transforms
+    {
+        std::vector<float> positionX, positionY, positionZ;
+        std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+        std::vector<float> scale;
+    };
+
+    // 世界空间包围球与AABB，由updateBounds从模型空间AABB与变换计算
+    struct Bounds
+    {
+        std::vector<float> centerX, centerY, centerZ, radius;
+        std::vector<float> minX, minY, minZ;
+        std::vector<float> maxX, maxY, maxZ;
+    };
+
+    void reserve(size_t count);
+    void clear();
+    uint32_t add(const ObjectDesc &object);
+    size_t size() const { return drawKeyArray.size(); }
+
+    void setTransform(uint32_t object, const float position[3], const float rotation[4], float scale);
+    void setDrawKey(uint32_t object, uint64_t drawKey);
+
+    // 重新计算变换过的对象的世界空间包围体，cull会自动调用
+    void updateBounds();
+
+    // 剔除后按升序输出可见对象的索引，返回可见数量
+    size_t cull(FrustumCuller &culler, const Frustum &frustum, std::vector<uint32_t> &visibleObjects);
+    // 上一次cull的逐位可见性，第i个对象对应第i / 64个word的第i % 64位
+    const std::vector<uint64_t> &visibilityBits() const { return visibleBits; }
+
+    const Transforms &transforms() const { return transformArrays; }
+    const Bounds &worldBounds() const { return boundsArrays; }
+    const std::vector<uint64_t> &drawKeys() const { return drawKeyArray; }
+    SphereArrays spheres() const;
+
+    // 对象的增删、变换或draw key改变时递增，用于判断缓存的结果是否过期
+    uint64_t version() const { return changeVersion; }
+
+private:
+    void markDirty(uint32_t object);
+    void computeBounds(uint32_t object);
+
+    Transforms transformArrays;
+    // 模型空间AABB的中心与半边长
+    std::vector<float> localCenterX, localCenterY, localCenterZ;
+    std::vector<float> localExtentX, localExtentY, localExtentZ;
+    Bounds boundsArrays;
+    std::vector<uint64_t> drawKeyArray;
+
+    std::vector<uint8_t> dirtyFlags;
+    std::vector<uint32_t> dirtyObjects;
+    std::vector<uint64_t> visibleBits;
+    uint64_t changeVersion = 0;
+};
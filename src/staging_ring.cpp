@@ -0,0 +1,128 @@
+#include "staging_ring.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void StagingRing::create(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties, VkDeviceSize size, uint32_t frameSlots)
+{
+    this->device = device;
+    this->size = size;
+    head = 0;
+    tail = 0;
+    frameEnds.assign(frameSlots, UINT64_MAX);
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &stagingBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create staging buffer!=====");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, stagingBuffer, &memRequirements);
+
+    //COHERENT省去flush，CPU只顺序写入，不需要CACHED
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    uint32_t memoryType = UINT32_MAX;
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    {
+        if ((memRequirements.memoryTypeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            memoryType = i;
+            break;
+        }
+    }
+    if (memoryType == UINT32_MAX)
+    {
+        throw std::runtime_error("=====Failed to find staging memory type!=====");
+    }
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = memoryType;
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to allocate staging memory!=====");
+    }
+    vkBindBufferMemory(device, stagingBuffer, memory, 0);
+    vkMapMemory(device, memory, 0, size, 0, &mapped);
+}
+
+void StagingRing::destroy()
+{
+    if (device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    vkUnmapMemory(device, memory);
+    vkDestroyBuffer(device, stagingBuffer, nullptr);
+    vkFreeMemory(device, memory, nullptr);
+    stagingBuffer = VK_NULL_HANDLE;
+    memory = VK_NULL_HANDLE;
+    mapped = nullptr;
+    device = VK_NULL_HANDLE;
+}
+
+void StagingRing::beginFrame(uint32_t frameSlot)
+{
+    if (frameEnds[frameSlot] != UINT64_MAX)
+    {
+        // 更早的slot一定已经完成，tail只会前进
+        tail = std::max(tail, frameEnds[frameSlot]);
+        frameEnds[frameSlot] = UINT64_MAX;
+    }
+}
+
+void StagingRing::endFrame(uint32_t frameSlot)
+{
+    frameEnds[frameSlot] = head;
+}
+
+bool StagingRing::allocate(VkDeviceSize allocationSize, VkDeviceSize alignment, Allocation &allocation)
+{
+    if (head == tail)
+    {
+        // 全部回收后从buffer开头重新开始，整块空间都是连续的
+        head = tail = (head + size - 1) / size * size;
+    }
+    uint64_t start = head;
+    VkDeviceSize offset = start % size;
+    VkDeviceSize padding = (alignment - offset % alignment) % alignment;
+    if (offset + padding + allocationSize > size)
+    {
+        // 尾部放不下，跳过剩余部分从buffer开头开始
+        start += size - offset;
+        offset = 0;
+        padding = 0;
+    }
+    uint64_t end = start + padding + allocationSize;
+    if (end - tail > size)
+    {
+        return false;
+    }
+
+    head = end;
+    allocation.offset = offset + padding;
+    allocation.data = static_cast<char *>(mapped) + allocation.offset;
+    return true;
+}
+
+VkDeviceSize StagingRing::largestFreeBlock() const
+{
+    uint64_t used = head - tail;
+    if (used == 0)
+    {
+        return size;
+    }
+    VkDeviceSize headOffset = head % size;
+    VkDeviceSize tailOffset = tail % size;
+    if (headOffset >= tailOffset && used < size)
+    {
+        return std::max(size - headOffset, tailOffset);
+    }
+    return size - used;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+// 一块常驻映射的HOST_VISIBLE buffer，按环形方式分配上传用的staging空间
+// 每个frame in flight记录自己分配到的位置，该frame的fence signal后(下次beginFrame)整体回收
+class StagingRing
+{
+public:
+    struct Allocation
+    {
+        VkDeviceSize offset = 0;
+        void *data = nullptr;
+    };
+
+    void create(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties, VkDeviceSize size, uint32_t frameSlots);
+    void destroy();
+
+    // 在等待过frameSlot的fence之后调用，回收该slot上一轮的分配
+    void beginFrame(uint32_t frameSlot);
+    // 提交前调用，记录本帧分配的结束位置
+    void endFrame(uint32_t frameSlot);
+
+    // 空间不足时返回false，调用方把上传推迟到之后的帧
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, Allocation &allocation);
+    // 不考虑对齐与回绕时还能分配的最大连续字节数
+    VkDeviceSize largestFreeBlock() const;
+
+    VkBuffer buffer() const { return stagingBuffer; }
+    VkDeviceSize capacity() const { return size; }
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void *mapped = nullptr;
+    VkDeviceSize size = 0;
+    // head与tail是单调递增的字节计数，取模得到buffer内的偏移
+    uint64_t head = 0;
+    uint64_t tail = 0;
+    // 每个slot上一次endFrame时的head，UINT64_MAX表示没有待回收的分配
+    std::vector<uint64_t> frameEnds;
+};
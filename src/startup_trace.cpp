@@ -0,0 +1,107 @@
+#include "startup_trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+
+namespace
+{
+    double toMs(StartupTrace::Clock::duration duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    long long toUs(StartupTrace::Clock::duration duration)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    }
+
+    std::string escapeJson(const std::string &text)
+    {
+        std::string escaped;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                escaped += '\\';
+                escaped += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char buffer[8];
+                snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                escaped += buffer;
+            }
+            else
+            {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+}
+
+StartupTrace::StartupTrace() : origin(Clock::now())
+{
+}
+
+size_t StartupTrace::begin(const char *name)
+{
+    Stage stage;
+    stage.name = name;
+    stage.depth = depth++;
+    stage.begin = Clock::now();
+    stage.end = stage.begin;
+    recorded.push_back(stage);
+    return recorded.size() - 1;
+}
+
+void StartupTrace::end(size_t index)
+{
+    recorded[index].end = Clock::now();
+    depth--;
+}
+
+double StartupTrace::totalMs() const
+{
+    Clock::time_point last = origin;
+    for (const auto &stage : recorded)
+    {
+        last = std::max(last, stage.end);
+    }
+    return toMs(last - origin);
+}
+
+void StartupTrace::printSummary(std::ostream &out) const
+{
+    out << "Startup stages:\n";
+    for (const auto &stage : recorded)
+    {
+        out << '\t' << std::string(stage.depth * 2, ' ') << std::left << std::setw(28 - stage.depth * 2) << stage.name
+            << std::right << std::fixed << std::setprecision(2) << std::setw(9) << toMs(stage.end - stage.begin) << " ms\n";
+    }
+    out << "\tTotal " << std::fixed << std::setprecision(2) << totalMs() << " ms\n";
+}
+
+void StartupTrace::writeChromeTrace(const std::string &path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("=====Failed to open startup trace file: " + path + "=====");
+    }
+
+    // "X"为complete event，ts与dur单位是微秒
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (size_t i = 0; i < recorded.size(); i++)
+    {
+        const Stage &stage = recorded[i];
+        file << "{\"name\":\"" << escapeJson(stage.name) << "\",\"cat\":\"startup\",\"ph\":\"X\""
+             << ",\"ts\":" << toUs(stage.begin - origin) << ",\"dur\":" << toUs(stage.end - stage.begin)
+             << ",\"pid\":1,\"tid\":1}" << (i + 1 < recorded.size() ? ",\n" : "\n");
+    }
+    file << "]}\n";
+}
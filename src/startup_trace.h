@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 记录启动阶段每一步的耗时，可以输出为Chrome trace JSON(chrome://tracing或Perfetto打开)
+// 阶段可以嵌套，嵌套关系由时间区间表示，trace查看器会自动画成层级
+class StartupTrace
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stage
+    {
+        std::string name;
+        Clock::time_point begin;
+        Clock::time_point end;
+        uint32_t depth = 0;
+    };
+
+    StartupTrace();
+
+    // 计时执行func，func抛出异常时阶段同样被结束
+    template <typename Func>
+    void measure(const char *name, Func &&func)
+    {
+        size_t index = begin(name);
+        try
+        {
+            std::forward<Func>(func)();
+        }
+        catch (...)
+        {
+            end(index);
+            throw;
+        }
+        end(index);
+    }
+
+    size_t begin(const char *name);
+    void end(size_t index);
+
+    const std::vector<Stage> &stages() const { return recorded; }
+    // 从构造到最后一个阶段结束的时间
+    double totalMs() const;
+
+    // 按记录顺序输出每个阶段的毫秒数，子阶段缩进
+    void printSummary(std::ostream &out) const;
+    // 写出Chrome trace的JSON Object格式，失败时抛出std::runtime_error
+    void writeChromeTrace(const std::string &path) const;
+
+private:
+    Clock::time_point origin;
+    std::vector<Stage> recorded;
+    uint32_t depth = 0;
+};
@@ -0,0 +1,161 @@
+#include "synchronization2.h"
+
+#include <stdexcept>
+
+#include "api_call_counter.h"
+
+namespace
+{
+    //旧接口中没有的位都在高32位
+    const VkFlags64 legacyBits = 0xFFFFFFFFull;
+}
+
+void Synchronization2::load(VkDevice device, bool enabled, bool core)
+{
+    queueSubmit2 = nullptr;
+    cmdPipelineBarrier2 = nullptr;
+    if (!enabled)
+    {
+        return;
+    }
+    //直接从device取函数指针，KHR版本与核心版本的签名相同
+    queueSubmit2 = (PFN_vkQueueSubmit2)vkGetDeviceProcAddr(device, core ? "vkQueueSubmit2" : "vkQueueSubmit2KHR");
+    cmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2)vkGetDeviceProcAddr(device, core ? "vkCmdPipelineBarrier2" : "vkCmdPipelineBarrier2KHR");
+    if (queueSubmit2 == nullptr || cmdPipelineBarrier2 == nullptr)
+    {
+        throw std::runtime_error("=====Failed to load synchronization2 functions!=====");
+    }
+}
+
+void Synchronization2::pipelineBarrier(VkCommandBuffer commandBuffer, const VkDependencyInfo &dependency) const
+{
+    countApiCall(ApiCall::PipelineBarrier);
+    countApiCall(ApiCall::Barrier, dependency.memoryBarrierCount + dependency.bufferMemoryBarrierCount + dependency.imageMemoryBarrierCount);
+    if (cmdPipelineBarrier2 != nullptr)
+    {
+        cmdPipelineBarrier2(commandBuffer, &dependency);
+        return;
+    }
+
+    if (dependency.memoryBarrierCount > maxLegacyBarriers || dependency.bufferMemoryBarrierCount > maxLegacyBarriers ||
+        dependency.imageMemoryBarrierCount > maxLegacyBarriers)
+    {
+        throw std::runtime_error("=====Too many barriers for vkCmdPipelineBarrier!=====");
+    }
+
+    //旧接口的stage是整个调用共用的，取所有barrier的并集
+    VkPipelineStageFlags2 srcStages = 0;
+    VkPipelineStageFlags2 dstStages = 0;
+    VkMemoryBarrier memoryBarriers[maxLegacyBarriers];
+    VkBufferMemoryBarrier bufferBarriers[maxLegacyBarriers];
+    VkImageMemoryBarrier imageBarriers[maxLegacyBarriers];
+    for (uint32_t i = 0; i < dependency.memoryBarrierCount; i++)
+    {
+        const VkMemoryBarrier2 &source = dependency.pMemoryBarriers[i];
+        srcStages |= source.srcStageMask;
+        dstStages |= source.dstStageMask;
+        memoryBarriers[i] = {};
+        memoryBarriers[i].sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarriers[i].srcAccessMask = legacyAccessMask(source.srcAccessMask);
+        memoryBarriers[i].dstAccessMask = legacyAccessMask(source.dstAccessMask);
+    }
+    for (uint32_t i = 0; i < dependency.bufferMemoryBarrierCount; i++)
+    {
+        const VkBufferMemoryBarrier2 &source = dependency.pBufferMemoryBarriers[i];
+        srcStages |= source.srcStageMask;
+        dstStages |= source.dstStageMask;
+        bufferBarriers[i] = {};
+        bufferBarriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufferBarriers[i].srcAccessMask = legacyAccessMask(source.srcAccessMask);
+        bufferBarriers[i].dstAccessMask = legacyAccessMask(source.dstAccessMask);
+        bufferBarriers[i].srcQueueFamilyIndex = source.srcQueueFamilyIndex;
+        bufferBarriers[i].dstQueueFamilyIndex = source.dstQueueFamilyIndex;
+        bufferBarriers[i].buffer = source.buffer;
+        bufferBarriers[i].offset = source.offset;
+        bufferBarriers[i].size = source.size;
+    }
+    for (uint32_t i = 0; i < dependency.imageMemoryBarrierCount; i++)
+    {
+        const VkImageMemoryBarrier2 &source = dependency.pImageMemoryBarriers[i];
+        srcStages |= source.srcStageMask;
+        dstStages |= source.dstStageMask;
+        imageBarriers[i] = {};
+        imageBarriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarriers[i].srcAccessMask = legacyAccessMask(source.srcAccessMask);
+        imageBarriers[i].dstAccessMask = legacyAccessMask(source.dstAccessMask);
+        imageBarriers[i].oldLayout = source.oldLayout;
+        imageBarriers[i].newLayout = source.newLayout;
+        imageBarriers[i].srcQueueFamilyIndex = source.srcQueueFamilyIndex;
+        imageBarriers[i].dstQueueFamilyIndex = source.dstQueueFamilyIndex;
+        imageBarriers[i].image = source.image;
+        imageBarriers[i].subresourceRange = source.subresourceRange;
+    }
+
+    vkCmdPipelineBarrier(commandBuffer, legacyStageMask(srcStages, true), legacyStageMask(dstStages, false), dependency.dependencyFlags,
+        dependency.memoryBarrierCount, memoryBarriers,
+        dependency.bufferMemoryBarrierCount, bufferBarriers,
+        dependency.imageMemoryBarrierCount, imageBarriers);
+}
+
+void Synchronization2::imageBarrier(VkCommandBuffer commandBuffer, const VkImageMemoryBarrier2 &barrier) const
+{
+    VkDependencyInfo dependency{};
+    dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency.imageMemoryBarrierCount = 1;
+    dependency.pImageMemoryBarriers = &barrier;
+    pipelineBarrier(commandBuffer, dependency);
+}
+
+VkPipelineStageFlags legacyStageMask(VkPipelineStageFlags2 stageMask, bool source)
+{
+    if (stageMask == VK_PIPELINE_STAGE_2_NONE)
+    {
+        return source ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    }
+    VkPipelineStageFlags legacy = static_cast<VkPipelineStageFlags>(stageMask & legacyBits);
+    if ((stageMask & ~legacyBits) != 0)
+    {
+        legacy |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    }
+    return legacy;
+}
+
+VkAccessFlags legacyAccessMask(VkAccessFlags2 accessMask)
+{
+    VkAccessFlags legacy = static_cast<VkAccessFlags>(accessMask & legacyBits);
+    if ((accessMask & (VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT)) != 0)
+    {
+        legacy |= VK_ACCESS_SHADER_READ_BIT;
+        accessMask &= ~(VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+    }
+    if ((accessMask & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT) != 0)
+    {
+        legacy |= VK_ACCESS_SHADER_WRITE_BIT;
+        accessMask &= ~VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    }
+    if ((accessMask & ~legacyBits) != 0)
+    {
+        legacy |= VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    }
+    return legacy;
+}
+
+VkImageMemoryBarrier2 makeImageBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess,
+    VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+    VkImageAspectFlags aspectMask)
+{
+    VkImageMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = srcStage;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstStageMask = dstStage;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {aspectMask, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+    return barrier;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// VK_KHR_synchronization2(1.3核心)的入口：barrier与submit都用*2结构描述，
+// 设备不支持时转换为旧的vkCmdPipelineBarrier/vkQueueSubmit，调用方不需要两套代码
+class Synchronization2
+{
+public:
+    // core为true时取1.3的核心函数，否则取KHR扩展的函数；enabled为false时只走旧接口
+    void load(VkDevice device, bool enabled, bool core);
+    bool enabled() const { return cmdPipelineBarrier2 != nullptr && queueSubmit2 != nullptr; }
+
+    // 旧接口下每种barrier最多maxLegacyBarriers个，超出时抛出std::runtime_error
+    void pipelineBarrier(VkCommandBuffer commandBuffer, const VkDependencyInfo &dependency) const;
+    void imageBarrier(VkCommandBuffer commandBuffer, const VkImageMemoryBarrier2 &barrier) const;
+
+    PFN_vkQueueSubmit2 queueSubmit2 = nullptr;
+
+    static const uint32_t maxLegacyBarriers = 16;
+
+private:
+    PFN_vkCmdPipelineBarrier2 cmdPipelineBarrier2 = nullptr;
+};
+
+// 把*2的stage/access掩码转换为旧的掩码；没有对应位的新stage退化为ALL_COMMANDS，新access退化为MEMORY_READ/WRITE
+// 空的stage在source一侧对应TOP_OF_PIPE，在destination一侧对应BOTTOM_OF_PIPE
+VkPipelineStageFlags legacyStageMask(VkPipelineStageFlags2 stageMask, bool source);
+VkAccessFlags legacyAccessMask(VkAccessFlags2 accessMask);
+
+// 覆盖aspectMask的所有mip与layer，需要其他范围时由调用方修改subresourceRange
+VkImageMemoryBarrier2 makeImageBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess,
+    VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+    VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT);
@@ -0,0 +1,278 @@
+#include "texture_residency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+uint32_t TextureResidency::mipForScreenSize(uint32_t width, uint32_t height, uint32_t mipLevels, float screenPixels)
+{
+    if (mipLevels == 0)
+    {
+        return 0;
+    }
+    if (screenPixels <= 1.0f)
+    {
+        return mipLevels - 1;
+    }
+    // 第level级的边长为size >> level，取仍不小于屏幕尺寸的最粗一级
+    float size = static_cast<float>(std::max(width, height));
+    float level = std::floor(std::log2(size / screenPixels));
+    if (level <= 0.0f)
+    {
+        return 0;
+    }
+    return std::min(static_cast<uint32_t>(level), mipLevels - 1);
+}
+
+uint32_t TextureResidency::addTexture(uint32_t width, uint32_t height, const std::vector<uint64_t> &mipSizes)
+{
+    Texture texture;
+    texture.alive = true;
+    texture.width = width;
+    texture.height = height;
+    texture.mipSizes = mipSizes;
+    uint32_t levels = static_cast<uint32_t>(mipSizes.size());
+    texture.residentTop = levels;
+
+    // 尾部：边长不超过tailSize的mip，至少包含最粗的一级
+    texture.tailTop = levels > 0 ? levels - 1 : 0;
+    for (uint32_t level = 0; level < levels; level++)
+    {
+        if (std::max(width >> level, height >> level) <= config.tailSize)
+        {
+            texture.tailTop = level;
+            break;
+        }
+    }
+    texture.requestedTop = texture.tailTop;
+
+    if (!freeSlots.empty())
+    {
+        uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        textures[slot] = texture;
+        return slot;
+    }
+    textures.push_back(texture);
+    return static_cast<uint32_t>(textures.size() - 1);
+}
+
+void TextureResidency::removeTexture(uint32_t texture)
+{
+    totalResident -= residentBytes(texture);
+    textures[texture] = Texture{};
+    freeSlots.push_back(texture);
+}
+
+void TextureResidency::requestScreenSize(uint32_t texture, float screenPixels, uint64_t frame)
+{
+    Texture &entry = textures[texture];
+    if (!entry.everRequested || entry.lastRequestFrame != frame)
+    {
+        entry.requestedPixels = 0.0f;
+    }
+    entry.requestedPixels = std::max(entry.requestedPixels, screenPixels);
+    uint32_t levels = static_cast<uint32_t>(entry.mipSizes.size());
+    entry.requestedTop = std::min(mipForScreenSize(entry.width, entry.height, levels, entry.requestedPixels), entry.tailTop);
+    entry.lastRequestFrame = frame;
+    entry.everRequested = true;
+}
+
+uint64_t TextureResidency::residentBytes(uint32_t texture) const
+{
+    const Texture &entry = textures[texture];
+    return bytesBetween(entry, entry.residentTop, static_cast<uint32_t>(entry.mipSizes.size()));
+}
+
+uint64_t TextureResidency::bytesBetween(const Texture &texture, uint32_t fromTop, uint32_t toTop) const
+{
+    uint64_t bytes = 0;
+    for (uint32_t level = fromTop; level < toTop; level++)
+    {
+        bytes += texture.mipSizes[level];
+    }
+    return bytes;
+}
+
+bool TextureResidency::victimClass(const Texture &entry, uint64_t frame, bool force, int &victimClass) const
+{
+    if (!entry.alive || entry.residentTop >= entry.tailTop)
+    {
+        return false;
+    }
+    if (!force && frame < entry.lastChangeFrame + config.minResidentFrames)
+    {
+        return false;
+    }
+
+    // 长时间没被请求的纹理 > 常驻比需要更精细的纹理 > (仅force时)正在使用的纹理
+    bool idle = !entry.everRequested || frame >= entry.lastRequestFrame + config.idleFrames;
+    bool overResident = entry.residentTop < entry.requestedTop;
+    victimClass = idle ? 2 : (overResident ? 1 : 0);
+    return victimClass > 0 || force;
+}
+
+uint32_t TextureResidency::findVictim(uint64_t frame, uint32_t exclude, bool force) const
+{
+    // 类别高的先换出，同类里最久没被请求的先换出
+    uint32_t best = UINT32_MAX;
+    int bestClass = 0;
+    uint64_t bestFrame = UINT64_MAX;
+    for (uint32_t i = 0; i < textures.size(); i++)
+    {
+        int currentClass;
+        if (i == exclude || !victimClass(textures[i], frame, force, currentClass))
+        {
+            continue;
+        }
+        const Texture &entry = textures[i];
+        if (best == UINT32_MAX || currentClass > bestClass || (currentClass == bestClass && entry.lastRequestFrame < bestFrame))
+        {
+            best = i;
+            bestClass = currentClass;
+            bestFrame = entry.lastRequestFrame;
+        }
+    }
+    return best;
+}
+
+uint64_t TextureResidency::evictableBytes(uint64_t frame, uint32_t exclude, bool force) const
+{
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < textures.size(); i++)
+    {
+        int currentClass;
+        if (i != exclude && victimClass(textures[i], frame, force, currentClass))
+        {
+            bytes += bytesBetween(textures[i], textures[i].residentTop, textures[i].tailTop);
+        }
+    }
+    return bytes;
+}
+
+void TextureResidency::evictOne(uint32_t texture, Plan &plan)
+{
+    Texture &entry = textures[texture];
+    uint64_t bytes = entry.mipSizes[entry.residentTop];
+    entry.residentTop++;
+    totalResident -= bytes;
+    plan.evictedBytes += bytes;
+}
+
+TextureResidency::Plan TextureResidency::plan(uint64_t frame, uint64_t budgetBytes, uint64_t uploadBudget, uint64_t perFrameUploadLimit)
+{
+    Plan result;
+    std::map<uint32_t, uint32_t> originalTops;
+    auto remember = [&](uint32_t texture) { originalTops.emplace(texture, textures[texture].residentTop); };
+
+    // 1. 预算变小(比如其他程序占用了显存)时先换出，直到回到预算以内
+    while (totalResident > budgetBytes)
+    {
+        uint32_t victim = findVictim(frame, UINT32_MAX, true);
+        if (victim == UINT32_MAX)
+        {
+            break;
+        }
+        remember(victim);
+        evictOne(victim, result);
+    }
+
+    // 2. 候选：新纹理的尾部最优先，其次是缺的级别最多、屏幕上最大的纹理
+    struct Candidate
+    {
+        uint32_t texture;
+        bool newTexture;
+        uint32_t missingLevels;
+        float pixels;
+    };
+    std::vector<Candidate> candidates;
+    for (uint32_t i = 0; i < textures.size(); i++)
+    {
+        const Texture &entry = textures[i];
+        if (!entry.alive)
+        {
+            continue;
+        }
+        uint32_t levels = static_cast<uint32_t>(entry.mipSizes.size());
+        bool newTexture = entry.residentTop == levels;
+        bool recentlyRequested = entry.everRequested && frame < entry.lastRequestFrame + config.idleFrames;
+        uint32_t wanted = newTexture ? entry.tailTop : entry.requestedTop;
+        if (entry.residentTop > wanted && (newTexture || recentlyRequested))
+        {
+            candidates.push_back({i, newTexture, entry.residentTop - wanted, entry.requestedPixels});
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+        if (a.newTexture != b.newTexture)
+            return a.newTexture;
+        if (a.missingLevels != b.missingLevels)
+            return a.missingLevels > b.missingLevels;
+        return a.pixels > b.pixels;
+    });
+
+    uint64_t uploaded = 0;
+    for (const Candidate &candidate : candidates)
+    {
+        Texture &entry = textures[candidate.texture];
+        uint32_t wanted = candidate.newTexture ? entry.tailTop : entry.requestedTop;
+        uint32_t levels = static_cast<uint32_t>(entry.mipSizes.size());
+
+        // 从粗到细一级一级地调入，任何一项预算不够就停在当前级别
+        uint32_t top = entry.residentTop;
+        while (top > wanted)
+        {
+            // 新纹理一次上传整个尾部，尾部之上的级别逐级计算
+            uint32_t nextTop = top == levels ? entry.tailTop : top - 1;
+            uint64_t cost = bytesBetween(entry, nextTop, top);
+            if (uploaded + cost > uploadBudget)
+            {
+                break;
+            }
+            // 单帧上限只约束非尾部数据；本帧还没上传过任何东西时允许一级超过上限的大mip
+            if (!candidate.newTexture && uploaded + cost > perFrameUploadLimit && uploaded > 0)
+            {
+                break;
+            }
+
+            // 先确认能腾出足够空间再换出，否则换出了也放不下，只会白白来回调度
+            if (totalResident + cost > budgetBytes &&
+                totalResident + cost - budgetBytes > evictableBytes(frame, candidate.texture, candidate.newTexture))
+            {
+                break;
+            }
+            while (totalResident + cost > budgetBytes)
+            {
+                uint32_t victim = findVictim(frame, candidate.texture, candidate.newTexture);
+                remember(victim);
+                evictOne(victim, result);
+            }
+
+            remember(candidate.texture);
+            top = nextTop;
+            entry.residentTop = top;
+            totalResident += cost;
+            uploaded += cost;
+        }
+    }
+    result.uploadBytes = uploaded;
+
+    for (const auto &original : originalTops)
+    {
+        Texture &entry = textures[original.first];
+        if (entry.residentTop != original.second)
+        {
+            entry.lastChangeFrame = frame;
+            result.changes.push_back({original.first, original.second, entry.residentTop});
+        }
+    }
+    return result;
+}
+
+void TextureResidency::setResidentTop(uint32_t texture, uint32_t topMip, uint64_t frame)
+{
+    Texture &entry = textures[texture];
+    totalResident -= residentBytes(texture);
+    entry.residentTop = topMip;
+    entry.lastChangeFrame = frame;
+    totalResident += residentBytes(texture);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// 纹理mip常驻策略，不依赖Vulkan，只处理"每张纹理最精细的常驻mip是哪一级"
+// 约定：mip 0最精细；topMip为最精细的常驻级别，topMip..mipLevels-1全部常驻，topMip == mipLevels表示什么都没有
+class TextureResidency
+{
+public:
+    struct Config
+    {
+        // 不超过该尺寸(像素)的mip总是常驻，纹理加入时先上传这些
+        uint32_t tailSize = 64;
+        // mip被调入后至少保留这么多帧才允许在预算压力下被换出，避免反复调入调出
+        uint32_t minResidentFrames = 60;
+        // 超过这么多帧没有被请求的纹理优先被换出
+        uint32_t idleFrames = 30;
+    };
+
+    struct Change
+    {
+        uint32_t texture;
+        uint32_t oldTopMip;
+        uint32_t newTopMip;
+    };
+
+    struct Plan
+    {
+        std::vector<Change> changes;
+        uint64_t uploadBytes = 0;
+        uint64_t evictedBytes = 0;
+    };
+
+    void setConfig(const Config &newConfig) { config = newConfig; }
+
+    // mipSizes[i]为第i级mip占用的字节数，返回纹理编号
+    uint32_t addTexture(uint32_t width, uint32_t height, const std::vector<uint64_t> &mipSizes);
+    void removeTexture(uint32_t texture);
+
+    // 记录纹理本帧在屏幕上的最大边长(像素)，同一帧多次请求取最大值
+    void requestScreenSize(uint32_t texture, float screenPixels, uint64_t frame);
+
+    // 计算本帧的调入/换出
+    // budgetBytes为所有纹理常驻数据的上限，uploadBudget为本帧staging还能提供的字节数
+    // 新纹理的低分辨率尾部不受uploadBudget中的单帧上限约束，保证尽快可用
+    Plan plan(uint64_t frame, uint64_t budgetBytes, uint64_t uploadBudget, uint64_t perFrameUploadLimit);
+
+    // 上传未能全部完成时由调用方修正实际的常驻级别
+    void setResidentTop(uint32_t texture, uint32_t topMip, uint64_t frame);
+
+    uint32_t residentTop(uint32_t texture) const { return textures[texture].residentTop; }
+    uint32_t requestedTop(uint32_t texture) const { return textures[texture].requestedTop; }
+    uint32_t tailTop(uint32_t texture) const { return textures[texture].tailTop; }
+    uint32_t mipLevels(uint32_t texture) const { return static_cast<uint32_t>(textures[texture].mipSizes.size()); }
+    uint64_t residentBytes() const { return totalResident; }
+    uint64_t residentBytes(uint32_t texture) const;
+
+    // 屏幕上最大边长为screenPixels时需要的最精细mip
+    static uint32_t mipForScreenSize(uint32_t width, uint32_t height, uint32_t mipLevels, float screenPixels);
+
+private:
+    struct Texture
+    {
+        bool alive = false;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint64_t> mipSizes;
+        uint32_t residentTop = 0;
+        uint32_t tailTop = 0;
+        uint32_t requestedTop = 0;
+        float requestedPixels = 0.0f;
+        uint64_t lastRequestFrame = 0;
+        bool everRequested = false;
+        uint64_t lastChangeFrame = 0;
+    };
+
+    uint64_t bytesBetween(const Texture &texture, uint32_t fromTop, uint32_t toTop) const;
+    // 纹理能否被换出一级mip，能时给出优先级类别(越大越先换出)
+    bool victimClass(const Texture &entry, uint64_t frame, bool force, int &victimClass) const;
+    // 挑一个可以换出一级mip的纹理，找不到返回UINT32_MAX
+    uint32_t findVictim(uint64_t frame, uint32_t exclude, bool force) const;
+    // 当前可以换出的总字节数，用来在真正换出之前判断能否腾出足够空间
+    uint64_t evictableBytes(uint64_t frame, uint32_t exclude, bool force) const;
+    void evictOne(uint32_t texture, Plan &plan);
+
+    Config config;
+    std::vector<Texture> textures;
+    std::vector<uint32_t> freeSlots;
+    uint64_t totalResident = 0;
+};
@@ -0,0 +1,123 @@
+#include "texture_source.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include "ktx2_file.h"
+#include "log.h"
+#include "mapped_file.h"
+#include "texture_transcoder.h"
+
+namespace
+{
+    class CheckerboardTextureSource : public TextureSource
+    {
+    public:
+        explicit CheckerboardTextureSource(uint32_t size) : size(size)
+        {
+            levels = 1;
+            while ((size >> levels) > 0)
+            {
+                levels++;
+            }
+        }
+
+        VkFormat format() const override { return VK_FORMAT_R8G8B8A8_SRGB; }
+        uint32_t width() const override { return size; }
+        uint32_t height() const override { return size; }
+        uint32_t mipLevels() const override { return levels; }
+
+        VkDeviceSize mipSize(uint32_t level) const override
+        {
+            VkDeviceSize extent = std::max(size >> level, 1u);
+            return extent * extent * 4;
+        }
+
+        void readMip(uint32_t level, void *destination) const override
+        {
+            // 每级的格子在纹理空间中大小相同(8x8个)，颜色按级别循环
+            static const uint8_t tints[][3] = {
+                {255, 255, 255}, {255, 96, 96}, {96, 255, 96}, {96, 96, 255},
+                {255, 255, 96}, {255, 96, 255}, {96, 255, 255},
+            };
+            const uint8_t *tint = tints[level % (sizeof(tints) / sizeof(tints[0]))];
+
+            uint32_t extent = std::max(size >> level, 1u);
+            uint32_t cell = std::max(extent / 8, 1u);
+            uint8_t *pixel = static_cast<uint8_t *>(destination);
+            for (uint32_t y = 0; y < extent; y++)
+            {
+                for (uint32_t x = 0; x < extent; x++)
+                {
+                    bool dark = ((x / cell) + (y / cell)) % 2 == 1;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        pixel[c] = dark ? static_cast<uint8_t>(tint[c] / 4) : tint[c];
+                    }
+                    pixel[3] = 255;
+                    pixel += 4;
+                }
+            }
+        }
+
+    private:
+        uint32_t size;
+        uint32_t levels;
+    };
+
+    class Ktx2TextureSource : public TextureSource
+    {
+    public:
+        Ktx2TextureSource(const std::string &path, const std::function<bool(VkFormat)> &isSupported) : file(path)
+        {
+            ktx = Ktx2File::parse(file.data(), file.size());
+            bool opaque = !ktx.hasAlpha;
+            if (ktx.encoding == Ktx2File::Encoding::Native && (ktx.vkFormat == VK_FORMAT_R8G8B8A8_UNORM || ktx.vkFormat == VK_FORMAT_R8G8B8A8_SRGB))
+            {
+                // 未压缩数据按实际像素判断，很多工具总是写出带alpha通道的RGBA
+                if (ktx.levels[0].byteLength < static_cast<uint64_t>(ktx.pixelWidth) * ktx.pixelHeight * 4)
+                {
+                    throw std::runtime_error("=====KTX2 level 0 is smaller than expected!=====");
+                }
+                opaque = isOpaqueRgba8(file.data() + ktx.levels[0].byteOffset, ktx.pixelWidth, ktx.pixelHeight);
+            }
+            target = chooseTranscodeTarget(ktx, opaque, isSupported);
+            targetFormat = transcodeTargetFormat(target, ktx);
+
+            logStream(LogLevel::Info) << "Texture " << path << ": " << ktx.pixelWidth << "x" << ktx.pixelHeight
+                                      << ", " << ktx.levels.size() << " mips, " << transcodeTargetName(target) << std::endl;
+        }
+
+        VkFormat format() const override { return targetFormat; }
+        uint32_t width() const override { return ktx.pixelWidth; }
+        uint32_t height() const override { return ktx.pixelHeight; }
+        uint32_t mipLevels() const override { return static_cast<uint32_t>(ktx.levels.size()); }
+
+        VkDeviceSize mipSize(uint32_t level) const override
+        {
+            return formatLevelSize(targetFormat, std::max(ktx.pixelWidth >> level, 1u), std::max(ktx.pixelHeight >> level, 1u));
+        }
+
+        void readMip(uint32_t level, void *destination) const override
+        {
+            transcodeLevel(ktx, file.data(), file.size(), level, target, destination);
+        }
+
+    private:
+        MappedFile file;
+        Ktx2File ktx;
+        TranscodeTarget target = TranscodeTarget::Native;
+        VkFormat targetFormat = VK_FORMAT_UNDEFINED;
+    };
+}
+
+std::unique_ptr<TextureSource> createCheckerboardTexture(uint32_t size)
+{
+    return std::make_unique<CheckerboardTextureSource>(size);
+}
+
+std::unique_ptr<TextureSource> createKtx2Texture(const std::string &path, const std::function<bool(VkFormat)> &isSupported)
+{
+    return std::make_unique<Ktx2TextureSource>(path, isSupported);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+// 纹理数据的来源，流式加载时按mip级别读取，数据必须是紧密排列的，可以直接vkCmdCopyBufferToImage
+class TextureSource
+{
+public:
+    virtual ~TextureSource() = default;
+
+    virtual VkFormat format() const = 0;
+    virtual uint32_t width() const = 0;
+    virtual uint32_t height() const = 0;
+    virtual uint32_t mipLevels() const = 0;
+    virtual VkDeviceSize mipSize(uint32_t level) const = 0;
+    // 把第level级mip写入destination，destination至少有mipSize(level)字节
+    virtual void readMip(uint32_t level, void *destination) const = 0;
+};
+
+// 程序生成的RGBA8棋盘格纹理，每一级mip的颜色不同，可以直接看出当前常驻的是哪一级
+std::unique_ptr<TextureSource> createCheckerboardTexture(uint32_t size);
+
+// 从KTX2文件创建纹理，文件保持内存映射，按mip读取时才转码
+// isSupported判断设备能否采样某个格式，用来在BC7/ASTC/ETC2/BC1/RGBA8之间选择目标
+std::unique_ptr<TextureSource> createKtx2Texture(const std::string &path, const std::function<bool(VkFormat)> &isSupported);
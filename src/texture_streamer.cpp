@@ -0,0 +1,362 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "api_call_counter.h"
+
+namespace
+{
+    // 每隔多少帧重新查询一次VK_EXT_memory_budget
+    const uint64_t budgetQueryInterval = 30;
+    // 可用显存中留给其他资源的比例
+    const double budgetHeadroom = 0.2;
+    // staging中每级mip的偏移对齐，覆盖所有格式的texel block大小
+    const VkDeviceSize stagingAlignment = 16;
+
+    VkExtent3D mipExtent(const TextureSource &source, uint32_t level)
+    {
+        return {std::max(source.width() >> level, 1u), std::max(source.height() >> level, 1u), 1};
+    }
+
+    void imageBarrier(const Synchronization2 &synchronization, VkCommandBuffer commandBuffer, VkImage image, uint32_t levelCount,
+        VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess,
+        VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+    {
+        VkImageMemoryBarrier2 barrier = makeImageBarrier(image, oldLayout, newLayout, srcStage, srcAccess, dstStage, dstAccess);
+        barrier.subresourceRange.levelCount = levelCount;
+        barrier.subresourceRange.layerCount = 1;
+        synchronization.imageBarrier(commandBuffer, barrier);
+    }
+}
+
+void TextureStreamer::create(VkPhysicalDevice physicalDevice, VkDevice device, const Synchronization2 &synchronization, bool memoryBudgetEnabled,
+    uint32_t frameSlots, const Config &config)
+{
+    this->physicalDevice = physicalDevice;
+    this->device = device;
+    this->synchronization = &synchronization;
+    this->memoryBudgetEnabled = memoryBudgetEnabled;
+    this->config = config;
+    residency.setConfig(config.residency);
+    retired.assign(frameSlots, {});
+
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    //预算按最大的DEVICE_LOCAL heap计算
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+    {
+        if ((memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) &&
+            memoryProperties.memoryHeaps[i].size > memoryProperties.memoryHeaps[budgetHeap].size)
+        {
+            budgetHeap = i;
+        }
+    }
+
+    stagingRing.create(device, memoryProperties, config.stagingSize, frameSlots);
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.minLod = 0.0f;
+    //image只包含常驻的mip，采样器不限制LOD
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create texture sampler!=====");
+    }
+
+    updateBudget();
+}
+
+void TextureStreamer::destroy()
+{
+    if (device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    for (auto &slot : retired)
+    {
+        for (const auto &image : slot)
+        {
+            vkDestroyImageView(device, image.view, nullptr);
+            vkDestroyImage(device, image.image, nullptr);
+            vkFreeMemory(device, image.memory, nullptr);
+        }
+        slot.clear();
+    }
+    for (auto &texture : textures)
+    {
+        vkDestroyImageView(device, texture.view, nullptr);
+        vkDestroyImage(device, texture.image, nullptr);
+        vkFreeMemory(device, texture.memory, nullptr);
+    }
+    textures.clear();
+    vkDestroySampler(device, textureSampler, nullptr);
+    stagingRing.destroy();
+    device = VK_NULL_HANDLE;
+}
+
+uint32_t TextureStreamer::addTexture(std::unique_ptr<TextureSource> source)
+{
+    std::vector<uint64_t> mipSizes;
+    for (uint32_t level = 0; level < source->mipLevels(); level++)
+    {
+        mipSizes.push_back(source->mipSize(level));
+    }
+    uint32_t texture = residency.addTexture(source->width(), source->height(), mipSizes);
+    if (texture >= textures.size())
+    {
+        textures.resize(texture + 1);
+    }
+    textures[texture] = GpuTexture{};
+    textures[texture].topMip = source->mipLevels();
+    textures[texture].source = std::move(source);
+    return texture;
+}
+
+void TextureStreamer::requestScreenSize(uint32_t texture, float screenPixels)
+{
+    residency.requestScreenSize(texture, screenPixels, frame);
+}
+
+void TextureStreamer::updateBudget()
+{
+    const VkMemoryHeap &heap = memoryProperties.memoryHeaps[budgetHeap];
+    if (!memoryBudgetEnabled)
+    {
+        budgetBytes = config.budgetBytes > 0 ? config.budgetBytes : heap.size / 4;
+        frameStats.budgetFromExtension = false;
+        return;
+    }
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+    memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memoryProperties2.pNext = &budgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties2);
+
+    //heapUsage包含本模块自己的分配，先扣掉，得到留给纹理的部分
+    VkDeviceSize heapBudget = budgetProperties.heapBudget[budgetHeap];
+    VkDeviceSize otherUsage = budgetProperties.heapUsage[budgetHeap] - std::min(budgetProperties.heapUsage[budgetHeap], allocatedBytes);
+    VkDeviceSize available = heapBudget > otherUsage ? heapBudget - otherUsage : 0;
+    VkDeviceSize allowed = static_cast<VkDeviceSize>(available * (1.0 - budgetHeadroom));
+    budgetBytes = config.budgetBytes > 0 ? std::min(config.budgetBytes, allowed) : allowed;
+    frameStats.budgetFromExtension = true;
+}
+
+uint32_t TextureStreamer::findDeviceLocalMemoryType(uint32_t typeFilter) const
+{
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    {
+        if ((typeFilter & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+        {
+            return i;
+        }
+    }
+    throw std::runtime_error("=====Failed to find texture memory type!=====");
+}
+
+void TextureStreamer::recordUpdates(VkCommandBuffer commandBuffer, uint32_t frameSlot, LinearArena &scratch)
+{
+    //这个slot上一轮的提交已经完成，可以回收staging与旧image
+    stagingRing.beginFrame(frameSlot);
+    for (const auto &image : retired[frameSlot])
+    {
+        vkDestroyImageView(device, image.view, nullptr);
+        vkDestroyImage(device, image.image, nullptr);
+        vkFreeMemory(device, image.memory, nullptr);
+        allocatedBytes -= image.allocationSize;
+    }
+    retired[frameSlot].clear();
+
+    if (frame % budgetQueryInterval == 0)
+    {
+        updateBudget();
+    }
+
+    VkDeviceSize uploadBudget = stagingRing.largestFreeBlock();
+    TextureResidency::Plan plan = residency.plan(frame, budgetBytes, uploadBudget, config.uploadBytesPerFrame);
+
+    frameStats.uploadedBytes = 0;
+    for (const auto &change : plan.changes)
+    {
+        uint32_t reached = applyChange(commandBuffer, frameSlot, change.texture, change.newTopMip, scratch);
+        if (reached != change.newTopMip)
+        {
+            residency.setResidentTop(change.texture, reached, frame);
+        }
+    }
+
+    stagingRing.endFrame(frameSlot);
+    frameStats.evictedBytes = plan.evictedBytes;
+    frameStats.residentBytes = residency.residentBytes();
+    frameStats.budgetBytes = budgetBytes;
+    frame++;
+}
+
+uint32_t TextureStreamer::applyChange(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint32_t texture, uint32_t newTop, LinearArena &scratch)
+{
+    GpuTexture &gpu = textures[texture];
+    const TextureSource &source = *gpu.source;
+    uint32_t levels = source.mipLevels();
+    uint32_t oldTop = gpu.topMip;
+
+    //先从粗到细申请staging并读入数据，staging不够时停在已经拿到空间的级别
+    struct PendingUpload
+    {
+        uint32_t level;
+        VkDeviceSize offset;
+    };
+    ArenaVector<PendingUpload> uploads{ArenaAllocator<PendingUpload>(scratch)};
+    uploads.reserve(levels);
+    uint32_t reachedTop = newTop;
+    for (uint32_t level = std::min(oldTop, levels); level-- > newTop;)
+    {
+        StagingRing::Allocation allocation;
+        if (!stagingRing.allocate(source.mipSize(level), stagingAlignment, allocation))
+        {
+            reachedTop = level + 1;
+            break;
+        }
+        source.readMip(level, allocation.data);
+        uploads.push_back({level, allocation.offset});
+        frameStats.uploadedBytes += source.mipSize(level);
+    }
+    if (reachedTop == oldTop || reachedTop >= levels)
+    {
+        return oldTop;
+    }
+
+    //新image只包含reachedTop..levels-1
+    VkExtent3D extent = mipExtent(source, reachedTop);
+    uint32_t newLevels = levels - reachedTop;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = extent;
+    imageInfo.mipLevels = newLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = source.format();
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkImage image;
+    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create texture image!=====");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findDeviceLocalMemoryType(memRequirements.memoryTypeBits);
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to allocate texture memory!=====");
+    }
+    vkBindImageMemory(device, image, memory, 0);
+    allocatedBytes += memRequirements.size;
+
+    imageBarrier(*synchronization, commandBuffer, image, newLevels,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE,
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+    //两张image都有的级别直接在GPU上复制
+    if (gpu.image != VK_NULL_HANDLE)
+    {
+        //等之前的帧采样完，再把旧image转为复制源
+        imageBarrier(*synchronization, commandBuffer, gpu.image, levels - oldTop,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_NONE,
+            VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+
+        ArenaVector<VkImageCopy> copies{ArenaAllocator<VkImageCopy>(scratch)};
+        copies.reserve(levels);
+        for (uint32_t level = std::max(oldTop, reachedTop); level < levels; level++)
+        {
+            VkImageCopy copy{};
+            copy.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - oldTop, 0, 1};
+            copy.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - reachedTop, 0, 1};
+            copy.extent = mipExtent(source, level);
+            copies.push_back(copy);
+        }
+        vkCmdCopyImage(commandBuffer, gpu.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(copies.size()), copies.data());
+        countApiCall(ApiCall::Copy);
+    }
+
+    //新增的级别从staging上传，所有级别一次提交
+    if (!uploads.empty())
+    {
+        ArenaVector<VkBufferImageCopy> regions{ArenaAllocator<VkBufferImageCopy>(scratch)};
+        regions.reserve(uploads.size());
+        for (const auto &upload : uploads)
+        {
+            if (upload.level < reachedTop)
+            {
+                continue;
+            }
+            VkBufferImageCopy region{};
+            region.bufferOffset = upload.offset;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, upload.level - reachedTop, 0, 1};
+            region.imageOffset = {0, 0, 0};
+            region.imageExtent = mipExtent(source, upload.level);
+            regions.push_back(region);
+        }
+        vkCmdCopyBufferToImage(commandBuffer, stagingRing.buffer(), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(regions.size()), regions.data());
+        countApiCall(ApiCall::Copy);
+    }
+
+    imageBarrier(*synchronization, commandBuffer, image, newLevels,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = source.format();
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = newLevels;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    VkImageView view;
+    if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS)
+    {
+        throw std::runtime_error("=====Failed to create texture image view!=====");
+    }
+
+    if (gpu.image != VK_NULL_HANDLE)
+    {
+        retired[frameSlot].push_back({gpu.image, gpu.memory, gpu.view, gpu.allocationSize});
+    }
+    gpu.image = image;
+    gpu.memory = memory;
+    gpu.view = view;
+    gpu.allocationSize = memRequirements.size;
+    gpu.topMip = reachedTop;
+    return reachedTop;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "frame_arena.h"
+#include "staging_ring.h"
+#include "synchronization2.h"
+#include "texture_residency.h"
+#include "texture_source.h"
+
+// 纹理流式加载：加入时只上传低分辨率的尾部mip，之后按屏幕尺寸逐级调入更精细的mip，
+// 超出显存预算时按TextureResidency的策略换出
+// 不使用sparse binding：常驻级别改变时重新分配一张只包含常驻mip的image，
+// 已常驻的级别在GPU上直接复制，只有新增的级别经staging ring上传
+class TextureStreamer
+{
+public:
+    struct Config
+    {
+        // 纹理常驻数据的上限，0表示自动：有VK_EXT_memory_budget时按当前可用显存计算，否则取显存heap的1/4
+        VkDeviceSize budgetBytes = 0;
+        VkDeviceSize stagingSize = 64ull * 1024 * 1024;
+        // 每帧最多上传的字节数，限制单帧的上传耗时
+        VkDeviceSize uploadBytesPerFrame = 16ull * 1024 * 1024;
+        TextureResidency::Config residency;
+    };
+
+    struct Stats
+    {
+        VkDeviceSize residentBytes = 0;
+        VkDeviceSize budgetBytes = 0;
+        VkDeviceSize uploadedBytes = 0; // 上一帧
+        VkDeviceSize evictedBytes = 0;  // 上一帧
+        bool budgetFromExtension = false;
+    };
+
+    // synchronization需要在destroy之前一直有效
+    void create(VkPhysicalDevice physicalDevice, VkDevice device, const Synchronization2 &synchronization, bool memoryBudgetEnabled,
+        uint32_t frameSlots, const Config &config);
+    void destroy();
+
+    uint32_t addTexture(std::unique_ptr<TextureSource> source);
+    // 本帧该纹理在屏幕上的最大边长(像素)，决定需要的mip级别
+    void requestScreenSize(uint32_t texture, float screenPixels);
+
+    // 在frameSlot的fence等待之后、render pass之外录制，执行本帧的调入/换出
+    // 结束后纹理处于SHADER_READ_ONLY_OPTIMAL；临时数组从scratch分配
+    void recordUpdates(VkCommandBuffer commandBuffer, uint32_t frameSlot, LinearArena &scratch);
+
+    // 至少录制过一次recordUpdates之后才有效，之前返回VK_NULL_HANDLE
+    VkImageView imageView(uint32_t texture) const { return textures[texture].view; }
+    VkSampler sampler() const { return textureSampler; }
+    const Stats &stats() const { return frameStats; }
+
+private:
+    struct GpuTexture
+    {
+        std::unique_ptr<TextureSource> source;
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkDeviceSize allocationSize = 0;
+        // GPU上image的mip 0对应源数据的第topMip级
+        uint32_t topMip = 0;
+    };
+
+    struct RetiredImage
+    {
+        VkImage image;
+        VkDeviceMemory memory;
+        VkImageView view;
+        VkDeviceSize allocationSize;
+    };
+
+    // 返回实际达到的常驻级别(staging不足时可能比newTop粗)
+    uint32_t applyChange(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint32_t texture, uint32_t newTop, LinearArena &scratch);
+    void updateBudget();
+    uint32_t findDeviceLocalMemoryType(uint32_t typeFilter) const;
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    const Synchronization2 *synchronization = nullptr;
+    bool memoryBudgetEnabled = false;
+    Config config;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    uint32_t budgetHeap = 0;
+
+    StagingRing stagingRing;
+    TextureResidency residency;
+    VkSampler textureSampler = VK_NULL_HANDLE;
+    std::vector<GpuTexture> textures;
+    // 被替换的image要等使用它的帧完成后才能销毁，按frame slot延迟
+    std::vector<std::vector<RetiredImage>> retired;
+    // 本模块所有image占用的显存，包括还没销毁的旧image
+    VkDeviceSize allocatedBytes = 0;
+    VkDeviceSize budgetBytes = 0;
+    uint64_t frame = 0;
+    Stats frameStats;
+};
@@ -0,0 +1,362 @@
+#include "texture_transcoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef KUTORY_WITH_BASISU
+#include <basisu_transcoder.h>
+#endif
+
+namespace
+{
+    struct Rgb
+    {
+        int r, g, b;
+    };
+
+    uint16_t toRgb565(const Rgb &color)
+    {
+        return static_cast<uint16_t>(((color.r * 31 + 127) / 255) << 11 | ((color.g * 63 + 127) / 255) << 5 | ((color.b * 31 + 127) / 255));
+    }
+
+    Rgb fromRgb565(uint16_t value)
+    {
+        int r = (value >> 11) & 31;
+        int g = (value >> 5) & 63;
+        int b = value & 31;
+        return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+    }
+
+    int distanceSquared(const Rgb &a, const Rgb &b)
+    {
+        int dr = a.r - b.r, dg = a.g - b.g, db = a.b - b.b;
+        return dr * dr + dg * dg + db * db;
+    }
+
+    // 单个4x4 block：沿亮度方向取两端颜色作为端点，再为每个像素选最近的调色板项
+    void encodeBc1Block(const Rgb pixels[16], uint8_t *block)
+    {
+        int minIndex = 0, maxIndex = 0;
+        int minLuma = INT32_MAX, maxLuma = -1;
+        for (int i = 0; i < 16; i++)
+        {
+            int luma = pixels[i].r * 2 + pixels[i].g * 4 + pixels[i].b;
+            if (luma < minLuma)
+            {
+                minLuma = luma;
+                minIndex = i;
+            }
+            if (luma > maxLuma)
+            {
+                maxLuma = luma;
+                maxIndex = i;
+            }
+        }
+
+        uint16_t color0 = toRgb565(pixels[maxIndex]);
+        uint16_t color1 = toRgb565(pixels[minIndex]);
+        uint32_t indices = 0;
+        if (color0 < color1)
+        {
+            std::swap(color0, color1);
+        }
+        if (color0 != color1)
+        {
+            // color0 > color1时为四色模式，两个插值色分别在1/3与2/3处
+            Rgb palette[4];
+            palette[0] = fromRgb565(color0);
+            palette[1] = fromRgb565(color1);
+            palette[2] = {(2 * palette[0].r + palette[1].r) / 3, (2 * palette[0].g + palette[1].g) / 3, (2 * palette[0].b + palette[1].b) / 3};
+            palette[3] = {(palette[0].r + 2 * palette[1].r) / 3, (palette[0].g + 2 * palette[1].g) / 3, (palette[0].b + 2 * palette[1].b) / 3};
+            for (int i = 0; i < 16; i++)
+            {
+                uint32_t best = 0;
+                int bestDistance = INT32_MAX;
+                for (uint32_t p = 0; p < 4; p++)
+                {
+                    int distance = distanceSquared(pixels[i], palette[p]);
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        best = p;
+                    }
+                }
+                indices |= best << (i * 2);
+            }
+        }
+
+        block[0] = static_cast<uint8_t>(color0 & 0xFF);
+        block[1] = static_cast<uint8_t>(color0 >> 8);
+        block[2] = static_cast<uint8_t>(color1 & 0xFF);
+        block[3] = static_cast<uint8_t>(color1 >> 8);
+        for (int i = 0; i < 4; i++)
+        {
+            block[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+        }
+    }
+
+    bool isBasisEncoding(const Ktx2File &file)
+    {
+        return file.encoding == Ktx2File::Encoding::Etc1s || file.encoding == Ktx2File::Encoding::Uastc;
+    }
+
+    bool isRgba8(VkFormat format)
+    {
+        return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+    }
+
+#ifdef KUTORY_WITH_BASISU
+    basist::transcoder_texture_format toBasisFormat(TranscodeTarget target)
+    {
+        switch (target)
+        {
+        case TranscodeTarget::BC7:
+            return basist::transcoder_texture_format::cTFBC7_RGBA;
+        case TranscodeTarget::BC1:
+            return basist::transcoder_texture_format::cTFBC1_RGB;
+        case TranscodeTarget::ETC2:
+            return basist::transcoder_texture_format::cTFETC2_RGBA;
+        case TranscodeTarget::ASTC4x4:
+            return basist::transcoder_texture_format::cTFASTC_4x4_RGBA;
+        default:
+            return basist::transcoder_texture_format::cTFRGBA32;
+        }
+    }
+
+    void transcodeBasisLevel(const Ktx2File &file, const uint8_t *fileData, size_t fileSize, uint32_t level, TranscodeTarget target, void *destination)
+    {
+        static std::once_flag initialized;
+        std::call_once(initialized, [] { basist::basisu_transcoder_init(); });
+
+        // ktx2_transcoder只引用文件数据，不拷贝
+        basist::ktx2_transcoder transcoder;
+        if (!transcoder.init(fileData, static_cast<uint32_t>(fileSize)) || !transcoder.start_transcoding())
+        {
+            throw std::runtime_error("=====Failed to initialize Basis Universal transcoder!=====");
+        }
+
+        VkFormat format = transcodeTargetFormat(target, file);
+        FormatBlockInfo info = formatBlockInfo(format);
+        uint32_t width = std::max(file.pixelWidth >> level, 1u);
+        uint32_t height = std::max(file.pixelHeight >> level, 1u);
+        // 压缩格式按block计容量，RGBA32按像素计
+        uint32_t capacity = static_cast<uint32_t>(formatLevelSize(format, width, height) / info.bytesPerBlock);
+        if (!transcoder.transcode_image_level(level, 0, 0, destination, capacity, toBasisFormat(target)))
+        {
+            throw std::runtime_error("=====Failed to transcode KTX2 level " + std::to_string(level) + "=====");
+        }
+    }
+#endif
+}
+
+FormatBlockInfo formatBlockInfo(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+        return {4, 4, 8};
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+        return {4, 4, 16};
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        return {1, 1, 4};
+    default:
+        throw std::runtime_error("=====Unsupported texture format: " + std::to_string(static_cast<int>(format)) + "=====");
+    }
+}
+
+VkDeviceSize formatLevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+    FormatBlockInfo info = formatBlockInfo(format);
+    VkDeviceSize blocksX = (std::max(width, 1u) + info.blockWidth - 1) / info.blockWidth;
+    VkDeviceSize blocksY = (std::max(height, 1u) + info.blockHeight - 1) / info.blockHeight;
+    return blocksX * blocksY * info.bytesPerBlock;
+}
+
+VkFormat transcodeTargetFormat(TranscodeTarget target, const Ktx2File &file)
+{
+    bool srgb = file.srgb || file.vkFormat == VK_FORMAT_R8G8B8A8_SRGB;
+    switch (target)
+    {
+    case TranscodeTarget::BC7:
+        return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    case TranscodeTarget::BC1:
+        return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case TranscodeTarget::ETC2:
+        return srgb ? VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK : VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK;
+    case TranscodeTarget::ASTC4x4:
+        return srgb ? VK_FORMAT_ASTC_4x4_SRGB_BLOCK : VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+    case TranscodeTarget::RGBA8:
+        return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    case TranscodeTarget::Native:
+        return file.vkFormat;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+const char *transcodeTargetName(TranscodeTarget target)
+{
+    switch (target)
+    {
+    case TranscodeTarget::BC7:
+        return "BC7";
+    case TranscodeTarget::BC1:
+        return "BC1";
+    case TranscodeTarget::ETC2:
+        return "ETC2";
+    case TranscodeTarget::ASTC4x4:
+        return "ASTC 4x4";
+    case TranscodeTarget::RGBA8:
+        return "RGBA8";
+    case TranscodeTarget::Native:
+        return "native";
+    }
+    return "unknown";
+}
+
+bool basisTranscoderAvailable()
+{
+#ifdef KUTORY_WITH_BASISU
+    return true;
+#else
+    return false;
+#endif
+}
+
+TranscodeTarget chooseTranscodeTarget(const Ktx2File &file, bool opaque, const std::function<bool(VkFormat)> &isSupported)
+{
+    std::vector<TranscodeTarget> preferences;
+    if (isBasisEncoding(file))
+    {
+        if (!basisTranscoderAvailable())
+        {
+            throw std::runtime_error("=====Basis Universal KTX2 needs the basisu transcoder (set BASISU_TRANSCODER_DIR)!=====");
+        }
+        // ETC1S本身画质有限，不透明时BC1/ETC2 RGB与BC7效果相同而体积只有一半
+        if (file.encoding == Ktx2File::Encoding::Etc1s && opaque)
+        {
+            preferences = {TranscodeTarget::BC1, TranscodeTarget::BC7, TranscodeTarget::ETC2, TranscodeTarget::ASTC4x4, TranscodeTarget::RGBA8};
+        }
+        else
+        {
+            preferences = {TranscodeTarget::BC7, TranscodeTarget::ASTC4x4, TranscodeTarget::ETC2, TranscodeTarget::RGBA8};
+        }
+    }
+    else if (isRgba8(file.vkFormat))
+    {
+        if (opaque)
+        {
+            preferences.push_back(TranscodeTarget::BC1);
+        }
+        preferences.push_back(TranscodeTarget::RGBA8);
+    }
+    else
+    {
+        preferences = {TranscodeTarget::Native};
+    }
+
+    for (TranscodeTarget target : preferences)
+    {
+        if (isSupported(transcodeTargetFormat(target, file)))
+        {
+            return target;
+        }
+    }
+    throw std::runtime_error("=====No supported format for this KTX2 texture!=====");
+}
+
+bool isOpaqueRgba8(const uint8_t *pixels, uint32_t width, uint32_t height)
+{
+    size_t count = static_cast<size_t>(width) * height;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (pixels[i * 4 + 3] != 255)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void encodeBc1(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *destination)
+{
+    uint32_t blocksX = (width + 3) / 4;
+    uint32_t blocksY = (height + 3) / 4;
+    for (uint32_t by = 0; by < blocksY; by++)
+    {
+        for (uint32_t bx = 0; bx < blocksX; bx++)
+        {
+            // 边缘不足4个像素时重复最后一行/列
+            Rgb pixels[16];
+            for (uint32_t y = 0; y < 4; y++)
+            {
+                for (uint32_t x = 0; x < 4; x++)
+                {
+                    uint32_t px = std::min(bx * 4 + x, width - 1);
+                    uint32_t py = std::min(by * 4 + y, height - 1);
+                    const uint8_t *source = rgba + (static_cast<size_t>(py) * width + px) * 4;
+                    pixels[y * 4 + x] = {source[0], source[1], source[2]};
+                }
+            }
+            encodeBc1Block(pixels, destination + (static_cast<size_t>(by) * blocksX + bx) * 8);
+        }
+    }
+}
+
+void transcodeLevel(const Ktx2File &file, const uint8_t *fileData, size_t fileSize, uint32_t level, TranscodeTarget target, void *destination)
+{
+    const Ktx2File::Level &entry = file.levels.at(level);
+    if (entry.byteLength > fileSize || entry.byteOffset > fileSize - entry.byteLength)
+    {
+        throw std::runtime_error("=====KTX2 level " + std::to_string(level) + " is out of range!=====");
+    }
+    const uint8_t *levelData = fileData + entry.byteOffset;
+    uint32_t width = std::max(file.pixelWidth >> level, 1u);
+    uint32_t height = std::max(file.pixelHeight >> level, 1u);
+
+    if (isBasisEncoding(file))
+    {
+#ifdef KUTORY_WITH_BASISU
+        transcodeBasisLevel(file, fileData, fileSize, level, target, destination);
+        return;
+#else
+        throw std::runtime_error("=====Basis Universal transcoder is not available!=====");
+#endif
+    }
+
+    if (target == TranscodeTarget::BC1 && isRgba8(file.vkFormat))
+    {
+        if (entry.byteLength < static_cast<uint64_t>(width) * height * 4)
+        {
+            throw std::runtime_error("=====KTX2 level " + std::to_string(level) + " is smaller than expected!=====");
+        }
+        encodeBc1(levelData, width, height, static_cast<uint8_t *>(destination));
+        return;
+    }
+
+    //Native与RGBA8：文件中的数据本身就是紧密排列的目标格式
+    VkDeviceSize expected = formatLevelSize(transcodeTargetFormat(target, file), width, height);
+    if (entry.byteLength < expected)
+    {
+        throw std::runtime_error("=====KTX2 level " + std::to_string(level) + " is smaller than expected!=====");
+    }
+    memcpy(destination, levelData, static_cast<size_t>(expected));
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "ktx2_file.h"
+
+// 把KTX2中的数据转成设备支持的GPU格式，全部在CPU上完成，不需要Vulkan设备就可以测试
+// - Basis Universal(ETC1S/UASTC)：需要在CMake中指定BASISU_TRANSCODER_DIR，编译进basisu的transcoder
+// - 未压缩的RGBA8：不透明时编码为BC1，否则保持RGBA8
+// - 已经是BC/ETC2/ASTC的数据：原样上传
+
+enum class TranscodeTarget
+{
+    BC7,
+    BC1,
+    ETC2,
+    ASTC4x4,
+    RGBA8,
+    // 不转码，直接使用文件中的vkFormat
+    Native,
+};
+
+struct FormatBlockInfo
+{
+    uint32_t blockWidth = 1;
+    uint32_t blockHeight = 1;
+    uint32_t bytesPerBlock = 4;
+};
+
+FormatBlockInfo formatBlockInfo(VkFormat format);
+// 紧密排列时一级mip的字节数
+VkDeviceSize formatLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+// 目标对应的VkFormat；Native时返回file.vkFormat
+VkFormat transcodeTargetFormat(TranscodeTarget target, const Ktx2File &file);
+const char *transcodeTargetName(TranscodeTarget target);
+
+// 按画质与体积选择设备支持的目标，isSupported一般用vkGetPhysicalDeviceFormatProperties实现
+// 都不支持时抛出std::runtime_error
+TranscodeTarget chooseTranscodeTarget(const Ktx2File &file, bool opaque, const std::function<bool(VkFormat)> &isSupported);
+
+// 未压缩RGBA8数据中是否所有alpha都为255
+bool isOpaqueRgba8(const uint8_t *pixels, uint32_t width, uint32_t height);
+
+// 把RGBA8编码为BC1(每个4x4 block 8字节)，destination至少为formatLevelSize(BC1, width, height)
+void encodeBc1(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *destination);
+
+// 把第level级转码写入destination，destination至少为formatLevelSize(transcodeTargetFormat(target), ...)
+void transcodeLevel(const Ktx2File &file, const uint8_t *fileData, size_t fileSize, uint32_t level, TranscodeTarget target, void *destination);
+
+// 编译时是否带有Basis Universal transcoder
+bool basisTranscoderAvailable();
@@ -0,0 +1,56 @@
+// 命令行数值参数的单元测试：负数、超出目标类型的值、nan/inf都必须被拒绝
+#include <string>
+#include <vector>
+
+#include "app_settings.h"
+#include "test_check.h"
+
+namespace
+{
+    AppSettings parse(const std::string &arg)
+    {
+        std::vector<char *> argv = {const_cast<char *>("DiveintoVulkan"), const_cast<char *>(arg.c_str())};
+        return parseAppSettings(static_cast<int>(argv.size()), argv.data());
+    }
+
+    bool rejected(const std::string &arg, const std::string &what)
+    {
+        return thrownMessage([&] { parse(arg); }) == "=====Invalid value for " + what + "=====";
+    }
+
+    void testUnsigned()
+    {
+        check(parse("--swapchain-images=3").swapChainImageCount == 3, "plain value is accepted");
+        check(rejected("--swapchain-images=-1", "--swapchain-images: -1"), "negative value is rejected");
+        check(rejected("--swapchain-images=+3", "--swapchain-images: +3"), "explicit sign is rejected");
+        check(rejected("--swapchain-images=4294967296", "--swapchain-images: 4294967296"), "value above UINT32_MAX is rejected");
+        check(rejected("--swapchain-images=3x", "--swapchain-images: 3x"), "trailing characters are rejected");
+        check(rejected("--swapchain-images=", "--swapchain-images: "), "empty value is rejected");
+    }
+
+    void testUnsigned64()
+    {
+        check(parse("--capture-start=5000000000").captureStart == 5000000000ull, "--capture-start keeps 64 bits");
+        check(parse("--exit-after=18446744073709551615").exitAfterFrames == UINT64_MAX, "--exit-after accepts UINT64_MAX");
+        check(rejected("--exit-after=18446744073709551616", "--exit-after: 18446744073709551616"), "value above UINT64_MAX is rejected");
+        check(rejected("--capture-start=-1", "--capture-start: -1"), "negative 64-bit value is rejected");
+    }
+
+    void testDouble()
+    {
+        check(parse("--fps-limit=59.94").fpsLimit == 59.94, "decimal value is accepted");
+        check(rejected("--fps-limit=nan", "--fps-limit: nan"), "nan is rejected");
+        check(rejected("--fps-limit=inf", "--fps-limit: inf"), "inf is rejected");
+        check(rejected("--texture-budget-mb=1e999", "--texture-budget-mb: 1e999"), "overflowing value is rejected");
+        check(rejected("--dynamic-resolution=-16", "--dynamic-resolution: -16"), "negative value is rejected");
+    }
+}
+
+int main()
+{
+    testUnsigned();
+    testUnsigned64();
+    testDouble();
+
+    return testResult("app_settings");
+}
@@ -0,0 +1,105 @@
+// 设备打分与--gpu选择的单元测试：用伪造的DeviceCandidate属性表，不需要Vulkan设备或loader
+// 任一检查失败时打印原因并返回非0，由ctest运行
+#include <string>
+#include <vector>
+
+#include "device_selection.h"
+#include "test_check.h"
+
+namespace
+{
+    DeviceCandidate makeCandidate(const std::string &name, VkPhysicalDeviceType deviceType, VkDeviceSize heapMiB)
+    {
+        DeviceCandidate candidate;
+        candidate.name = name;
+        candidate.deviceType = deviceType;
+        candidate.apiVersion = VK_API_VERSION_1_3;
+        candidate.maxImageDimension2D = 16384;
+        candidate.deviceLocalHeapSize = heapMiB * 1024 * 1024;
+        candidate.queueFamilies.push_back({VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, 1, 64, {1, 1, 1}});
+        candidate.meetsRequirements = true;
+        return candidate;
+    }
+
+    // 核显排在前面，并且给它更多的附加项，确认设备类型的权重仍然占优
+    std::vector<DeviceCandidate> makeCandidates()
+    {
+        DeviceCandidate integrated = makeCandidate("Intel(R) UHD Graphics 770", VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 256 * 1024);
+        integrated.queueFamilies.push_back({VK_QUEUE_TRANSFER_BIT, 1, 64, {1, 1, 1}});
+        integrated.queueFamilies.push_back({VK_QUEUE_COMPUTE_BIT, 1, 64, {1, 1, 1}});
+        integrated.extensions = {"VK_KHR_present_wait", "VK_KHR_present_id", "VK_EXT_memory_budget"};
+
+        DeviceCandidate discrete = makeCandidate("NVIDIA GeForce RTX 4070", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 2 * 1024);
+        discrete.apiVersion = VK_API_VERSION_1_2;
+
+        DeviceCandidate cpu = makeCandidate("llvmpipe (LLVM 17.0.6, 256 bits)", VK_PHYSICAL_DEVICE_TYPE_CPU, 0);
+
+        return {integrated, discrete, cpu};
+    }
+
+    void testDiscretePreferred()
+    {
+        std::vector<DeviceCandidate> candidates = makeCandidates();
+        check(scoreDevice(candidates[1]).score > scoreDevice(candidates[0]).score, "discrete GPU scores above integrated GPU");
+
+        DeviceSelection selection = selectDevice(candidates, "");
+        check(selection.index == 1, "empty selector picks the discrete GPU");
+        check(!selection.overridden, "empty selector is not an override");
+    }
+
+    void testUnsuitableSkipped()
+    {
+        std::vector<DeviceCandidate> candidates = makeCandidates();
+        candidates[1].meetsRequirements = false;
+        check(!scoreDevice(candidates[1]).suitable, "device without required support is unsuitable");
+        check(selectDevice(candidates, "").index == 0, "unsuitable discrete GPU falls back to the integrated GPU");
+
+        for (DeviceCandidate &candidate : candidates)
+        {
+            candidate.meetsRequirements = false;
+        }
+        check(thrownMessage([&] { selectDevice(candidates, ""); }) == "=====No suitable GPU!=====", "no suitable device throws");
+    }
+
+    void testNameOverride()
+    {
+        std::vector<DeviceCandidate> candidates = makeCandidates();
+        DeviceSelection selection = selectDevice(candidates, "uhd");
+        check(selection.index == 0, "name selector matches a case-insensitive substring");
+        check(selection.overridden, "name selector is an override");
+
+        check(selectDevice(candidates, "LLVMPIPE").index == 2, "name selector overrides the score");
+        check(thrownMessage([&] { selectDevice(candidates, "radeon"); }) == "=====No GPU matches \"radeon\"!=====",
+            "unknown name throws");
+    }
+
+    void testIndexOverride()
+    {
+        std::vector<DeviceCandidate> candidates = makeCandidates();
+        DeviceSelection selection = selectDevice(candidates, "0");
+        check(selection.index == 0, "index selector picks the device in enumeration order");
+        check(selection.overridden, "index selector is an override");
+        check(selectDevice(candidates, "2").index == 2, "index selector overrides the score");
+
+        check(findDeviceBySelector(candidates, "3") == candidates.size(), "out-of-range index is not found");
+        check(thrownMessage([&] { selectDevice(candidates, "3"); }) == "=====No GPU matches \"3\"!=====", "out-of-range index throws");
+        check(thrownMessage([&] { selectDevice(candidates, "99999999999999999999"); }) ==
+                  "=====Invalid value for --gpu: 99999999999999999999=====",
+            "index beyond unsigned long long throws an invalid value error");
+
+        candidates[2].meetsRequirements = false;
+        check(thrownMessage([&] { selectDevice(candidates, "2"); }) ==
+                  "=====Requested GPU \"llvmpipe (LLVM 17.0.6, 256 bits)\" is not suitable!=====",
+            "overriding with an unsuitable device throws");
+    }
+}
+
+int main()
+{
+    testDiscretePreferred();
+    testUnsuitableSkipped();
+    testNameOverride();
+    testIndexOverride();
+
+    return testResult("device_selection");
+}
@@ -0,0 +1,103 @@
+// 稳定运行时每帧零堆分配的测试：以KUTORY_COUNT_ALLOCATIONS=1编译，替换全局operator new统计分配次数
+// 模拟主循环中每帧的用法：FrameArena按frame in flight轮换，ArenaVector逐个push_back，DrawList清空后重新收集并排序
+// 预热阶段允许分配(arena溢出后扩容、DrawList的vector增长)，之后每一帧的分配次数必须为0
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "allocation_counter.h"
+#include "draw_list.h"
+#include "frame_arena.h"
+#include "test_check.h"
+
+namespace
+{
+    const uint32_t framesInFlight = 2;
+    // 故意比每帧的用量小，让预热阶段经过溢出与扩容
+    const size_t bytesPerFrame = 1024;
+    // 每帧的物体数按这个周期变化
+    const uint32_t workloadPeriod = 8;
+    // 每个slot都要遇到过最大的一帧，溢出之后再reset一次才换成足够大的块
+    const uint32_t warmupFrames = workloadPeriod + framesInFlight;
+    const uint32_t frameCount = 64;
+
+    struct Barrier
+    {
+        uint64_t image;
+        uint32_t oldLayout;
+        uint32_t newLayout;
+    };
+
+    // 一帧的工作量，数量随帧号周期性变化，与真实场景中可见物体数的波动类似
+    void simulateFrame(uint32_t frame, LinearArena &arena, DrawList &drawList)
+    {
+        uint32_t objects = 200 + (frame * 5 % workloadPeriod) * 40;
+
+        ArenaVector<Barrier> barriers{ArenaAllocator<Barrier>(arena)};
+        ArenaVector<uint32_t> visible{ArenaAllocator<uint32_t>(arena)};
+        for (uint32_t i = 0; i < objects; i++)
+        {
+            visible.push_back(i);
+            if (i % 16 == 0)
+            {
+                barriers.push_back({i, 0, 1});
+            }
+        }
+        uint64_t *scratch = arena.allocateArray<uint64_t>(objects);
+        scratch[objects - 1] = visible.back();
+
+        drawList.clear();
+        for (uint32_t object : visible)
+        {
+            DrawKeyFields fields;
+            fields.pipeline = object % 3;
+            fields.material = object % 7;
+            fields.mesh = object % 11;
+            fields.depth = static_cast<float>(object) / objects;
+            drawList.add(packDrawKey(fields), object);
+        }
+        drawList.sort();
+    }
+
+    void testCounterWorks()
+    {
+        check(allocationCountingEnabled(), "test is built with KUTORY_COUNT_ALLOCATIONS=1");
+        AllocationScope scope;
+        std::vector<uint32_t> heap(16);
+        check(scope.allocations() == 1 && scope.bytes() >= heap.size() * sizeof(uint32_t), "a std::vector allocation is counted");
+    }
+
+    void testSteadyStateFrames()
+    {
+        FrameArena frameArena;
+        frameArena.create(framesInFlight, bytesPerFrame);
+        DrawList drawList;
+
+        uint64_t warmupAllocations = 0;
+        uint64_t steadyAllocations = 0;
+        for (uint32_t frame = 0; frame < frameCount; frame++)
+        {
+            uint32_t slot = frame % framesInFlight;
+            AllocationScope frameAllocations;
+            frameArena.beginFrame(slot);
+            simulateFrame(frame, frameArena.current(), drawList);
+            (frame < warmupFrames ? warmupAllocations : steadyAllocations) += frameAllocations.allocations();
+        }
+
+        check(warmupAllocations > 0, "warm-up grows the arenas and the draw list");
+        check(frameArena.arena(0).stats().overflows > 0, "the initial arena capacity overflows");
+        if (steadyAllocations > 0)
+        {
+            fprintf(stderr, "%llu heap allocations after warm-up\n", static_cast<unsigned long long>(steadyAllocations));
+        }
+        check(steadyAllocations == 0, "no heap allocations after warm-up");
+    }
+}
+
+int main()
+{
+    testCounterWorks();
+    testSteadyStateFrames();
+
+    return testResult("frame_allocation");
+}
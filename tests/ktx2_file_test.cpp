@@ -0,0 +1,144 @@
+// KTX2解析与RGBA8转码的单元测试：在内存中拼出KTX2文件，再逐项破坏header、level index与数据
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ktx2_file.h"
+#include "test_check.h"
+#include "texture_transcoder.h"
+
+namespace
+{
+    const uint8_t ktx2Identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+    const size_t headerSize = 80;
+    const size_t levelIndexEntrySize = 24;
+
+    template <typename T>
+    void write(std::vector<uint8_t> &data, size_t offset, T value)
+    {
+        memcpy(data.data() + offset, &value, sizeof(T));
+    }
+
+    // 8x8的不透明RGBA8纹理，完整的mip链(8x8、4x4、2x2、1x1)，没有DFD，数据紧跟在level index之后
+    std::vector<uint8_t> makeRgba8File()
+    {
+        const uint32_t size = 8;
+        const uint32_t levelCount = 4;
+        size_t dataOffset = headerSize + levelCount * levelIndexEntrySize;
+
+        std::vector<uint8_t> levelData;
+        std::vector<uint64_t> offsets;
+        for (uint32_t level = 0; level < levelCount; level++)
+        {
+            uint32_t extent = size >> level;
+            offsets.push_back(dataOffset + levelData.size());
+            for (uint32_t i = 0; i < extent * extent; i++)
+            {
+                uint8_t value = static_cast<uint8_t>(level * 64 + i);
+                levelData.insert(levelData.end(), {value, static_cast<uint8_t>(255 - value), 128, 255});
+            }
+        }
+
+        std::vector<uint8_t> data(dataOffset + levelData.size(), 0);
+        memcpy(data.data(), ktx2Identifier, sizeof(ktx2Identifier));
+        write<uint32_t>(data, 12, VK_FORMAT_R8G8B8A8_UNORM);
+        write<uint32_t>(data, 16, 1);
+        write<uint32_t>(data, 20, size);
+        write<uint32_t>(data, 24, size);
+        write<uint32_t>(data, 36, 1);
+        write<uint32_t>(data, 40, levelCount);
+        for (uint32_t level = 0; level < levelCount; level++)
+        {
+            uint64_t length = static_cast<uint64_t>(size >> level) * (size >> level) * 4;
+            size_t entry = headerSize + level * levelIndexEntrySize;
+            write<uint64_t>(data, entry, offsets[level]);
+            write<uint64_t>(data, entry + 8, length);
+            write<uint64_t>(data, entry + 16, length);
+        }
+        memcpy(data.data() + dataOffset, levelData.data(), levelData.size());
+        return data;
+    }
+
+    Ktx2File parse(const std::vector<uint8_t> &data)
+    {
+        return Ktx2File::parse(data.data(), data.size());
+    }
+
+    void testValidFile()
+    {
+        std::vector<uint8_t> data = makeRgba8File();
+        Ktx2File file = parse(data);
+        check(file.vkFormat == VK_FORMAT_R8G8B8A8_UNORM, "format is read from the header");
+        check(file.pixelWidth == 8 && file.pixelHeight == 8, "size is read from the header");
+        check(file.levels.size() == 4, "every level index entry is read");
+        check(file.encoding == Ktx2File::Encoding::Native, "file without DFD is native");
+
+        const Ktx2File::Level &level0 = file.levels[0];
+        check(isOpaqueRgba8(data.data() + level0.byteOffset, 8, 8), "level 0 is opaque");
+
+        std::vector<uint8_t> rgba(static_cast<size_t>(formatLevelSize(VK_FORMAT_R8G8B8A8_UNORM, 4, 4)));
+        transcodeLevel(file, data.data(), data.size(), 1, TranscodeTarget::Native, rgba.data());
+        check(memcmp(rgba.data(), data.data() + file.levels[1].byteOffset, rgba.size()) == 0, "native level 1 is copied unchanged");
+
+        std::vector<uint8_t> bc1(static_cast<size_t>(formatLevelSize(VK_FORMAT_BC1_RGB_UNORM_BLOCK, 8, 8)));
+        check(bc1.size() == 32, "8x8 BC1 is four 8-byte blocks");
+        transcodeLevel(file, data.data(), data.size(), 0, TranscodeTarget::BC1, bc1.data());
+    }
+
+    void testTruncatedLevelIndex()
+    {
+        std::vector<uint8_t> data = makeRgba8File();
+        // 第一项只剩byteOffset
+        data.resize(headerSize + 8);
+        check(thrownMessage([&] { parse(data); }) == "=====Truncated KTX2 file!=====", "truncated level index throws");
+
+        data.resize(headerSize - 1);
+        check(thrownMessage([&] { parse(data); }) == "=====Not a KTX2 file!=====", "truncated header throws");
+    }
+
+    void testOverflowingLevelIndex()
+    {
+        // byteOffset + byteLength回绕成16，按相加比较会被当作合法
+        std::vector<uint8_t> data = makeRgba8File();
+        write<uint64_t>(data, headerSize, 0xFFFFFFFFFFFFFFF0ull);
+        write<uint64_t>(data, headerSize + 8, 32);
+        check(thrownMessage([&] { parse(data); }) == "=====KTX2 level 0 is out of range!=====", "wrapping byteOffset throws");
+
+        data = makeRgba8File();
+        write<uint64_t>(data, headerSize + 8, data.size() + 1);
+        check(thrownMessage([&] { parse(data); }) == "=====KTX2 level 0 is out of range!=====", "byteLength beyond the file throws");
+
+        data = makeRgba8File();
+        write<uint32_t>(data, 40, 5);
+        check(thrownMessage([&] { parse(data); }) == "=====KTX2 file has 5 levels, at most 4 are possible!=====",
+            "more levels than the mip chain throws");
+    }
+
+    void testTruncatedLevelData()
+    {
+        // level index本身合法，但level 0比8x8 RGBA8需要的256字节短
+        std::vector<uint8_t> data = makeRgba8File();
+        write<uint64_t>(data, headerSize + 8, 16);
+        Ktx2File file = parse(data);
+
+        std::vector<uint8_t> bc1(static_cast<size_t>(formatLevelSize(VK_FORMAT_BC1_RGB_UNORM_BLOCK, 8, 8)));
+        check(thrownMessage([&] { transcodeLevel(file, data.data(), data.size(), 0, TranscodeTarget::BC1, bc1.data()); }) ==
+                  "=====KTX2 level 0 is smaller than expected!=====",
+            "short RGBA8 level is not encoded to BC1");
+
+        std::vector<uint8_t> rgba(static_cast<size_t>(formatLevelSize(VK_FORMAT_R8G8B8A8_UNORM, 8, 8)));
+        check(thrownMessage([&] { transcodeLevel(file, data.data(), data.size(), 0, TranscodeTarget::Native, rgba.data()); }) ==
+                  "=====KTX2 level 0 is smaller than expected!=====",
+            "short native level is not copied");
+    }
+}
+
+int main()
+{
+    testValidFile();
+    testTruncatedLevelIndex();
+    testOverflowingLevelIndex();
+    testTruncatedLevelData();
+
+    return testResult("ktx2_file");
+}
@@ -0,0 +1,191 @@
+// 网格处理各步骤的单元测试：在程序生成的平面网格上检查顶点缓存优化、简化、LOD选择与.kmesh的写入/映射/解析
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "mesh_file.h"
+#include "mesh_processing.h"
+#include "test_check.h"
+
+namespace
+{
+    // size x size个格子的平面，轻微起伏让QEM有非零误差；indices按列优先输出，顶点缓存命中很差
+    void makeGrid(uint32_t size, std::vector<MeshVertex> &vertices, std::vector<uint32_t> &indices)
+    {
+        uint32_t stride = size + 1;
+        for (uint32_t y = 0; y <= size; y++)
+        {
+            for (uint32_t x = 0; x <= size; x++)
+            {
+                MeshVertex vertex;
+                vertex.position[0] = static_cast<float>(x);
+                vertex.position[1] = static_cast<float>(y);
+                vertex.position[2] = 0.05f * std::sin(x * 0.4f) * std::cos(y * 0.3f);
+                vertex.uv[0] = static_cast<float>(x) / size;
+                vertex.uv[1] = static_cast<float>(y) / size;
+                vertices.push_back(vertex);
+            }
+        }
+        for (uint32_t x = 0; x < size; x++)
+        {
+            for (uint32_t y = 0; y < size; y++)
+            {
+                uint32_t v = y * stride + x;
+                indices.insert(indices.end(), {v, v + 1, v + stride + 1, v, v + stride + 1, v + stride});
+            }
+        }
+    }
+
+    // 旋转到最小索引在前，保持绕序，再整体排序，用于比较两组三角形是否相同
+    std::vector<uint64_t> canonicalTriangles(const std::vector<uint32_t> &indices)
+    {
+        std::vector<uint64_t> keys;
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            uint32_t a = indices[t], b = indices[t + 1], c = indices[t + 2];
+            while (a > b || a > c)
+            {
+                uint32_t first = a;
+                a = b;
+                b = c;
+                c = first;
+            }
+            keys.push_back((uint64_t(a) << 42) | (uint64_t(b) << 21) | c);
+        }
+        std::sort(keys.begin(), keys.end());
+        return keys;
+    }
+
+    void testVertexCache()
+    {
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t> indices;
+        makeGrid(32, vertices, indices);
+
+        std::vector<uint32_t> optimized = optimizeVertexCache(indices, vertices.size());
+        check(optimized.size() == indices.size(), "vertex cache optimization keeps every index");
+        check(canonicalTriangles(optimized) == canonicalTriangles(indices), "vertex cache optimization keeps the triangles and winding");
+
+        VertexCacheStats before = analyzeVertexCache(indices, vertices.size());
+        VertexCacheStats after = analyzeVertexCache(optimized, vertices.size());
+        check(after.acmr < before.acmr, "vertex cache optimization lowers ACMR");
+        check(after.acmr < 0.8f, "optimized grid is close to the ideal ACMR of 0.5");
+
+        std::vector<uint32_t> overdraw = optimizeOverdraw(optimized, vertices);
+        check(canonicalTriangles(overdraw) == canonicalTriangles(indices), "overdraw optimization keeps the triangles and winding");
+
+        std::vector<uint32_t> remap = optimizeVertexFetchRemap(optimized, vertices.size());
+        uint32_t next = 0;
+        bool firstUse = true;
+        for (uint32_t index : optimized)
+        {
+            firstUse = firstUse && remap[index] <= next;
+            next = std::max(next, remap[index] + 1);
+        }
+        check(firstUse && next == vertices.size(), "vertex fetch remap numbers vertices by first use");
+
+        std::vector<uint32_t> partial(optimized.begin(), optimized.begin() + 3);
+        std::vector<uint32_t> partialRemap = optimizeVertexFetchRemap(partial, vertices.size());
+        check(std::count(partialRemap.begin(), partialRemap.end(), UINT32_MAX) == static_cast<long>(vertices.size() - 3),
+            "unused vertices map to UINT32_MAX");
+    }
+
+    void testSimplify()
+    {
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t> indices;
+        makeGrid(32, vertices, indices);
+
+        size_t target = indices.size() / 4;
+        float error = 0.0f;
+        std::vector<uint32_t> simplified = simplifyMesh(indices, vertices, target, 0.5f, &error);
+        check(simplified.size() % 3 == 0, "simplified mesh is a triangle list");
+        check(simplified.size() <= target, "simplification reaches the target index count");
+        check(simplified.size() > 0, "simplification keeps some triangles");
+        check(error > 0.0f && error <= 0.5f, "simplification error is positive and within the target");
+        check(std::all_of(simplified.begin(), simplified.end(), [&](uint32_t index) { return index < vertices.size(); }),
+            "simplified indices reference the original vertex buffer");
+
+        float strictError = 0.0f;
+        std::vector<uint32_t> strict = simplifyMesh(indices, vertices, target, 0.0001f, &strictError);
+        check(strict.size() > simplified.size(), "a smaller error budget keeps more triangles");
+        check(strictError <= 0.0001f, "simplification never exceeds the error budget");
+    }
+
+    void testSelectLod()
+    {
+        MeshLod lods[3];
+        lods[1].error = 0.01f;
+        lods[2].error = 0.1f;
+        float projectionScale = 1000.0f;
+        check(selectMeshLod(lods, 3, 0.0f, projectionScale, 1.0f) == 0, "camera inside the bounds uses LOD 0");
+        check(selectMeshLod(lods, 3, 5.0f, projectionScale, 1.0f) == 0, "near camera uses LOD 0");
+        check(selectMeshLod(lods, 3, 20.0f, projectionScale, 1.0f) == 1, "LOD 1 once its error is under a pixel");
+        check(selectMeshLod(lods, 3, 200.0f, projectionScale, 1.0f) == 2, "far camera uses the coarsest LOD");
+        check(selectMeshLod(lods, 3, 20.0f, projectionScale, 0.1f) == 0, "a stricter pixel threshold keeps LOD 0");
+    }
+
+    void testMeshFileRoundTrip()
+    {
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t> indices;
+        makeGrid(32, vertices, indices);
+        MeshImportOptions options;
+        options.lodMaxError = 0.5f;
+        MeshAsset asset = importMesh(vertices, indices, options);
+        check(asset.lods.size() > 1, "import builds a LOD chain");
+        for (size_t i = 1; i < asset.lods.size(); i++)
+        {
+            check(asset.lods[i].indexCount < asset.lods[i - 1].indexCount, "each LOD has fewer triangles");
+            check(asset.lods[i].error >= asset.lods[i - 1].error, "each LOD has at least the previous error");
+        }
+        bool withinLimits = true;
+        for (const Meshlet &meshlet : asset.meshlets)
+        {
+            withinLimits = withinLimits && meshlet.vertexCount <= options.meshletMaxVertices && meshlet.triangleCount <= options.meshletMaxTriangles;
+        }
+        check(!asset.meshlets.empty() && withinLimits, "meshlets respect the vertex and triangle limits");
+
+        const std::string path = "mesh_processing_test.kmesh";
+        writeMeshFile(path, asset);
+        {
+            MappedFile mapped(path);
+            MeshFile file = MeshFile::parse(mapped.data(), mapped.size());
+            check(file.vertexCount == asset.vertices.size() &&
+                      memcmp(file.vertices, asset.vertices.data(), asset.vertices.size() * sizeof(PackedVertex)) == 0,
+                "vertices survive the round trip");
+            check(file.indexCount == asset.indices.size() && memcmp(file.indices, asset.indices.data(), asset.indices.size() * sizeof(uint32_t)) == 0,
+                "indices survive the round trip");
+            check(file.lodCount == asset.lods.size() && memcmp(file.lods, asset.lods.data(), asset.lods.size() * sizeof(MeshLod)) == 0,
+                "LODs survive the round trip");
+            check(file.meshletCount == asset.meshlets.size() && memcmp(file.meshlets, asset.meshlets.data(), asset.meshlets.size() * sizeof(Meshlet)) == 0,
+                "meshlets survive the round trip");
+            check(file.meshletVertexCount == asset.meshletVertices.size() && file.meshletTriangleBytes == asset.meshletTriangles.size(),
+                "meshlet data sizes survive the round trip");
+            check(file.radius == asset.radius && memcmp(&file.quantization, &asset.quantization, sizeof(MeshQuantization)) == 0,
+                "bounds and quantization survive the round trip");
+
+            std::vector<uint32_t> aligned((mapped.size() + 3) / 4);
+            memcpy(aligned.data(), mapped.data(), mapped.size());
+            const uint8_t *bytes = reinterpret_cast<const uint8_t *>(aligned.data());
+            check(thrownMessage([&] { MeshFile::parse(bytes, mapped.size() - 16); }).find("=====Mesh file section out of range") == 0,
+                "truncated mesh file throws");
+            check(thrownMessage([&] { MeshFile::parse(bytes, 64); }) == "=====Not a mesh file!=====", "truncated header throws");
+        }
+        remove(path.c_str());
+    }
+}
+
+int main()
+{
+    testVertexCache();
+    testSimplify();
+    testSelectLod();
+    testMeshFileRoundTrip();
+
+    return testResult("mesh_processing");
+}
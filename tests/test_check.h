@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+// tests/中各个测试共用的检查函数：失败时打印原因并计数，main最后按testFailures返回
+inline int testFailures = 0;
+
+inline void check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "FAILED: %s\n", what);
+        testFailures++;
+    }
+}
+
+// 返回抛出的std::runtime_error的内容，没有抛出时返回空字符串
+inline std::string thrownMessage(const std::function<void()> &call)
+{
+    try
+    {
+        call();
+    }
+    catch (const std::runtime_error &e)
+    {
+        return e.what();
+    }
+    return "";
+}
+
+// 打印结果并返回main的退出码
+inline int testResult(const char *name)
+{
+    if (testFailures > 0)
+    {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, testFailures);
+        return 1;
+    }
+    printf("%s: all checks passed\n", name);
+    return 0;
+}
@@ -0,0 +1,112 @@
+// 离线吞吐量渲染：jobs个互不相关的城市场景，每个沿一条街道渲染frames帧，分给所有设备的所有queue同时渲染
+// 每个worker线程占用一个queue，调度器按测得的帧/秒分配帧块，结束时输出每个worker与总的吞吐量
+// 用法：batch_render [--jobs=8] [--frames=120] [--grid=32] [--size=1280x720] [--devices=<index|name,...>]
+//                    [--queues-per-device=2] [--frames-in-flight=2] [--chunk-ms=250] [--output=out/job%02d_%05d.png]
+//                    [--shader-dir=shader]
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "batch_renderer.h"
+
+namespace
+{
+    struct Options
+    {
+        uint32_t jobs = 8;
+        uint32_t frames = 120;
+        uint32_t grid = 32;
+        double chunkMs = 250.0;
+        BatchRenderer::Config renderer;
+    };
+
+    Options parseOptions(int argc, char **argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; i++)
+        {
+            const char *arg = argv[i];
+            if (sscanf(arg, "--jobs=%u", &options.jobs) == 1)
+                continue;
+            if (sscanf(arg, "--frames=%u", &options.frames) == 1)
+                continue;
+            if (sscanf(arg, "--grid=%u", &options.grid) == 1)
+                continue;
+            if (sscanf(arg, "--size=%ux%u", &options.renderer.width, &options.renderer.height) == 2)
+                continue;
+            if (sscanf(arg, "--queues-per-device=%u", &options.renderer.queuesPerDevice) == 1)
+                continue;
+            if (sscanf(arg, "--frames-in-flight=%u", &options.renderer.framesInFlight) == 1)
+                continue;
+            if (sscanf(arg, "--chunk-ms=%lf", &options.chunkMs) == 1)
+                continue;
+            if (strncmp(arg, "--devices=", 10) == 0)
+                options.renderer.devices = arg + 10;
+            else if (strncmp(arg, "--output=", 9) == 0)
+                options.renderer.outputPattern = arg + 9;
+            else if (strncmp(arg, "--shader-dir=", 13) == 0)
+                options.renderer.shaderDirectory = arg + 13;
+            else
+                throw std::runtime_error(std::string("=====Unknown argument: ") + arg + "=====");
+        }
+        options.jobs = std::max(options.jobs, 1u);
+        options.frames = std::max(options.frames, 1u);
+        options.grid = std::max(options.grid, 2u);
+        options.renderer.width = std::max(options.renderer.width, 1u);
+        options.renderer.height = std::max(options.renderer.height, 1u);
+        options.renderer.scheduler.chunkSeconds = std::max(options.chunkMs, 1.0) / 1000.0;
+
+        //任务编号与帧号都要出现在文件名中，否则不同的帧会互相覆盖
+        const std::string &output = options.renderer.outputPattern;
+        if (!output.empty() && std::count(output.begin(), output.end(), '%') < 2)
+        {
+            throw std::runtime_error("=====--output needs two %d placeholders (job, frame): " + output + "=====");
+        }
+        return options;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+
+        std::vector<BatchJob> jobs(options.jobs);
+        for (uint32_t i = 0; i < options.jobs; i++)
+        {
+            jobs[i].name = "job" + std::to_string(i);
+            jobs[i].seed = i + 1;
+            jobs[i].grid = options.grid;
+            jobs[i].frames = options.frames;
+        }
+
+        BatchRenderer renderer;
+        renderer.setConfig(options.renderer);
+        renderer.create();
+        printf("%u jobs x %u frames (%ux%u, %u buildings each) on %u workers\n", options.jobs, options.frames, options.renderer.width,
+            options.renderer.height, options.grid * options.grid, renderer.workerCount());
+
+        BatchResult result = renderer.run(jobs);
+
+        printf("\n%-4s %-40s %6s %8s %8s %10s\n", "gpu", "device", "queue", "frames", "chunks", "frames/s");
+        for (const BatchWorkerResult &worker : result.workers)
+        {
+            printf("%-4u %-40.40s %6u %8llu %8u %10.1f\n", worker.deviceIndex, worker.deviceName.c_str(), worker.queueIndex,
+                static_cast<unsigned long long>(worker.frames), worker.chunks, worker.framesPerSecond);
+        }
+        printf("\n%llu frames in %.2f s: %.1f frames/s\n", static_cast<unsigned long long>(result.frames), result.seconds,
+            result.seconds > 0.0 ? result.frames / result.seconds : 0.0);
+        renderer.destroy();
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,168 @@
+// 离线网格处理：OBJ -> .kmesh(见src/mesh_file.h)
+// 输出每一步的统计：顶点缓存ACMR、各级LOD的三角形数与误差、meshlet数量、量化误差与文件大小，
+// 最后重新mmap写出的文件并检查内容，再用selectMeshLod列出不同距离下选中的LOD
+// 用法：mesh_convert input.obj output.kmesh [--lods=6] [--lod-reduction=0.5] [--lod-error=0.05]
+//                    [--meshlet-vertices=64] [--meshlet-triangles=124] [--pixel-error=1]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "mesh_file.h"
+#include "mesh_processing.h"
+#include "obj_loader.h"
+
+namespace
+{
+    struct Options
+    {
+        std::string input;
+        std::string output;
+        MeshImportOptions import;
+        float pixelError = 1.0f;
+    };
+
+    Options parseOptions(int argc, char **argv)
+    {
+        Options options;
+        std::vector<std::string> paths;
+        for (int i = 1; i < argc; i++)
+        {
+            const char *arg = argv[i];
+            if (sscanf(arg, "--lods=%u", &options.import.maxLods) == 1)
+                continue;
+            if (sscanf(arg, "--lod-reduction=%f", &options.import.lodReduction) == 1)
+                continue;
+            if (sscanf(arg, "--lod-error=%f", &options.import.lodMaxError) == 1)
+                continue;
+            if (sscanf(arg, "--meshlet-vertices=%u", &options.import.meshletMaxVertices) == 1)
+                continue;
+            if (sscanf(arg, "--meshlet-triangles=%u", &options.import.meshletMaxTriangles) == 1)
+                continue;
+            if (sscanf(arg, "--pixel-error=%f", &options.pixelError) == 1)
+                continue;
+            if (strncmp(arg, "--", 2) == 0)
+                throw std::runtime_error(std::string("=====Unknown argument: ") + arg + "=====");
+            paths.push_back(arg);
+        }
+        if (paths.size() != 2)
+        {
+            throw std::runtime_error("=====Usage: mesh_convert input.obj output.kmesh [options]=====");
+        }
+        options.input = paths[0];
+        options.output = paths[1];
+        return options;
+    }
+
+    double elapsedMs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t> indices;
+        loadObj(options.input, vertices, indices);
+        printf("%s: %zu vertices, %zu triangles (loaded in %.1f ms)\n", options.input.c_str(), vertices.size(), indices.size() / 3,
+            elapsedMs(start));
+
+        start = std::chrono::steady_clock::now();
+        MeshAsset asset = importMesh(vertices, indices, options.import);
+        printf("processed in %.1f ms\n\n", elapsedMs(start));
+
+        //原始顺序与优化后的LOD0(已经重排过顶点，只比较缓存命中)
+        std::vector<uint32_t> lod0(asset.indices.begin(), asset.indices.begin() + asset.lods[0].indexCount);
+        VertexCacheStats before = analyzeVertexCache(indices, vertices.size());
+        VertexCacheStats after = analyzeVertexCache(lod0, asset.vertices.size());
+        printf("vertex cache (FIFO 16): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.acmr, after.acmr, before.atvr, after.atvr);
+
+        //同一个屏幕误差阈值下，每一级开始被选中的距离：1080p、垂直视角60度
+        float projectionScale = 1080.0f / (2.0f * std::tan(0.5236f));
+        printf("\n%-4s %10s %10s %10s %12s %14s\n", "lod", "triangles", "meshlets", "error", "error/radius", "from distance");
+        for (size_t i = 0; i < asset.lods.size(); i++)
+        {
+            const MeshLod &lod = asset.lods[i];
+            float distance = lod.error * projectionScale / options.pixelError;
+            printf("%-4zu %10u %10u %10.5f %12.5f %14.2f\n", i, lod.indexCount / 3, lod.meshletCount, lod.error,
+                lod.error / std::max(asset.radius, 1e-20f), distance);
+        }
+
+        uint32_t meshletTriangles = 0;
+        uint32_t meshletVertices = 0;
+        for (uint32_t i = asset.lods[0].meshletOffset; i < asset.lods[0].meshletOffset + asset.lods[0].meshletCount; i++)
+        {
+            meshletTriangles += asset.meshlets[i].triangleCount;
+            meshletVertices += asset.meshlets[i].vertexCount;
+        }
+        if (asset.lods[0].meshletCount > 0)
+        {
+            printf("\nLOD0 meshlets: %.1f vertices, %.1f triangles on average (limit %u/%u)\n",
+                float(meshletVertices) / asset.lods[0].meshletCount, float(meshletTriangles) / asset.lods[0].meshletCount,
+                options.import.meshletMaxVertices, options.import.meshletMaxTriangles);
+        }
+
+        //量化误差：原始顶点用同样的参数量化再还原
+        float positionError = 0.0f;
+        float normalError = 0.0f;
+        for (const MeshVertex &vertex : vertices)
+        {
+            MeshVertex decoded = dequantizeVertex(quantizeVertex(vertex, asset.quantization), asset.quantization);
+            for (int k = 0; k < 3; k++)
+            {
+                positionError = std::max(positionError, std::fabs(decoded.position[k] - vertex.position[k]));
+            }
+            const float *n = vertex.normal;
+            float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length > 0.0f)
+            {
+                float cosine = (decoded.normal[0] * n[0] + decoded.normal[1] * n[1] + decoded.normal[2] * n[2]) / length;
+                normalError = std::max(normalError, std::acos(std::min(cosine, 1.0f)));
+            }
+        }
+        printf("quantization: %zu -> %zu bytes per vertex, max position error %.6f (%.6f of radius), max normal error %.4f degrees\n",
+            sizeof(MeshVertex), sizeof(PackedVertex), positionError, positionError / std::max(asset.radius, 1e-20f),
+            normalError * 57.29578f);
+
+        writeMeshFile(options.output, asset);
+
+        //重新映射并检查，确认文件可以直接使用
+        MappedFile mapped(options.output);
+        MeshFile file = MeshFile::parse(mapped.data(), mapped.size());
+        if (file.vertexCount != asset.vertices.size() || file.indexCount != asset.indices.size() || file.lodCount != asset.lods.size() ||
+            memcmp(file.vertices, asset.vertices.data(), asset.vertices.size() * sizeof(PackedVertex)) != 0 ||
+            memcmp(file.indices, asset.indices.data(), asset.indices.size() * sizeof(uint32_t)) != 0)
+        {
+            throw std::runtime_error("=====Mesh file verification failed!=====");
+        }
+        size_t originalBytes = vertices.size() * sizeof(MeshVertex) + indices.size() * sizeof(uint32_t);
+        printf("wrote %s: %zu bytes (source vertices + indices %zu bytes)\n", options.output.c_str(), mapped.size(), originalBytes);
+
+        //与运行时相同：直接用映射的LOD表选择，距离为到包围球表面的距离
+        printf("LOD at distance (x radius):");
+        for (float multiple = 1.0f; multiple <= 1024.0f; multiple *= 4.0f)
+        {
+            uint32_t lod = selectMeshLod(file.lods, file.lodCount, multiple * file.radius, projectionScale, options.pixelError);
+            printf(" %g:%u", multiple, lod);
+        }
+        printf("\n");
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}